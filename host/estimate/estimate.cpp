@@ -0,0 +1,81 @@
+// Estimation sur l'hôte : le PrintEstimator du firmware (GcodeParser + modèle du
+// planificateur) appliqué à des fichiers locaux, avec le débit en lignes/s.
+//
+//   pio run -e native_estimate
+//   .pio/build/native_estimate/program [--no-cache] [--repeat N] job.gcode...
+//       --no-cache : supprime le .est avant chaque passe (mesure du calcul complet)
+//       --repeat N : N passes par fichier, la plus rapide est retenue
+#include <Arduino.h>
+#include "print_estimator.h"
+#include "storage_mmap.h"
+#include <string>
+
+static void usage() {
+  fprintf(stderr, "usage: estimate [--no-cache] [--repeat N] FILE...\n");
+}
+
+int main(int argc, char **argv) {
+  bool noCache = false;
+  int repeat = 1;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; first++) {
+    if (!strcmp(argv[first], "--no-cache")) {
+      noCache = true;
+    } else if (!strcmp(argv[first], "--repeat") && first + 1 < argc) {
+      repeat = atoi(argv[++first]);
+      if (repeat < 1) repeat = 1;
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (first >= argc) {
+    usage();
+    return 2;
+  }
+
+  int failures = 0;
+  for (int i = first; i < argc; i++) {
+    // Le répertoire du fichier tient lieu de carte SD ; le .est s'écrit à côté
+    std::string arg(argv[i]);
+    size_t slash = arg.rfind('/');
+    std::string root = slash == std::string::npos ? "." : arg.substr(0, slash);
+    std::string path = "/" + (slash == std::string::npos ? arg : arg.substr(slash + 1));
+    if (root.empty()) root = "/";
+    MmapStorage storage(root.c_str());
+    if (!storage.begin()) {
+      fprintf(stderr, "%s: répertoire illisible\n", root.c_str());
+      failures++;
+      continue;
+    }
+    char cache[SD_PATH_MAX];
+    PrintEstimator::cachePath(path.c_str(), cache, sizeof(cache));
+
+    EstimateResult result, best = {};
+    int64_t bestUs = -1;
+    bool ok = true;
+    for (int r = 0; r < repeat && ok; r++) {
+      if (noCache) storage.remove(cache);
+      int64_t t0 = esp_timer_get_time();
+      ok = printEstimator.estimate(&storage, path.c_str(), result);
+      int64_t us = esp_timer_get_time() - t0;
+      if (ok && (bestUs < 0 || us < bestUs)) {
+        bestUs = us;
+        best = result;
+      }
+    }
+    if (!ok) {
+      printf("ERROR: Estimate failed for %s\n", argv[i]);
+      failures++;
+      continue;
+    }
+    unsigned long total = (unsigned long)(best.seconds + 0.5f);
+    double linesPerS = bestUs > 0 ? best.lines * 1e6 / (double)bestUs : 0.0;
+    printf("ESTIMATE file=%s bytes=%lu lines=%lu moves=%lu time_s=%.1f time=%luh%02lum%02lus "
+           "filament_mm=%.1f us=%lld lines_per_s=%.0f cached=%d\n",
+           argv[i], (unsigned long)best.bytes, (unsigned long)best.lines, (unsigned long)best.moves,
+           best.seconds, total / 3600, (total / 60) % 60, total % 60, best.filamentMm,
+           (long long)bestUs, linesPerS, best.cached ? 1 : 0);
+  }
+  return failures ? 1 : 0;
+}
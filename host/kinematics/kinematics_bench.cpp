@@ -0,0 +1,99 @@
+// Cinématiques du firmware sur l'hôte : aller-retour inverse/forward sur une grille du
+// volume, coût par segment, et pour la delta l'écart au milieu des segments (les chariots
+// vont en ligne droite d'une extrémité à l'autre, l'effecteur non) selon la vitesse.
+//
+//   pio run -e native_kinematics
+//   .pio/build/native_kinematics/program [--repeat N]
+//       --repeat N : N passes du banc, la plus rapide est retenue
+// Code 1 si un aller-retour dépasse KINEMATICS_TEST_TOLERANCE_UM.
+#include <Arduino.h>
+#include "kinematics.h"
+
+struct Midpoint {
+  const Kinematics *k;
+  float last[3];
+  bool hasLast;
+  float maxErrorMm;
+  float from[3], to[3];   // Droite demandée
+};
+
+// Distance du milieu moteur de chaque segment, repassé en cartésien, à la droite demandée
+static bool midpointError(const float motor[4], void *context) {
+  Midpoint *m = (Midpoint *)context;
+  if (m->hasLast) {
+    float mid[3] = { 0.5f * (m->last[0] + motor[0]), 0.5f * (m->last[1] + motor[1]), 0.5f * (m->last[2] + motor[2]) };
+    float cart[3];
+    if (m->k->forward(mid, cart)) {
+      double d[3], u[3], len = 0.0, dot = 0.0;
+      for (int i = 0; i < 3; i++) {
+        u[i] = m->to[i] - m->from[i];
+        d[i] = cart[i] - m->from[i];
+        len += u[i] * u[i];
+        dot += d[i] * u[i];
+      }
+      double t = len > 0.0 ? dot / len : 0.0, dist = 0.0;
+      for (int i = 0; i < 3; i++) dist += (d[i] - t * u[i]) * (d[i] - t * u[i]);
+      if (sqrt(dist) > m->maxErrorMm) m->maxErrorMm = (float)sqrt(dist);
+    }
+  }
+  memcpy(m->last, motor, sizeof(m->last));
+  m->hasLast = true;
+  return true;
+}
+
+int main(int argc, char **argv) {
+  int repeat = 3;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+      if (repeat < 1) repeat = 1;
+    } else {
+      fprintf(stderr, "usage: kinematics_bench [--repeat N]\n");
+      return 2;
+    }
+  }
+
+  static const char *const names[3] = { "cartesian", "corexy", "delta" };
+  bool all = true;
+  for (int t = 0; t < 3; t++) {
+    KinematicsTestResult r = machineKinematics.selfTest((KinematicsType)t);
+    all = all && r.pass;
+    printf("KIN_TEST model=%s points=%u unreachable=%u max_err_um=%.3f tolerance_um=%.1f pass=%d\n", names[t],
+           (unsigned)r.points, (unsigned)r.unreachable, r.maxErrorUm, (float)KINEMATICS_TEST_TOLERANCE_UM,
+           r.pass ? 1 : 0);
+  }
+  for (int t = 0; t < 3; t++) {
+    KinematicsBenchResult best = machineKinematics.bench((KinematicsType)t);
+    for (int k = 1; k < repeat; k++) {
+      KinematicsBenchResult r = machineKinematics.bench((KinematicsType)t);
+      if (r.nsPerSegment > 0.0f && r.nsPerSegment < best.nsPerSegment) best = r;
+    }
+    printf("KIN_BENCH model=%s segments=%u ns_per_segment=%.1f budget_pct=%d max_segments_per_s=%u "
+           "max_feed_mm_s=%.0f\n",
+           names[t], (unsigned)best.segments, best.nsPerSegment, KINEMATICS_CPU_BUDGET_PCT,
+           (unsigned)best.maxSegmentsPerS, best.maxFeedMmS);
+  }
+
+  // Traversée du volume à vitesse croissante : segments plus longs, écart plus grand
+  const Kinematics &delta = machineKinematics.model(KinematicsType::DELTA);
+  const float from[4] = { -DELTA_PRINTABLE_RADIUS_MM * 0.7f, -DELTA_PRINTABLE_RADIUS_MM * 0.3f, 0.2f, 0.0f };
+  const float to[4] = { DELTA_PRINTABLE_RADIUS_MM * 0.7f, DELTA_PRINTABLE_RADIUS_MM * 0.5f, 0.2f, 5.0f };
+  static const float feeds[] = { 25.0f, 50.0f, 100.0f, 200.0f, 400.0f };
+  for (size_t f = 0; f < sizeof(feeds) / sizeof(feeds[0]); f++) {
+    Midpoint m = {};
+    m.k = &delta;
+    memcpy(m.from, from, sizeof(m.from));
+    memcpy(m.to, to, sizeof(m.to));
+    // Point de départ du premier segment
+    float start[3];
+    delta.inverse(from, start);
+    memcpy(m.last, start, sizeof(m.last));
+    m.hasLast = true;
+    uint32_t n = delta.segmentCount(from, to, feeds[f]);
+    delta.split(from, to, n, midpointError, &m);
+    float length = hypotf(to[0] - from[0], to[1] - from[1]);
+    printf("KIN_DELTA feed_mm_s=%.0f sps=%u segments=%u segment_mm=%.3f midpoint_err_um=%.2f\n", feeds[f],
+           (unsigned)DELTA_SEGMENTS_PER_SECOND, (unsigned)n, length / n, m.maxErrorMm * 1000.0f);
+  }
+  return all ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+// Prétraitement sur l'hôte : le MotionOptimizer du firmware appliqué à un fichier G-code,
+// réécrit avec les droites fusionnées et les arcs G2/G3. Les lignes qui ne sont pas des
+// mouvements (chauffe, commentaires, G28...) sont recopiées telles quelles, à leur place.
+//
+//   pio run -e native_optimize
+//   .pio/build/native_optimize/program IN.gcode OUT.gcode
+//
+// Rapport OPTIMIZE : commandes avant/après, mm de trajet par commande (ce qu'une place de
+// gcodeQueue ou motionQueue rapporte), filament net relu dans les deux fichiers.
+#include <Arduino.h>
+#include "gcode_parser.h"
+#include "motion_optimizer.h"
+#include "machine_state.h"
+
+struct Output {
+  FILE *file;
+  const MotionCommand *current;   // Commande en cours de push
+  const char *currentText;        // Sa ligne d'origine
+  uint32_t lines;
+  uint32_t commands;
+};
+
+// Nombre le plus court qui se relit en la même valeur float (scale : 60 pour F en mm/min)
+static void formatNumber(char *out, size_t size, float value, double scale) {
+  for (int decimals = 0; decimals <= 9; decimals++) {
+    snprintf(out, size, "%.*f", decimals, value * scale);
+    if ((float)((double)(float)strtod(out, nullptr) / scale) == value) return;
+  }
+  snprintf(out, size, "%.9g", value * scale);
+}
+
+static bool writeCommand(const MotionCommand &cmd, void *context) {
+  Output *o = (Output *)context;
+  o->commands++;
+  o->lines++;
+  // Commande passée sans être retenue : la ligne d'origine, commentaire compris
+  if (&cmd == o->current) {
+    fprintf(o->file, "%s\n", o->currentText);
+    return true;
+  }
+  char text[160];
+  int n = snprintf(text, sizeof(text), "%c%d", cmd.type, GcodeParser::rawCode(cmd));
+  const struct {
+    bool present;
+    char letter;
+    float value;
+    double scale;
+  } fields[] = {
+    { cmd.has_x, 'X', cmd.x, 1.0 }, { cmd.has_y, 'Y', cmd.y, 1.0 }, { cmd.has_z, 'Z', cmd.z, 1.0 },
+    { cmd.has_i, 'I', cmd.i, 1.0 }, { cmd.has_j, 'J', cmd.j, 1.0 }, { cmd.has_e, 'E', cmd.e, 1.0 },
+    { cmd.has_f, 'F', cmd.f, 60.0 }, { cmd.has_s, 'S', cmd.s, 1.0 },
+  };
+  for (size_t k = 0; k < sizeof(fields) / sizeof(fields[0]); k++) {
+    if (!fields[k].present) continue;
+    char number[40];
+    formatNumber(number, sizeof(number), fields[k].value, fields[k].scale);
+    n += snprintf(text + n, sizeof(text) - n, " %c%s", fields[k].letter, number);
+  }
+  fprintf(o->file, "%s\n", text);
+  return true;
+}
+
+struct PathStats {
+  uint32_t lines;
+  uint32_t commands;
+  double travelMm;
+  double filamentMm;
+};
+
+// Relecture d'un fichier : trajet XY et filament net, comme PrintEstimator
+static bool measure(const char *path, PathStats &out) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  memset(&out, 0, sizeof(out));
+  GcodeParser parser;
+  const float *pos = parser.currentPosition();
+  char line[COMM_LINE_MAX];
+  while (fgets(line, sizeof(line), f)) {
+    out.lines++;
+    char *statement = GcodeParser::trackedStatement(line);
+    if (!statement) continue;
+    MotionCommand cmd;
+    if (parser.parseLine(statement, cmd) != GcodeParser::ParseResult::OK) continue;
+    out.commands++;
+    float before[4];
+    memcpy(before, pos, sizeof(before));
+    if (!parser.trackPosition(cmd) || cmd.code == (int)GcodeType::G92) continue;
+    double dx = pos[AXIS_X] - before[AXIS_X], dy = pos[AXIS_Y] - before[AXIS_Y];
+    if (cmd.has_i || cmd.has_j) {
+      // Longueur de l'arc, pas de la corde
+      double cx = before[AXIS_X] + cmd.i, cy = before[AXIS_Y] + cmd.j;
+      double sweep = atan2(pos[AXIS_Y] - cy, pos[AXIS_X] - cx) - atan2(before[AXIS_Y] - cy, before[AXIS_X] - cx);
+      if (cmd.code == (int)GcodeType::G2 && sweep >= 0.0) sweep -= 2.0 * M_PI;
+      if (cmd.code == (int)GcodeType::G3 && sweep <= 0.0) sweep += 2.0 * M_PI;
+      out.travelMm += fabs(sweep) * hypot(cmd.i, cmd.j);
+    } else {
+      out.travelMm += sqrt(dx * dx + dy * dy);
+    }
+    // En M83, somme des E du fichier : la position float suivie perd les décimales
+    if (cmd.has_e) out.filamentMm += parser.absoluteExtrusion() ? pos[AXIS_E] - before[AXIS_E] : cmd.e;
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: optimize IN.gcode OUT.gcode\n");
+    return 2;
+  }
+  FILE *in = fopen(argv[1], "r");
+  if (!in) {
+    fprintf(stderr, "ERROR: cannot read %s\n", argv[1]);
+    return 2;
+  }
+  Output o = { fopen(argv[2], "w"), nullptr, nullptr, 0, 0 };
+  if (!o.file) {
+    fprintf(stderr, "ERROR: cannot write %s\n", argv[2]);
+    fclose(in);
+    return 2;
+  }
+
+  int64_t t0 = esp_timer_get_time();
+  GcodeParser parser;
+  MotionOptimizer optimizer;
+  optimizer.setSink(writeCommand, &o);
+  optimizer.setEnabled(true);
+  uint32_t linesIn = 0;
+  char line[COMM_LINE_MAX], work[COMM_LINE_MAX];
+  while (fgets(line, sizeof(line), in)) {
+    linesIn++;
+    line[strcspn(line, "\r\n")] = '\0';
+    strcpy(work, line);
+    char *statement = GcodeParser::trackedStatement(work);
+    MotionCommand cmd;
+    if (!statement || parser.parseLine(statement, cmd) != GcodeParser::ParseResult::OK) {
+      // Ni mouvement ni mode : la suite en attente d'abord, puis la ligne telle quelle
+      optimizer.flush();
+      fprintf(o.file, "%s\n", line);
+      o.lines++;
+      continue;
+    }
+    float start[4];
+    memcpy(start, parser.currentPosition(), sizeof(start));
+    parser.trackPosition(cmd);
+    o.current = &cmd;
+    o.currentText = line;
+    optimizer.push(cmd, start, parser.currentPosition(), parser.absolutePositioning(), parser.absoluteExtrusion());
+    o.current = nullptr;
+  }
+  optimizer.flush();
+  fclose(in);
+  fclose(o.file);
+  int64_t us = esp_timer_get_time() - t0;
+
+  PathStats before, after;
+  if (!measure(argv[1], before) || !measure(argv[2], after)) {
+    fprintf(stderr, "ERROR: cannot re-read output\n");
+    return 1;
+  }
+  const MotionOptimizerStats &s = optimizer.getStats();
+  printf("OPTIMIZE file=%s lines_in=%u lines_out=%u commands_in=%u commands_out=%u lines=%u arcs=%u merged=%u "
+         "reduction_pct=%.1f mm_per_cmd_in=%.3f mm_per_cmd_out=%.3f travel_in_mm=%.1f travel_out_mm=%.1f "
+         "filament_in_mm=%.5f filament_out_mm=%.5f filament_delta_mm=%.6f us=%lld lines_per_s=%.0f\n",
+         argv[1], (unsigned)linesIn, (unsigned)o.lines, (unsigned)before.commands, (unsigned)after.commands,
+         (unsigned)s.linesMerged, (unsigned)s.arcsFitted, (unsigned)s.segmentsMerged,
+         before.commands ? 100.0 * (1.0 - (double)after.commands / before.commands) : 0.0,
+         before.commands ? before.travelMm / before.commands : 0.0,
+         after.commands ? after.travelMm / after.commands : 0.0, before.travelMm, after.travelMm,
+         before.filamentMm, after.filamentMm, after.filamentMm - before.filamentMm, (long long)us,
+         us > 0 ? linesIn * 1e6 / (double)us : 0.0);
+  return 0;
+}
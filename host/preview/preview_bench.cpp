@@ -0,0 +1,138 @@
+// Aperçu de trajectoire sur l'hôte : le ToolpathPreview du firmware (GcodeParser dédié,
+// tracé Bresenham, cache .pvw) appliqué à des fichiers locaux lus par MmapStorage.
+//
+//   pio run -e native_preview
+//   .pio/build/native_preview/program --generate job.gcode 50     (job synthétique de 50 Mo)
+//   .pio/build/native_preview/program [--layer N] [--no-cache] [--repeat N] job.gcode...
+//       --generate F MB : écrit un job de MB Mo (couches de 0.2 mm, périmètres et remplissage)
+//       --layer N       : une seule couche, sinon tout le job
+//       --no-cache      : supprime le .pvw avant chaque passe (mesure du tracé complet)
+//       --repeat N      : N passes par fichier, la plus rapide est retenue
+// Sans --no-cache, la passe retenue après la première est une lecture du cache.
+#include <Arduino.h>
+#include "toolpath_preview.h"
+#include "storage_mmap.h"
+#include <string>
+
+static void usage() {
+  fprintf(stderr, "usage: preview [--layer N] [--no-cache] [--repeat N] FILE...\n"
+                  "       preview --generate FILE MB\n");
+}
+
+// Couches carrées de 60 mm : deux périmètres puis un remplissage à 45° alterné, de quoi
+// ressembler au découpage d'un trancheur (une ligne G1 par segment, E relatif)
+static bool generate(const char *path, long megabytes) {
+  FILE *f = fopen(path, "w");
+  if (!f) return false;
+  const long target = megabytes * 1024L * 1024L;
+  const float cx = 110.0f, cy = 110.0f, half = 30.0f, spacing = 0.45f;
+  long written = fprintf(f, "; Job synthétique preview_bench\nG21\nG90\nM83\nG28\n");
+  int layer = 0;
+  while (written < target) {
+    float z = 0.2f * (layer + 1);
+    written += fprintf(f, ";LAYER:%d\nG1 Z%.2f F600\n", layer, z);
+    for (int p = 0; p < 2; p++) {
+      float h = half - p * spacing;
+      written += fprintf(f, "G0 X%.3f Y%.3f F9000\n", cx - h, cy - h);
+      written += fprintf(f, "G1 X%.3f Y%.3f E%.5f F1800\n", cx + h, cy - h, 2 * h * 0.033f);
+      written += fprintf(f, "G1 X%.3f Y%.3f E%.5f\n", cx + h, cy + h, 2 * h * 0.033f);
+      written += fprintf(f, "G1 X%.3f Y%.3f E%.5f\n", cx - h, cy + h, 2 * h * 0.033f);
+      written += fprintf(f, "G1 X%.3f Y%.3f E%.5f\n", cx - h, cy - h, 2 * h * 0.033f);
+    }
+    // Remplissage : segments courts le long des diagonales, sens alterné à chaque couche
+    float inner = half - 2 * spacing;
+    bool flip = layer & 1;
+    for (float d = -2 * inner; d <= 2 * inner && written < target; d += spacing * 4) {
+      float x0 = cx - inner, x1 = cx + inner;
+      float y0 = cy + (flip ? -d : d) - inner, y1 = y0 + 2 * inner * (flip ? -1 : 1);
+      written += fprintf(f, "G0 X%.3f Y%.3f\n", x0, y0);
+      for (int s = 1; s <= 8; s++) {
+        float t = s / 8.0f;
+        written += fprintf(f, "G1 X%.3f Y%.3f E%.5f\n", x0 + (x1 - x0) * t, y0 + (y1 - y0) * t, 0.0095f);
+      }
+    }
+    layer++;
+  }
+  fprintf(f, "M84\n");
+  fclose(f);
+  printf("GENERATE file=%s bytes=%ld layers=%d\n", path, written, layer);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 4 && !strcmp(argv[1], "--generate")) {
+    long mb = atol(argv[3]);
+    if (mb <= 0 || !generate(argv[2], mb)) {
+      usage();
+      return 2;
+    }
+    return 0;
+  }
+  bool noCache = false;
+  int repeat = 1;
+  int16_t layer = PREVIEW_ALL_LAYERS;
+  int first = 1;
+  for (; first < argc && argv[first][0] == '-'; first++) {
+    if (!strcmp(argv[first], "--no-cache")) {
+      noCache = true;
+    } else if (!strcmp(argv[first], "--repeat") && first + 1 < argc) {
+      repeat = atoi(argv[++first]);
+      if (repeat < 1) repeat = 1;
+    } else if (!strcmp(argv[first], "--layer") && first + 1 < argc) {
+      layer = (int16_t)atoi(argv[++first]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (first >= argc) {
+    usage();
+    return 2;
+  }
+
+  int failures = 0;
+  for (int i = first; i < argc; i++) {
+    // Le répertoire du fichier tient lieu de carte SD ; le .pvw s'écrit à côté
+    std::string arg(argv[i]);
+    size_t slash = arg.rfind('/');
+    std::string root = slash == std::string::npos ? "." : arg.substr(0, slash);
+    std::string path = "/" + (slash == std::string::npos ? arg : arg.substr(slash + 1));
+    if (root.empty()) root = "/";
+    MmapStorage storage(root.c_str());
+    if (!storage.begin()) {
+      fprintf(stderr, "%s: répertoire illisible\n", root.c_str());
+      failures++;
+      continue;
+    }
+    char cache[SD_PATH_MAX];
+    if (!ToolpathPreview::cachePath(path.c_str(), layer, cache, sizeof(cache))) {
+      printf("ERROR: Path too long for %s\n", argv[i]);
+      failures++;
+      continue;
+    }
+
+    PreviewResult result, best = {};
+    int64_t bestUs = -1;
+    bool ok = true;
+    for (int r = 0; r < repeat && ok; r++) {
+      if (noCache) storage.remove(cache);
+      int64_t t0 = esp_timer_get_time();
+      ok = toolpathPreview.render(&storage, path.c_str(), layer, result);
+      int64_t us = esp_timer_get_time() - t0;
+      if (ok && (bestUs < 0 || us < bestUs)) {
+        bestUs = us;
+        best = result;
+      }
+    }
+    if (!ok) {
+      printf("ERROR: Preview failed for %s\n", argv[i]);
+      failures++;
+      continue;
+    }
+    double linesPerS = bestUs > 0 ? best.lines * 1e6 / (double)bestUs : 0.0;
+    printf("PREVIEW file=%s layer=%d bytes=%lu lines=%lu segments=%lu layers=%u us=%lld lines_per_s=%.0f cached=%d\n",
+           argv[i], (int)best.layer, (unsigned long)best.bytes, (unsigned long)best.lines,
+           (unsigned long)best.segments, (unsigned)best.layers, (long long)bestUs, linesPerS, best.cached ? 1 : 0);
+  }
+  return failures ? 1 : 0;
+}
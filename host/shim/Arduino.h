@@ -0,0 +1,237 @@
+#pragma once
+
+// Sous-ensemble de l'Arduino ESP32 pour les builds hôte (platform = native) : String,
+// Serial sur un pseudo-terminal, temps et FreeRTOS sur threads (voir freertos/).
+// Les modules du firmware compilent tels quels ; ARDUINO n'est pas défini.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <ctype.h>
+#include <algorithm>
+#include <string>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class String {
+public:
+  String(const char *s = "") : s(s ? s : "") {}
+  String(const std::string &s) : s(s) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int v, unsigned char base = DEC) : s(toText((long)v, base)) {}
+  explicit String(unsigned int v, unsigned char base = DEC) : s(toText((unsigned long)v, base)) {}
+  explicit String(long v, unsigned char base = DEC) : s(toText(v, base)) {}
+  explicit String(unsigned long v, unsigned char base = DEC) : s(toText(v, base)) {}
+  explicit String(float v, unsigned int decimals = 2) : s(toText((double)v, decimals)) {}
+  explicit String(double v, unsigned int decimals = 2) : s(toText(v, decimals)) {}
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return (unsigned int)s.size(); }
+  bool isEmpty() const { return s.empty(); }
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+  char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+  char operator[](unsigned int i) const { return charAt(i); }
+  char &operator[](unsigned int i) { return s[i]; }
+  void setCharAt(unsigned int i, char c) { if (i < s.size()) s[i] = c; }
+
+  String &operator=(const char *o) { s = o ? o : ""; return *this; }
+  String &operator+=(const String &o) { s += o.s; return *this; }
+  String &operator+=(const char *o) { s += o; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  String &operator+=(int v) { s += toText((long)v, DEC); return *this; }
+  String &operator+=(unsigned int v) { s += toText((unsigned long)v, DEC); return *this; }
+  String &operator+=(long v) { s += toText(v, DEC); return *this; }
+  String &operator+=(unsigned long v) { s += toText(v, DEC); return *this; }
+  bool concat(const String &o) { s += o.s; return true; }
+  bool concat(const char *o) { s += o; return true; }
+  bool concat(char c) { s += c; return true; }
+  friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+  friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+  friend String operator+(const String &a, char c) { return String(a.s + c); }
+
+  bool equals(const String &o) const { return s == o.s; }
+  bool equals(const char *o) const { return s == o; }
+  bool equalsIgnoreCase(const String &o) const { return strcasecmp(s.c_str(), o.s.c_str()) == 0; }
+  bool operator==(const String &o) const { return s == o.s; }
+  bool operator==(const char *o) const { return s == o; }
+  bool operator!=(const String &o) const { return s != o.s; }
+  bool operator!=(const char *o) const { return s != o; }
+  bool operator<(const String &o) const { return s < o.s; }
+  int compareTo(const String &o) const { return s.compare(o.s); }
+  bool startsWith(const String &p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+  bool startsWith(const String &p, unsigned int offset) const {
+    return offset <= s.size() && s.compare(offset, p.s.size(), p.s) == 0;
+  }
+  bool endsWith(const String &p) const {
+    return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+  }
+
+  int indexOf(char c, unsigned int from = 0) const { return position(s.find(c, from)); }
+  int indexOf(const String &p, unsigned int from = 0) const { return position(s.find(p.s, from)); }
+  int lastIndexOf(char c) const { return position(s.rfind(c)); }
+  int lastIndexOf(const String &p) const { return position(s.rfind(p.s)); }
+  String substring(unsigned int from) const { return from >= s.size() ? String() : String(s.substr(from)); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    return String(s.substr(from, to - from));
+  }
+
+  void trim() {
+    size_t a = s.find_first_not_of(" \t\r\n\v\f");
+    if (a == std::string::npos) {
+      s.clear();
+      return;
+    }
+    s = s.substr(a, s.find_last_not_of(" \t\r\n\v\f") - a + 1);
+  }
+  void toUpperCase() { for (size_t i = 0; i < s.size(); i++) s[i] = (char)toupper((unsigned char)s[i]); }
+  void toLowerCase() { for (size_t i = 0; i < s.size(); i++) s[i] = (char)tolower((unsigned char)s[i]); }
+  void replace(const String &from, const String &to) {
+    if (from.s.empty()) return;
+    for (size_t i = s.find(from.s); i != std::string::npos; i = s.find(from.s, i + to.s.size())) {
+      s.replace(i, from.s.size(), to.s);
+    }
+  }
+  void replace(char from, char to) { for (size_t i = 0; i < s.size(); i++) if (s[i] == from) s[i] = to; }
+  void remove(unsigned int index) { if (index < s.size()) s.erase(index); }
+  void remove(unsigned int index, unsigned int count) { if (index < s.size()) s.erase(index, count); }
+
+  // Comme l'Arduino : préfixe numérique, 0 si aucun
+  long toInt() const { return strtol(s.c_str(), nullptr, 10); }
+  float toFloat() const { return (float)strtod(s.c_str(), nullptr); }
+  double toDouble() const { return strtod(s.c_str(), nullptr); }
+
+private:
+  std::string s;
+
+  static int position(size_t i) { return i == std::string::npos ? -1 : (int)i; }
+  static std::string toText(unsigned long v, unsigned char base);
+  static std::string toText(long v, unsigned char base);
+  static std::string toText(double v, unsigned int decimals);
+};
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+
+  size_t print(const String &s) { return write(s.c_str(), s.length()); }
+  size_t print(const char *s) { return write(s); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned int v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(unsigned long v, int base = DEC) { return print(String(v, (unsigned char)base)); }
+  size_t print(double v, int digits = 2) { return print(String(v, (unsigned int)digits)); }
+  size_t println() { return write("\r\n"); }
+  template <typename T>
+  size_t println(const T &v) { size_t n = print(v); return n + println(); }
+  template <typename T>
+  size_t println(const T &v, int format) { size_t n = print(v, format); return n + println(); }
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+  Stream() : timeoutMs(1000) {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  void setTimeout(unsigned long timeout) { timeoutMs = timeout; }
+  size_t readBytes(uint8_t *buffer, size_t length);
+  size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+  size_t readBytesUntil(char terminator, char *buffer, size_t length);
+  String readStringUntil(char terminator);
+
+protected:
+  unsigned long timeoutMs;
+  int timedRead();
+};
+
+// UART0 simulé : un pseudo-terminal dont l'esclave (portName()) s'ouvre comme un port
+// série. Les octets reçus sont délivrés au débit de begin() si setPacing(true), pour
+// que le firmware voie les mêmes rafales qu'à 115200 bauds.
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial();
+  void begin(unsigned long baud);
+  void end();
+  void setRxBufferSize(size_t size);
+  void setTxBufferSize(size_t size) {}
+  int available() override;
+  int read() override;
+  int peek() override;
+  using Print::write;
+  size_t write(uint8_t b) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  int availableForWrite();
+  void flush() {}
+  operator bool() const { return masterFd >= 0; }
+
+  // Hôte seulement
+  const char *portName() const { return slaveName; }
+  void setPacing(bool enabled) { pacing = enabled; }
+  uint32_t rxBytes() const { return rxTotal; }
+  uint32_t txBytes() const { return txTotal; }
+  uint32_t txDroppedBytes() const { return txDropped; }
+
+private:
+  int masterFd;
+  int slaveFd;                // Gardé ouvert : le maître ne voit pas de raccrochage
+  char slaveName[64];
+  uint8_t *rx;
+  size_t rxCapacity;
+  size_t rxHead, rxCount;
+  bool pacing;
+  unsigned long baud;
+  volatile uint32_t rxTotal, txTotal, txDropped;
+  pthread_mutex_t rxLock;
+  pthread_mutex_t txLock;
+
+  static void *readerThread(void *self);
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+public:
+  uint32_t getFreeHeap() { return heap_caps_get_free_size(MALLOC_CAP_INTERNAL); }
+  uint32_t getMinFreeHeap() { return heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL); }
+  uint32_t getPsramSize() { return 8 * 1024 * 1024; }
+  uint32_t getFreePsram() { return heap_caps_get_free_size(MALLOC_CAP_SPIRAM); }
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getCycleCount() { return (uint32_t)(esp_timer_get_time() * 240); }
+  void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+inline bool isDigit(int c) { return c >= '0' && c <= '9'; }
+inline bool isAlpha(int c) { return isalpha(c) != 0; }
+inline bool isSpace(int c) { return isspace(c) != 0; }
+inline bool isHexadecimalDigit(int c) { return isxdigit(c) != 0; }
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define IRAM_ATTR
+#define F(s) (s)
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// LED d'état sans effet sur l'hôte
+struct CRGB {
+  enum Color : uint32_t { Black = 0x000000, Red = 0xFF0000, Green = 0x008000, Blue = 0x0000FF, White = 0xFFFFFF };
+  uint8_t r, g, b;
+  CRGB() : r(0), g(0), b(0) {}
+  CRGB(uint32_t rgb) : r((uint8_t)(rgb >> 16)), g((uint8_t)(rgb >> 8)), b((uint8_t)rgb) {}
+  CRGB &fadeLightBy(uint8_t amount) {
+    r = (uint8_t)(r * (255 - amount) / 255);
+    g = (uint8_t)(g * (255 - amount) / 255);
+    b = (uint8_t)(b * (255 - amount) / 255);
+    return *this;
+  }
+};
+
+enum EOrder { RGB, GRB };
+template <uint8_t PIN, EOrder ORDER>
+class WS2812 {};
+
+class CFastLED {
+public:
+  template <template <uint8_t, EOrder> class CHIPSET, uint8_t PIN, EOrder ORDER>
+  void addLeds(CRGB *leds, int count) {}
+  void show() {}
+  void setBrightness(uint8_t) {}
+};
+
+extern CFastLED FastLED;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Tas de l'hôte : les capacités sont ignorées à l'allocation. La SRAM interne est simulée
+// (HOST_INTERNAL_HEAP_BYTES moins les octets alloués par le processus, voir host_heap.cpp),
+// pour que HEALTH et HEAP suivent les allocations réelles ; la PSRAM (8 Mo) reste fixe.
+#define MALLOC_CAP_EXEC     (1 << 0)
+#define MALLOC_CAP_32BIT    (1 << 1)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT  (1 << 12)
+#define HOST_INTERNAL_HEAP_BYTES (512 * 1024)
+#define HOST_PSRAM_BYTES         (8 * 1024 * 1024)
+
+// Allocation faite depuis une tâche du firmware (taille demandée, adresse de retour)
+typedef void (*HostAllocationHook)(size_t size, void *caller);
+void hostSetAllocationHook(HostAllocationHook hook);
+size_t hostHeapInUse();
+size_t hostHeapPeak();
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) { return calloc(n, size); }
+static inline void *heap_caps_realloc(void *p, size_t size, uint32_t caps) { return realloc(p, size); }
+static inline void heap_caps_free(void *p) { free(p); }
+static inline size_t hostHeapFree(size_t used) {
+  return used < HOST_INTERNAL_HEAP_BYTES ? HOST_INTERNAL_HEAP_BYTES - used : 0;
+}
+static inline size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_BYTES : hostHeapFree(hostHeapInUse());
+}
+static inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_BYTES : hostHeapFree(hostHeapPeak());
+}
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return heap_caps_get_free_size(caps); }
+static inline size_t heap_caps_get_total_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? HOST_PSRAM_BYTES : HOST_INTERNAL_HEAP_BYTES;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// µs depuis le démarrage du processus (horloge monotone)
+int64_t esp_timer_get_time();
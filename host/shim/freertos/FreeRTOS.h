@@ -0,0 +1,69 @@
+#pragma once
+
+// FreeRTOS (API ESP-IDF) sur threads POSIX, pour les builds hôte. Une tâche est un
+// thread, un tick vaut une milliseconde. Les priorités et l'affinité ne sont pas
+// appliquées : l'ordonnanceur de l'hôte décide, xPortGetCoreID() rend le cœur demandé.
+// Les sections critiques sont des mutex récursifs, pas des verrous tournants.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+typedef void (*TaskFunction_t)(void *);
+
+struct HostTask;
+struct HostQueue;
+struct HostEventGroup;
+typedef HostTask *TaskHandle_t;
+typedef HostQueue *QueueHandle_t;
+typedef HostQueue *SemaphoreHandle_t;
+typedef HostEventGroup *EventGroupHandle_t;
+
+// Objets des créations statiques (xQueueCreateStatic...) : le descripteur de l'hôte y est
+// construit sur place. La pile fournie à xTaskCreateStatic n'est pas utilisée par le thread.
+typedef struct {
+  alignas(16) uint8_t opaque[256];
+} StaticQueue_t;
+typedef StaticQueue_t StaticSemaphore_t;
+typedef struct {
+  alignas(16) uint8_t opaque[256];
+} StaticTask_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define errQUEUE_FULL 0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portNUM_PROCESSORS 2
+#define tskIDLE_PRIORITY 0
+#define tskNO_AFFINITY 0x7FFFFFFF
+#define configMAX_PRIORITIES 25
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configASSERT(x) do { if (!(x)) abort(); } while (0)
+
+typedef struct {
+  pthread_mutex_t lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+#define portENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->lock)
+#define portEXIT_CRITICAL(mux) pthread_mutex_unlock(&(mux)->lock)
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux) portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(x) ((void)(x))
+#define spinlock_initialize(mux) pthread_mutex_init(&(mux)->lock, hostRecursiveMutexAttr())
+
+const pthread_mutexattr_t *hostRecursiveMutexAttr();
+// Thread créé par xTaskCreate* (tâche du firmware), pas main ni un thread de l'hôte
+bool hostInTask();
+BaseType_t xPortGetCoreID();
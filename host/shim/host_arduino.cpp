@@ -0,0 +1,255 @@
+// String, Print/Stream et Serial sur pseudo-terminal pour les builds hôte
+#include "Arduino.h"
+#include "FastLED.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+CFastLED FastLED;
+
+unsigned long millis() {
+  return (unsigned long)(esp_timer_get_time() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)esp_timer_get_time();
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  int64_t end = esp_timer_get_time() + us;
+  while (esp_timer_get_time() < end) {
+  }
+}
+
+std::string String::toText(unsigned long v, unsigned char base) {
+  if (base < 2 || base > 36) base = 10;
+  char buf[8 * sizeof(unsigned long) + 1];
+  char *p = buf + sizeof(buf);
+  *--p = '\0';
+  do {
+    unsigned digit = v % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    v /= base;
+  } while (v);
+  return p;
+}
+
+std::string String::toText(long v, unsigned char base) {
+  if (v < 0 && base == 10) return "-" + toText((unsigned long)-v, base);
+  return toText((unsigned long)v, base);
+}
+
+std::string String::toText(double v, unsigned int decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+  return buf;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && write(buffer[n])) n++;
+  return n;
+}
+
+size_t Print::printf(const char *format, ...) {
+  char local[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(local, sizeof(local), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(local)) return write((const uint8_t *)local, (size_t)len);
+  std::string big((size_t)len + 1, '\0');
+  va_start(args, format);
+  vsnprintf(&big[0], big.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *)big.data(), (size_t)len);
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+    vTaskDelay(1);
+  } while (millis() - start < timeoutMs);
+  return -1;
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    buffer[n++] = (uint8_t)c;
+  }
+  return n;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    buffer[n++] = (char)c;
+  }
+  return n;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String out;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) out += (char)c;
+  return out;
+}
+
+HardwareSerial::HardwareSerial()
+    : masterFd(-1), slaveFd(-1), rx(nullptr), rxCapacity(256), rxHead(0), rxCount(0), pacing(false), baud(115200),
+      rxTotal(0), txTotal(0), txDropped(0) {
+  slaveName[0] = '\0';
+  pthread_mutex_init(&rxLock, nullptr);
+  pthread_mutex_init(&txLock, nullptr);
+}
+
+void HardwareSerial::setRxBufferSize(size_t size) {
+  if (masterFd < 0 && size > 0) rxCapacity = size;
+}
+
+void HardwareSerial::begin(unsigned long rate) {
+  if (masterFd >= 0) return;
+  baud = rate;
+  int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 || !ptsname(fd)) {
+    fprintf(stderr, "Serial: pseudo-terminal indisponible (%s)\n", strerror(errno));
+    if (fd >= 0) close(fd);
+    return;
+  }
+  strncpy(slaveName, ptsname(fd), sizeof(slaveName) - 1);
+  // Mode brut côté esclave : ni écho ni traduction des fins de ligne pour le client
+  slaveFd = open(slaveName, O_RDWR | O_NOCTTY);
+  if (slaveFd >= 0) {
+    struct termios tio;
+    tcgetattr(slaveFd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slaveFd, TCSANOW, &tio);
+  }
+  // Écritures non bloquantes : sans client qui lit, la sortie est perdue comme sur l'UART
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  rx = (uint8_t *)malloc(rxCapacity);
+  masterFd = fd;
+  pthread_t reader;
+  pthread_create(&reader, nullptr, readerThread, this);
+  pthread_detach(reader);
+}
+
+void HardwareSerial::end() {}
+
+// Remplit le tampon de réception depuis le pty. Tampon plein : le thread attend, et le
+// client finit bloqué dans write() comme derrière un contrôle de flux.
+void *HardwareSerial::readerThread(void *self) {
+  HardwareSerial *s = (HardwareSerial *)self;
+  uint8_t chunk[64];
+  int64_t lineFreeAt = 0;
+  while (true) {
+    pthread_mutex_lock(&s->rxLock);
+    size_t room = s->rxCapacity - s->rxCount;
+    pthread_mutex_unlock(&s->rxLock);
+    if (room == 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    struct pollfd p = { s->masterFd, POLLIN, 0 };
+    if (poll(&p, 1, 100) <= 0) continue;
+    size_t want = room < sizeof(chunk) ? room : sizeof(chunk);
+    // Au débit de la liaison : 10 bits par octet
+    if (s->pacing && s->baud) want = want < 16 ? want : 16;
+    ssize_t n = ::read(s->masterFd, chunk, want);
+    if (n <= 0) {
+      vTaskDelay(1);
+      continue;
+    }
+    if (s->pacing && s->baud) {
+      int64_t now = esp_timer_get_time();
+      if (lineFreeAt < now) lineFreeAt = now;
+      lineFreeAt += (int64_t)n * 10 * 1000000 / (int64_t)s->baud;
+      while (esp_timer_get_time() < lineFreeAt) {
+        struct timespec d = { 0, 20000 };
+        nanosleep(&d, nullptr);
+      }
+    }
+    pthread_mutex_lock(&s->rxLock);
+    for (ssize_t i = 0; i < n; i++) {
+      s->rx[(s->rxHead + s->rxCount) % s->rxCapacity] = chunk[i];
+      s->rxCount++;
+    }
+    s->rxTotal += (uint32_t)n;
+    pthread_mutex_unlock(&s->rxLock);
+  }
+  return nullptr;
+}
+
+int HardwareSerial::available() {
+  pthread_mutex_lock(&rxLock);
+  int n = (int)rxCount;
+  pthread_mutex_unlock(&rxLock);
+  return n;
+}
+
+int HardwareSerial::read() {
+  pthread_mutex_lock(&rxLock);
+  int c = -1;
+  if (rxCount) {
+    c = rx[rxHead];
+    rxHead = (rxHead + 1) % rxCapacity;
+    rxCount--;
+  }
+  pthread_mutex_unlock(&rxLock);
+  return c;
+}
+
+int HardwareSerial::peek() {
+  pthread_mutex_lock(&rxLock);
+  int c = rxCount ? rx[rxHead] : -1;
+  pthread_mutex_unlock(&rxLock);
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+  return write(&b, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (masterFd < 0) return 0;
+  // Un seul écrivain à la fois, comme le verrou du pilote UART : pas de lignes entrelacées
+  pthread_mutex_lock(&txLock);
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = ::write(masterFd, buffer + done, size - done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && errno == EAGAIN) {
+      // Client lent : on lui laisse le temps de vider le pty, au-delà la sortie est perdue
+      struct pollfd p = { masterFd, POLLOUT, 0 };
+      if (poll(&p, 1, 50) > 0) continue;
+      txDropped += (uint32_t)(size - done);
+      break;
+    }
+    if (n <= 0) break;
+    done += (size_t)n;
+  }
+  txTotal += (uint32_t)done;
+  pthread_mutex_unlock(&txLock);
+  return size;
+}
+
+int HardwareSerial::availableForWrite() {
+  // Tampon d'émission du pilote UART de la cible
+  return 1024;
+}
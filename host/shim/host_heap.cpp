@@ -0,0 +1,106 @@
+// Tas de l'hôte compté : malloc et consorts remplacent ceux de la glibc (les appels de la
+// libc et de libstdc++ passent aussi par eux) et délèguent aux fonctions __libc_*. Les
+// octets en cours d'utilisation donnent le tas libre de heap_caps_get_free_size() ; les
+// allocations faites depuis une tâche du firmware sont signalées au crochet installé.
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include <atomic>
+#include <errno.h>
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void *__libc_valloc(size_t size);
+void *__libc_pvalloc(size_t size);
+void __libc_free(void *p);
+}
+
+static std::atomic<int64_t> inUse(0);
+static std::atomic<int64_t> peakInUse(0);
+static std::atomic<HostAllocationHook> hook(nullptr);
+
+static void *taken(void *p, size_t requested, void *caller) {
+  if (!p) return p;
+  int64_t now = inUse.fetch_add((int64_t)malloc_usable_size(p)) + (int64_t)malloc_usable_size(p);
+  int64_t peak = peakInUse.load(std::memory_order_relaxed);
+  while (now > peak && !peakInUse.compare_exchange_weak(peak, now)) {
+  }
+  HostAllocationHook h = hook.load(std::memory_order_acquire);
+  if (h && hostInTask()) h(requested, caller);
+  return p;
+}
+
+static void released(void *p) {
+  if (p) inUse.fetch_sub((int64_t)malloc_usable_size(p));
+}
+
+extern "C" {
+
+void *malloc(size_t size) {
+  return taken(__libc_malloc(size), size, __builtin_return_address(0));
+}
+
+void *calloc(size_t n, size_t size) {
+  return taken(__libc_calloc(n, size), n * size, __builtin_return_address(0));
+}
+
+void *realloc(void *p, size_t size) {
+  if (!p) return malloc(size);
+  if (size == 0) {
+    free(p);
+    return nullptr;
+  }
+  size_t before = malloc_usable_size(p);
+  void *q = __libc_realloc(p, size);
+  if (!q) return q;
+  inUse.fetch_sub((int64_t)before);
+  return taken(q, size, __builtin_return_address(0));
+}
+
+void free(void *p) {
+  released(p);
+  __libc_free(p);
+}
+
+void *memalign(size_t alignment, size_t size) {
+  return taken(__libc_memalign(alignment, size), size, __builtin_return_address(0));
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+  return taken(__libc_memalign(alignment, size), size, __builtin_return_address(0));
+}
+
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+  void *p = taken(__libc_memalign(alignment, size), size, __builtin_return_address(0));
+  if (!p) return ENOMEM;
+  *out = p;
+  return 0;
+}
+
+void *valloc(size_t size) {
+  return taken(__libc_valloc(size), size, __builtin_return_address(0));
+}
+
+void *pvalloc(size_t size) {
+  return taken(__libc_pvalloc(size), size, __builtin_return_address(0));
+}
+
+}
+
+void hostSetAllocationHook(HostAllocationHook h) {
+  hook.store(h, std::memory_order_release);
+}
+
+size_t hostHeapInUse() {
+  int64_t n = inUse.load(std::memory_order_relaxed);
+  return n > 0 ? (size_t)n : 0;
+}
+
+size_t hostHeapPeak() {
+  int64_t n = peakInUse.load(std::memory_order_relaxed);
+  return n > 0 ? (size_t)n : 0;
+}
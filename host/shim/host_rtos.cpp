@@ -0,0 +1,515 @@
+// FreeRTOS sur pthreads : tâches, files, sémaphores, groupes d'événements et notifications
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include <errno.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+struct HostTask {
+  pthread_t thread;
+  char name[16];
+  TaskFunction_t fn;
+  void *param;
+  uint32_t stackSize;
+  UBaseType_t priority;
+  BaseType_t core;
+  UBaseType_t number;
+  bool alive;
+  pthread_mutex_t lock;
+  pthread_cond_t notified;
+  uint32_t notifyCount;
+};
+
+struct HostQueue {
+  pthread_mutex_t lock;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+  uint8_t *storage;
+  UBaseType_t length;
+  UBaseType_t itemSize;
+  UBaseType_t head;
+  UBaseType_t count;
+  // Mutex (récursif ou non) : propriétaire et profondeur
+  bool isMutex;
+  TaskHandle_t owner;
+  UBaseType_t depth;
+  bool isStatic;            // Descripteur et stockage fournis par l'appelant
+};
+
+struct HostEventGroup {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  EventBits_t bits;
+};
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<HostTask *> registry;
+static UBaseType_t nextTaskNumber = 1;
+static __thread HostTask *currentTask = nullptr;
+
+const pthread_mutexattr_t *hostRecursiveMutexAttr() {
+  static pthread_mutexattr_t attr;
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, [] {
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  });
+  return &attr;
+}
+
+int64_t esp_timer_get_time() {
+  static struct timespec origin;
+  static pthread_once_t once = PTHREAD_ONCE_INIT;
+  pthread_once(&once, [] { clock_gettime(CLOCK_MONOTONIC, &origin); });
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)(now.tv_sec - origin.tv_sec) * 1000000 + (now.tv_nsec - origin.tv_nsec) / 1000;
+}
+
+// Échéance absolue pour pthread_cond_timedwait, portMAX_DELAY : aucune
+static bool deadline(TickType_t ticks, struct timespec &at) {
+  if (ticks == portMAX_DELAY) return false;
+  clock_gettime(CLOCK_REALTIME, &at);
+  at.tv_sec += ticks / 1000;
+  at.tv_nsec += (long)(ticks % 1000) * 1000000;
+  if (at.tv_nsec >= 1000000000) {
+    at.tv_sec++;
+    at.tv_nsec -= 1000000000;
+  }
+  return true;
+}
+
+// false à l'échéance
+static bool waitOn(pthread_cond_t *cond, pthread_mutex_t *lock, bool timed, const struct timespec &at) {
+  if (!timed) return pthread_cond_wait(cond, lock) == 0;
+  return pthread_cond_timedwait(cond, lock, &at) != ETIMEDOUT;
+}
+
+static_assert(sizeof(HostTask) <= sizeof(StaticTask_t), "StaticTask_t trop petit pour HostTask");
+static_assert(sizeof(HostQueue) <= sizeof(StaticQueue_t), "StaticQueue_t trop petit pour HostQueue");
+
+bool hostInTask() {
+  return currentTask && currentTask->fn;
+}
+
+static HostTask *newTask(const char *name, uint32_t stackSize, UBaseType_t priority, BaseType_t core,
+                         void *place = nullptr) {
+  HostTask *t = place ? new (place) HostTask() : new HostTask();
+  strncpy(t->name, name ? name : "", sizeof(t->name) - 1);
+  t->stackSize = stackSize;
+  t->priority = priority;
+  t->core = core;
+  t->alive = true;
+  pthread_mutex_init(&t->lock, nullptr);
+  pthread_cond_init(&t->notified, nullptr);
+  pthread_mutex_lock(&registryLock);
+  t->number = nextTaskNumber++;
+  registry.push_back(t);
+  pthread_mutex_unlock(&registryLock);
+  return t;
+}
+
+static void *taskEntry(void *arg) {
+  HostTask *t = (HostTask *)arg;
+  currentTask = t;
+  t->fn(t->param);
+  // Une tâche FreeRTOS ne doit pas retourner ; on la traite comme vTaskDelete(NULL)
+  vTaskDelete(nullptr);
+  return nullptr;
+}
+
+static bool startTask(HostTask *t, TaskFunction_t fn, void *param) {
+  t->fn = fn;
+  t->param = param;
+  // Piles de l'hôte : la taille FreeRTOS ne suffirait pas à la libc
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  int err = pthread_create(&t->thread, &attr, taskEntry, t);
+  pthread_attr_destroy(&attr);
+  if (err != 0) {
+    t->alive = false;
+    return false;
+  }
+  return true;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *created, BaseType_t core) {
+  HostTask *t = newTask(name, stackDepth, priority, core);
+  if (!startTask(t, fn, param)) return pdFAIL;
+  if (created) *created = t;
+  return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *param,
+                                          UBaseType_t priority, StackType_t *stack, StaticTask_t *buffer,
+                                          BaseType_t core) {
+  if (!stack || !buffer) return nullptr;
+  HostTask *t = newTask(name, stackDepth, priority, core, buffer);
+  return startTask(t, fn, param) ? t : nullptr;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  HostTask *self = xTaskGetCurrentTaskHandle();
+  if (task && task != self) abort();
+  pthread_mutex_lock(&registryLock);
+  self->alive = false;
+  pthread_mutex_unlock(&registryLock);
+  // Le descripteur reste alloué : d'autres tâches peuvent encore comparer la poignée
+  pthread_exit(nullptr);
+}
+
+void vTaskDelay(TickType_t ticks) {
+  struct timespec d = { (time_t)(ticks / 1000), (long)(ticks % 1000) * 1000000 };
+  if (ticks == 0) {
+    sched_yield();
+    return;
+  }
+  while (nanosleep(&d, &d) != 0 && errno == EINTR) {
+  }
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period) {
+  *previousWake += period;
+  int32_t remaining = (int32_t)(*previousWake - xTaskGetTickCount());
+  if (remaining > 0) vTaskDelay((TickType_t)remaining);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+void taskYIELD() {
+  sched_yield();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  // Thread créé hors de xTaskCreate (main) : déclaré à la première demande
+  if (!currentTask) {
+    currentTask = newTask("main", 0, 1, 0);
+    currentTask->thread = pthread_self();
+  }
+  return currentTask;
+}
+
+BaseType_t xPortGetCoreID() {
+  HostTask *t = currentTask;
+  return (t && t->core != tskNO_AFFINITY) ? t->core : 0;
+}
+
+char *pcTaskGetName(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  return (task ? task : xTaskGetCurrentTaskHandle())->stackSize;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks() {
+  pthread_mutex_lock(&registryLock);
+  UBaseType_t n = 0;
+  for (HostTask *t : registry) n += t->alive ? 1 : 0;
+  pthread_mutex_unlock(&registryLock);
+  return n;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, uint32_t *totalRunTime) {
+  UBaseType_t n = 0;
+  pthread_mutex_lock(&registryLock);
+  for (HostTask *t : registry) {
+    if (!t->alive) continue;
+    if (n == size) {
+      n = 0;  // Comme FreeRTOS : tableau trop petit, rien n'est rempli
+      break;
+    }
+    TaskStatus_t &s = status[n++];
+    memset(&s, 0, sizeof(s));
+    s.xHandle = t;
+    s.pcTaskName = t->name;
+    s.xTaskNumber = t->number;
+    s.eCurrentState = t == currentTask ? eRunning : eBlocked;
+    s.uxCurrentPriority = s.uxBasePriority = t->priority;
+    s.usStackHighWaterMark = t->stackSize;
+    s.xCoreID = t->core;
+    clockid_t clock;
+    struct timespec cpu;
+    if (pthread_getcpuclockid(t->thread, &clock) == 0 && clock_gettime(clock, &cpu) == 0) {
+      s.ulRunTimeCounter = (uint32_t)((int64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000);
+    }
+  }
+  pthread_mutex_unlock(&registryLock);
+  if (totalRunTime) *totalRunTime = (uint32_t)esp_timer_get_time();
+  return n;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+  HostTask *t = xTaskGetCurrentTaskHandle();
+  struct timespec at;
+  bool timed = deadline(ticks, at);
+  pthread_mutex_lock(&t->lock);
+  while (t->notifyCount == 0 && ticks != 0) {
+    if (!waitOn(&t->notified, &t->lock, timed, at)) break;
+  }
+  uint32_t value = t->notifyCount;
+  if (value) t->notifyCount = clearOnExit ? 0 : value - 1;
+  pthread_mutex_unlock(&t->lock);
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  pthread_mutex_lock(&task->lock);
+  task->notifyCount++;
+  pthread_cond_signal(&task->notified);
+  pthread_mutex_unlock(&task->lock);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+  xTaskNotifyGive(task);
+  if (woken) *woken = pdFALSE;
+}
+
+static HostQueue *newQueue(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage = nullptr,
+                           StaticQueue_t *place = nullptr) {
+  HostQueue *q = place ? new (place) HostQueue() : new HostQueue();
+  q->isStatic = place != nullptr;
+  pthread_mutex_init(&q->lock, nullptr);
+  pthread_cond_init(&q->notEmpty, nullptr);
+  pthread_cond_init(&q->notFull, nullptr);
+  q->length = length;
+  q->itemSize = itemSize;
+  if (q->isStatic) q->storage = storage;
+  else q->storage = itemSize ? (uint8_t *)malloc((size_t)length * itemSize) : nullptr;
+  return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  if (length == 0) return nullptr;
+  return newQueue(length, itemSize);
+}
+
+QueueHandle_t xQueueCreateStatic(UBaseType_t length, UBaseType_t itemSize, uint8_t *storage, StaticQueue_t *buffer) {
+  if (length == 0 || !buffer || (itemSize && !storage)) return nullptr;
+  return newQueue(length, itemSize, storage, buffer);
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  pthread_mutex_destroy(&queue->lock);
+  pthread_cond_destroy(&queue->notEmpty);
+  pthread_cond_destroy(&queue->notFull);
+  if (queue->isStatic) {
+    queue->~HostQueue();
+    return;
+  }
+  free(queue->storage);
+  delete queue;
+}
+
+static BaseType_t queuePut(QueueHandle_t q, const void *item, TickType_t ticks, bool front) {
+  struct timespec at;
+  bool timed = deadline(ticks, at);
+  pthread_mutex_lock(&q->lock);
+  while (q->count == q->length) {
+    if (ticks == 0 || !waitOn(&q->notFull, &q->lock, timed, at)) {
+      pthread_mutex_unlock(&q->lock);
+      return errQUEUE_FULL;
+    }
+  }
+  if (q->itemSize) {
+    UBaseType_t slot;
+    if (front) {
+      q->head = (q->head + q->length - 1) % q->length;
+      slot = q->head;
+    } else {
+      slot = (q->head + q->count) % q->length;
+    }
+    memcpy(q->storage + (size_t)slot * q->itemSize, item, q->itemSize);
+  }
+  q->count++;
+  pthread_cond_signal(&q->notEmpty);
+  pthread_mutex_unlock(&q->lock);
+  return pdPASS;
+}
+
+static BaseType_t queueGet(QueueHandle_t q, void *item, TickType_t ticks, bool remove) {
+  struct timespec at;
+  bool timed = deadline(ticks, at);
+  pthread_mutex_lock(&q->lock);
+  while (q->count == 0) {
+    if (ticks == 0 || !waitOn(&q->notEmpty, &q->lock, timed, at)) {
+      pthread_mutex_unlock(&q->lock);
+      return pdFALSE;
+    }
+  }
+  if (q->itemSize && item) memcpy(item, q->storage + (size_t)q->head * q->itemSize, q->itemSize);
+  if (remove) {
+    q->head = (q->head + 1) % q->length;
+    q->count--;
+    pthread_cond_signal(&q->notFull);
+  }
+  pthread_mutex_unlock(&q->lock);
+  return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  return queuePut(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  return queuePut(queue, item, ticks, true);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  return queueGet(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks) {
+  return queueGet(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  pthread_mutex_lock(&queue->lock);
+  queue->head = 0;
+  queue->count = 0;
+  pthread_cond_broadcast(&queue->notFull);
+  pthread_mutex_unlock(&queue->lock);
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  pthread_mutex_lock(&queue->lock);
+  UBaseType_t n = queue->count;
+  pthread_mutex_unlock(&queue->lock);
+  return n;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  pthread_mutex_lock(&queue->lock);
+  UBaseType_t n = queue->length - queue->count;
+  pthread_mutex_unlock(&queue->lock);
+  return n;
+}
+
+// Sémaphores : files d'éléments vides, le compte est le nombre de jetons disponibles
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) {
+  HostQueue *q = newQueue(maxCount, 0);
+  q->count = initialCount;
+  return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  return xSemaphoreCreateCounting(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  HostQueue *q = newQueue(1, 0);
+  q->count = 1;
+  q->isMutex = true;
+  return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+  return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buffer) {
+  if (!buffer) return nullptr;
+  HostQueue *q = newQueue(1, 0, nullptr, buffer);
+  q->count = 1;
+  q->isMutex = true;
+  return q;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+  if (queueGet(sem, nullptr, ticks, true) != pdTRUE) return pdFALSE;
+  if (sem->isMutex) {
+    sem->owner = xTaskGetCurrentTaskHandle();
+    sem->depth = 1;
+  }
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+  if (sem->isMutex) {
+    if (sem->owner != xTaskGetCurrentTaskHandle()) return pdFALSE;
+    sem->owner = nullptr;
+    sem->depth = 0;
+  }
+  return queuePut(sem, nullptr, 0, false);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) {
+  if (sem->owner == xTaskGetCurrentTaskHandle()) {
+    sem->depth++;
+    return pdTRUE;
+  }
+  return xSemaphoreTake(sem, ticks);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+  if (sem->owner != xTaskGetCurrentTaskHandle()) return pdFALSE;
+  if (--sem->depth > 0) return pdTRUE;
+  return xSemaphoreGive(sem);
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+  HostEventGroup *g = new HostEventGroup();
+  pthread_mutex_init(&g->lock, nullptr);
+  pthread_cond_init(&g->changed, nullptr);
+  return g;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+  pthread_mutex_destroy(&group->lock);
+  pthread_cond_destroy(&group->changed);
+  delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+  pthread_mutex_lock(&group->lock);
+  group->bits |= bits;
+  EventBits_t now = group->bits;
+  pthread_cond_broadcast(&group->changed);
+  pthread_mutex_unlock(&group->lock);
+  return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+  pthread_mutex_lock(&group->lock);
+  EventBits_t before = group->bits;
+  group->bits &= ~bits;
+  pthread_mutex_unlock(&group->lock);
+  return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+  pthread_mutex_lock(&group->lock);
+  EventBits_t bits = group->bits;
+  pthread_mutex_unlock(&group->lock);
+  return bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+                                BaseType_t waitForAll, TickType_t ticks) {
+  struct timespec at;
+  bool timed = deadline(ticks, at);
+  pthread_mutex_lock(&group->lock);
+  while (true) {
+    EventBits_t set = group->bits & bits;
+    bool met = waitForAll ? set == bits : set != 0;
+    if (met || ticks == 0 || !waitOn(&group->changed, &group->lock, timed, at)) break;
+  }
+  EventBits_t value = group->bits;
+  bool met = waitForAll ? (value & bits) == bits : (value & bits) != 0;
+  if (met && clearOnExit) group->bits &= ~bits;
+  pthread_mutex_unlock(&group->lock);
+  return value;
+}
@@ -0,0 +1,41 @@
+// Seqlock de MachineStateStore sur l'hôte : deux écrivains (threads de la cale FreeRTOS,
+// donc réellement parallèles sur une machine multicœur) contre un lecteur, comme la
+// commande TEST_SNAPSHOT. Chaque publication garde ses champs égaux entre eux : une copie
+// qui les mélange est une lecture déchirée.
+//
+//   pio run -e native_snapshot
+//   .pio/build/native_snapshot/program [--ms N] [--repeat N]
+//       --ms N     : durée d'une passe en ms (1000 par défaut)
+//       --repeat N : nombre de passes (3 par défaut)
+// Code 1 si une lecture est déchirée ou si un écrivain n'a pas pu être lancé.
+#include <Arduino.h>
+#include "machine_state.h"
+
+int main(int argc, char **argv) {
+  uint32_t ms = 1000;
+  int repeat = 3;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--ms") && i + 1 < argc) {
+      long v = atol(argv[++i]);
+      ms = v > 0 ? (uint32_t)v : 1000;
+    } else if (!strcmp(argv[i], "--repeat") && i + 1 < argc) {
+      repeat = atoi(argv[++i]);
+      if (repeat < 1) repeat = 1;
+    } else {
+      fprintf(stderr, "usage: %s [--ms N] [--repeat N]\n", argv[0]);
+      return 2;
+    }
+  }
+  bool pass = true;
+  for (int k = 0; k < repeat; k++) {
+    MachineStateStressResult r;
+    bool started = MachineStateStore::stressTest(ms, r);
+    bool ok = started && r.torn == 0 && r.reads > 0 && r.writes > 0;
+    pass = pass && ok;
+    printf("SNAP_TEST pass=%d started=%d reads=%lu writes=%lu retries=%lu max_retries=%lu read_max_us=%lu "
+           "torn=%lu ok=%d\n",
+           k + 1, started ? 1 : 0, (unsigned long)r.reads, (unsigned long)r.writes, (unsigned long)r.retries,
+           (unsigned long)r.maxRetries, (unsigned long)r.readMaxUs, (unsigned long)r.torn, ok ? 1 : 0);
+  }
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+// Calibration tactile sur l'hôte : solve() sur des transformations synthétiques bruitées,
+// refus des points alignés et fromLegacyRange() contre l'ancien map() du pilote, aux
+// dimensions de l'écran (les mêmes vérifications que TEST_CALIB sur la cible).
+//
+//   pio run -e native_touch_cal
+//   .pio/build/native_touch_cal/program
+// Code 1 si une vérification échoue.
+#include <Arduino.h>
+#include "touch_calibrator.h"
+#include "touch_config.h"
+
+// Résolution LVGL (lvgl_screen_display.h, hors des builds hôte)
+static const int32_t WIDTH = 320;
+static const int32_t HEIGHT = 240;
+
+int main() {
+  bool pass = true;
+  for (uint8_t k = 0; k < TOUCH_CAL_TEST_CASES; k++) {
+    TouchCalTestResult r = TouchCalibrator::selfTest(k, WIDTH, HEIGHT);
+    pass = pass && r.pass;
+    printf("TOUCH_CAL_TEST case=%u points=%u residual_px=%.2f max_err_px=%.2f pass=%d\n", (unsigned)k,
+           (unsigned)r.points, r.residualPx, r.maxErrorPx, r.pass ? 1 : 0);
+  }
+  bool rejected = TouchCalibrator::rejectsCollinear();
+  pass = pass && rejected;
+  printf("TOUCH_CAL_TEST case=collinear pass=%d\n", rejected ? 1 : 0);
+  TouchCalTestResult legacy = TouchCalibrator::legacyTest(TOUCH_X_MIN, TOUCH_X_MAX, TOUCH_Y_MIN, TOUCH_Y_MAX, WIDTH,
+                                                          HEIGHT);
+  pass = pass && legacy.pass;
+  printf("TOUCH_CAL_TEST case=legacy max_err_px=%.2f pass=%d\n", legacy.maxErrorPx, legacy.pass ? 1 : 0);
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,22 @@
+// Configuration LVGL du banc de rendu hôte (env:native_ui_bench). Reprend ce que l'UI
+// suppose de la cible : 16 bits, tas LVGL intégré, thème par défaut, polices Montserrat
+// utilisées par screens.c. Le reste garde les valeurs par défaut de LVGL 9.
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+#define LV_COLOR_DEPTH          16
+#define LV_USE_STDLIB_MALLOC    LV_STDLIB_BUILTIN
+#define LV_USE_STDLIB_STRING    LV_STDLIB_BUILTIN
+#define LV_USE_STDLIB_SPRINTF   LV_STDLIB_BUILTIN
+#define LV_MEM_SIZE             (64 * 1024U)
+#define LV_USE_OS               LV_OS_NONE
+#define LV_DEF_REFR_PERIOD      33
+#define LV_USE_THEME_DEFAULT    1
+#define LV_FONT_MONTSERRAT_14   1
+#define LV_FONT_MONTSERRAT_22   1
+#define LV_FONT_DEFAULT         &lv_font_montserrat_14
+#define LV_USE_LOG              0
+#define LV_USE_ASSERT_NULL      0
+#define LV_USE_ASSERT_MALLOC    0
+
+#endif
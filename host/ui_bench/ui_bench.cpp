@@ -0,0 +1,414 @@
+// Banc de rendu de l'UI EEZ sur l'hôte : la même UI (ui_init, create_screens) tourne sur
+// un écran LVGL en mémoire, avec les mêmes tampons partiels que la cible, et des scènes
+// scriptées rejouent l'entrée tactile. Par scène : temps de rendu par image, surface
+// invalidée, nombre d'envois et surface envoyée.
+//
+//   pio run -e native_ui_bench
+//   .pio/build/native_ui_bench/program [--repeat N] [--csv out.csv] [--baseline ref.csv]
+//                                      [--tolerance PCT] [--dump DIR] [scène.scene...]
+//
+// Sans fichier de scène, les scènes intégrées sont jouées. Les surfaces sont
+// déterministes (horloge simulée) : entre deux commits, tout écart est un changement de
+// l'UI ; les temps sont comparés à --tolerance près et un dépassement rend le code 1.
+//
+// Référence versionnée : host/ui_bench/baseline.csv, produite par
+//   .pio/build/native_ui_bench/program --csv host/ui_bench/baseline.csv
+// Le CSV commence par "# lvgl=<version>" : une référence d'une autre version de LVGL
+// que celle figée dans platformio.ini est refusée (code 2) au lieu d'être comparée.
+//
+// Syntaxe des scènes, une commande par ligne (# : commentaire) :
+//   scene <nom>              nom du résultat
+//   screen <nom>             charge un écran (main)
+//   idle <n>                 n images non comptées (animations, mise en place)
+//   frames <n>               n images comptées
+//   press <x> <y> / move <x> <y> / release
+//   drag <x0> <y0> <x1> <y1> <n>   appui, n images de déplacement comptées, relâché
+//   redraw <n>               n fois : écran entier invalidé puis une image comptée
+#include <lvgl.h>
+#include "../../lib/lvgl_user_interface/src/ui/ui.h"
+#include "../../lib/config.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+struct FrameSample {
+  uint32_t renderUs;
+  uint32_t flushes;
+  uint64_t flushPx;
+  uint64_t invalidatedPx;
+};
+
+struct SceneResult {
+  std::string name;
+  uint32_t frames = 0;
+  uint32_t rendered = 0;      // Images ayant envoyé au moins une zone
+  uint64_t totalUs = 0;
+  uint32_t avgUs = 0, p50Us = 0, p95Us = 0, maxUs = 0;
+  uint32_t flushes = 0;
+  uint64_t flushPx = 0;
+  uint64_t invalidatedPx = 0;
+};
+
+static const char *const BUILTIN_SCENES[] = {
+  "scene main_first_render\n"
+  "screen main\n"
+  "frames 20\n",
+
+  // Aucune image attendue : une invalidation parasite se voit ici
+  "scene main_idle\n"
+  "screen main\n"
+  "idle 20\n"
+  "frames 60\n",
+
+  "scene main_button_press\n"
+  "screen main\n"
+  "idle 20\n"
+  "press 160 120\nframes 6\nrelease\nframes 10\n"
+  "press 160 120\nframes 6\nrelease\nframes 10\n"
+  "press 160 120\nframes 6\nrelease\nframes 10\n",
+
+  "scene main_drag_across_button\n"
+  "screen main\n"
+  "idle 20\n"
+  "drag 20 120 300 120 30\n"
+  "frames 10\n",
+
+  // Pire cas : tout l'écran à chaque image, en tampons d'un dixième d'écran
+  "scene main_full_redraw\n"
+  "screen main\n"
+  "idle 20\n"
+  "redraw 30\n",
+};
+
+// Écran en mémoire : mêmes tampons et même format que LVGL_Display::begin
+static uint16_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+static uint8_t drawBuf[2][DRAW_BUF_SIZE];
+static uint32_t nowMs;
+static FrameSample current;
+static lv_indev_state_t touchState = LV_INDEV_STATE_RELEASED;
+static int32_t touchX, touchY;
+
+static uint32_t tickCb() {
+  return nowMs;
+}
+
+static uint64_t nowUs() {
+  using namespace std::chrono;
+  return (uint64_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void flushCb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map) {
+  int32_t w = lv_area_get_width(area);
+  int32_t h = lv_area_get_height(area);
+  const uint16_t *src = (const uint16_t *)px_map;
+  for (int32_t y = 0; y < h; y++) {
+    memcpy(&framebuffer[(area->y1 + y) * SCREEN_WIDTH + area->x1], src + y * w, (size_t)w * sizeof(uint16_t));
+  }
+  current.flushes++;
+  current.flushPx += (uint64_t)w * h;
+  lv_display_flush_ready(disp);
+}
+
+static void invalidateCb(lv_event_t *e) {
+  const lv_area_t *area = (const lv_area_t *)lv_event_get_param(e);
+  if (area) current.invalidatedPx += (uint64_t)lv_area_get_width(area) * lv_area_get_height(area);
+}
+
+static void touchReadCb(lv_indev_t *indev, lv_indev_data_t *data) {
+  data->point.x = touchX;
+  data->point.y = touchY;
+  data->state = touchState;
+}
+
+// LVGL repart de zéro à chaque scène : aucun état (style pressé, animation) ne déborde
+static void setupUi() {
+  lv_init();
+  nowMs = 0;
+  lv_tick_set_cb(tickCb);
+  lv_display_t *disp = lv_display_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+  lv_display_set_color_format(disp, LV_COLOR_FORMAT_RGB565_SWAPPED);
+  lv_display_set_buffers(disp, drawBuf[0], drawBuf[1], DRAW_BUF_SIZE, LV_DISPLAY_RENDER_MODE_PARTIAL);
+  lv_display_set_flush_cb(disp, flushCb);
+  lv_display_add_event_cb(disp, invalidateCb, LV_EVENT_INVALIDATE_AREA, nullptr);
+  lv_indev_t *indev = lv_indev_create();
+  lv_indev_set_type(indev, LV_INDEV_TYPE_POINTER);
+  lv_indev_set_read_cb(indev, touchReadCb);
+  touchState = LV_INDEV_STATE_RELEASED;
+  touchX = touchY = 0;
+  ui_init();
+}
+
+// Une période de rafraîchissement par image : un appel = une lecture tactile + un rendu
+static FrameSample step() {
+  nowMs += LV_DEF_REFR_PERIOD;
+  current = FrameSample();
+  uint64_t t0 = nowUs();
+  lv_timer_handler();
+  current.renderUs = (uint32_t)(nowUs() - t0);
+  return current;
+}
+
+static bool parseScreen(const std::string &name, ScreensEnum &id) {
+  static const std::map<std::string, ScreensEnum> screens = { { "main", SCREEN_ID_MAIN } };
+  auto it = screens.find(name);
+  if (it == screens.end()) return false;
+  id = it->second;
+  return true;
+}
+
+static bool runScene(const std::string &script, SceneResult &result) {
+  setupUi();
+  std::vector<FrameSample> samples;
+  // Invalidations faites par la scène elle-même (chargement d'écran, redraw) : comptées
+  // dans l'image suivante
+  uint64_t pendingInvalidated = 0;
+  auto record = [&](uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+      FrameSample s = step();
+      s.invalidatedPx += pendingInvalidated;
+      pendingInvalidated = 0;
+      samples.push_back(s);
+    }
+  };
+  std::istringstream in(script);
+  std::string line;
+  int lineNo = 0;
+  while (std::getline(in, line)) {
+    lineNo++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) line.erase(hash);
+    std::istringstream words(line);
+    std::string cmd;
+    if (!(words >> cmd)) continue;
+    bool ok = true;
+    if (cmd == "scene") {
+      ok = (bool)(words >> result.name);
+    } else if (cmd == "screen") {
+      std::string name;
+      ScreensEnum id;
+      ok = (words >> name) && parseScreen(name, id);
+      // ui_init() a déjà chargé l'écran principal : pas de second fondu
+      if (ok && lv_screen_active() != ((lv_obj_t **)&objects)[id - 1]) {
+        current = FrameSample();
+        loadScreen(id);
+        pendingInvalidated += current.invalidatedPx;
+      }
+    } else if (cmd == "idle") {
+      uint32_t n = 0;
+      ok = (bool)(words >> n);
+      for (uint32_t i = 0; i < n; i++) step();
+      pendingInvalidated = 0;
+    } else if (cmd == "frames") {
+      uint32_t n = 0;
+      ok = (bool)(words >> n);
+      record(n);
+    } else if (cmd == "press" || cmd == "move") {
+      ok = (bool)(words >> touchX >> touchY);
+      touchState = LV_INDEV_STATE_PRESSED;
+    } else if (cmd == "release") {
+      touchState = LV_INDEV_STATE_RELEASED;
+    } else if (cmd == "drag") {
+      int32_t x0, y0, x1, y1;
+      uint32_t n;
+      ok = (words >> x0 >> y0 >> x1 >> y1 >> n) && n > 0;
+      if (ok) {
+        touchState = LV_INDEV_STATE_PRESSED;
+        for (uint32_t i = 0; i <= n; i++) {
+          touchX = x0 + (x1 - x0) * (int32_t)i / (int32_t)n;
+          touchY = y0 + (y1 - y0) * (int32_t)i / (int32_t)n;
+          record(1);
+        }
+        touchState = LV_INDEV_STATE_RELEASED;
+        record(1);
+      }
+    } else if (cmd == "redraw") {
+      uint32_t n = 0;
+      ok = (bool)(words >> n);
+      for (uint32_t i = 0; i < n; i++) {
+        current = FrameSample();
+        lv_obj_invalidate(lv_screen_active());
+        pendingInvalidated += current.invalidatedPx;
+        record(1);
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "ERROR: scene %s line %d: %s\n", result.name.c_str(), lineNo, line.c_str());
+      lv_deinit();
+      return false;
+    }
+  }
+  lv_deinit();
+
+  std::vector<uint32_t> times;
+  result.frames = (uint32_t)samples.size();
+  for (const FrameSample &s : samples) {
+    result.flushes += s.flushes;
+    result.flushPx += s.flushPx;
+    result.invalidatedPx += s.invalidatedPx;
+    if (s.flushes == 0) continue;
+    times.push_back(s.renderUs);
+    result.totalUs += s.renderUs;
+  }
+  result.rendered = (uint32_t)times.size();
+  if (!times.empty()) {
+    std::sort(times.begin(), times.end());
+    result.avgUs = (uint32_t)(result.totalUs / times.size());
+    result.p50Us = times[times.size() / 2];
+    result.p95Us = times[std::min(times.size() - 1, times.size() * 95 / 100)];
+    result.maxUs = times.back();
+  }
+  return true;
+}
+
+// Image finale de la scène en PPM (RGB565 octets inversés -> RGB888)
+static void dumpFramebuffer(const std::string &dir, const std::string &name) {
+  std::string path = dir + "/" + name + ".ppm";
+  FILE *f = fopen(path.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "ERROR: cannot write %s\n", path.c_str());
+    return;
+  }
+  fprintf(f, "P6 %d %d 255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+  for (uint32_t i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+    uint16_t c = (uint16_t)((framebuffer[i] >> 8) | (framebuffer[i] << 8));
+    uint8_t rgb[3] = { (uint8_t)((c >> 11) << 3), (uint8_t)(((c >> 5) & 0x3F) << 2), (uint8_t)((c & 0x1F) << 3) };
+    fwrite(rgb, 1, sizeof(rgb), f);
+  }
+  fclose(f);
+}
+
+static const char *CSV_HEADER = "scene,frames,rendered,avg_us,p50_us,p95_us,max_us,flushes,flush_px,invalidated_px";
+
+static std::string lvglVersion() {
+  char text[32];
+  snprintf(text, sizeof(text), "%d.%d.%d", LVGL_VERSION_MAJOR, LVGL_VERSION_MINOR, LVGL_VERSION_PATCH);
+  return text;
+}
+
+// Scènes de la référence ; version vide si le fichier n'a pas de ligne "# lvgl="
+static std::map<std::string, SceneResult> loadBaseline(const char *path, std::string &version) {
+  std::map<std::string, SceneResult> out;
+  std::ifstream in(path);
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 7, "# lvgl=") == 0) {
+      version = line.substr(7);
+      continue;
+    }
+    if (line.empty() || line[0] == '#' || line.compare(0, 6, "scene,") == 0) continue;
+    for (char &c : line) if (c == ',') c = ' ';
+    std::istringstream f(line);
+    SceneResult r;
+    if (f >> r.name >> r.frames >> r.rendered >> r.avgUs >> r.p50Us >> r.p95Us >> r.maxUs >> r.flushes >> r.flushPx >>
+        r.invalidatedPx) {
+      out[r.name] = r;
+    }
+  }
+  return out;
+}
+
+int main(int argc, char **argv) {
+  uint32_t repeat = 5;
+  double tolerance = 10.0;
+  const char *csvPath = nullptr;
+  const char *baselinePath = nullptr;
+  const char *dumpDir = nullptr;
+  std::vector<std::string> scripts;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (a == "--repeat" && hasValue) repeat = (uint32_t)std::max(1, atoi(argv[++i]));
+    else if (a == "--csv" && hasValue) csvPath = argv[++i];
+    else if (a == "--baseline" && hasValue) baselinePath = argv[++i];
+    else if (a == "--tolerance" && hasValue) tolerance = atof(argv[++i]);
+    else if (a == "--dump" && hasValue) dumpDir = argv[++i];
+    else if (a.compare(0, 2, "--") == 0) {
+      fprintf(stderr, "usage: %s [--repeat N] [--csv out.csv] [--baseline ref.csv] [--tolerance PCT] "
+                      "[--dump DIR] [scene...]\n", argv[0]);
+      return 2;
+    } else {
+      std::ifstream in(a);
+      if (!in) {
+        fprintf(stderr, "ERROR: cannot read %s\n", a.c_str());
+        return 2;
+      }
+      std::stringstream text;
+      text << in.rdbuf();
+      scripts.push_back(text.str());
+    }
+  }
+  if (scripts.empty()) scripts.assign(std::begin(BUILTIN_SCENES), std::end(BUILTIN_SCENES));
+
+  std::map<std::string, SceneResult> baseline;
+  if (baselinePath) {
+    std::ifstream probe(baselinePath);
+    if (!probe) {
+      fprintf(stderr, "ERROR: cannot read %s\n", baselinePath);
+      return 2;
+    }
+    std::string version;
+    baseline = loadBaseline(baselinePath, version);
+    if (version != lvglVersion()) {
+      fprintf(stderr, "ERROR: baseline %s made with LVGL %s, bench built with LVGL %s\n", baselinePath,
+              version.empty() ? "?" : version.c_str(), lvglVersion().c_str());
+      return 2;
+    }
+  }
+  std::vector<SceneResult> results;
+  bool regression = false;
+  for (const std::string &script : scripts) {
+    // Meilleure des répétitions : les surfaces sont identiques, seul le bruit de l'hôte varie
+    SceneResult best;
+    for (uint32_t r = 0; r < repeat; r++) {
+      SceneResult run;
+      run.name = "scene" + std::to_string(results.size());
+      if (!runScene(script, run)) return 2;
+      if (r == 0 || run.totalUs < best.totalUs) best = run;
+    }
+    if (dumpDir) {
+      // La dernière répétition a laissé son image dans framebuffer
+      dumpFramebuffer(dumpDir, best.name);
+    }
+    printf("SCENE name=%s frames=%u rendered=%u avg_us=%u p50_us=%u p95_us=%u max_us=%u flushes=%u "
+           "flush_px=%llu invalidated_px=%llu\n",
+           best.name.c_str(), best.frames, best.rendered, best.avgUs, best.p50Us, best.p95Us, best.maxUs,
+           best.flushes, (unsigned long long)best.flushPx, (unsigned long long)best.invalidatedPx);
+    auto it = baseline.find(best.name);
+    if (it != baseline.end()) {
+      const SceneResult &ref = it->second;
+      double delta = ref.avgUs ? 100.0 * ((double)best.avgUs - ref.avgUs) / ref.avgUs : 0.0;
+      bool slower = delta > tolerance;
+      bool changed = best.flushes != ref.flushes || best.flushPx != ref.flushPx ||
+                     best.invalidatedPx != ref.invalidatedPx || best.rendered != ref.rendered;
+      printf("DELTA name=%s avg_us=%u->%u (%+.1f%%) flush_px=%llu->%llu invalidated_px=%llu->%llu%s%s\n",
+             best.name.c_str(), ref.avgUs, best.avgUs, delta, (unsigned long long)ref.flushPx,
+             (unsigned long long)best.flushPx, (unsigned long long)ref.invalidatedPx,
+             (unsigned long long)best.invalidatedPx, slower ? " REGRESSION" : "", changed ? " CHANGED" : "");
+      regression |= slower;
+    }
+    results.push_back(best);
+  }
+  if (csvPath) {
+    FILE *f = fopen(csvPath, "w");
+    if (!f) {
+      fprintf(stderr, "ERROR: cannot write %s\n", csvPath);
+      return 2;
+    }
+    fprintf(f, "# lvgl=%s\n%s\n", lvglVersion().c_str(), CSV_HEADER);
+    for (const SceneResult &r : results) {
+      fprintf(f, "%s,%u,%u,%u,%u,%u,%u,%u,%llu,%llu\n", r.name.c_str(), r.frames, r.rendered, r.avgUs, r.p50Us,
+              r.p95Us, r.maxUs, r.flushes, (unsigned long long)r.flushPx, (unsigned long long)r.invalidatedPx);
+    }
+    fclose(f);
+  }
+  return regression ? 1 : 0;
+}
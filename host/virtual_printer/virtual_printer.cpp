@@ -0,0 +1,557 @@
+// Imprimante virtuelle : la chaîne Comm → SD → Parser → Motion du firmware, ses tâches
+// et ses files, sur Linux. Serial est un pseudo-terminal, un répertoire tient lieu de
+// carte SD (PosixStorage), et MotionTask remplace le planificateur absent en vidant
+// motionQueue.
+//
+//   pio run -e native_vprinter
+//   .pio/build/native_vprinter/program --sd DIR [--link /tmp/vprinter]
+//       Interactif : le port affiché (ou le lien) s'ouvre comme un port série.
+//   .pio/build/native_vprinter/program --sd DIR --job JOB.gcode [--probes N] [--csv out.csv]
+//       Mesure : N allers-retours M105 sur le port, puis READ_SD du job jusqu'au dernier
+//       mouvement sorti de motionQueue. Code 1 si le job n'est pas allé au bout ou si
+//       un mouvement sort du volume atteignable de la cinématique (unreachable=N).
+//       --busy-probes N : pendant le job, N allers-retours M105 (voie immédiate) et N G90
+//       (flux HOST, "ok" à l'entrée dans sa file) en alternance toutes les 50 ms ; les G90
+//       s'ajoutent aux commandes comptées.
+//
+// Options communes : --no-pacing (octets reçus sans limite de débit), --motion-us N
+// (durée simulée de chaque commande de mouvement, 0 par défaut), --timeout S,
+// --optimize (MotionOptimizer actif dès le démarrage, comme OPTIMIZE ON), --kinematics
+// cartesian|corexy|delta (MotionTask découpe chaque mouvement en segments moteurs).
+//
+//   .pio/build/native_vprinter_static/program --sd DIR --job JOB.gcode --soak S
+//       Endurance : READ_SD du job en boucle pendant S secondes, tas verrouillé après le
+//       démarrage. Code 1 si une tâche alloue ou si le tas libre dérive entre la fin du
+//       premier passage et celle du dernier.
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include <Arduino.h>
+#include "system_manager.h"
+#include "sd_manager.h"
+#include "comm_manager.h"
+#include "gcode_parser.h"
+#include "gcode_scheduler.h"
+#include "machine_state.h"
+#include "fault_bus.h"
+#include "boot_sequencer.h"
+#include "motion_optimizer.h"
+#include "heap_guard.h"
+#include "kinematics.h"
+#include "mem_placement.h"
+#include "storage_posix.h"
+#include <esp_heap_caps.h>
+#include "../../lib/config.h"
+#include <algorithm>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+struct Options {
+  const char *sdRoot = "sd";
+  const char *link = nullptr;
+  const char *job = nullptr;
+  const char *csv = nullptr;
+  uint32_t probes = 200;
+  uint32_t busyProbes = 0;
+  uint32_t motionUs = 0;
+  uint32_t timeoutS = 600;
+  uint32_t soakS = 0;
+  bool pacing = true;
+  bool optimize = false;
+  KinematicsType kinematics = (KinematicsType)KINEMATICS_TYPE_DEFAULT;
+};
+
+static Options options;
+
+// Sortie de motionQueue : horodatage de chaque commande, dans l'ordre, pour la mesure. En
+// interactif et en endurance les commandes sont seulement comptées : le vecteur ferait
+// grossir le tas après son verrouillage. En mesure, il est réservé avant le verrouillage
+// pour toutes les lignes du job (reserveMotionTimes).
+static pthread_mutex_t motionLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<int64_t> motionTimes;
+static uint32_t motionCount;
+static uint32_t motionMoves;
+static uint32_t motionSegments;
+static uint32_t motionUnreachable;   // Mouvements refusés par la cinématique active
+
+// Position cartésienne suivie par MotionTask, avec ses propres modes G90/G91 et M82/M83
+struct MotionTracker {
+  float pos[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  float feed = PLANNER_DEFAULT_FEED_MM_S;
+  bool absolute = true;
+  bool absoluteE = true;
+};
+
+static bool countSegment(const float motor[4], void *context) {
+  (*(uint32_t *)context)++;
+  return true;
+}
+
+// Segments moteurs d'une commande ; les arcs passent en corde, seul le nombre compte ici.
+// Un mouvement hors du volume atteignable ne compte aucun segment et est compté à part.
+static uint32_t segmentMotion(MotionTracker &t, const MotionCommand &cmd) {
+  if (cmd.type == 'G' && cmd.code == (int)GcodeType::G90) t.absolute = true;
+  if (cmd.type == 'G' && cmd.code == (int)GcodeType::G91) t.absolute = false;
+  if (cmd.type == 'M' && cmd.code == (int)GcodeType::M82) t.absoluteE = true;
+  if (cmd.type == 'M' && cmd.code == (int)GcodeType::M83) t.absoluteE = false;
+  if (cmd.type != 'G' || cmd.code > 3) return 0;
+  if (cmd.has_f && cmd.f > 0.0f) t.feed = cmd.f;
+  float to[4];
+  const float values[4] = { cmd.x, cmd.y, cmd.z, cmd.e };
+  const bool present[4] = { cmd.has_x, cmd.has_y, cmd.has_z, cmd.has_e };
+  for (int i = 0; i < 4; i++) {
+    bool absolute = i == AXIS_E ? t.absoluteE : t.absolute;
+    to[i] = !present[i] ? t.pos[i] : absolute ? values[i] : t.pos[i] + values[i];
+  }
+  uint32_t segments = 0;
+  if (!machineKinematics.active().segment(t.pos, to, t.feed, countSegment, &segments)) {
+    motionUnreachable++;
+    segments = 0;
+  }
+  memcpy(t.pos, to, sizeof(to));
+  return segments;
+}
+
+static void motionTask(void *pvParameters) {
+  MotionCommand cmd;
+  MotionTracker tracker;
+  while (1) {
+    if (xQueueReceive(motionQueue, &cmd, portMAX_DELAY) != pdTRUE) continue;
+    int64_t now = esp_timer_get_time();
+    pthread_mutex_lock(&motionLock);
+    if (options.job && !options.soakS) motionTimes.push_back(now);
+    motionCount++;
+    if (cmd.type == 'G' && cmd.code <= 3) motionMoves++;
+    motionSegments += segmentMotion(tracker, cmd);
+    pthread_mutex_unlock(&motionLock);
+    if (options.motionUs) delayMicroseconds(options.motionUs);
+  }
+}
+
+// Une commande de mouvement au plus par ligne du job et par sonde G90 : plus aucune
+// allocation pendant la mesure
+static void reserveMotionTimes() {
+  std::string path = std::string(options.sdRoot) + "/" + options.job;
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) return;
+  size_t lines = 1;
+  int c;
+  while ((c = fgetc(f)) != EOF) {
+    if (c == '\n') lines++;
+  }
+  fclose(f);
+  motionTimes.reserve(lines + options.busyProbes);
+}
+
+static bool bootQueues() { return systemManager.initQueues(); }
+static bool bootSd() { return sdManager.init(); }
+static bool bootTasks() { return systemManager.startTasks(); }
+
+// Mêmes étapes que main.cpp, sans écran ni tactile
+static bool boot() {
+  BootStageId queues = bootSequencer.addStage("queues", bootQueues);
+  BootStageId sd = bootSequencer.addStage("sd", bootSd, bootDep(queues));
+  BootStageId tasks = bootSequencer.addStage("tasks", bootTasks, bootDep(queues));
+  bootSequencer.runAfter(tasks, sd);
+  if (!bootSequencer.run()) return false;
+  return heapGuard.createTask(motionTask, "MotionTask", 4096, NULL, 2, NULL, 1);
+}
+
+// Côté hôte du port série : lignes reçues, horodatées par un thread lecteur
+class HostLink {
+public:
+  bool open(const char *port) {
+    fd = ::open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0) return false;
+    struct termios tio;
+    tcgetattr(fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(fd, TCSANOW, &tio);
+    pthread_mutex_init(&lock, nullptr);
+    pthread_cond_init(&arrived, nullptr);
+    pthread_t reader;
+    pthread_create(&reader, nullptr, readerThread, this);
+    pthread_detach(reader);
+    return true;
+  }
+
+  void send(const char *line) {
+    std::string out = std::string(line) + "\n";
+    size_t done = 0;
+    while (done < out.size()) {
+      ssize_t n = ::write(fd, out.data() + done, out.size() - done);
+      if (n <= 0) return;
+      done += (size_t)n;
+    }
+  }
+
+  // Prochaine ligne reçue commençant par prefix ; les autres sont écartées. errors compte
+  // les lignes "ERROR" écartées au passage.
+  bool waitFor(const char *prefix, uint32_t timeoutMs, int64_t *at, uint32_t *errors) {
+    int64_t end = esp_timer_get_time() + (int64_t)timeoutMs * 1000;
+    pthread_mutex_lock(&lock);
+    while (true) {
+      while (!lines.empty()) {
+        Line l = lines.front();
+        lines.pop_front();
+        if (l.text.compare(0, strlen(prefix), prefix) == 0) {
+          pthread_mutex_unlock(&lock);
+          if (at) *at = l.at;
+          return true;
+        }
+        if (errors && l.text.compare(0, 5, "ERROR") == 0) (*errors)++;
+      }
+      int64_t now = esp_timer_get_time();
+      if (now >= end) break;
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      int64_t ns = ts.tv_nsec + std::min<int64_t>(end - now, 10000) * 1000;
+      ts.tv_sec += ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+      pthread_cond_timedwait(&arrived, &lock, &ts);
+    }
+    pthread_mutex_unlock(&lock);
+    return false;
+  }
+
+  uint32_t drain() {
+    uint32_t errors = 0;
+    waitFor("\x01", 0, nullptr, &errors);
+    return errors;
+  }
+
+private:
+  struct Line {
+    int64_t at;
+    std::string text;
+  };
+  int fd = -1;
+  pthread_mutex_t lock;
+  pthread_cond_t arrived;
+  std::deque<Line> lines;
+
+  static void *readerThread(void *self) {
+    HostLink *h = (HostLink *)self;
+    std::string partial;
+    char buf[512];
+    while (true) {
+      ssize_t n = ::read(h->fd, buf, sizeof(buf));
+      if (n <= 0) return nullptr;
+      int64_t now = esp_timer_get_time();
+      for (ssize_t i = 0; i < n; i++) {
+        if (buf[i] == '\r') continue;
+        if (buf[i] != '\n') {
+          partial += buf[i];
+          continue;
+        }
+        pthread_mutex_lock(&h->lock);
+        h->lines.push_back({ now, partial });
+        pthread_cond_signal(&h->arrived);
+        pthread_mutex_unlock(&h->lock);
+        partial.clear();
+      }
+    }
+  }
+};
+
+static uint32_t percentile(std::vector<uint32_t> v, uint32_t pct) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, v.size() * pct / 100)];
+}
+
+struct JobResult {
+  uint32_t commands;
+  uint32_t moves;
+  uint32_t segments;        // Segments moteurs de la cinématique active
+  uint32_t unreachable;     // Mouvements hors du volume de cette cinématique
+  uint32_t elapsedMs;
+  uint32_t firstMs;
+  uint32_t gapP50Us, gapP95Us, gapMaxUs;
+  uint32_t errors;
+  bool complete;
+};
+
+// Allers-retours de l'hôte pendant le job : rapport et ligne du flux HOST
+struct BusyProbes {
+  std::vector<uint32_t> report, stream;
+  uint32_t timeouts = 0;
+};
+
+// Job terminé : SD lue jusqu'au bout, files vides et plus rien en sortie depuis 100 ms
+// (le parser marque une pause de 10 ms entre deux lignes)
+static bool jobDrained(size_t &lastCount, int64_t &lastChange) {
+  MachineState s;
+  machineState.snapshot(s);
+  pthread_mutex_lock(&motionLock);
+  size_t count = motionCount;
+  pthread_mutex_unlock(&motionLock);
+  int64_t now = esp_timer_get_time();
+  if (count != lastCount) {
+    lastCount = count;
+    lastChange = now;
+  }
+  bool read = !s.printing && s.sd_size > 0 && s.sd_bytes == s.sd_size;
+  return read && gcodeScheduler.pending() == 0 && uxQueueMessagesWaiting(motionQueue) == 0 &&
+         now - lastChange > 100000;
+}
+
+static bool runJob(HostLink &host, JobResult &r, BusyProbes *busy = nullptr) {
+  memset(&r, 0, sizeof(r));
+  pthread_mutex_lock(&motionLock);
+  motionTimes.clear();
+  motionCount = 0;
+  motionMoves = 0;
+  motionSegments = 0;
+  motionUnreachable = 0;
+  pthread_mutex_unlock(&motionLock);
+  char cmd[COMM_LINE_MAX];
+  snprintf(cmd, sizeof(cmd), "READ_SD %s", options.job);
+  int64_t start = esp_timer_get_time();
+  host.send(cmd);
+  if (!host.waitFor("OK: READ_SD", 2000, nullptr, &r.errors)) return false;
+  size_t lastCount = 0;
+  int64_t lastChange = start;
+  int64_t deadline = start + (int64_t)options.timeoutS * 1000000;
+  int64_t nextProbe = start;
+  while (!(r.complete = jobDrained(lastCount, lastChange))) {
+    if (esp_timer_get_time() > deadline) break;
+    r.errors += host.drain();
+    if (busy && busy->stream.size() < options.busyProbes && esp_timer_get_time() >= nextProbe) {
+      bool report = busy->report.size() <= busy->stream.size();
+      int64_t sent = esp_timer_get_time(), at;
+      host.send(report ? "M105" : "G90");
+      if (host.waitFor(report ? "ok T:" : "ok", 1000, &at, &r.errors)) {
+        (report ? busy->report : busy->stream).push_back((uint32_t)(at - sent));
+      } else {
+        busy->timeouts++;
+      }
+      nextProbe = sent + 50000;
+    }
+    vTaskDelay(pdMS_TO_TICKS(5));
+  }
+  r.errors += host.drain();
+  pthread_mutex_lock(&motionLock);
+  std::vector<int64_t> times = motionTimes;
+  r.commands = motionCount;
+  r.moves = motionMoves;
+  r.segments = motionSegments;
+  r.unreachable = motionUnreachable;
+  pthread_mutex_unlock(&motionLock);
+  if (times.empty()) return r.complete;
+  r.firstMs = (uint32_t)((times.front() - start) / 1000);
+  r.elapsedMs = (uint32_t)((times.back() - start) / 1000);
+  std::vector<uint32_t> gaps;
+  for (size_t i = 1; i < times.size(); i++) gaps.push_back((uint32_t)(times[i] - times[i - 1]));
+  r.gapP50Us = percentile(gaps, 50);
+  r.gapP95Us = percentile(gaps, 95);
+  r.gapMaxUs = gaps.empty() ? 0 : *std::max_element(gaps.begin(), gaps.end());
+  return r.complete;
+}
+
+static int runBench() {
+  HostLink host;
+  if (!host.open(Serial.portName())) {
+    fprintf(stderr, "ERROR: cannot open %s\n", Serial.portName());
+    return 2;
+  }
+  // Journal du démarrage
+  vTaskDelay(pdMS_TO_TICKS(300));
+  host.drain();
+
+  // Aller-retour d'une commande traitée par CommTask, réponse écrite par ReportManager
+  std::vector<uint32_t> latencies;
+  for (uint32_t i = 0; i < options.probes; i++) {
+    int64_t sent = esp_timer_get_time();
+    host.send("M105");
+    int64_t at;
+    if (!host.waitFor("ok", 1000, &at, nullptr)) {
+      fprintf(stderr, "ERROR: M105 probe %u timed out\n", i);
+      return 1;
+    }
+    latencies.push_back((uint32_t)(at - sent));
+  }
+  uint32_t latMax = latencies.empty() ? 0 : *std::max_element(latencies.begin(), latencies.end());
+  printf("VPRINTER_LATENCY cmd=M105 n=%u p50_us=%u p95_us=%u p99_us=%u max_us=%u\n", (unsigned)latencies.size(),
+         percentile(latencies, 50), percentile(latencies, 95), percentile(latencies, 99), latMax);
+
+  JobResult r;
+  BusyProbes busy;
+  bool ok = runJob(host, r, &busy);
+  // Un mouvement hors d'atteinte n'a produit aucun segment : le résultat ne vaut rien
+  if (r.unreachable) {
+    fprintf(stderr, "ERROR: %u moves of %s out of reach for %s kinematics\n", r.unreachable, options.job,
+            machineKinematics.active().name());
+  }
+  double seconds = r.elapsedMs / 1000.0;
+  FaultStats faults;
+  faultBus.getStats(faults);
+  printf("VPRINTER_JOB file=%s complete=%d commands=%u moves=%u elapsed_ms=%u commands_per_s=%.1f first_ms=%u "
+         "gap_p50_us=%u gap_p95_us=%u gap_max_us=%u errors=%u faults=%u rx_bytes=%u tx_bytes=%u optimize=%d "
+         "kinematics=%s segments=%u unreachable=%u\n",
+         options.job, ok ? 1 : 0, r.commands, r.moves, r.elapsedMs, seconds > 0 ? r.commands / seconds : 0.0,
+         r.firstMs, r.gapP50Us, r.gapP95Us, r.gapMaxUs, r.errors, (unsigned)faults.raised, Serial.rxBytes(),
+         Serial.txBytes(), options.optimize ? 1 : 0, machineKinematics.active().name(), r.segments, r.unreachable);
+  if (options.busyProbes) {
+    const std::vector<uint32_t> *sets[2] = { &busy.report, &busy.stream };
+    static const char *const names[2] = { "M105", "G90" };
+    for (int k = 0; k < 2; k++) {
+      const std::vector<uint32_t> &v = *sets[k];
+      printf("VPRINTER_LATENCY_PRINTING cmd=%s n=%u p50_us=%u p95_us=%u max_us=%u timeouts=%u\n", names[k],
+             (unsigned)v.size(), percentile(v, 50), percentile(v, 95),
+             v.empty() ? 0 : *std::max_element(v.begin(), v.end()), busy.timeouts);
+    }
+  }
+  if (options.csv) {
+    FILE *f = fopen(options.csv, "w");
+    if (f) {
+      fprintf(f, "job,complete,commands,moves,elapsed_ms,first_ms,gap_p50_us,gap_p95_us,gap_max_us,errors,"
+                 "latency_p50_us,latency_p95_us,latency_max_us,unreachable\n");
+      fprintf(f, "%s,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n", options.job, ok ? 1 : 0, r.commands, r.moves,
+              r.elapsedMs, r.firstMs, r.gapP50Us, r.gapP95Us, r.gapMaxUs, r.errors, percentile(latencies, 50),
+              percentile(latencies, 95), latMax, r.unreachable);
+      fclose(f);
+    } else {
+      fprintf(stderr, "ERROR: cannot write %s\n", options.csv);
+    }
+  }
+  return ok && !r.unreachable ? 0 : 1;
+}
+
+// Tas interne libre : celui des tâches, plus les quelques octets du thread principal (hôte)
+static uint32_t heapFree() {
+  return (uint32_t)heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+static int runSoak() {
+  HostLink host;
+  if (!host.open(Serial.portName())) {
+    fprintf(stderr, "ERROR: cannot open %s\n", Serial.portName());
+    return 2;
+  }
+  vTaskDelay(pdMS_TO_TICKS(300));
+  host.drain();
+  heapGuard.resetStats();
+
+  // Référence prise après le premier passage : les tampons paresseux (descripteurs de
+  // fichier de la libc, chaînes du lien hôte) sont alors en place
+  int64_t end = esp_timer_get_time() + (int64_t)options.soakS * 1000000;
+  uint32_t iterations = 0, freeStart = 0, freeEnd = 0, commands = 0, errors = 0;
+  bool complete = true;
+  do {
+    JobResult r;
+    complete = runJob(host, r) && !r.unreachable && complete;
+    iterations++;
+    commands += r.commands;
+    errors += r.errors;
+    freeEnd = heapFree();
+    if (iterations == 1) freeStart = freeEnd;
+    HeapGuardStats h;
+    heapGuard.getStats(h);
+    printf("VPRINTER_SOAK iter=%u commands=%u complete=%d unreachable=%u free=%u allocs=%u bytes=%u\n", iterations,
+           r.commands, r.complete ? 1 : 0, r.unreachable, freeEnd, h.allocations, h.bytes);
+    fflush(stdout);
+  } while (esp_timer_get_time() < end);
+
+  HeapGuardStats h;
+  heapGuard.getStats(h);
+  int32_t drift = (int32_t)freeStart - (int32_t)freeEnd;
+  bool pass = complete && h.locked && h.allocations == 0 && drift <= 0;
+  printf("VPRINTER_SOAK_SUMMARY file=%s seconds=%u iterations=%u commands=%u errors=%u static=%d locked=%d "
+         "arena_used=%u free_start=%u free_end=%u drift=%d allocs=%u bytes=%u largest=%u pass=%d\n",
+         options.job, options.soakS, iterations, commands, errors, STATIC_ALLOCATION, h.locked ? 1 : 0, h.arenaUsed,
+         freeStart, freeEnd, drift, h.allocations, h.bytes, h.largest, pass ? 1 : 0);
+  if (h.allocations) heapGuard.printReport();
+  return pass ? 0 : 1;
+}
+
+static void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--sd DIR] [--link PATH] [--job FILE [--probes N] [--busy-probes N] [--csv FILE]] "
+          "[--no-pacing] [--motion-us N] [--timeout S] [--optimize] [--kinematics cartesian|corexy|delta] "
+          "[--soak S]\n",
+          argv0);
+}
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool value = i + 1 < argc;
+    if (a == "--sd" && value) options.sdRoot = argv[++i];
+    else if (a == "--link" && value) options.link = argv[++i];
+    else if (a == "--job" && value) options.job = argv[++i];
+    else if (a == "--csv" && value) options.csv = argv[++i];
+    else if (a == "--probes" && value) options.probes = (uint32_t)atoi(argv[++i]);
+    else if (a == "--busy-probes" && value) options.busyProbes = (uint32_t)atoi(argv[++i]);
+    else if (a == "--motion-us" && value) options.motionUs = (uint32_t)atoi(argv[++i]);
+    else if (a == "--timeout" && value) options.timeoutS = (uint32_t)atoi(argv[++i]);
+    else if (a == "--soak" && value) options.soakS = (uint32_t)atoi(argv[++i]);
+    else if (a == "--no-pacing") options.pacing = false;
+    else if (a == "--optimize") options.optimize = true;
+    else if (a == "--kinematics" && value) {
+      std::string name = argv[++i];
+      std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+      if (!MachineKinematics::parseType(name.c_str(), options.kinematics)) {
+        usage(argv[0]);
+        return 2;
+      }
+    }
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  // Signaux traités par sigwait() plus bas, jamais dans une tâche
+  sigset_t stop;
+  sigemptyset(&stop);
+  sigaddset(&stop, SIGINT);
+  sigaddset(&stop, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+
+  static PosixStorage sdCard(options.sdRoot);
+  sdManager.setStorage(&sdCard);
+  Serial.setPacing(options.pacing);
+  motionOptimizer.setEnabled(options.optimize);
+  if (!machineKinematics.select(options.kinematics)) {
+    fprintf(stderr, "ERROR: cannot select kinematics\n");
+    return 2;
+  }
+  commManager.init();
+  if (!Serial) return 2;
+  memPlacement.init();
+  if (options.link) {
+    unlink(options.link);
+    if (symlink(Serial.portName(), options.link) != 0) fprintf(stderr, "ERROR: cannot create %s\n", options.link);
+  }
+  printf("VPRINTER port=%s sd=%s pacing=%d\n", options.link ? options.link : Serial.portName(), options.sdRoot,
+         options.pacing ? 1 : 0);
+  fflush(stdout);
+  if (!boot()) {
+    fprintf(stderr, "ERROR: boot failed\n");
+    return 2;
+  }
+  if (options.job && !options.soakS) reserveMotionTimes();
+  heapGuard.lock();
+
+  int rc = 0;
+  if (options.job && options.soakS) {
+    rc = runSoak();
+  } else if (options.job) {
+    rc = runBench();
+  } else {
+    int sig;
+    sigwait(&stop, &sig);
+    pthread_mutex_lock(&motionLock);
+    printf("VPRINTER_STATS rx_bytes=%u tx_bytes=%u tx_dropped=%u commands=%u moves=%u\n", Serial.rxBytes(),
+           Serial.txBytes(), Serial.txDroppedBytes(), motionCount, motionMoves);
+    pthread_mutex_unlock(&motionLock);
+  }
+  if (options.link) unlink(options.link);
+  fflush(stdout);
+  // Les tâches ne se terminent jamais : sortie sans détruire les objets globaux
+  _exit(rc);
+}
@@ -0,0 +1,114 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "boot_sequencer.h"
+#include <freertos/task.h>
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+static_assert(BOOT_MAX_STAGES <= 24, "Un EventGroup FreeRTOS ne porte que 24 bits");
+
+static const char *const BOOT_STATE_NAMES[] = { "PENDING", "RUNNING", "DONE", "FAILED", "SKIPPED" };
+static portMUX_TYPE bootMux = portMUX_INITIALIZER_UNLOCKED;
+
+BootSequencer bootSequencer;
+
+BootSequencer::BootSequencer() : stages(), stageCount(0), doneBits(nullptr), failedMask(0), runStart_us(0),
+  ready_us(0), ready(false) {}
+
+BootStageId BootSequencer::addStage(const char *name, BootStageFn fn, uint32_t deps, uint32_t stackSize, int8_t core) {
+  if (stageCount >= BOOT_MAX_STAGES) {
+    DEBUG_ERRORF_AUTO("Erreur: Trop d'étapes de démarrage, %s ignorée", name);
+    return BOOT_MAX_STAGES;
+  }
+  BootStage &stage = stages[stageCount];
+  stage.name = name;
+  stage.fn = fn;
+  // Un prérequis inconnu (ajout refusé) ne doit pas bloquer l'étape indéfiniment
+  stage.deps = deps & ((1UL << stageCount) - 1);
+  stage.after = 0;
+  stage.stackSize = stackSize;
+  stage.core = core;
+  stage.state = BootStageState::PENDING;
+  return stageCount++;
+}
+
+void BootSequencer::runAfter(BootStageId stage, BootStageId previous) {
+  if (stage < stageCount && previous < stage) stages[stage].after |= bootDep(previous);
+}
+
+void BootSequencer::stageTask(void *pvParameters) {
+  BootStageId id = (BootStageId)(uintptr_t)pvParameters;
+  BootStage &stage = bootSequencer.stages[id];
+  if (stage.deps | stage.after) {
+    xEventGroupWaitBits(bootSequencer.doneBits, stage.deps | stage.after, pdFALSE, pdTRUE, portMAX_DELAY);
+  }
+  stage.start_us = (uint32_t)esp_timer_get_time() - bootSequencer.runStart_us;
+  bool ok = false;
+  if (bootSequencer.failedMask & stage.deps) {
+    stage.state = BootStageState::SKIPPED;
+    DEBUG_ERRORF_AUTO("Erreur: Étape %s sautée, prérequis en échec", stage.name);
+  } else {
+    stage.state = BootStageState::RUNNING;
+    ok = stage.fn();
+    stage.state = ok ? BootStageState::DONE : BootStageState::FAILED;
+    if (!ok) DEBUG_ERRORF_AUTO("Erreur: Étape de démarrage %s en échec", stage.name);
+  }
+  stage.end_us = (uint32_t)esp_timer_get_time() - bootSequencer.runStart_us;
+  if (!ok) {
+    portENTER_CRITICAL(&bootMux);
+    bootSequencer.failedMask |= bootDep(id);
+    portEXIT_CRITICAL(&bootMux);
+  }
+  xEventGroupSetBits(bootSequencer.doneBits, bootDep(id));
+  vTaskDelete(NULL);
+}
+
+bool BootSequencer::run(uint32_t timeout_ms) {
+  runStart_us = (uint32_t)esp_timer_get_time();
+  doneBits = xEventGroupCreate();
+  if (!doneBits) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer le groupe d'événements de démarrage");
+    return false;
+  }
+  for (uint8_t i = 0; i < stageCount; i++) {
+    BaseType_t core = stages[i].core < 0 ? tskNO_AFFINITY : stages[i].core;
+    // Priorité au-dessus de loop() : les étapes passent avant toute autre activité
+    if (xTaskCreatePinnedToCore(stageTask, stages[i].name, stages[i].stackSize, (void *)(uintptr_t)i, 2,
+                                NULL, core) != pdPASS) {
+      DEBUG_ERRORF_AUTO("Erreur: Impossible de lancer l'étape %s", stages[i].name);
+      stages[i].state = BootStageState::FAILED;
+      portENTER_CRITICAL(&bootMux);
+      failedMask |= bootDep(i);
+      portEXIT_CRITICAL(&bootMux);
+      xEventGroupSetBits(doneBits, bootDep(i));
+    }
+  }
+  uint32_t all = (1UL << stageCount) - 1;
+  EventBits_t bits = xEventGroupWaitBits(doneBits, all, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+  for (uint8_t i = 0; i < stageCount; i++) {
+    if (!(bits & bootDep(i))) {
+      DEBUG_ERRORF_AUTO("Erreur: Étape %s non terminée après %lu ms", stages[i].name, (unsigned long)timeout_ms);
+      // L'étape en retard tourne encore et peut écrire failedMask en même temps
+      portENTER_CRITICAL(&bootMux);
+      failedMask |= bootDep(i);
+      portEXIT_CRITICAL(&bootMux);
+    }
+  }
+  ready_us = (uint32_t)esp_timer_get_time();
+  ready = true;
+  DEBUG_PRINTF_AUTO("Démarrage terminé en %lu ms (%lu ms depuis le reset)",
+                    (unsigned long)((ready_us - runStart_us) / 1000), (unsigned long)(ready_us / 1000));
+  return failedMask == 0;
+}
+
+void BootSequencer::printReport() {
+  reportLine("BOOT ready_us=%lu since_reset_us=%lu stages=%u failed=0x%lx\n",
+             (unsigned long)(ready ? ready_us - runStart_us : 0), (unsigned long)ready_us,
+             (unsigned)stageCount, (unsigned long)failedMask);
+  for (uint8_t i = 0; i < stageCount; i++) {
+    const BootStage &s = stages[i];
+    uint32_t duration = s.end_us > s.start_us ? s.end_us - s.start_us : 0;
+    reportLine("STAGE %s start_us=%lu dur_us=%lu deps=0x%lx %s\n", s.name, (unsigned long)s.start_us,
+               (unsigned long)duration, (unsigned long)s.deps, BOOT_STATE_NAMES[(size_t)s.state]);
+  }
+  Serial.println("OK");
+}
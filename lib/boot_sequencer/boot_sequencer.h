@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/event_groups.h>
+#include "../config.h"
+
+// Démarrage en graphe de dépendances : chaque étape tourne dans sa propre tâche dès
+// que ses prérequis sont prêts, les étapes indépendantes (SD, écran, files...) en parallèle.
+// Une étape dont un prérequis a échoué est sautée. La commande BOOT affiche les durées.
+typedef bool (*BootStageFn)();
+typedef uint8_t BootStageId;
+
+enum class BootStageState : uint8_t { PENDING, RUNNING, DONE, FAILED, SKIPPED };
+
+struct BootStage {
+  const char *name;
+  BootStageFn fn;
+  uint32_t deps;          // Masque des étapes prérequises
+  uint32_t after;         // Ordre seulement (ressource partagée) : leur échec ne saute pas l'étape
+  uint32_t stackSize;
+  int8_t core;
+  BootStageState state;
+  uint32_t start_us;      // Relatifs au début de run()
+  uint32_t end_us;
+};
+
+class BootSequencer {
+private:
+  BootStage stages[BOOT_MAX_STAGES];
+  uint8_t stageCount;
+  EventGroupHandle_t doneBits;
+  volatile uint32_t failedMask;
+  uint32_t runStart_us;   // Depuis le reset, pour le temps total jusqu'à l'état prêt
+  uint32_t ready_us;
+  volatile bool ready;
+
+  static void stageTask(void *pvParameters);
+
+public:
+  BootSequencer();
+  // deps : masque construit avec bootDep() ; core -1 pour laisser FreeRTOS choisir
+  BootStageId addStage(const char *name, BootStageFn fn, uint32_t deps = 0,
+                       uint32_t stackSize = BOOT_STAGE_STACK, int8_t core = -1);
+  void runAfter(BootStageId stage, BootStageId previous);
+  // Bloque la tâche appelante jusqu'à la fin de toutes les étapes
+  bool run(uint32_t timeout_ms = BOOT_TIMEOUT_MS);
+  bool isReady() const { return ready; }
+  bool hasFailures() const { return failedMask != 0; }
+  uint32_t readyTime_us() const { return ready_us; }
+  void printReport();
+};
+
+static inline uint32_t bootDep(BootStageId id) { return 1UL << id; }
+
+extern BootSequencer bootSequencer;
@@ -0,0 +1,43 @@
+#include "checksum.h"
+
+// Table générée à la première utilisation (1 Ko en RAM, évite une table constante en flash)
+static uint32_t crc32Table[256];
+static bool crc32TableReady = false;
+
+static void crc32BuildTable() {
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+    }
+    crc32Table[i] = c;
+  }
+  crc32TableReady = true;
+}
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+  if (!crc32TableReady) crc32BuildTable();
+  crc = ~crc;
+  while (len--) {
+    crc = crc32Table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+uint32_t crc32(const uint8_t *data, size_t len) {
+  return crc32Update(0, data, len);
+}
+
+uint16_t crc16Update(uint16_t crc, const uint8_t *data, size_t len) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (int k = 0; k < 8; k++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+uint16_t crc16(const uint8_t *data, size_t len) {
+  return crc16Update(0xFFFF, data, len);
+}
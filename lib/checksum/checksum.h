@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC32 (polynôme IEEE 802.3, réfléchi) : même résultat que zlib.crc32 côté hôte
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
+uint32_t crc32(const uint8_t *data, size_t len);
+
+// CRC16-CCITT (polynôme 0x1021, valeur initiale 0xFFFF, non réfléchi)
+uint16_t crc16Update(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16(const uint8_t *data, size_t len);
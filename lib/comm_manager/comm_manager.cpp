@@ -1,77 +1,555 @@
-
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_COMM
 #include "comm_manager.h"
 #include "sd_manager.h"
 #include "system_manager.h"
 #include "gcode_parser.h"
+#include "gcode_scheduler.h"
+#include "upload_manager.h"
+#include "host_protocol.h"
+#include "report_manager.h"
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "boot_sequencer.h"
+#include "health_monitor.h"
+#include "heap_guard.h"
+#include "mem_placement.h"
+#include "kinematics.h"
+#include "machine_state.h"
+#include "print_estimator.h"
+#include "motion_optimizer.h"
+#if defined(ARDUINO)
+// Écran, tactile et aperçus : absents de l'imprimante virtuelle (host/virtual_printer)
+#include "lvgl_screen_display.h"
+#include "toolpath_preview.h"
+#include "thumbnail.h"
+#include "file_browser.h"
+#include "touchscreen_driver.h"
+#include "touch_calibrator.h"
+#include "../touch_config.h"
+#endif
+#include "../config.h"
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include "../report_line.h"
 #include "../debug_manager.h"
-extern QueueHandle_t gcodeQueue;
 extern QueueHandle_t sdQueue;
 
 CommManager commManager;
+static char lineBuffer[COMM_LINE_MAX];
+static size_t lineLength = 0;
+static bool lineOverflow = false;
+
+// Flux G-code de l'hôte, à la Marlin : "N<n> <commande>*<somme>" facultatif, un "ok" par
+// ligne G/M, "Resend: <n>" sur somme fausse ou numéro hors séquence.
+static long lastLineNumber = 0;
+static char pendingLine[GCODE_LINE_MAX];
+static bool linePending = false;
+static uint32_t streamLines = 0, streamResends = 0, streamChecksumErrors = 0, streamSequenceErrors = 0;
+static uint32_t streamQueueWaits = 0;
+// Lignes complètes arrivées pendant qu'une ligne attend : traitées dans l'ordre ensuite
+static char backlog[COMM_BACKLOG_LINES][COMM_LINE_MAX];
+static uint8_t backlogHead = 0, backlogCount = 0;
+static uint32_t backlogDropped = 0;
+// Commande en cours : copiée hors de lineBuffer et de backlog, que pollConsole() réécrit
+static char commandLine[COMM_LINE_MAX];
+static TaskHandle_t commTaskHandle = nullptr;
+// Dernière lecture de la console (0 : pas de mesure, liaison en mode upload ou binaire)
+static uint32_t lastPollUs = 0, maxPollGapUs = 0;
+
+enum class LineCheck { PLAIN, NUMBERED, BAD_CHECKSUM, NO_CHECKSUM, OUT_OF_SEQUENCE };
+
+static bool startsWith(const char *line, const char *prefix) {
+  return strncmp(line, prefix, strlen(prefix)) == 0;
+}
+
+// Commande G/M au numéro complet : "M110" ne reconnaît ni "M1100" ni "M110.1"
+static bool isCommand(const char *line, const char *code) {
+  size_t length = strlen(code);
+  if (strncmp(line, code, length) != 0) return false;
+  return !isDigit(line[length]) && line[length] != '.';
+}
+
+// Argument d'une commande console : ce qui suit le mot-clé, sans blancs de bord
+static char *argument(char *line, size_t keyword) {
+  size_t length = strlen(line);
+  return GcodeParser::trimLine(line + (keyword < length ? keyword : length));
+}
+
+// Retire le numéro et la somme (XOR des octets avant '*') d'une ligne numérotée, sur place.
+// "N<n> M110" recale la numérotation sans contrôle de séquence.
+static LineCheck checkLineNumber(char *&line) {
+  if (line[0] != 'N' || !isDigit(line[1])) return LineCheck::PLAIN;
+  char *star = strrchr(line, '*');
+  if (!star) return LineCheck::NO_CHECKSUM;
+  uint8_t sum = 0;
+  for (const char *p = line; p < star; p++) sum ^= (uint8_t)*p;
+  const char *given = GcodeParser::trimLine(star + 1);
+  if (!isDigit(given[0]) || strtol(given, nullptr, 10) != sum) return LineCheck::BAD_CHECKSUM;
+  long number = strtol(line + 1, nullptr, 10);
+  char *body = line + 1;
+  while (body < star && isDigit(*body)) body++;
+  *star = '\0';
+  line = GcodeParser::trimLine(body);
+  if (isCommand(line, "M110")) {
+    lastLineNumber = number;
+    return LineCheck::NUMBERED;
+  }
+  if (number != lastLineNumber + 1) return LineCheck::OUT_OF_SEQUENCE;
+  lastLineNumber = number;
+  return LineCheck::NUMBERED;
+}
+
+static void requestResend(const char *reason) {
+  streamResends++;
+  reportLine("ERROR: %s, Last Line: %ld\n", reason, lastLineNumber);
+  reportLine("Resend: %ld\n", lastLineNumber + 1);
+  Serial.println("ok");
+}
+
+// Ligne acceptée : copiée dans la file du flux HOST, "ok" dès qu'elle y entre. File
+// pleine : la ligne attend ici et l'hôte reste bloqué sur son "ok", mais la console
+// continue d'être lue (M112, lignes suivantes mises de côté). Le job SD a sa propre
+// file : elle peut être pleine sans bloquer l'hôte.
+static void streamLine(const char *line) {
+  size_t length = strlen(line);
+  if (length >= GCODE_LINE_MAX) {
+    DEBUG_ERRORF_AUTO("Erreur: Ligne série trop longue (%u)", (unsigned)length);
+    faultBus.raise(FaultCode::PARSE_INVALID, FaultSource::COMM, (int32_t)length);
+    Serial.println("ERROR: Line too long");
+    Serial.println("ok");
+    return;
+  }
+  memcpy(pendingLine, line, length + 1);
+  linePending = true;
+}
+
+static void flushPendingLine() {
+  if (faultBus.isHalted()) {
+    linePending = false;
+    Serial.println("ERROR: Halted, send M999");
+    Serial.println("ok");
+    return;
+  }
+  if (!gcodeScheduler.submit(GcodeStream::HOST, pendingLine, 0)) return;
+  linePending = false;
+  streamLines++;
+  Serial.println("ok");
+}
+
+// Assemble une ligne à partir des octets disponibles sans jamais attendre.
+// M112 est reconnu ici, au moment où la fin de ligne arrive, et exécuté sur place :
+// il ne passe ni par gcodeQueue ni par motionQueue. La ligne rendue est lineBuffer,
+// modifiable sur place jusqu'au prochain appel.
+static char *readConsoleLine() {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+  if (lastPollUs && now - lastPollUs > maxPollGapUs) {
+    maxPollGapUs = now - lastPollUs;
+    faultBus.notePollGap(maxPollGapUs);
+  }
+  lastPollUs = now;
+  while (Serial.available()) {
+    int b = Serial.read();
+    if (b < 0) break;
+    if (b != '\n') {
+      if (b == '\r') continue;
+      if (lineLength < sizeof(lineBuffer) - 1) lineBuffer[lineLength++] = (char)b;
+      else lineOverflow = true;
+      continue;
+    }
+    uint32_t detectedAt = (uint32_t)esp_timer_get_time();
+    lineBuffer[lineLength] = '\0';
+    lineLength = 0;
+    if (lineOverflow) {
+      lineOverflow = false;
+      Serial.println("ERROR: Line too long");
+      continue;
+    }
+    if (FaultBus::isEmergencyStopLine(lineBuffer)) {
+      faultBus.emergencyStop(FaultSource::COMM, detectedAt);
+      FaultStats stats;
+      faultBus.getStats(stats);
+      reportLine("OK: EMERGENCY_STOP halt_us=%lu\n", (unsigned long)stats.haltLastUs);
+      continue;
+    }
+    return lineBuffer;
+  }
+  return nullptr;
+}
+
+// Ligne en attente : la console est vidée dans backlog, M112 étant reconnu par
+// readConsoleLine() sur chaque ligne complète. Au-delà de COMM_BACKLOG_LINES, l'hôte
+// n'attend plus ses "ok" : la ligne est écartée ; numérotée, elle revient par Resend.
+static void backlogConsoleLines() {
+  char *line;
+  while ((line = readConsoleLine()) != nullptr) {
+    if (backlogCount == COMM_BACKLOG_LINES) {
+      backlogDropped++;
+      DEBUG_ERRORF_AUTO("Erreur: Ligne écartée pendant l'attente de la file HOST");
+      Serial.println("ERROR: Line buffer full");
+      continue;
+    }
+    uint8_t slot = (backlogHead + backlogCount) % COMM_BACKLOG_LINES;
+    strncpy(backlog[slot], line, COMM_LINE_MAX - 1);
+    backlog[slot][COMM_LINE_MAX - 1] = '\0';
+    backlogCount++;
+  }
+}
+
+// Relecture de la console pendant une commande longue de CommTask : M112 exécuté sur place,
+// les autres lignes mises de côté comme pendant l'attente de la file HOST
+static void pollConsole() {
+  if (xTaskGetCurrentTaskHandle() == commTaskHandle) backlogConsoleLines();
+}
+
+// Ligne mise de côté la plus ancienne, modifiable sur place jusqu'à la prochaine mise de côté
+static char *popBacklogLine() {
+  if (backlogCount == 0) return nullptr;
+  char *line = backlog[backlogHead];
+  backlogHead = (backlogHead + 1) % COMM_BACKLOG_LINES;
+  backlogCount--;
+  return line;
+}
 
 void CommManager::commTask(void *pvParameters) {
+  commTaskHandle = xTaskGetCurrentTaskHandle();
+  faultBus.setConsolePoll(pollConsole);
   while (1) {
-    if (Serial.available()) {
-      String line = Serial.readStringUntil('\n');
-      line.trim();
-      if (line.isEmpty()) {
+    if (uploadManager.isActive()) {
+      // Mode binaire M28 : la liaison série appartient à l'upload jusqu'à M29
+      lastPollUs = 0;
+      uploadManager.poll();
+      vTaskDelay(1);
+      continue;
+    }
+    if (hostProtocol.isActive()) {
+      // Paquets COBS jusqu'à une requête PROTO_TEXT
+      lastPollUs = 0;
+      hostProtocol.poll();
+      vTaskDelay(1);
+      continue;
+    }
+    if (linePending) {
+      // La file se libère au rythme du parser ; M112 n'attend pas
+      flushPendingLine();
+      if (linePending) {
+        backlogConsoleLines();
+        vTaskDelay(1);
+      }
+      continue;
+    }
+    char *line = popBacklogLine();
+    if (!line) line = readConsoleLine();
+    if (line) {
+      TRACE_SCOPE(COMM_COMMAND);
+      strncpy(commandLine, line, sizeof(commandLine) - 1);
+      commandLine[sizeof(commandLine) - 1] = '\0';
+      line = commandLine;
+      line = GcodeParser::trimLine(line);
+      if (!*line) {
         DEBUG_PRINTF_AUTO("Commande série vide ignorée");
         continue;
       }
-      DEBUG_PRINTF_AUTO("Commande série reçue: %s", line.c_str());
-      if (line.startsWith("READ_SD ")) {
-        String filename = line.substring(8);
-        filename.trim();
-        if (filename.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour READ_SD");
+      DEBUG_PRINTF_AUTO("Commande série reçue: %s", line);
+      LineCheck check = checkLineNumber(line);
+      if (check == LineCheck::BAD_CHECKSUM) {
+        streamChecksumErrors++;
+        requestResend("Checksum mismatch");
+        continue;
+      }
+      if (check == LineCheck::NO_CHECKSUM) {
+        streamChecksumErrors++;
+        requestResend("No checksum with line number");
+        continue;
+      }
+      if (check == LineCheck::OUT_OF_SEQUENCE) {
+        streamSequenceErrors++;
+        requestResend("Line number is not last line number+1");
+        continue;
+      }
+      line = GcodeParser::stripComment(line);
+      if (!*line) {
+        Serial.println("ok");
+        continue;
+      }
+      if (faultBus.isHalted() && (startsWith(line, "READ_SD ") || startsWith(line, "M28 "))) {
+        Serial.println("ERROR: Halted, send M999");
+      } else if (startsWith(line, "READ_SD ")) {
+        char *filename = argument(line, 8);
+        if (!*filename) {
+          DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour READ_SD");
           Serial.println("ERROR: Empty filename");
           continue;
         }
         sdManager.readFile(filename);
         Serial.println("OK: READ_SD command sent");
-      } else if (line.startsWith("TEST_SD ")) {
-        String filename = line.substring(8);
-        filename.trim();
-        if (filename.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide pour TEST_SD");
+      } else if (startsWith(line, "TEST_SD ")) {
+        char *filename = argument(line, 8);
+        if (!*filename) {
+          DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour TEST_SD");
           Serial.println("ERROR: Empty filename");
           continue;
         }
         sdManager.testReadSD(filename);
         Serial.println("OK: TEST_SD command sent");
-      } else if (line.startsWith("TEST_SYSTEM")) {
+      } else if (startsWith(line, "TEST_SYSTEM")) {
         systemManager.testSystem();
         Serial.println("OK: TEST_SYSTEM command sent");
-      } else if (line.startsWith("CLEAR_GCODE")) {
-        xQueueReset(gcodeQueue);
-        DEBUG_PRINTF_AUTO("gcodeQueue vidée via commande CLEAR_GCODE");
+      } else if (startsWith(line, "CLEAR_GCODE")) {
+        gcodeScheduler.discardAll();
+        DEBUG_PRINTF_AUTO("Files G-code vidées via commande CLEAR_GCODE");
         Serial.println("OK: gcodeQueue cleared");
-      } else if (line.startsWith("LIST_SD")) {
+      } else if (startsWith(line, "LIST_SD")) {
         sdManager.listFiles();
         DEBUG_PRINTF_AUTO("Commande LIST_SD exécutée");
-      } else if (line.startsWith("TEST_PARSE ")) {
-        String cmd = line.substring(11);
-        cmd.trim();
-        if (cmd.isEmpty()) {
-          DEBUG_PRINTF_AUTO("Erreur: Commande vide pour TEST_PARSE");
+      } else if (startsWith(line, "TRACE_START")) {
+        traceRecorder.start();
+        Serial.println("OK: Trace started");
+      } else if (startsWith(line, "TRACE_STOP")) {
+        traceRecorder.stop();
+        Serial.println("OK: Trace stopped");
+      } else if (startsWith(line, "TRACE_DUMP")) {
+        traceRecorder.dump();
+      } else if (startsWith(line, "BOOT")) {
+        bootSequencer.printReport();
+#if defined(ARDUINO)
+      } else if (startsWith(line, "DISPLAY")) {
+        display.printStats();
+      } else if (startsWith(line, "BROWSE_STATS")) {
+        fileBrowser.printStats();
+      } else if (startsWith(line, "BROWSE_CLOSE")) {
+        if (display.lock()) {
+          fileBrowser.close();
+          display.unlock();
+        }
+        Serial.println("OK: Browser closed");
+      } else if (startsWith(line, "BROWSE_SCROLL")) {
+        // Défilement animé du haut en bas de la liste ouverte, 10 s par défaut
+        long ms = strtol(argument(line, 14), nullptr, 10);
+        if (display.lock()) {
+          fileBrowser.scrollTest(ms > 0 ? (uint32_t)ms : 10000);
+          display.unlock();
+        }
+        Serial.println("OK: Browser scroll started");
+      } else if (startsWith(line, "BROWSE")) {
+        // BROWSE [répertoire] : racine par défaut
+        const char *dir = argument(line, 6);
+        if (!*dir) dir = "/";
+        bool opened = false;
+        if (display.lock()) {
+          opened = fileBrowser.open(dir);
+          display.unlock();
+        }
+        if (opened) {
+          Serial.println("OK: Browser opened");
+        } else {
+          DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir l'explorateur sur %s", dir);
+          Serial.println("ERROR: Browser unavailable");
+        }
+      } else if (startsWith(line, "TOUCH_CAL_RESET")) {
+        // Retour aux constantes de touch_config.h
+        touchCalibrator.erase();
+        touchscreenDriver.setCalibration(TouchCalibrator::fromLegacyRange(TOUCH_X_MIN, TOUCH_X_MAX, TOUCH_Y_MIN,
+                                                                          TOUCH_Y_MAX, SCREEN_WIDTH, SCREEN_HEIGHT), false);
+        Serial.println("OK: Touch calibration reset");
+      } else if (startsWith(line, "TOUCH_CAL")) {
+        if (touchCalibrator.start()) {
+          Serial.println("OK: Touch calibration started");
+        } else {
+          Serial.println("ERROR: Touch calibration already running");
+        }
+      } else if (startsWith(line, "TEST_CALIB")) {
+        TouchCalibrator::printSelfTest();
+      } else if (startsWith(line, "TOUCH")) {
+        touchscreenDriver.printStats();
+#endif
+      } else if (startsWith(line, "TEST_SNAPSHOT")) {
+        // Durée en ms, 2 s par défaut
+        long ms = strtol(argument(line, 14), nullptr, 10);
+        if (!MachineStateStore::startStressTest(ms > 0 ? (uint32_t)ms : 2000)) {
+          Serial.println("ERROR: TEST_SNAPSHOT already running or task creation failed");
+        }
+#if defined(ARDUINO)
+      } else if (startsWith(line, "PREVIEW ")) {
+        // PREVIEW <fichier> [couche] : toutes les couches si la couche est omise
+        char *filename = argument(line, 8);
+        int16_t layer = PREVIEW_ALL_LAYERS;
+        char *space = strrchr(filename, ' ');
+        if (space && isDigit(space[1])) {
+          layer = (int16_t)strtol(space + 1, nullptr, 10);
+          *space = '\0';
+          filename = GcodeParser::trimLine(filename);
+        }
+        if (!*filename) {
+          DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour PREVIEW");
+          Serial.println("ERROR: Empty filename");
+        } else if (!toolpathPreview.request(filename, layer)) {
+          Serial.println("ERROR: Preview queue full");
+        } else {
+          Serial.println("OK: PREVIEW queued");
+        }
+      } else if (startsWith(line, "THUMB ")) {
+        // THUMB <fichier> : extraction (ou cache) de la miniature, rapport THUMB en retour
+        char *filename = argument(line, 6);
+        if (!*filename) {
+          DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour THUMB");
+          Serial.println("ERROR: Empty filename");
+        } else if (!thumbnailCache.request(filename, true)) {
+          Serial.println("ERROR: Thumbnail queue full");
+        } else {
+          Serial.println("OK: THUMB queued");
+        }
+#endif
+      } else if (startsWith(line, "ESTIMATE ")) {
+        // ESTIMATE <fichier> : durée et filament, rapport ESTIMATE en retour
+        char *filename = argument(line, 9);
+        if (!*filename) {
+          DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour ESTIMATE");
+          Serial.println("ERROR: Empty filename");
+        } else if (!printEstimator.request(filename, true)) {
+          Serial.println("ERROR: Estimate queue full");
+        } else {
+          Serial.println("OK: ESTIMATE queued");
+        }
+      } else if (startsWith(line, "ETA")) {
+        printEstimator.printEta();
+      } else if (startsWith(line, "OPTIMIZE")) {
+        // OPTIMIZE [ON|OFF|RESET] : fusion des segments entre parser et motionQueue
+        const char *arg = argument(line, 8);
+        if (strcmp(arg, "ON") == 0 || strcmp(arg, "OFF") == 0) {
+          motionOptimizer.setEnabled(strcmp(arg, "ON") == 0);
+          Serial.println(motionOptimizer.isEnabled() ? "OK: Optimizer enabled" : "OK: Optimizer disabled");
+        } else if (strcmp(arg, "RESET") == 0) {
+          motionOptimizer.resetStats();
+          Serial.println("OK: Optimizer stats reset");
+        } else if (!*arg) {
+          motionOptimizer.printStats();
+        } else {
+          Serial.println("ERROR: Usage OPTIMIZE [ON|OFF|RESET]");
+        }
+      } else if (startsWith(line, "KINEMATICS")) {
+        // KINEMATICS [CARTESIAN|COREXY|DELTA|TEST|BENCH]
+        const char *arg = argument(line, 10);
+        KinematicsType type;
+        if (!*arg) {
+          machineKinematics.printReport();
+        } else if (strcmp(arg, "TEST") == 0) {
+          machineKinematics.printSelfTest();
+        } else if (strcmp(arg, "BENCH") == 0) {
+          machineKinematics.printBench();
+        } else if (MachineKinematics::parseType(arg, type)) {
+          if (machineKinematics.select(type)) {
+            reportLine("OK: Kinematics %s\n", machineKinematics.active().name());
+          } else {
+            Serial.println("ERROR: Printing or position out of reach, kinematics unchanged");
+          }
+        } else {
+          Serial.println("ERROR: Usage KINEMATICS [CARTESIAN|COREXY|DELTA|TEST|BENCH]");
+        }
+      } else if (startsWith(line, "HEALTH")) {
+        healthMonitor.printReport();
+      } else if (startsWith(line, "MEM")) {
+        const char *arg = argument(line, 3);
+        if (strcmp(arg, "PROBE") == 0) {
+          if (memPlacement.measure()) {
+            memPlacement.printReport();
+          } else {
+            Serial.println("ERROR: Heap locked, probe skipped");
+          }
+        } else if (!*arg) {
+          memPlacement.printReport();
+        } else {
+          Serial.println("ERROR: Usage MEM [PROBE]");
+        }
+      } else if (startsWith(line, "HEAP")) {
+        if (strcmp(argument(line, 4), "RESET") == 0) {
+          heapGuard.resetStats();
+          Serial.println("OK: Heap stats reset");
+        } else {
+          heapGuard.printReport();
+        }
+      } else if (startsWith(line, "SCHED")) {
+        if (strcmp(argument(line, 5), "RESET") == 0) {
+          gcodeScheduler.resetStats();
+          Serial.println("OK: Scheduler stats reset");
+        } else {
+          gcodeScheduler.printReport();
+        }
+      } else if (startsWith(line, "STATS")) {
+        faultBus.printStats();
+      } else if (isCommand(line, "M999")) {
+        // Reprise après arrêt d'urgence, comme Marlin
+        faultBus.clearHalt();
+        Serial.println("OK: Halt cleared");
+      } else if (startsWith(line, "BINARY")) {
+        Serial.println("OK: BINARY mode");
+        hostProtocol.begin();
+      } else if (startsWith(line, "M28 ")) {
+        uploadManager.begin(argument(line, 4));
+      } else if (isCommand(line, "M29")) {
+        Serial.println("ERROR: No upload in progress");
+      } else if (startsWith(line, "TEST_PARSE ")) {
+        char *cmd = argument(line, 11);
+        if (!*cmd) {
+          DEBUG_ERRORF_AUTO("Erreur: Commande vide pour TEST_PARSE");
           Serial.println("ERROR: Empty command");
           continue;
         }
         gcodeParser.testParse(cmd);
         Serial.println("OK: TEST_PARSE command sent");
+      } else if (startsWith(line, "STREAM_STATS")) {
+        reportLine("STREAM lines=%lu resends=%lu checksum_errors=%lu sequence_errors=%lu queue_waits=%lu "
+                   "backlog_dropped=%lu last_line=%ld\n",
+                   (unsigned long)streamLines, (unsigned long)streamResends, (unsigned long)streamChecksumErrors,
+                   (unsigned long)streamSequenceErrors, (unsigned long)streamQueueWaits,
+                   (unsigned long)backlogDropped, lastLineNumber);
+      } else if (startsWith(line, "STREAM_RESET")) {
+        streamLines = streamResends = streamChecksumErrors = streamSequenceErrors = streamQueueWaits = 0;
+        backlogDropped = 0;
+        Serial.println("OK: Stream stats reset");
+      } else if (isCommand(line, "M110")) {
+        // M110 N<n> : prochaine ligne attendue n+1
+        const char *n = strchr(line, 'N');
+        lastLineNumber = n ? strtol(n + 1, nullptr, 10) : 0;
+        Serial.println("ok");
+      } else if (startsWith(line, "G") || startsWith(line, "M")) {
+        // Voie immédiate : rapports et M24/M25 exécutés ici, sans attendre les files.
+        // Le reste est vérifié ici sans état modal, puis confié au contexte HOST du
+        // scheduler, seul à appliquer G90/G91 et M82/M83 dans l'ordre du flux.
+        MotionCommand cmd;
+        if (GcodeParser::checkSyntax(line, cmd) != GcodeParser::ParseResult::OK) {
+          DEBUG_PRINTF_AUTO("Commande non reconnue: %s", line);
+          Serial.println("ERROR: Unknown command");
+          Serial.println("ok");
+        } else if (GcodeParser::isReportingCommand(cmd)) {
+          reportManager.handleCommand(cmd);
+        } else if (faultBus.isHalted()) {
+          Serial.println("ERROR: Halted, send M999");
+          Serial.println("ok");
+        } else if (GcodeScheduler::isStreamControl(cmd)) {
+          gcodeScheduler.control(cmd);
+          Serial.println("ok");
+        } else {
+          streamLine(line);
+          flushPendingLine();
+          if (linePending) streamQueueWaits++;
+        }
       } else {
-        DEBUG_PRINTF_AUTO("Commande non reconnue: %s", line.c_str());
+        DEBUG_PRINTF_AUTO("Commande non reconnue: %s", line);
         Serial.println("ERROR: Unknown command");
       }
     }
-    vTaskDelay(pdMS_TO_TICKS(10));
+    // Rien à traiter : la période de scrutation borne la détection de M112
+    else vTaskDelay(pdMS_TO_TICKS(COMM_POLL_INTERVAL_MS));
   }
 }
 
 void CommManager::init() {
-  Serial.begin(115200);
+  // Le buffer RX doit être dimensionné avant begin() pour absorber une fenêtre d'upload
+  Serial.setRxBufferSize(SERIAL_RX_BUFFER_SIZE);
+  // Sans tampon d'émission, availableForWrite() ne voit que la FIFO matérielle (128 octets) :
+  // l'auto-report M155 ne passerait jamais par ReportManager::writeNonBlocking
+  Serial.setTxBufferSize(SERIAL_TX_BUFFER_SIZE);
+  Serial.begin(SERIAL_BAUD_RATE);
 }
 
 void CommManager::testComm(String cmd) {
@@ -80,21 +558,21 @@ void CommManager::testComm(String cmd) {
   if (cmd.startsWith("READ_SD ")) {
     String filename = cmd.substring(8);
     filename.trim();
-    sdManager.readFile(filename);
+    sdManager.readFile(filename.c_str());
   } else if (cmd.startsWith("TEST_SD ")) {
     String filename = cmd.substring(8);
     filename.trim();
-    sdManager.testReadSD(filename);
+    sdManager.testReadSD(filename.c_str());
   } else if (cmd.startsWith("CLEAR_GCODE")) {
-    xQueueReset(gcodeQueue);
-    DEBUG_PRINTF_AUTO("Test: gcodeQueue vidée");
+    gcodeScheduler.discardAll();
+    DEBUG_PRINTF_AUTO("Test: Files G-code vidées");
   } else if (cmd.startsWith("LIST_SD")) {
     sdManager.listFiles();
     DEBUG_PRINTF_AUTO("Test: Commande LIST_SD exécutée");
   } else if (cmd.startsWith("TEST_PARSE ")) {
     String cmd_str = cmd.substring(11);
     cmd_str.trim();
-    gcodeParser.testParse(cmd_str);
+    gcodeParser.testParse(cmd_str.c_str());
   } else {
     DEBUG_PRINTF_AUTO("Test: Commande non gérée %s", cmd.c_str());
   }
@@ -13,7 +13,127 @@
 #define NUM_LEDS   1     // Nombre de LEDs
 #define COLOR_ORDER GRB  // Ordre des couleurs selon ta LED
 #define STABILITY_DELAY 3000
-//Screen config 
+//Screen config (orientation paysage native via MADCTL)
 #define SCREEN_WIDTH  320
 #define SCREEN_HEIGHT 240
-#define DRAW_BUF_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 10 * (LV_COLOR_DEPTH / 8))
\ No newline at end of file
+#define DRAW_BUF_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 10 * (LV_COLOR_DEPTH / 8))
+//Liaison série
+#define SERIAL_BAUD_RATE      115200
+#define SERIAL_RX_BUFFER_SIZE 4096  // Doit contenir au moins une fenêtre d'upload complète
+#define SERIAL_TX_BUFFER_SIZE 1024  // Réponses M105/M114/M115 et auto-report écrits sans bloquer
+//Upload binaire vers la SD (M28/M29)
+#define UPLOAD_BLOCK_SIZE   512     // Taille max de la charge utile d'un bloc
+#define UPLOAD_WINDOW       8       // Blocs en vol (puissance de 2)
+#define UPLOAD_TIMEOUT_MS   10000   // Abandon si aucun octet reçu pendant ce délai
+#define UPLOAD_TEXT_LINE_MAX 32     // Ligne de contrôle hors trame ("N<n> M29*<somme>", M112)
+#define SD_WRITE_CHUNK_SIZE 4096    // Multiple de 512 : écritures alignées sur les secteurs
+//Stockage
+#define STORAGE_MAX_OPEN_FILES 4    // Fichiers ouverts simultanément par backend
+//Protocole binaire hôte (COBS + CRC16)
+#define HOST_PROTO_MAX_PAYLOAD 240  // Charge utile max d'un paquet
+//Traces (TRACE_START / TRACE_STOP / TRACE_DUMP)
+#define TRACE_ENABLED        1
+#define TRACE_BUFFER_RECORDS 2048   // 12 octets par événement (puissance de 2)
+#define TRACE_MAX_TASKS      16     // Pistes par tâche dans la trace, au-delà : piste "other"
+//Bus de défauts et arrêt d'urgence
+#define FAULT_QUEUE_LENGTH   16     // Événements en attente de systemTask
+#define FAULT_HALT_HANDLERS  4      // Sorties coupées par l'arrêt d'urgence
+#define COMM_POLL_INTERVAL_MS 2     // Période de scrutation série : borne de détection de M112
+#define COMM_LINE_MAX        256    // Ligne console la plus longue acceptée
+#define COMM_BACKLOG_LINES   4      // Lignes lues pendant qu'une ligne G/M attend sa place dans la file HOST
+//Files de la chaîne Comm → SD → Parser (éléments copiés octet par octet par FreeRTOS)
+#define GCODE_LINE_MAX       96     // Ligne G-code sans commentaire, dans gcodeQueue
+#define SD_PATH_MAX          64     // Chemin du job, dans sdQueue
+//Flux G-code concurrents (SCHED) : hôte et écran servis avant le job SD
+#define SCHED_HOST_QUEUE_LEN 4      // Lignes G/M de la liaison série en attente du parser
+#define SCHED_UI_QUEUE_LEN   4      // Commandes de l'écran en attente du parser
+#define SCHED_PAUSE_POLL_MS  20     // SDTask suspendu par M25 : période de vérification de M24
+//Démarrage (BOOT)
+#define BOOT_MAX_STAGES   16        // Bits d'un EventGroup FreeRTOS : 24 au plus
+#define BOOT_STAGE_STACK  4096
+#define BOOT_TIMEOUT_MS   10000     // Au-delà, les étapes en retard sont déclarées en échec
+//Surveillance (HEALTH)
+#define HEALTH_SAMPLE_MS        1000
+#define HEALTH_MAX_TASKS        40      // ~27 tâches vivantes après le démarrage, marge pour les tâches ponctuelles
+#define HEALTH_MAX_QUEUES       6
+#define HEALTH_STACK_MIN_FREE   512     // Octets de pile restants sous lesquels un défaut est levé
+#define HEALTH_HEAP_MIN_FREE    16384   // Octets de SRAM interne
+//Aperçu du parcours (PREVIEW)
+#define PREVIEW_SIZE          120   // Côté du canevas en pixels
+#define PREVIEW_BED_X_MM      220   // Plateau représenté, origine en bas à gauche
+#define PREVIEW_BED_Y_MM      220
+#define PREVIEW_QUEUE_LENGTH  2
+#define PREVIEW_TASK_STACK    4096
+//Calibration tactile (TOUCH_CAL)
+#define TOUCH_CAL_POINTS        5       // Quatre coins et le centre, résolus aux moindres carrés
+#define TOUCH_CAL_MARGIN_PCT    10      // Position des cibles depuis les bords
+#define TOUCH_CAL_TIMEOUT_MS    30000   // Par cible
+#define TOUCH_CAL_MAX_RESIDUAL  4.0f    // Écart RMS (px) au-delà duquel la calibration est refusée
+#define TOUCH_CAL_TASK_STACK    4096
+//Miniatures des jobs (THUMB)
+#define THUMB_MAX_W         120     // Image décodée, réduite d'un facteur entier pour tenir
+#define THUMB_MAX_H         120
+#define THUMB_SCAN_BYTES    131072  // En-tête lu au plus pour trouver les blocs "; thumbnail begin"
+#define THUMB_DATA_MAX      49152   // PNG ou QOI encodé, après base64
+#define THUMB_LRU_ENTRIES   8       // Images décodées gardées en PSRAM
+#define THUMB_BG_COLOR      0x202020 // Fond sous les pixels transparents
+#define THUMB_QUEUE_LENGTH  8
+#define THUMB_TASK_STACK    4096
+//Explorateur de fichiers (BROWSE)
+#define FILE_BROWSER_ROW_HEIGHT   32      // Lignes de hauteur fixe : position = rang x hauteur
+#define FILE_BROWSER_ROW_MARGIN   2       // Lignes gardées de part et d'autre de la zone visible
+#define FILE_BROWSER_PAGE_ENTRIES 16      // Entrées lues d'un coup sur la SD
+#define FILE_BROWSER_PAGE_SLOTS   4       // Pages gardées en RAM (au moins 3)
+#define FILE_BROWSER_MAX_ENTRIES  16384   // Au-delà, le répertoire est tronqué
+#define FILE_BROWSER_NAME_MAX     64
+#define FILE_BROWSER_QUEUE_LENGTH 8
+#define FILE_BROWSER_TASK_STACK   4096
+//Modèle du planificateur (ESTIMATE, ETA) : réglages de mouvement de la machine
+#define PLANNER_ACCEL_MM_S2         1500    // Mouvements extrudés (M204 P)
+#define PLANNER_TRAVEL_ACCEL_MM_S2  3000    // Déplacements sans extrusion (M204 T)
+#define PLANNER_RETRACT_ACCEL_MM_S2 1500    // Rétractions et réamorces seules (M204 R)
+#define PLANNER_JUNCTION_DEV_MM     0.013f  // Écart de jonction (M205 J)
+#define PLANNER_MAX_FEED_XY_MM_S    300
+#define PLANNER_MAX_FEED_Z_MM_S     10
+#define PLANNER_MAX_FEED_E_MM_S     60
+#define PLANNER_DEFAULT_FEED_MM_S   25      // Avant le premier F du job
+#define PLANNER_HOMING_FEED_MM_S    50
+#define PLANNER_BUFFER_BLOCKS       16      // Blocs vus par l'anticipation
+#define PLANNER_ARC_SEGMENT_MM      1.0f    // Arcs G2/G3 découpés en cordes de cette longueur
+#define ESTIMATE_PROFILE_POINTS     64      // Durée estimée à intervalles d'octets, pour l'ETA
+#define ESTIMATE_ETA_SETTLE_S       30      // Durée estimée avant de caler l'ETA sur le rythme réel
+#define ESTIMATE_QUEUE_LENGTH       4
+#define ESTIMATE_TASK_STACK         4096
+//Optimiseur de flux (OPTIMIZE) : segments alignés fusionnés, suites courbes en G2/G3
+#define OPTIMIZER_ENABLED_DEFAULT   false   // Activable par OPTIMIZE ON
+#define OPTIMIZER_MAX_SEGMENTS      32      // Segments repris au plus par une commande émise
+#define OPTIMIZER_LINE_TOLERANCE_MM 0.01f   // Écart des points intermédiaires à la droite
+#define OPTIMIZER_ARC_TOLERANCE_MM  0.01f   // Écart des points et des cordes à l'arc
+#define OPTIMIZER_ARC_MIN_SEGMENTS  4       // En dessous, les segments passent tels quels
+#define OPTIMIZER_ARC_MIN_RADIUS_MM 0.5f
+#define OPTIMIZER_ARC_MAX_RADIUS_MM 500.0f  // Au-delà, la suite est traitée comme une droite
+#define OPTIMIZER_E_RATIO_TOLERANCE 0.02f   // Écart relatif d'extrusion par mm dans une suite
+#define OPTIMIZER_IDLE_FLUSH_MS     50      // Suite en attente émise si gcodeQueue reste vide
+//Allocation statique (HEAP) : environnements *_static de platformio.ini
+#ifndef STATIC_ALLOCATION
+#define STATIC_ALLOCATION           0       // 1 : files, tâches et mutex dans l'arène, tas verrouillé après le démarrage
+#endif
+#define STATIC_ARENA_BYTES          (72 * 1024) // Piles, stockage des files et objets FreeRTOS
+#define HEAP_GUARD_RECENT           8       // Dernières allocations après verrouillage, affichées par HEAP
+//Placement mémoire (MEM) : SRAM interne pour le DMA et le mouvement, PSRAM pour les caches
+#define MEM_PLACEMENT_TAGS          16      // Couples étiquette/région suivis par MEM
+#define MEM_PROBE_INTERNAL_BYTES    16384   // Sonde de mesure en SRAM interne (puissance de 2)
+#define MEM_PROBE_PSRAM_BYTES       (256 * 1024) // Plus grande que le cache de données (puissance de 2)
+#define MEM_PROBE_RANDOM_READS      4096
+//Cinématique (KINEMATICS) : coordonnées cartésiennes vers positions moteurs
+#define KINEMATICS_TYPE_DEFAULT     0       // 0 cartésienne, 1 CoreXY, 2 delta
+#define DELTA_RADIUS_MM             105.0f  // Centre vers axe des chariots, moins le décalage de l'effecteur
+#define DELTA_DIAGONAL_ROD_MM       215.0f
+#define DELTA_PRINTABLE_RADIUS_MM   90.0f
+#define DELTA_SEGMENTS_PER_SECOND   200
+#define DELTA_MIN_SEGMENT_MM        0.5f    // Mouvements lents : segments pas plus courts que ça
+#define KINEMATICS_MIN_SEGMENT_MM   0.5f    // Longueur retenue pour la vitesse maximale du banc
+#define KINEMATICS_CPU_BUDGET_PCT   25      // Part d'un cœur accordée au calcul des segments
+#define KINEMATICS_BENCH_SEGMENTS   10000
+#define KINEMATICS_TEST_SPAN_MM     150.0f  // Grille de -span à +span en X et Y (cartésienne, CoreXY)
+#define KINEMATICS_TEST_TOLERANCE_UM 5.0f
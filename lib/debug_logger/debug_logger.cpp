@@ -0,0 +1,176 @@
+#include "debug_logger.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include "heap_guard.h"
+#include "../report_line.h"
+
+static_assert((DEBUG_LOG_RING_SIZE & (DEBUG_LOG_RING_SIZE - 1)) == 0, "DEBUG_LOG_RING_SIZE doit être une puissance de 2");
+
+DebugLogger debugLogger;
+
+// File bornée de Vyukov : chaque entrée porte un numéro de séquence, les producteurs
+// se réservent une place par CAS sur head et la publient en avançant la séquence
+DebugLogRing::DebugLogRing() : dropped(0), head(0), tail(0) {
+  for (uint32_t i = 0; i < DEBUG_LOG_RING_SIZE; i++) {
+    entries[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+DebugLogEntry *DebugLogRing::reserve() {
+  uint32_t pos = head.load(std::memory_order_relaxed);
+  while (true) {
+    DebugLogEntry *e = &entries[pos & (DEBUG_LOG_RING_SIZE - 1)];
+    int32_t diff = (int32_t)(e->sequence.load(std::memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return e;
+    } else if (diff < 0) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else {
+      pos = head.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void DebugLogRing::commit(DebugLogEntry *entry) {
+  // La séquence vaut encore la position réservée : pos + 1 publie l'entrée
+  uint32_t pos = entry->sequence.load(std::memory_order_relaxed);
+  entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+DebugLogEntry *DebugLogRing::peek() {
+  DebugLogEntry *e = &entries[tail & (DEBUG_LOG_RING_SIZE - 1)];
+  if (e->sequence.load(std::memory_order_acquire) != tail + 1) return nullptr;
+  return e;
+}
+
+void DebugLogRing::release(DebugLogEntry *entry) {
+  entry->sequence.store(tail + DEBUG_LOG_RING_SIZE, std::memory_order_release);
+  tail++;
+}
+
+DebugLogRing &DebugLogger::ring() {
+#if defined(ARDUINO)
+  return rings[xPortGetCoreID() & 1];
+#else
+  return rings[0];
+#endif
+}
+
+uint32_t DebugLogger::droppedCount() {
+  return rings[0].dropped.load(std::memory_order_relaxed) + rings[1].dropped.load(std::memory_order_relaxed);
+}
+
+void DebugLogger::begin() {
+  static bool started = false;
+  if (started) return;
+  started = true;
+  heapGuard.createTask(drainTask, "DebugLogDrain", 3072, NULL, tskIDLE_PRIORITY + 1, NULL, 0);
+}
+
+// Reformate une conversion printf avec le type réellement capturé
+void DebugLogger::format(const DebugLogEntry &entry, char *out, size_t outSize) {
+  const char *f = entry.fmt;
+  size_t len = 0;
+  uint8_t arg = 0;
+  while (*f && len < outSize - 1) {
+    if (*f != '%') {
+      out[len++] = *f++;
+      continue;
+    }
+    if (f[1] == '%') {
+      out[len++] = '%';
+      f += 2;
+      continue;
+    }
+    // Copie drapeaux, largeur et précision, sans les modificateurs de longueur. Un '*'
+    // consomme l'argument capturé suivant et est remplacé par sa valeur
+    char spec[24];
+    size_t n = 0;
+    spec[n++] = *f++;
+    while (*f && strchr("-+ #0123456789.*", *f) && n < sizeof(spec) - 4) {
+      if (*f != '*') {
+        spec[n++] = *f++;
+        continue;
+      }
+      f++;
+      long long star = 0;
+      if (arg < entry.argCount) {
+        const DebugArgValue &sv = entry.args[arg];
+        star = (entry.kinds[arg] == DebugArgKind::DOUBLE) ? (long long)sv.d : sv.i;
+        arg++;
+      }
+      // Largeur négative : alignement à gauche ; précision négative : ignorée
+      if (star < 0 && n > 0 && spec[n - 1] == '.') {
+        n--;
+        continue;
+      }
+      if (star < -999) star = -999;
+      if (star > 999) star = 999;
+      int w = snprintf(spec + n, sizeof(spec) - 4 - n, "%lld", star);
+      if (w > 0) n += ((size_t)w < sizeof(spec) - 4 - n) ? (size_t)w : sizeof(spec) - 5 - n;
+    }
+    while (*f && strchr("hlLqjzt", *f)) f++;
+    char conv = *f ? *f++ : 's';
+    size_t room = outSize - len;
+    int written = 0;
+    if (arg >= entry.argCount) {
+      written = snprintf(out + len, room, "<?>");
+    } else {
+      DebugArgKind kind = entry.kinds[arg];
+      const DebugArgValue &v = entry.args[arg];
+      arg++;
+      long long asSigned = (kind == DebugArgKind::DOUBLE) ? (long long)v.d : v.i;
+      if (strchr("di", conv)) {
+        spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, asSigned);
+      } else if (strchr("uxXo", conv)) {
+        spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, (unsigned long long)asSigned);
+      } else if (conv == 'c') {
+        spec[n++] = conv; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, (int)asSigned);
+      } else if (strchr("fFeEgGaA", conv)) {
+        double d = (kind == DebugArgKind::DOUBLE) ? v.d : (kind == DebugArgKind::UINT ? (double)v.u : (double)v.i);
+        spec[n++] = conv; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, d);
+      } else if (conv == 's') {
+        spec[n++] = conv; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, kind == DebugArgKind::STR ? entry.strings + v.strOffset : "<?>");
+      } else {
+        spec[n++] = 'p'; spec[n] = '\0';
+        written = snprintf(out + len, room, spec, v.p);
+      }
+    }
+    if (written > 0) len += ((size_t)written < room) ? (size_t)written : room - 1;
+  }
+  out[len] = '\0';
+}
+
+void DebugLogger::drainTask(void *pvParameters) {
+  static char line[256];
+  uint32_t reportedDrops = 0;
+  while (1) {
+    bool idle = true;
+    for (int r = 0; r < 2; r++) {
+      DebugLogRing &ring = debugLogger.rings[r];
+      DebugLogEntry *e;
+      while ((e = ring.peek()) != nullptr) {
+        const char *file = strrchr(e->file, '/');
+        file = file ? file + 1 : e->file;
+        int prefix = snprintf(line, sizeof(line), "[%s] -> ", file);
+        debugLogger.format(*e, line + prefix, sizeof(line) - prefix - 1);
+        ring.release(e);
+        strcat(line, "\n");
+        Serial.print(line);
+        idle = false;
+      }
+    }
+    uint32_t drops = debugLogger.droppedCount();
+    if (drops != reportedDrops) {
+      reportLine("[debug_logger] -> %lu messages perdus (anneau plein)\n", (unsigned long)(drops - reportedDrops));
+      reportedDrops = drops;
+    }
+    if (idle) vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
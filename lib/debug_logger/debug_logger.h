@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+
+// Journal différé : l'appelant ne fait que copier le pointeur de format (qui sert
+// d'identifiant) et les arguments bruts dans un anneau sans verrou par cœur.
+// La tâche DebugLogDrain, de basse priorité, formate et envoie sur le port série.
+
+#define DEBUG_LOG_RING_SIZE    32   // Entrées par cœur (puissance de 2)
+#define DEBUG_LOG_MAX_ARGS     6
+#define DEBUG_LOG_STRING_BYTES 64   // Place pour les arguments %s copiés
+
+enum class DebugArgKind : uint8_t { INT, UINT, DOUBLE, STR, PTR };
+
+union DebugArgValue {
+  int64_t i;
+  uint64_t u;
+  double d;
+  const void *p;
+  uint16_t strOffset;
+};
+
+struct DebugLogEntry {
+  std::atomic<uint32_t> sequence;
+  const char *fmt;
+  const char *file;
+  uint8_t level;
+  uint8_t argCount;
+  uint8_t stringUsed;
+  DebugArgKind kinds[DEBUG_LOG_MAX_ARGS];
+  DebugArgValue args[DEBUG_LOG_MAX_ARGS];
+  char strings[DEBUG_LOG_STRING_BYTES];
+};
+
+class DebugLogRing {
+public:
+  DebugLogRing();
+  DebugLogEntry *reserve();               // nullptr si l'anneau est plein
+  void commit(DebugLogEntry *entry);
+  DebugLogEntry *peek();                  // Consommateur unique (tâche de vidage)
+  void release(DebugLogEntry *entry);
+  std::atomic<uint32_t> dropped;
+
+private:
+  DebugLogEntry entries[DEBUG_LOG_RING_SIZE];
+  std::atomic<uint32_t> head;
+  uint32_t tail;
+};
+
+class DebugLogger {
+public:
+  void begin();
+  DebugLogRing &ring();
+  uint32_t droppedCount();
+  static void drainTask(void *pvParameters);
+
+private:
+  DebugLogRing rings[2];
+  void format(const DebugLogEntry &entry, char *out, size_t outSize);
+};
+
+extern DebugLogger debugLogger;
+
+// Capture typée des arguments, sans formatage
+inline void debugLogCapture(DebugLogEntry &e, DebugArgKind kind, DebugArgValue v) {
+  if (e.argCount < DEBUG_LOG_MAX_ARGS) {
+    e.kinds[e.argCount] = kind;
+    e.args[e.argCount] = v;
+    e.argCount++;
+  }
+}
+
+// Les chaînes sont copiées : c_str() d'un String temporaire ne survit pas à l'appel.
+// len est la longueur réelle de la source (strlen, ou strnlen borné par la taille du
+// tableau) : la copie ne lit jamais au-delà, tronquée à la place restante dans l'entrée.
+inline void debugLogString(DebugLogEntry &e, const char *s, size_t len) {
+  DebugArgValue v;
+  v.strOffset = e.stringUsed;
+  size_t room = DEBUG_LOG_STRING_BYTES - e.stringUsed;
+  if (room == 0) {
+    v.strOffset = DEBUG_LOG_STRING_BYTES - 1;
+  } else {
+    size_t n = (len < room - 1) ? len : room - 1;
+    if (n) memcpy(e.strings + e.stringUsed, s, n);
+    e.strings[e.stringUsed + n] = '\0';
+    e.stringUsed += n + 1;
+  }
+  debugLogCapture(e, DebugArgKind::STR, v);
+}
+
+inline void debugLogArg(DebugLogEntry &e, const char *s) { debugLogString(e, s, s ? strlen(s) : 0); }
+inline void debugLogArg(DebugLogEntry &e, char *s) { debugLogArg(e, (const char *)s); }
+
+inline void debugLogInt(DebugLogEntry &e, int64_t value) {
+  DebugArgValue v;
+  v.i = value;
+  debugLogCapture(e, DebugArgKind::INT, v);
+}
+
+inline void debugLogUint(DebugLogEntry &e, uint64_t value) {
+  DebugArgValue v;
+  v.u = value;
+  debugLogCapture(e, DebugArgKind::UINT, v);
+}
+
+inline void debugLogArg(DebugLogEntry &e, char value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, signed char value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, short value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, int value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, long value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, long long value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, bool value) { debugLogInt(e, value); }
+inline void debugLogArg(DebugLogEntry &e, unsigned char value) { debugLogUint(e, value); }
+inline void debugLogArg(DebugLogEntry &e, unsigned short value) { debugLogUint(e, value); }
+inline void debugLogArg(DebugLogEntry &e, unsigned int value) { debugLogUint(e, value); }
+inline void debugLogArg(DebugLogEntry &e, unsigned long value) { debugLogUint(e, value); }
+inline void debugLogArg(DebugLogEntry &e, unsigned long long value) { debugLogUint(e, value); }
+
+inline void debugLogArg(DebugLogEntry &e, double value) {
+  DebugArgValue v;
+  v.d = value;
+  debugLogCapture(e, DebugArgKind::DOUBLE, v);
+}
+
+inline void debugLogArg(DebugLogEntry &e, float value) { debugLogArg(e, (double)value); }
+
+inline void debugLogArg(DebugLogEntry &e, const void *value) {
+  DebugArgValue v;
+  v.p = value;
+  debugLogCapture(e, DebugArgKind::PTR, v);
+}
+
+inline void debugLogArgs(DebugLogEntry &) {}
+
+// Arguments pris par référence : un tableau char[N] garde sa taille jusqu'à la copie
+template <typename T, typename... Rest>
+inline void debugLogArgs(DebugLogEntry &e, const T &first, const Rest &... rest) {
+  debugLogArg(e, first);
+  debugLogArgs(e, rest...);
+}
+
+template <size_t N, typename... Rest>
+inline void debugLogArgs(DebugLogEntry &e, const char (&first)[N], const Rest &... rest) {
+  debugLogString(e, first, strnlen(first, N));
+  debugLogArgs(e, rest...);
+}
+
+template <typename... Args>
+inline void debugLog(uint8_t level, const char *file, const char *fmt, const Args &... args) {
+  DebugLogRing &ring = debugLogger.ring();
+  DebugLogEntry *e = ring.reserve();
+  if (!e) return;
+  e->fmt = fmt;
+  e->file = file;
+  e->level = level;
+  e->argCount = 0;
+  e->stringUsed = 0;
+  debugLogArgs(*e, args...);
+  ring.commit(e);
+}
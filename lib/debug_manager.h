@@ -1,14 +1,48 @@
 #pragma once
 #define DEBUG 1
+
+// Niveaux de log, filtrés à la compilation par module
+#define DEBUG_LEVEL_NONE  0
+#define DEBUG_LEVEL_ERROR 1
+#define DEBUG_LEVEL_INFO  2
+#define DEBUG_LEVEL_TRACE 3   // Messages par ligne de G-code
+
+// Niveau par module : un .cpp définit DEBUG_MODULE_LEVEL avant ses includes
+#ifndef DEBUG_LEVEL_COMM
+#define DEBUG_LEVEL_COMM   DEBUG_LEVEL_INFO
+#endif
+#ifndef DEBUG_LEVEL_SD
+#define DEBUG_LEVEL_SD     DEBUG_LEVEL_INFO
+#endif
+#ifndef DEBUG_LEVEL_PARSER
+#define DEBUG_LEVEL_PARSER DEBUG_LEVEL_INFO
+#endif
+#ifndef DEBUG_LEVEL_SYSTEM
+#define DEBUG_LEVEL_SYSTEM DEBUG_LEVEL_INFO
+#endif
+#ifndef DEBUG_MODULE_LEVEL
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_INFO
+#endif
+
 #if DEBUG
+#include <debug_logger.h>
+#include "report_line.h"
 #define __ORIGIN_FILENAME__ (strrchr("/" __FILE__, '/') + 1)
 #define DEBUG_PRINT(x) Serial.println(x)
-#define DEBUG_PRINTF(x, ...) Serial.printf(x, ##__VA_ARGS__)
-  #define DEBUG_PRINT_AUTO(msg)  Serial.printf("[%s] -> %s\n", __ORIGIN_FILENAME__, msg)
-  #define DEBUG_PRINTF_AUTO(fmt, ...) Serial.printf("[%s] -> " fmt "\n", __ORIGIN_FILENAME__, ##__VA_ARGS__)
+#define DEBUG_PRINTF(x, ...) reportLine(x, ##__VA_ARGS__)
+// Les variantes _AUTO passent par le journal différé : quelques copies mémoire
+// dans la tâche appelante, le formatage et l'UART dans la tâche DebugLogDrain
+#define DEBUG_LOG_AT(level, fmt, ...) \
+  do { if (DEBUG_MODULE_LEVEL >= (level)) debugLog((level), __FILE__, fmt, ##__VA_ARGS__); } while (0)
+  #define DEBUG_PRINT_AUTO(msg)  DEBUG_LOG_AT(DEBUG_LEVEL_INFO, "%s", msg)
+  #define DEBUG_PRINTF_AUTO(fmt, ...) DEBUG_LOG_AT(DEBUG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+  #define DEBUG_ERRORF_AUTO(fmt, ...) DEBUG_LOG_AT(DEBUG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+  #define DEBUG_TRACEF_AUTO(fmt, ...) DEBUG_LOG_AT(DEBUG_LEVEL_TRACE, fmt, ##__VA_ARGS__)
 #else
 #define DEBUG_PRINT(x)
 #define DEBUG_PRINTF(x, ...)
   #define DEBUG_PRINT_AUTO(msg)
   #define DEBUG_PRINTF_AUTO(fmt, ...)
-#endif
\ No newline at end of file
+  #define DEBUG_ERRORF_AUTO(fmt, ...)
+  #define DEBUG_TRACEF_AUTO(fmt, ...)
+#endif
@@ -0,0 +1,131 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "fault_bus.h"
+#include "machine_state.h"
+#include "heap_guard.h"
+#include "gcode_scheduler.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <freertos/queue.h>
+
+extern QueueHandle_t sdQueue;
+extern QueueHandle_t motionQueue;
+
+static const char *const FAULT_CODE_NAMES[] = {
+  "NONE", "INIT_FAILED", "SD_INIT", "SD_OPEN", "SD_WRITE", "SD_LIST", "QUEUE_FULL",
+  "BAD_FILENAME", "PARSE_INVALID_TYPE", "PARSE_UNSUPPORTED", "PARSE_INVALID", "EMERGENCY_STOP",
+  "STACK_LOW", "HEAP_LOW", "QUEUE_SATURATED", "HEAP_AFTER_LOCK"
+};
+static_assert(sizeof(FAULT_CODE_NAMES) / sizeof(FAULT_CODE_NAMES[0]) == (size_t)FaultCode::COUNT, "Nom manquant dans FAULT_CODE_NAMES");
+
+static const char *const FAULT_SOURCE_NAMES[] = { "SYSTEM", "COMM", "SD", "PARSER", "UPLOAD", "HOST", "HEALTH" };
+static_assert(sizeof(FAULT_SOURCE_NAMES) / sizeof(FAULT_SOURCE_NAMES[0]) == (size_t)FaultSource::COUNT, "Nom manquant dans FAULT_SOURCE_NAMES");
+
+FaultBus faultBus;
+
+FaultBus::FaultBus() : queue(nullptr), halted(false), haltHandlers(), haltHandlerCount(0), consolePoll(nullptr),
+  counts(), stats(), mux(portMUX_INITIALIZER_UNLOCKED) {}
+
+bool FaultBus::init() {
+  if (!queue) queue = heapGuard.createQueue(FAULT_QUEUE_LENGTH, sizeof(FaultEvent));
+  return queue != nullptr;
+}
+
+void FaultBus::raise(FaultCode code, FaultSource source, int32_t detail) {
+  FaultEvent event = { (uint32_t)esp_timer_get_time(), detail, code, source };
+  portENTER_CRITICAL(&mux);
+  counts[(size_t)code]++;
+  stats.raised++;
+  portEXIT_CRITICAL(&mux);
+  // Jamais bloquant : un défaut ne doit pas bloquer la tâche qui le signale
+  if (!queue || xQueueSend(queue, &event, 0) != pdTRUE) {
+    portENTER_CRITICAL(&mux);
+    stats.dropped++;
+    portEXIT_CRITICAL(&mux);
+  }
+}
+
+bool FaultBus::receive(FaultEvent &event, TickType_t timeout) {
+  return queue && xQueueReceive(queue, &event, timeout) == pdTRUE;
+}
+
+void FaultBus::emergencyStop(FaultSource source, uint32_t detectedAt_us) {
+  bool wasHalted = halted.exchange(true, std::memory_order_acq_rel);
+  for (uint8_t i = 0; i < haltHandlerCount; i++) haltHandlers[i]();
+  // Plus rien ne doit sortir des files : les tâches en attente d'envoi sont débloquées
+  if (motionQueue) xQueueReset(motionQueue);
+  gcodeScheduler.discardAll();
+  if (sdQueue) xQueueReset(sdQueue);
+  machineState.setHotendTarget(0);
+  machineState.setBedTarget(0);
+  uint32_t latency = (uint32_t)esp_timer_get_time() - detectedAt_us;
+  portENTER_CRITICAL(&mux);
+  stats.emergencyStops++;
+  stats.haltLastUs = latency;
+  if (latency > stats.haltMaxUs) stats.haltMaxUs = latency;
+  portEXIT_CRITICAL(&mux);
+  if (!wasHalted) raise(FaultCode::EMERGENCY_STOP, source, (int32_t)latency);
+}
+
+void FaultBus::clearHalt() {
+  halted.store(false, std::memory_order_release);
+  DEBUG_PRINTF_AUTO("Arrêt d'urgence acquitté");
+}
+
+bool FaultBus::addHaltHandler(HaltHandler handler) {
+  if (haltHandlerCount >= FAULT_HALT_HANDLERS) return false;
+  haltHandlers[haltHandlerCount++] = handler;
+  return true;
+}
+
+void FaultBus::notePollGap(uint32_t us) {
+  portENTER_CRITICAL(&mux);
+  if (us > stats.pollGapMaxUs) stats.pollGapMaxUs = us;
+  portEXIT_CRITICAL(&mux);
+}
+
+void FaultBus::getStats(FaultStats &out) {
+  portENTER_CRITICAL(&mux);
+  out = stats;
+  portEXIT_CRITICAL(&mux);
+  // Un M112 arrivé juste après une lecture attend la suivante, puis l'arrêt lui-même
+  uint32_t poll = COMM_POLL_INTERVAL_MS * 1000UL;
+  out.haltBoundUs = (out.pollGapMaxUs > poll ? out.pollGapMaxUs : poll) + out.haltMaxUs;
+}
+
+void FaultBus::printStats() {
+  FaultStats s;
+  getStats(s);
+  reportLine("STATS faults=%lu dropped=%lu estop=%lu halt_last_us=%lu halt_max_us=%lu poll_gap_max_us=%lu "
+             "halt_bound_us=%lu halted=%d\n",
+             (unsigned long)s.raised, (unsigned long)s.dropped, (unsigned long)s.emergencyStops,
+             (unsigned long)s.haltLastUs, (unsigned long)s.haltMaxUs, (unsigned long)s.pollGapMaxUs,
+             (unsigned long)s.haltBoundUs, isHalted() ? 1 : 0);
+  for (size_t i = 1; i < (size_t)FaultCode::COUNT; i++) {
+    if (counts[i]) reportLine("FAULT %s %lu\n", FAULT_CODE_NAMES[i], (unsigned long)counts[i]);
+  }
+  Serial.println("OK");
+}
+
+// Reconnaît "M112" (numéro de ligne N et commentaire ou checksum tolérés) sans construire de String
+bool FaultBus::isEmergencyStopLine(const char *line) {
+  const char *p = line;
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p == 'N' || *p == 'n') {
+    p++;
+    while (*p >= '0' && *p <= '9') p++;
+    while (*p == ' ' || *p == '\t') p++;
+  }
+  if (*p != 'M' && *p != 'm') return false;
+  p++;
+  if (p[0] != '1' || p[1] != '1' || p[2] != '2') return false;
+  p += 3;
+  return !((*p >= '0' && *p <= '9') || *p == '.');
+}
+
+const char *FaultBus::codeName(FaultCode code) {
+  return (size_t)code < (size_t)FaultCode::COUNT ? FAULT_CODE_NAMES[(size_t)code] : "?";
+}
+
+const char *FaultBus::sourceName(FaultSource source) {
+  return (size_t)source < (size_t)FaultSource::COUNT ? FAULT_SOURCE_NAMES[(size_t)source] : "?";
+}
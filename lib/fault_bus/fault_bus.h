@@ -0,0 +1,90 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "../config.h"
+
+// Bus de défauts : événements typés (code, source, horodatage) consommés par
+// systemTask. L'arrêt d'urgence ne passe pas par ce bus :
+// il est exécuté directement dans la tâche qui le détecte.
+enum class FaultCode : uint8_t {
+  NONE = 0,
+  INIT_FAILED,        // Création des queues ou init d'un module
+  SD_INIT,
+  SD_OPEN,
+  SD_WRITE,
+  SD_LIST,
+  QUEUE_FULL,         // Envoi refusé après délai (detail : profondeur de la file)
+  BAD_FILENAME,
+  PARSE_INVALID_TYPE,
+  PARSE_UNSUPPORTED,  // detail : code G/M brut
+  PARSE_INVALID,
+  EMERGENCY_STOP,
+  STACK_LOW,          // detail : octets de pile restants
+  HEAP_LOW,           // detail : minimum de tas libre
+  QUEUE_SATURATED,    // detail : longueur de la file pleine
+  HEAP_AFTER_LOCK,    // detail : allocations depuis le dernier échantillon (STATIC_ALLOCATION)
+  COUNT
+};
+
+enum class FaultSource : uint8_t { SYSTEM = 0, COMM, SD, PARSER, UPLOAD, HOST, HEALTH, COUNT };
+
+struct FaultEvent {
+  uint32_t timestamp_us;
+  int32_t detail;
+  FaultCode code;
+  FaultSource source;
+};
+
+struct FaultStats {
+  uint32_t raised;
+  uint32_t dropped;          // Bus plein, événement perdu (le compteur par code reste juste)
+  uint32_t emergencyStops;
+  uint32_t haltLastUs;       // Détection -> sorties coupées
+  uint32_t haltMaxUs;
+  uint32_t pollGapMaxUs;     // Plus long intervalle mesuré entre deux lectures de la console
+  uint32_t haltBoundUs;      // Pire délai M112 reçu -> sorties coupées : pire intervalle de
+                             // lecture (au moins COMM_POLL_INTERVAL_MS) + pire arrêt mesuré
+};
+
+typedef void (*HaltHandler)();
+typedef void (*ConsolePoll)();
+
+class FaultBus {
+private:
+  QueueHandle_t queue;
+  std::atomic<bool> halted;
+  HaltHandler haltHandlers[FAULT_HALT_HANDLERS];
+  uint8_t haltHandlerCount;
+  ConsolePoll consolePoll;
+  uint32_t counts[(size_t)FaultCode::COUNT];
+  FaultStats stats;
+  portMUX_TYPE mux;
+
+public:
+  FaultBus();
+  bool init();
+  bool isReady() const { return queue != nullptr; }
+  // Non bloquant, utilisable depuis n'importe quelle tâche
+  void raise(FaultCode code, FaultSource source, int32_t detail = 0);
+  bool receive(FaultEvent &event, TickType_t timeout);
+  // Coupe les sorties enregistrées et vide les files, sans attendre aucune tâche
+  void emergencyStop(FaultSource source, uint32_t detectedAt_us);
+  void clearHalt();
+  bool isHalted() const { return halted.load(std::memory_order_acquire); }
+  bool addHaltHandler(HaltHandler handler);
+  // Commandes longues exécutées par CommTask (LIST_SD, TEST_SD, TRACE_DUMP) : la console
+  // est relue entre deux morceaux et M112 y est exécuté sur place. Sans effet ailleurs.
+  void setConsolePoll(ConsolePoll poll) { consolePoll = poll; }
+  void pollConsole() { if (consolePoll) consolePoll(); }
+  // CommTask : intervalle entre deux lectures de la console, retenu s'il est le pire
+  void notePollGap(uint32_t us);
+  void getStats(FaultStats &out);
+  uint32_t count(FaultCode code) const { return counts[(size_t)code]; }
+  void printStats();
+  static bool isEmergencyStopLine(const char *line);
+  static const char *codeName(FaultCode code);
+  static const char *sourceName(FaultSource source);
+};
+
+extern FaultBus faultBus;
@@ -0,0 +1,487 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
+#include "file_browser.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <Arduino.h>
+#include <string.h>
+#include <strings.h>
+#if defined(ARDUINO)
+#include "sd_manager.h"
+#include "heap_guard.h"
+#include "lvgl_screen_display.h"
+#endif
+
+DirectoryIndex::DirectoryIndex() : dir(), checkpoints(), entries(0), complete(false), truncated(false), elapsedMs(0) {}
+
+void DirectoryIndex::clear() {
+  complete.store(false, std::memory_order_release);
+  entries.store(0, std::memory_order_release);
+  truncated = false;
+  elapsedMs = 0;
+}
+
+bool DirectoryIndex::accept(const char *name, const StorageStat &st) {
+  if (name[0] == '.') return false;
+  if (st.isDir) return true;
+  const char *ext = strrchr(name, '.');
+  return ext && (strcasecmp(ext, ".gcode") == 0 || strcasecmp(ext, ".gco") == 0 || strcasecmp(ext, ".g") == 0);
+}
+
+void DirectoryIndex::copyEntry(BrowserEntry &out, const char *name, const StorageStat &st) {
+  // Nom trop long : affiché tronqué, il ne pourra pas être ouvert
+  strncpy(out.name, name, sizeof(out.name) - 1);
+  out.name[sizeof(out.name) - 1] = '\0';
+  out.size = st.size;
+  out.isDir = st.isDir;
+}
+
+// Une position de reprise toutes les FILE_BROWSER_PAGE_ENTRIES entrées retenues ; le
+// compteur n'est publié qu'une fois la position écrite
+bool DirectoryIndex::buildEntry(const char *name, const StorageStat &st, uint32_t at, void *ctx) {
+  Build *b = (Build *)ctx;
+  DirectoryIndex *ix = b->index;
+  if (!accept(name, st)) return true;
+  uint32_t n = ix->entries.load(std::memory_order_relaxed);
+  if (n >= FILE_BROWSER_MAX_ENTRIES) {
+    ix->truncated = true;
+    return false;
+  }
+  uint32_t page = n / FILE_BROWSER_PAGE_ENTRIES;
+  if (n % FILE_BROWSER_PAGE_ENTRIES == 0) ix->checkpoints[page] = at;
+  if (page < b->prefillPages) copyEntry(b->page.entries[b->page.count++], name, st);
+  ix->entries.store(n + 1, std::memory_order_release);
+  if (page < b->prefillPages && b->page.count == FILE_BROWSER_PAGE_ENTRIES) {
+    b->cb(page, b->page, b->ctx);
+    b->page.count = 0;
+  }
+  return true;
+}
+
+bool DirectoryIndex::build(Storage *storage, const char *path, uint8_t prefillPages, BrowserPageCallback cb,
+                           void *ctx) {
+  uint32_t t0 = millis();
+  clear();
+  if (strlen(path) >= sizeof(dir)) return false;
+  strcpy(dir, path);
+  Build b;
+  b.index = this;
+  b.prefillPages = cb ? prefillPages : 0;
+  b.cb = cb;
+  b.ctx = ctx;
+  b.page.count = 0;
+  bool ok = storage && storage->scan(dir, 0, buildEntry, &b);
+  // Pages annoncées mais incomplètes (fin du répertoire ou erreur) : rendues telles quelles
+  for (uint32_t p = count() / FILE_BROWSER_PAGE_ENTRIES; p < b.prefillPages; p++) {
+    cb(p, b.page, ctx);
+    b.page.count = 0;
+  }
+  elapsedMs = millis() - t0;
+  complete.store(true, std::memory_order_release);
+  return ok;
+}
+
+bool DirectoryIndex::pageEntry(const char *name, const StorageStat &st, uint32_t at, void *ctx) {
+  BrowserPage *out = ((PageLoad *)ctx)->out;
+  if (!accept(name, st)) return true;
+  copyEntry(out->entries[out->count++], name, st);
+  return out->count < FILE_BROWSER_PAGE_ENTRIES;
+}
+
+bool DirectoryIndex::loadPage(Storage *storage, uint32_t page, BrowserPage &out) {
+  out.count = 0;
+  if (!storage || page * FILE_BROWSER_PAGE_ENTRIES >= count()) return false;
+  PageLoad load = { &out };
+  return storage->scan(dir, checkpoints[page], pageEntry, &load) && out.count > 0;
+}
+
+#if defined(ARDUINO)
+enum : uint8_t { BROWSER_OPEN, BROWSER_LOAD };
+
+struct BrowserRequest {
+  uint8_t type;
+  uint8_t slot;
+  uint16_t generation;
+  uint32_t page;
+  char path[FILE_BROWSER_NAME_MAX];
+};
+
+static const uint32_t NO_ENTRY = UINT32_MAX;
+static const int32_t HEADER_HEIGHT = 28;
+static const int32_t PANEL_TOP = 44;   // Sous le bandeau de l'écran principal
+
+FileBrowser fileBrowser;
+
+FileBrowser::FileBrowser() : requests(nullptr), index(), indexGeneration(0), generation(0), dir(), slots(),
+  useClock(0), rows(), shown(0), windowStart(0), windowEnd(0), selected(NO_ENTRY), panel(nullptr),
+  pathLabel(nullptr), countLabel(nullptr), list(nullptr), spacer(nullptr), timer(nullptr), stats() {}
+
+bool FileBrowser::init() {
+  if (!requests) requests = heapGuard.createQueue(FILE_BROWSER_QUEUE_LENGTH, sizeof(BrowserRequest));
+  return requests != nullptr;
+}
+
+bool FileBrowser::post(uint8_t type, const char *path, uint32_t page, uint8_t slot) {
+  BrowserRequest req;
+  req.type = type;
+  req.slot = slot;
+  req.generation = generation;
+  req.page = page;
+  req.path[0] = '\0';
+  if (path) {
+    if (strlen(path) >= sizeof(req.path)) return false;
+    strcpy(req.path, path);
+  }
+  return requests && xQueueSend(requests, &req, 0) == pdTRUE;
+}
+
+void FileBrowser::create() {
+  panel = lv_obj_create(objects.main);
+  lv_obj_set_pos(panel, 0, PANEL_TOP);
+  lv_obj_set_size(panel, SCREEN_WIDTH, SCREEN_HEIGHT - PANEL_TOP);
+  lv_obj_set_style_pad_all(panel, 0, 0);
+  lv_obj_set_style_radius(panel, 0, 0);
+  lv_obj_set_style_border_width(panel, 0, 0);
+  lv_obj_remove_flag(panel, LV_OBJ_FLAG_SCROLLABLE);
+
+  lv_obj_t *back = lv_button_create(panel);
+  lv_obj_set_pos(back, 4, 2);
+  lv_obj_set_size(back, 40, HEADER_HEIGHT - 4);
+  lv_obj_add_event_cb(back, backClickedCb, LV_EVENT_CLICKED, this);
+  lv_obj_t *arrow = lv_label_create(back);
+  lv_label_set_text(arrow, LV_SYMBOL_LEFT);
+  lv_obj_center(arrow);
+  pathLabel = lv_label_create(panel);
+  lv_obj_set_pos(pathLabel, 52, 6);
+  lv_obj_set_width(pathLabel, 180);
+  lv_label_set_long_mode(pathLabel, LV_LABEL_LONG_DOT);
+  countLabel = lv_label_create(panel);
+  lv_obj_align(countLabel, LV_ALIGN_TOP_RIGHT, -6, 6);
+
+  list = lv_obj_create(panel);
+  lv_obj_set_pos(list, 0, HEADER_HEIGHT);
+  lv_obj_set_size(list, SCREEN_WIDTH, LIST_HEIGHT);
+  lv_obj_set_style_pad_all(list, 0, 0);
+  lv_obj_set_style_radius(list, 0, 0);
+  lv_obj_set_style_border_width(list, 0, 0);
+  lv_obj_set_scroll_dir(list, LV_DIR_VER);
+  lv_obj_set_scrollbar_mode(list, LV_SCROLLBAR_MODE_ACTIVE);
+  lv_obj_add_event_cb(list, scrollCb, LV_EVENT_SCROLL, this);
+  // Hauteur de défilement fixée par ce seul objet, placé sous la dernière entrée
+  spacer = lv_obj_create(list);
+  lv_obj_set_size(spacer, 1, 1);
+  lv_obj_set_style_bg_opa(spacer, LV_OPA_TRANSP, 0);
+  lv_obj_set_style_border_width(spacer, 0, 0);
+  lv_obj_remove_flag(spacer, LV_OBJ_FLAG_CLICKABLE);
+
+  for (uint8_t i = 0; i < POOL_ROWS; i++) {
+    Row &row = rows[i];
+    row.obj = lv_obj_create(list);
+    lv_obj_set_size(row.obj, SCREEN_WIDTH - 8, FILE_BROWSER_ROW_HEIGHT);
+    lv_obj_set_style_pad_hor(row.obj, 8, 0);
+    lv_obj_set_style_pad_ver(row.obj, 0, 0);
+    lv_obj_set_style_radius(row.obj, 0, 0);
+    lv_obj_set_style_border_width(row.obj, 1, 0);
+    lv_obj_set_style_border_side(row.obj, LV_BORDER_SIDE_BOTTOM, 0);
+    lv_obj_set_style_bg_color(row.obj, lv_palette_lighten(LV_PALETTE_BLUE, 3), LV_STATE_CHECKED);
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_SCROLL_ON_FOCUS);
+    lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_event_cb(row.obj, rowClickedCb, LV_EVENT_CLICKED, &row);
+    row.name = lv_label_create(row.obj);
+    lv_obj_set_width(row.name, SCREEN_WIDTH - 100);
+    lv_label_set_long_mode(row.name, LV_LABEL_LONG_DOT);
+    lv_obj_align(row.name, LV_ALIGN_LEFT_MID, 0, 0);
+    row.size = lv_label_create(row.obj);
+    lv_obj_align(row.size, LV_ALIGN_RIGHT_MID, 0, 0);
+    row.index = NO_ENTRY;
+    row.loaded = false;
+  }
+  // Suit la croissance du compte pendant le parcours
+  timer = lv_timer_create(timerCb, 100, this);
+  lv_timer_pause(timer);
+}
+
+bool FileBrowser::open(const char *path) {
+  if (!objects.main || strlen(path) >= sizeof(dir)) return false;
+  if (!panel) create();
+  strcpy(dir, path);
+  generation++;
+  // Les premières pages arrivent avec le parcours
+  for (uint8_t i = 0; i < FILE_BROWSER_PAGE_SLOTS; i++) {
+    slots[i].number = i;
+    slots[i].generation = generation;
+    slots[i].lastUse = 0;
+    slots[i].state = SlotState::LOADING;
+  }
+  for (uint8_t i = 0; i < POOL_ROWS; i++) {
+    rows[i].index = NO_ENTRY;
+    lv_obj_add_flag(rows[i].obj, LV_OBJ_FLAG_HIDDEN);
+  }
+  selected = NO_ENTRY;
+  shown = UINT32_MAX;
+  lv_obj_scroll_to_y(list, 0, LV_ANIM_OFF);
+  lv_label_set_text(pathLabel, dir);
+  lv_obj_remove_flag(panel, LV_OBJ_FLAG_HIDDEN);
+  lv_obj_move_foreground(panel);
+  lv_timer_resume(timer);
+  refresh(false);
+  if (post(BROWSER_OPEN, dir, 0, 0)) return true;
+  for (uint8_t i = 0; i < FILE_BROWSER_PAGE_SLOTS; i++) slots[i].state = SlotState::EMPTY;
+  return false;
+}
+
+void FileBrowser::close() {
+  if (!panel) return;
+  lv_anim_delete(this, scrollAnimCb);
+  lv_obj_add_flag(panel, LV_OBJ_FLAG_HIDDEN);
+  lv_timer_pause(timer);
+}
+
+const BrowserEntry *FileBrowser::lookup(uint32_t entry) {
+  uint32_t page = entry / FILE_BROWSER_PAGE_ENTRIES;
+  uint32_t offset = entry % FILE_BROWSER_PAGE_ENTRIES;
+  for (uint8_t i = 0; i < FILE_BROWSER_PAGE_SLOTS; i++) {
+    Slot &s = slots[i];
+    if (s.state != SlotState::READY || s.generation != generation || s.number != page) continue;
+    s.lastUse = ++useClock;
+    return offset < s.page.count ? &s.page.entries[offset] : nullptr;
+  }
+  return nullptr;
+}
+
+// Place libre, ou page la moins récemment affichée hors de la fenêtre de lignes
+void FileBrowser::requestPage(uint32_t page) {
+  uint32_t firstPage = windowStart / FILE_BROWSER_PAGE_ENTRIES;
+  uint32_t lastPage = windowEnd > 0 ? (windowEnd - 1) / FILE_BROWSER_PAGE_ENTRIES : 0;
+  Slot *victim = nullptr;
+  for (uint8_t i = 0; i < FILE_BROWSER_PAGE_SLOTS; i++) {
+    Slot &s = slots[i];
+    bool current = s.generation == generation && s.state != SlotState::EMPTY;
+    if (current && s.number == page) return;   // Déjà là ou en cours de lecture
+    if (s.state == SlotState::LOADING) continue;
+    if (current && s.number >= firstPage && s.number <= lastPage) continue;
+    if (!current) {
+      victim = &s;
+      break;
+    }
+    if (!victim || s.lastUse < victim->lastUse) victim = &s;
+  }
+  if (!victim) return;   // Tout est en lecture : nouvel essai au prochain rafraîchissement
+  victim->number = page;
+  victim->generation = generation;
+  victim->state = SlotState::LOADING;
+  if (!post(BROWSER_LOAD, nullptr, page, (uint8_t)(victim - slots))) victim->state = SlotState::EMPTY;
+}
+
+void FileBrowser::bind(Row &row, uint32_t entry) {
+  if (row.index != entry) stats.binds++;
+  row.index = entry;
+  lv_obj_set_y(row.obj, (int32_t)entry * FILE_BROWSER_ROW_HEIGHT);
+  lv_obj_remove_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+  if (entry == selected) lv_obj_add_state(row.obj, LV_STATE_CHECKED);
+  else lv_obj_remove_state(row.obj, LV_STATE_CHECKED);
+  const BrowserEntry *e = lookup(entry);
+  row.loaded = e != nullptr;
+  if (!e) {
+    stats.pageMisses++;
+    lv_label_set_text(row.name, "...");
+    lv_label_set_text(row.size, "");
+    requestPage(entry / FILE_BROWSER_PAGE_ENTRIES);
+    return;
+  }
+  if (e->isDir) {
+    lv_label_set_text_fmt(row.name, LV_SYMBOL_DIRECTORY " %s", e->name);
+    lv_label_set_text(row.size, "");
+  } else {
+    lv_label_set_text(row.name, e->name);
+    if (e->size >= 1024 * 1024) {
+      lv_label_set_text_fmt(row.size, "%lu.%lu Mo", (unsigned long)(e->size >> 20),
+                            (unsigned long)((e->size & 0xFFFFF) * 10 >> 20));
+    } else {
+      lv_label_set_text_fmt(row.size, "%lu Ko", (unsigned long)((e->size + 1023) >> 10));
+    }
+  }
+}
+
+// Ligne de l'entrée i : rows[i % POOL_ROWS]. La fenêtre ne dépassant jamais POOL_ROWS
+// entrées, deux entrées visibles ne se disputent jamais une ligne ; au défilement, seules
+// les lignes sorties de la fenêtre sont réaffectées.
+void FileBrowser::refresh(bool force) {
+  uint32_t count = indexGeneration.load(std::memory_order_acquire) == generation ? index.count() : 0;
+  if (count != shown) {
+    shown = count;
+    if (count > 0) {
+      lv_obj_remove_flag(spacer, LV_OBJ_FLAG_HIDDEN);
+      lv_obj_set_y(spacer, (int32_t)count * FILE_BROWSER_ROW_HEIGHT - 1);
+    } else {
+      lv_obj_add_flag(spacer, LV_OBJ_FLAG_HIDDEN);
+    }
+    lv_label_set_text_fmt(countLabel, "%lu", (unsigned long)count);
+  }
+  int32_t scrollY = lv_obj_get_scroll_y(list);
+  uint32_t first = scrollY > 0 ? (uint32_t)scrollY / FILE_BROWSER_ROW_HEIGHT : 0;
+  windowStart = first > FILE_BROWSER_ROW_MARGIN ? first - FILE_BROWSER_ROW_MARGIN : 0;
+  windowEnd = windowStart + POOL_ROWS < count ? windowStart + POOL_ROWS : count;
+  for (uint8_t i = 0; i < POOL_ROWS; i++) {
+    Row &row = rows[i];
+    if (row.index != NO_ENTRY && (row.index < windowStart || row.index >= windowEnd)) {
+      row.index = NO_ENTRY;
+      lv_obj_add_flag(row.obj, LV_OBJ_FLAG_HIDDEN);
+    }
+  }
+  for (uint32_t entry = windowStart; entry < windowEnd; entry++) {
+    Row &row = rows[entry % POOL_ROWS];
+    if (force || row.index != entry || !row.loaded) bind(row, entry);
+  }
+}
+
+void FileBrowser::enter(uint32_t entry) {
+  const BrowserEntry *e = lookup(entry);
+  if (!e) return;
+  char path[FILE_BROWSER_NAME_MAX];
+  int n = snprintf(path, sizeof(path), "%s%s%s", dir, strcmp(dir, "/") == 0 ? "" : "/", e->name);
+  if (n <= 0 || (size_t)n >= sizeof(path)) {
+    DEBUG_ERRORF_AUTO("Erreur: Chemin trop long pour %s", e->name);
+    return;
+  }
+  if (e->isDir) {
+    open(path);
+    return;
+  }
+  selected = entry;
+  refresh(true);
+  DEBUG_PRINTF_AUTO("Job sélectionné: %s", path);
+}
+
+void FileBrowser::completePage(uint16_t gen, uint32_t number, const BrowserPage *entries) {
+  if (!display.lock()) return;
+  for (uint8_t i = 0; i < FILE_BROWSER_PAGE_SLOTS; i++) {
+    Slot &s = slots[i];
+    if (s.state != SlotState::LOADING || s.generation != gen || s.number != number) continue;
+    if (entries) {
+      s.page = *entries;
+      s.state = SlotState::READY;
+      stats.pageLoads++;
+    } else {
+      s.state = SlotState::EMPTY;
+    }
+    break;
+  }
+  if (gen == generation && isOpen()) refresh(false);
+  display.unlock();
+}
+
+void FileBrowser::pageReady(uint32_t page, const BrowserPage &entries, void *ctx) {
+  fileBrowser.completePage(((BrowserRequest *)ctx)->generation, page, &entries);
+}
+
+void FileBrowser::scrollCb(lv_event_t *e) {
+  ((FileBrowser *)lv_event_get_user_data(e))->refresh(false);
+}
+
+void FileBrowser::rowClickedCb(lv_event_t *e) {
+  Row *row = (Row *)lv_event_get_user_data(e);
+  if (row->index != NO_ENTRY) fileBrowser.enter(row->index);
+}
+
+void FileBrowser::backClickedCb(lv_event_t *e) {
+  FileBrowser *self = (FileBrowser *)lv_event_get_user_data(e);
+  if (strcmp(self->dir, "/") == 0) {
+    self->close();
+    return;
+  }
+  char parent[FILE_BROWSER_NAME_MAX];
+  strcpy(parent, self->dir);
+  char *slash = strrchr(parent, '/');
+  if (slash == parent || !slash) strcpy(parent, "/");
+  else *slash = '\0';
+  self->open(parent);
+}
+
+void FileBrowser::timerCb(lv_timer_t *t) {
+  FileBrowser *self = (FileBrowser *)lv_timer_get_user_data(t);
+  self->refresh(false);
+  if (self->index.isComplete() && self->indexGeneration.load() == self->generation) lv_timer_pause(t);
+}
+
+void FileBrowser::scrollAnimCb(void *var, int32_t value) {
+  lv_obj_scroll_to_y(((FileBrowser *)var)->list, value, LV_ANIM_OFF);
+}
+
+void FileBrowser::scrollTest(uint32_t durationMs) {
+  if (!isOpen()) return;
+  int32_t end = (int32_t)shown * FILE_BROWSER_ROW_HEIGHT - LIST_HEIGHT;
+  if (end <= 0) return;
+  lv_anim_t a;
+  lv_anim_init(&a);
+  lv_anim_set_var(&a, this);
+  lv_anim_set_exec_cb(&a, scrollAnimCb);
+  lv_anim_set_values(&a, 0, end);
+  lv_anim_set_duration(&a, durationMs);
+  lv_anim_set_path_cb(&a, lv_anim_path_linear);
+  lv_anim_start(&a);
+}
+
+uint32_t FileBrowser::countObjects(lv_obj_t *obj) {
+  uint32_t n = 1;
+  for (uint32_t i = 0; i < lv_obj_get_child_count(obj); i++) n += countObjects(lv_obj_get_child(obj, (int32_t)i));
+  return n;
+}
+
+void FileBrowser::getStats(FileBrowserStats &out) {
+  out = stats;
+  out.entries = shown == UINT32_MAX ? 0 : shown;
+  out.scanMs = index.isComplete() ? index.scanMs() : 0;
+  out.objects = panel ? countObjects(panel) : 0;
+  out.lvMemUsed = 0;
+#if LV_USE_STDLIB_MALLOC == LV_STDLIB_BUILTIN
+  lv_mem_monitor_t mon;
+  lv_mem_monitor(&mon);
+  out.lvMemUsed = (uint32_t)(mon.total_size - mon.free_size);
+#endif
+}
+
+void FileBrowser::printStats() {
+  FileBrowserStats s;
+  if (!display.lock()) {
+    Serial.println("ERROR: Display not ready");
+    return;
+  }
+  bool visible = isOpen();
+  getStats(s);
+  display.unlock();
+  reportLine("BROWSE open=%d dir=%s entries=%lu complete=%d truncated=%d scan_ms=%lu rows=%u objects=%lu "
+             "binds=%lu page_loads=%lu page_misses=%lu lv_mem_used=%lu\n",
+             visible ? 1 : 0, dir[0] ? dir : "-", (unsigned long)s.entries, index.isComplete() ? 1 : 0,
+             index.isTruncated() ? 1 : 0, (unsigned long)s.scanMs, (unsigned)POOL_ROWS,
+             (unsigned long)s.objects, (unsigned long)s.binds, (unsigned long)s.pageLoads,
+             (unsigned long)s.pageMisses, (unsigned long)s.lvMemUsed);
+  Serial.println("OK");
+}
+
+// Toute la lecture SD est ici : le défilement ne fait jamais attendre LvglTask sur la carte
+void FileBrowser::browserTask(void *pvParameters) {
+  FileBrowser &fb = fileBrowser;
+  static BrowserPage page;
+  BrowserRequest req;
+  while (1) {
+    if (xQueueReceive(fb.requests, &req, portMAX_DELAY) != pdTRUE) continue;
+    Storage *storage = sdManager.getStorage();
+    if (req.type == BROWSER_OPEN) {
+      fb.index.clear();
+      fb.indexGeneration.store(req.generation, std::memory_order_release);
+      if (!fb.index.build(storage, req.path, FILE_BROWSER_PAGE_SLOTS, pageReady, &req)) {
+        DEBUG_ERRORF_AUTO("Erreur: Impossible de parcourir %s", req.path);
+      } else {
+        DEBUG_PRINTF_AUTO("Répertoire %s: %lu entrées en %lu ms", req.path, (unsigned long)fb.index.count(),
+                          (unsigned long)fb.index.scanMs());
+      }
+      continue;
+    }
+    // Répertoire changé depuis la demande : la place a déjà été reprise par open()
+    if (req.generation != fb.indexGeneration.load(std::memory_order_acquire)) continue;
+    bool ok = fb.index.loadPage(storage, req.page, page);
+    fb.completePage(req.generation, req.page, ok ? &page : nullptr);
+  }
+}
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "storage.h"
+#include "../config.h"
+#if defined(ARDUINO)
+#include <lvgl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+// Liste des jobs virtualisée : seules les lignes visibles (plus FILE_BROWSER_ROW_MARGIN de
+// part et d'autre) existent en objets LVGL, recyclées au défilement. Les noms ne sont
+// jamais tous en mémoire : un parcours du répertoire compte les entrées et note la
+// position de reprise de chaque page, puis les pages sont relues à la demande.
+
+struct BrowserEntry {
+  char name[FILE_BROWSER_NAME_MAX];
+  uint32_t size;
+  bool isDir;
+};
+
+struct BrowserPage {
+  BrowserEntry entries[FILE_BROWSER_PAGE_ENTRIES];
+  uint8_t count;
+};
+
+// Pages remplies pendant le parcours, pour afficher le début de la liste sans attendre la fin
+typedef void (*BrowserPageCallback)(uint32_t page, const BrowserPage &entries, void *ctx);
+
+class DirectoryIndex {
+public:
+  DirectoryIndex();
+  void clear();
+  // Parcours complet de dir ; les prefillPages premières pages sont passées à cb au fil de l'eau
+  bool build(Storage *storage, const char *dir, uint8_t prefillPages, BrowserPageCallback cb, void *ctx);
+  bool loadPage(Storage *storage, uint32_t page, BrowserPage &out);
+  // Lisible depuis une autre tâche : croît pendant build()
+  uint32_t count() const { return entries.load(std::memory_order_acquire); }
+  bool isComplete() const { return complete.load(std::memory_order_acquire); }
+  bool isTruncated() const { return truncated; }
+  uint32_t scanMs() const { return elapsedMs; }
+  // Répertoires et G-code, sans les fichiers cachés ni les caches .pvw / .thb
+  static bool accept(const char *name, const StorageStat &st);
+
+private:
+  struct Build {
+    DirectoryIndex *index;
+    uint8_t prefillPages;
+    BrowserPageCallback cb;
+    void *ctx;
+    BrowserPage page;
+  };
+  struct PageLoad {
+    BrowserPage *out;
+  };
+
+  char dir[FILE_BROWSER_NAME_MAX];
+  uint32_t checkpoints[FILE_BROWSER_MAX_ENTRIES / FILE_BROWSER_PAGE_ENTRIES];
+  std::atomic<uint32_t> entries;
+  std::atomic<bool> complete;
+  bool truncated;
+  uint32_t elapsedMs;
+
+  static bool buildEntry(const char *name, const StorageStat &st, uint32_t at, void *ctx);
+  static bool pageEntry(const char *name, const StorageStat &st, uint32_t at, void *ctx);
+  static void copyEntry(BrowserEntry &out, const char *name, const StorageStat &st);
+};
+
+#if defined(ARDUINO)
+struct FileBrowserStats {
+  uint32_t entries;
+  uint32_t scanMs;
+  uint32_t binds;         // Lignes réaffectées à une autre entrée
+  uint32_t pageLoads;     // Pages lues sur la SD
+  uint32_t pageMisses;    // Lignes affichées avant que leur page soit chargée
+  uint32_t objects;       // Objets LVGL du panneau, constant quelle que soit la taille du répertoire
+  uint32_t lvMemUsed;     // Tas LVGL (0 sans l'allocateur intégré)
+};
+
+class FileBrowser {
+public:
+  FileBrowser();
+  bool init();
+  // Appels LVGL : sous display.lock() hors de la tâche de rendu
+  bool open(const char *dir);
+  void close();
+  bool isOpen() const { return panel && !lv_obj_has_flag(panel, LV_OBJ_FLAG_HIDDEN); }
+  // Défilement animé de tout le répertoire, pour mesurer le rendu (commande DISPLAY)
+  void scrollTest(uint32_t durationMs);
+  void getStats(FileBrowserStats &out);
+  void printStats();
+  static void browserTask(void *pvParameters);
+
+private:
+  enum class SlotState : uint8_t { EMPTY, LOADING, READY };
+  struct Slot {
+    BrowserPage page;
+    uint32_t number;
+    uint32_t lastUse;
+    uint16_t generation;
+    SlotState state;
+  };
+  static const uint8_t LIST_HEIGHT = 168;
+  static const uint8_t POOL_ROWS = (LIST_HEIGHT + FILE_BROWSER_ROW_HEIGHT - 1) / FILE_BROWSER_ROW_HEIGHT + 1 +
+                                   2 * FILE_BROWSER_ROW_MARGIN;
+  struct Row {
+    lv_obj_t *obj;
+    lv_obj_t *name;
+    lv_obj_t *size;
+    uint32_t index;       // Entrée affichée, UINT32_MAX si aucune
+    bool loaded;          // false : emplacement réservé en attendant la page
+  };
+
+  QueueHandle_t requests;
+  DirectoryIndex index;
+  std::atomic<uint16_t> indexGeneration;  // Répertoire décrit par index
+  uint16_t generation;                    // Répertoire affiché
+  char dir[FILE_BROWSER_NAME_MAX];
+  Slot slots[FILE_BROWSER_PAGE_SLOTS];
+  uint32_t useClock;
+  Row rows[POOL_ROWS];
+  uint32_t shown;         // Entrées couvertes par la zone de défilement
+  uint32_t windowStart;   // Entrées ayant une ligne : [windowStart, windowEnd)
+  uint32_t windowEnd;
+  uint32_t selected;
+  lv_obj_t *panel;
+  lv_obj_t *pathLabel;
+  lv_obj_t *countLabel;
+  lv_obj_t *list;
+  lv_obj_t *spacer;
+  lv_timer_t *timer;
+  FileBrowserStats stats;
+
+  void create();
+  void refresh(bool force);
+  void bind(Row &row, uint32_t entry);
+  const BrowserEntry *lookup(uint32_t entry);
+  void requestPage(uint32_t page);
+  bool post(uint8_t type, const char *path, uint32_t page, uint8_t slot);
+  void completePage(uint16_t gen, uint32_t number, const BrowserPage *entries);
+  void enter(uint32_t entry);
+  static void pageReady(uint32_t page, const BrowserPage &entries, void *ctx);
+  static uint32_t countObjects(lv_obj_t *obj);
+  static void scrollCb(lv_event_t *e);
+  static void rowClickedCb(lv_event_t *e);
+  static void backClickedCb(lv_event_t *e);
+  static void timerCb(lv_timer_t *t);
+  static void scrollAnimCb(void *var, int32_t value);
+};
+
+extern FileBrowser fileBrowser;
+#endif
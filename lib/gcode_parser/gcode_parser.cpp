@@ -1,7 +1,15 @@
-
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_PARSER
 #include "gcode_parser.h"
+#include "../config.h"
 #include "../debug_manager.h"
 #include "system_manager.h"
+#include "machine_state.h"
+#include "report_manager.h"
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "health_monitor.h"
+#include "motion_optimizer.h"
+#include "gcode_scheduler.h"
 
 GcodeParser gcodeParser;
 
@@ -9,78 +17,158 @@ void GcodeParser::init() {
   DEBUG_PRINTF_AUTO("Initialisation du Gcode Parser");
   absolute_positioning = true; // G90 par défaut
   absolute_extrusion = true;  // M82 par défaut
+  motionOptimizer.setSink(emitMotion, nullptr);
 }
 
-void GcodeParser::testParse(String cmd) {
-  cmd.trim();
-  if (cmd.isEmpty()) {
+void GcodeParser::testParse(const char *cmd) {
+  if (!*cmd) {
     DEBUG_PRINTF_AUTO("Test: Commande vide ignorée");
     Serial.println("ERROR: Empty command");
     return;
   }
-  DEBUG_PRINTF_AUTO("Test: Parsing commande '%s'", cmd.c_str());
+  DEBUG_PRINTF_AUTO("Test: Parsing commande '%s'", cmd);
+
+  MotionCommand parsed_cmd;
+  switch (parseLine(cmd, parsed_cmd)) {
+    case ParseResult::OK:
+      DEBUG_PRINTF_AUTO("Test: Commande valide, type=%c, code=%d", parsed_cmd.type, rawCode(parsed_cmd));
+      Serial.println("OK: Command parsed");
+      break;
+    case ParseResult::INVALID_TYPE:
+      DEBUG_PRINTF_AUTO("Test: Type de commande inconnu '%s'", cmd);
+      Serial.println("ERROR: Invalid command type");
+      break;
+    case ParseResult::UNSUPPORTED:
+      DEBUG_PRINTF_AUTO("Test: Code %c%d non supporté", parsed_cmd.type, rawCode(parsed_cmd));
+      Serial.println("ERROR: Unsupported command");
+      break;
+    case ParseResult::INVALID:
+      DEBUG_PRINTF_AUTO("Test: Erreur parsing '%s'", cmd);
+      Serial.println("ERROR: Invalid command");
+      break;
+  }
+}
 
-  MotionCommand parsed_cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false};
-  int space_pos = cmd.indexOf(' ');
-  String params = (space_pos == -1) ? "" : cmd.substring(space_pos + 1);
-  String code_str = cmd.substring(0, space_pos == -1 ? cmd.length() : space_pos);
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
 
-  if (!code_str.startsWith("G") && !code_str.startsWith("M")) {
-    DEBUG_PRINTF_AUTO("Test: Type de commande inconnu '%s'", code_str.c_str());
-    Serial.println("ERROR: Invalid command type");
-    return;
+static const double POW10[16] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+// Nombre en tête de [p, end), 0 si aucun : même valeur que String::toFloat() (strtod puis
+// float), sans copie. Signe, chiffres et point sont décodés ici : mantisse entière exacte
+// divisée par une puissance de 10 exacte, donc le même arrondi que strtod. Exposant,
+// hexadécimal ou plus de 15 chiffres passent par strtod.
+static float parseNumber(const char *p, const char *end) {
+  const char *q = p;
+  bool negative = false;
+  if (q < end && (*q == '-' || *q == '+')) negative = *q++ == '-';
+  uint64_t mantissa = 0;
+  int digits = 0, scale = 0;
+  while (q < end && *q >= '0' && *q <= '9') {
+    mantissa = mantissa * 10 + (uint64_t)(*q++ - '0');
+    digits++;
+  }
+  if (q < end && *q == '.') {
+    q++;
+    while (q < end && *q >= '0' && *q <= '9') {
+      mantissa = mantissa * 10 + (uint64_t)(*q++ - '0');
+      digits++;
+      scale++;
+    }
+  }
+  if (digits == 0 || digits > 15 || (q < end && (*q == 'e' || *q == 'E' || *q == 'x' || *q == 'X'))) {
+    return (float)strtod(p, nullptr);
+  }
+  double value = (double)mantissa / POW10[scale];
+  return (float)(negative ? -value : value);
+}
+
+// Entier en tête de [p, end), 0 si aucun, comme String::toInt()
+static int parseInteger(const char *p, const char *end) {
+  while (p < end && isBlank(*p)) p++;
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+  long value = 0;
+  while (p < end && *p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+  return (int)(negative ? -value : value);
+}
+
+// Jeton suivant des paramètres : séparés par des espaces, blancs de bord ignorés comme
+// avec String::trim(). Rend nullptr en fin de ligne, end pointe après le jeton.
+static const char *nextToken(const char *&p, const char *&end) {
+  while (isBlank(*p)) p++;
+  if (!*p) return nullptr;
+  const char *start = p;
+  while (*p && *p != ' ') p++;
+  end = p;
+  return start;
+}
+
+GcodeParser::ParseResult GcodeParser::checkSyntax(const char *line, MotionCommand &cmd) {
+  GcodeParser scratch;
+  return scratch.parseLine(line, cmd);
+}
+
+GcodeParser::ParseResult GcodeParser::parseLine(const char *line, MotionCommand &cmd) {
+  cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false, 0.0f, 0.0f, false, false};
+  const char *space = strchr(line, ' ');
+  const char *params = space ? space + 1 : "";
+  const char *codeEnd = space ? space : line + strlen(line);
+
+  if (line[0] != 'G' && line[0] != 'M') {
+    return ParseResult::INVALID_TYPE;
   }
 
-  parsed_cmd.type = code_str.charAt(0);
-  int raw_code = code_str.substring(1).toInt();
-  parsed_cmd.code = raw_code;
-  if (parsed_cmd.type == 'M') {
-    parsed_cmd.code += 1000; // Décaler les M codes
+  cmd.type = line[0];
+  cmd.code = parseInteger(line + 1, codeEnd);
+  if (cmd.type == 'M') {
+    cmd.code += 1000; // Décaler les M codes
   }
 
   bool valid = false;
-  switch (static_cast<GcodeType>(parsed_cmd.code)) {
+  switch (static_cast<GcodeType>(cmd.code)) {
     case GcodeType::G0:
     case GcodeType::G1:
-      valid = parseLinearMovementCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseLinearMovementCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::G2:
     case GcodeType::G3:
-      valid = parseArcMovementCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseArcMovementCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::G92:
-      valid = parseSetPositionCommand(params, parsed_cmd);
+      valid = parseSetPositionCommand(params, cmd);
       break;
     case GcodeType::G28:
-      valid = parseHomingCommand(params, parsed_cmd);
+      valid = parseHomingCommand(params, cmd);
       break;
     case GcodeType::G29:
-      valid = parseLevelingCommand(params, parsed_cmd);
+      valid = parseLevelingCommand(params, cmd);
       break;
     case GcodeType::G20:
     case GcodeType::G21:
     case GcodeType::G90:
     case GcodeType::G91:
-      valid = parsePositioningCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parsePositioningCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M104:
     case GcodeType::M109:
     case GcodeType::M140:
     case GcodeType::M190:
-      valid = parseTemperatureCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseTemperatureCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M106:
     case GcodeType::M107:
-      valid = parseFanCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseFanCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M82:
     case GcodeType::M83:
-      valid = parseExtruderCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseExtruderCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M17:
     case GcodeType::M18:
     case GcodeType::M84:
-      valid = parseMotorsCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseMotorsCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M20:
     case GcodeType::M21:
@@ -92,47 +180,35 @@ void GcodeParser::testParse(String cmd) {
     case GcodeType::M27:
     case GcodeType::M28:
     case GcodeType::M29:
-      valid = parseSDCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+      valid = parseSDCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M105:
     case GcodeType::M114:
     case GcodeType::M115:
-      valid = parseReportingCommand(params, parsed_cmd, static_cast<GcodeType>(parsed_cmd.code));
+    case GcodeType::M155:
+      valid = parseReportingCommand(params, cmd, static_cast<GcodeType>(cmd.code));
       break;
     case GcodeType::M112:
-      valid = parseEmergencyCommand(params, parsed_cmd);
+      valid = parseEmergencyCommand(params, cmd);
       break;
     default:
-      DEBUG_PRINTF_AUTO("Test: Code %c%d non supporté", parsed_cmd.type, raw_code);
-      Serial.println("ERROR: Unsupported command");
-      return;
+      return ParseResult::UNSUPPORTED;
   }
-
-  if (valid) {
-    DEBUG_PRINTF_AUTO("Test: Commande valide, type=%c, code=%d", parsed_cmd.type, raw_code);
-    Serial.println("OK: Command parsed");
-  } else {
-    DEBUG_PRINTF_AUTO("Test: Erreur parsing '%s'", cmd.c_str());
-    Serial.println("ERROR: Invalid command");
+  if (valid && (cmd.has_i || cmd.has_j) && cmd.code != static_cast<int>(GcodeType::G2) &&
+      cmd.code != static_cast<int>(GcodeType::G3)) {
+    DEBUG_ERRORF_AUTO("Erreur: I et J réservés aux arcs G2/G3");
+    valid = false;
   }
+  return valid ? ParseResult::OK : ParseResult::INVALID;
 }
 
-bool GcodeParser::parseParameters(String params, MotionCommand &cmd) {
+bool GcodeParser::parseParameters(const char *params, MotionCommand &cmd) {
   cmd.has_x = cmd.has_y = cmd.has_z = cmd.has_e = cmd.has_f = cmd.has_s = false;
-  params.trim();
-
-  while (!params.isEmpty()) {
-    int next_space = params.indexOf(' ');
-    String param = (next_space == -1) ? params : params.substring(0, next_space);
-    if (param.length() < 1) {
-      DEBUG_PRINTF_AUTO("Erreur: Paramètre invalide '%s'", param.c_str());
-      return false;
-    }
-    char param_type = param.charAt(0);
-    float value = 0.0f;
-    if (param.length() > 1) {
-      value = param.substring(1).toFloat();
-    }
+  cmd.has_i = cmd.has_j = false;
+  const char *p = params, *end;
+  while (const char *param = nextToken(p, end)) {
+    char param_type = param[0];
+    float value = end - param > 1 ? parseNumber(param + 1, end) : 0.0f;
     switch (param_type) {
       case 'X': cmd.x = value; cmd.has_x = true; break;
       case 'Y': cmd.y = value; cmd.has_y = true; break;
@@ -140,72 +216,71 @@ bool GcodeParser::parseParameters(String params, MotionCommand &cmd) {
       case 'E': cmd.e = value; cmd.has_e = true; break;
       case 'F': cmd.f = value / 60.0; cmd.has_f = true; break; // Convertir mm/min en mm/s
       case 'S': cmd.s = value; cmd.has_s = true; break;
+      case 'I': cmd.i = value; cmd.has_i = true; break;
+      case 'J': cmd.j = value; cmd.has_j = true; break;
       default:
-        DEBUG_PRINTF_AUTO("Erreur: Paramètre inconnu '%c'", param_type);
+        DEBUG_ERRORF_AUTO("Erreur: Paramètre inconnu '%c'", param_type);
         return false;
     }
-    params = (next_space == -1) ? "" : params.substring(next_space + 1);
-    params.trim();
   }
   return true;
 }
 
-bool GcodeParser::parseLinearMovementCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseLinearMovementCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(code);
   if (!parseParameters(params, cmd)) return false;
   if (!cmd.has_x && !cmd.has_y && !cmd.has_z && !cmd.has_e) {
-    DEBUG_PRINTF_AUTO("Erreur: G%d sans paramètres X, Y, Z, ou E", static_cast<int>(code));
+    DEBUG_ERRORF_AUTO("Erreur: G%d sans paramètres X, Y, Z, ou E", static_cast<int>(code));
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseArcMovementCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseArcMovementCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(code);
   if (!parseParameters(params, cmd)) return false;
   if (!cmd.has_f || (!cmd.has_x && !cmd.has_y && !cmd.has_z)) {
-    DEBUG_PRINTF_AUTO("Erreur: G%d (arc) sans F ou axes", static_cast<int>(code));
+    DEBUG_ERRORF_AUTO("Erreur: G%d (arc) sans F ou axes", static_cast<int>(code));
+    return false;
+  }
+  if (!cmd.has_i && !cmd.has_j) {
+    DEBUG_ERRORF_AUTO("Erreur: G%d (arc) sans centre I/J", static_cast<int>(code));
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseSetPositionCommand(String params, MotionCommand &cmd) {
+bool GcodeParser::parseSetPositionCommand(const char *params, MotionCommand &cmd) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(GcodeType::G92);
   if (!parseParameters(params, cmd)) return false;
   if (!cmd.has_x && !cmd.has_y && !cmd.has_z && !cmd.has_e) {
-    DEBUG_PRINTF_AUTO("Erreur: G92 sans paramètres X, Y, Z, ou E");
+    DEBUG_ERRORF_AUTO("Erreur: G92 sans paramètres X, Y, Z, ou E");
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseHomingCommand(String params, MotionCommand &cmd) {
+bool GcodeParser::parseHomingCommand(const char *params, MotionCommand &cmd) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(GcodeType::G28);
-  params.trim();
-  if (params.isEmpty()) {
+  const char *p = params, *end;
+  const char *param = nextToken(p, end);
+  if (!param) {
     cmd.has_x = cmd.has_y = cmd.has_z = true; // G28 sans paramètres = homing tous axes
     return true;
   }
 
   cmd.has_x = cmd.has_y = cmd.has_z = false;
-  while (!params.isEmpty()) {
-    int next_space = params.indexOf(' ');
-    String param = (next_space == -1) ? params : params.substring(0, next_space);
-    if (param.length() < 1) {
-      DEBUG_PRINTF_AUTO("Erreur: Paramètre invalide '%s'", param.c_str());
-      return false;
-    }
-    char param_type = param.charAt(0);
-    if (param.length() > 1) {
+  for (; param; param = nextToken(p, end)) {
+    char param_type = param[0];
+    if (end - param > 1) {
       // Si une valeur est fournie (ex. X0), vérifier qu'elle est nulle
-      float value = param.substring(1).toFloat();
+      float value = parseNumber(param + 1, end);
       if (value != 0.0f) {
-        DEBUG_PRINTF_AUTO("Erreur: G28 ne supporte pas de valeurs non nulles pour %c", param_type);
+        DEBUG_ERRORF_AUTO("Erreur: G28 ne supporte pas de valeurs non nulles pour %c", param_type);
         return false;
       }
     }
@@ -214,20 +289,18 @@ bool GcodeParser::parseHomingCommand(String params, MotionCommand &cmd) {
       case 'Y': cmd.has_y = true; break;
       case 'Z': cmd.has_z = true; break;
       default:
-        DEBUG_PRINTF_AUTO("Erreur: Paramètre inconnu '%c' pour G28", param_type);
+        DEBUG_ERRORF_AUTO("Erreur: Paramètre inconnu '%c' pour G28", param_type);
         return false;
     }
-    params = (next_space == -1) ? "" : params.substring(next_space + 1);
-    params.trim();
   }
   if (!cmd.has_x && !cmd.has_y && !cmd.has_z) {
-    DEBUG_PRINTF_AUTO("Erreur: G28 sans axes spécifiés");
+    DEBUG_ERRORF_AUTO("Erreur: G28 sans axes spécifiés");
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseLevelingCommand(String params, MotionCommand &cmd) {
+bool GcodeParser::parseLevelingCommand(const char *params, MotionCommand &cmd) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(GcodeType::G29);
   if (!parseParameters(params, cmd)) return false;
@@ -235,13 +308,13 @@ bool GcodeParser::parseLevelingCommand(String params, MotionCommand &cmd) {
   return true;
 }
 
-bool GcodeParser::parsePositioningCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parsePositioningCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'G';
   cmd.code = static_cast<int>(code);
-  if (!params.isEmpty()) {
+  if (*params) {
     if (!parseParameters(params, cmd)) return false;
     if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: G%d ne doit pas avoir de paramètres", static_cast<int>(code));
+      DEBUG_ERRORF_AUTO("Erreur: G%d ne doit pas avoir de paramètres", static_cast<int>(code));
       return false;
     }
   }
@@ -253,53 +326,53 @@ bool GcodeParser::parsePositioningCommand(String params, MotionCommand &cmd, Gco
   return true;
 }
 
-bool GcodeParser::parseTemperatureCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseTemperatureCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
   if (!parseParameters(params, cmd)) return false;
   if (!cmd.has_s) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d nécessite un paramètre S", static_cast<int>(code) - 1000);
+    DEBUG_ERRORF_AUTO("Erreur: M%d nécessite un paramètre S", static_cast<int>(code) - 1000);
     return false;
   }
   if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", static_cast<int>(code) - 1000);
+    DEBUG_ERRORF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", static_cast<int>(code) - 1000);
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseFanCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseFanCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
   if (code == GcodeType::M106) {
     if (!parseParameters(params, cmd)) return false;
     if (!cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: M106 nécessite un paramètre S");
+      DEBUG_ERRORF_AUTO("Erreur: M106 nécessite un paramètre S");
       return false;
     }
   } else if (code == GcodeType::M107) {
-    if (!params.isEmpty()) {
+    if (*params) {
       if (!parseParameters(params, cmd)) return false;
       if (cmd.has_s) {
-        DEBUG_PRINTF_AUTO("Erreur: M107 ne doit pas avoir de paramètre S");
+        DEBUG_ERRORF_AUTO("Erreur: M107 ne doit pas avoir de paramètre S");
         return false;
       }
     }
   }
   if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f) {
-    DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", static_cast<int>(code) - 1000);
+    DEBUG_ERRORF_AUTO("Erreur: M%d ne doit pas avoir de paramètres X, Y, Z, E, ou F", static_cast<int>(code) - 1000);
     return false;
   }
   return true;
 }
 
-bool GcodeParser::parseExtruderCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseExtruderCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
-  if (!params.isEmpty()) {
+  if (*params) {
     if (!parseParameters(params, cmd)) return false;
     if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres", static_cast<int>(code) - 1000);
+      DEBUG_ERRORF_AUTO("Erreur: M%d ne doit pas avoir de paramètres", static_cast<int>(code) - 1000);
       return false;
     }
   }
@@ -308,7 +381,7 @@ bool GcodeParser::parseExtruderCommand(String params, MotionCommand &cmd, GcodeT
   return true;
 }
 
-bool GcodeParser::parseMotorsCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseMotorsCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
   if (!parseParameters(params, cmd)) return false;
@@ -316,7 +389,7 @@ bool GcodeParser::parseMotorsCommand(String params, MotionCommand &cmd, GcodeTyp
   return true;
 }
 
-bool GcodeParser::parseSDCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseSDCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
   if (!parseParameters(params, cmd)) return false;
@@ -324,26 +397,28 @@ bool GcodeParser::parseSDCommand(String params, MotionCommand &cmd, GcodeType co
   return true;
 }
 
-bool GcodeParser::parseReportingCommand(String params, MotionCommand &cmd, GcodeType code) {
+bool GcodeParser::parseReportingCommand(const char *params, MotionCommand &cmd, GcodeType code) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(code);
-  if (!params.isEmpty()) {
+  if (*params) {
     if (!parseParameters(params, cmd)) return false;
-    if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: M%d ne doit pas avoir de paramètres", static_cast<int>(code) - 1000);
+    // Seul M155 accepte S (intervalle de l'auto-report en secondes)
+    bool s_allowed = (code == GcodeType::M155);
+    if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || (cmd.has_s && !s_allowed)) {
+      DEBUG_ERRORF_AUTO("Erreur: M%d ne doit pas avoir de paramètres", static_cast<int>(code) - 1000);
       return false;
     }
   }
   return true;
 }
 
-bool GcodeParser::parseEmergencyCommand(String params, MotionCommand &cmd) {
+bool GcodeParser::parseEmergencyCommand(const char *params, MotionCommand &cmd) {
   cmd.type = 'M';
   cmd.code = static_cast<int>(GcodeType::M112);
-  if (!params.isEmpty()) {
+  if (*params) {
     if (!parseParameters(params, cmd)) return false;
     if (cmd.has_x || cmd.has_y || cmd.has_z || cmd.has_e || cmd.has_f || cmd.has_s) {
-      DEBUG_PRINTF_AUTO("Erreur: M112 ne doit pas avoir de paramètres");
+      DEBUG_ERRORF_AUTO("Erreur: M112 ne doit pas avoir de paramètres");
       return false;
     }
   }
@@ -351,114 +426,182 @@ bool GcodeParser::parseEmergencyCommand(String params, MotionCommand &cmd) {
 }
 
 void GcodeParser::parserTask(void *pvParameters) {
-  String line;
+  char line[GCODE_LINE_MAX];
+  GcodeStream stream;
   while (1) {
-    if (xQueueReceive(gcodeQueue, &line, portMAX_DELAY) == pdTRUE) {
-      DEBUG_PRINTF_AUTO("Parsing ligne: '%s'", line.c_str());
-      MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false};
-      int space_pos = line.indexOf(' ');
-      String params = (space_pos == -1) ? "" : line.substring(space_pos + 1);
-      String code_str = line.substring(0, space_pos == -1 ? line.length() : space_pos);
-
-      if (!code_str.startsWith("G") && !code_str.startsWith("M")) {
-        DEBUG_PRINTF_AUTO("Erreur: Type de commande inconnu '%s'", code_str.c_str());
-        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-        Serial.println("ERROR: Invalid command type");
-        continue;
-      }
-
-      cmd.type = code_str.charAt(0);
-      int raw_code = code_str.substring(1).toInt();
-      cmd.code = raw_code;
-      if (cmd.type == 'M') {
-        cmd.code += 1000; // Décaler les M codes
-      }
-
-      bool valid = false;
-      switch (static_cast<GcodeType>(cmd.code)) {
-        case GcodeType::G0:
-        case GcodeType::G1:
-          valid = gcodeParser.parseLinearMovementCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::G2:
-        case GcodeType::G3:
-          valid = gcodeParser.parseArcMovementCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::G92:
-          valid = gcodeParser.parseSetPositionCommand(params, cmd);
-          break;
-        case GcodeType::G28:
-          valid = gcodeParser.parseHomingCommand(params, cmd);
-          break;
-        case GcodeType::G29:
-          valid = gcodeParser.parseLevelingCommand(params, cmd);
-          break;
-        case GcodeType::G20:
-        case GcodeType::G21:
-        case GcodeType::G90:
-        case GcodeType::G91:
-          valid = gcodeParser.parsePositioningCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M104:
-        case GcodeType::M109:
-        case GcodeType::M140:
-        case GcodeType::M190:
-          valid = gcodeParser.parseTemperatureCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M106:
-        case GcodeType::M107:
-          valid = gcodeParser.parseFanCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M82:
-        case GcodeType::M83:
-          valid = gcodeParser.parseExtruderCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M17:
-        case GcodeType::M18:
-        case GcodeType::M84:
-          valid = gcodeParser.parseMotorsCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M20:
-        case GcodeType::M21:
-        case GcodeType::M22:
-        case GcodeType::M23:
-        case GcodeType::M24:
-        case GcodeType::M25:
-        case GcodeType::M26:
-        case GcodeType::M27:
-        case GcodeType::M28:
-        case GcodeType::M29:
-          valid = gcodeParser.parseSDCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M105:
-        case GcodeType::M114:
-        case GcodeType::M115:
-          valid = gcodeParser.parseReportingCommand(params, cmd, static_cast<GcodeType>(cmd.code));
-          break;
-        case GcodeType::M112:
-          valid = gcodeParser.parseEmergencyCommand(params, cmd);
-          break;
-        default:
-          DEBUG_PRINTF_AUTO("Erreur: Code %c%d non supporté", cmd.type, raw_code);
-          if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-          Serial.println("ERROR: Unsupported command");
-          continue;
+    // Une fusion en attente n'attend pas indéfiniment la ligne suivante (fin de job, pause)
+    TickType_t wait = motionOptimizer.hasPending() ? pdMS_TO_TICKS(OPTIMIZER_IDLE_FLUSH_MS) : portMAX_DELAY;
+    if (!gcodeScheduler.next(line, stream, wait)) {
+      if (faultBus.isHalted()) {
+        motionOptimizer.discard();
+      } else {
+        motionOptimizer.flush();
       }
+      continue;
+    }
+    DEBUG_TRACEF_AUTO("Parsing ligne: '%s'", line);
+    if (faultBus.isHalted()) {
+      DEBUG_TRACEF_AUTO("Ligne ignorée, arrêt d'urgence en cours: '%s'", line);
+      motionOptimizer.discard();
+      continue;
+    }
+    // Modes G90/G91 et M82/M83 propres au flux d'origine de la ligne
+    GcodeParser &parser = gcodeScheduler.context(stream);
+    MotionCommand cmd;
+    TRACE_BEGIN(PARSER_PARSE);
+    ParseResult result = parser.parseLine(line, cmd);
+    TRACE_END(PARSER_PARSE);
+    if (result == ParseResult::INVALID_TYPE) {
+      DEBUG_ERRORF_AUTO("Erreur: Type de commande inconnu '%s'", line);
+      faultBus.raise(FaultCode::PARSE_INVALID_TYPE, FaultSource::PARSER);
+      Serial.println("ERROR: Invalid command type");
+      continue;
+    }
+    if (result == ParseResult::UNSUPPORTED) {
+      DEBUG_ERRORF_AUTO("Erreur: Code %c%d non supporté", cmd.type, rawCode(cmd));
+      faultBus.raise(FaultCode::PARSE_UNSUPPORTED, FaultSource::PARSER, rawCode(cmd));
+      Serial.println("ERROR: Unsupported command");
+      continue;
+    }
 
-      if (valid) {
-        if (xQueueSend(motionQueue, &cmd, pdMS_TO_TICKS(5000)) != pdTRUE) {
-          DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à motionQueue après 5s");
-          if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-          Serial.println("ERROR: Failed to send to motionQueue");
-        } else {
-          DEBUG_PRINTF_AUTO("Commande envoyée à motionQueue: %c%d", cmd.type, raw_code);
-        }
+    if (result == ParseResult::OK) {
+      if (cmd.code == static_cast<int>(GcodeType::M112)) {
+        faultBus.emergencyStop(FaultSource::PARSER, (uint32_t)esp_timer_get_time());
+      } else if (isReportingCommand(cmd)) {
+        // Les rapports ne passent pas par motionQueue : réponse immédiate
+        reportManager.handleCommand(cmd);
+      } else if (GcodeScheduler::isStreamControl(cmd)) {
+        // M25 dans le fichier : les lignes SD suivantes attendent M24
+        gcodeScheduler.control(cmd);
       } else {
-        DEBUG_PRINTF_AUTO("Erreur: Commande invalide '%s'", line.c_str());
-        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-        Serial.println("ERROR: Invalid command");
+        // Position commandée suivie dès le parsing : l'optimiseur en a besoin avant d'émettre
+        float start[4];
+        memcpy(start, parser.currentPosition(), sizeof(start));
+        parser.applyToState(cmd);
+        if (motionOptimizer.push(cmd, start, parser.currentPosition(), parser.absolutePositioning(),
+                                 parser.absoluteExtrusion())) {
+          DEBUG_TRACEF_AUTO("Commande transmise: %c%d", cmd.type, rawCode(cmd));
+        }
       }
+    } else {
+      DEBUG_ERRORF_AUTO("Erreur: Commande invalide '%s'", line);
+      faultBus.raise(FaultCode::PARSE_INVALID, FaultSource::PARSER);
+      Serial.println("ERROR: Invalid command");
     }
     vTaskDelay(pdMS_TO_TICKS(10));
   }
 }
+
+bool GcodeParser::enqueueMotion(const MotionCommand &cmd) {
+  TRACE_BEGIN(PARSER_ENQUEUE);
+  BaseType_t sent = xQueueSend(motionQueue, &cmd, pdMS_TO_TICKS(5000));
+  TRACE_END(PARSER_ENQUEUE);
+  TRACE_COUNTER(MOTION_QUEUE_DEPTH, uxQueueMessagesWaiting(motionQueue));
+  healthMonitor.noteQueue(motionQueue);
+  return sent == pdTRUE;
+}
+
+bool GcodeParser::emitMotion(const MotionCommand &cmd, void *context) {
+  if (enqueueMotion(cmd)) return true;
+  DEBUG_ERRORF_AUTO("Erreur: Impossible d'envoyer à motionQueue après 5s");
+  faultBus.raise(FaultCode::QUEUE_FULL, FaultSource::PARSER, uxQueueMessagesWaiting(motionQueue));
+  Serial.println("ERROR: Failed to send to motionQueue");
+  return false;
+}
+
+bool GcodeParser::isReportingCommand(const MotionCommand &cmd) {
+  switch (static_cast<GcodeType>(cmd.code)) {
+    case GcodeType::M105:
+    case GcodeType::M114:
+    case GcodeType::M115:
+    case GcodeType::M155:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static int32_t toMicrons(float mm) {
+  return (int32_t)lroundf(mm * 1000.0f);
+}
+
+static int16_t toCentiDegrees(float deg) {
+  return (int16_t)lroundf(deg * 100.0f);
+}
+
+bool GcodeParser::trackPosition(const MotionCommand &cmd) {
+  if (cmd.type != 'G') return false;
+  float *axes[4] = { &position[AXIS_X], &position[AXIS_Y], &position[AXIS_Z], &position[AXIS_E] };
+  const float values[4] = { cmd.x, cmd.y, cmd.z, cmd.e };
+  const bool present[4] = { cmd.has_x, cmd.has_y, cmd.has_z, cmd.has_e };
+  switch (static_cast<GcodeType>(cmd.code)) {
+    case GcodeType::G0:
+    case GcodeType::G1:
+    case GcodeType::G2:
+    case GcodeType::G3:
+      for (int i = 0; i < 4; i++) {
+        if (!present[i]) continue;
+        bool absolute = (i == AXIS_E) ? absolute_extrusion : absolute_positioning;
+        *axes[i] = absolute ? values[i] : *axes[i] + values[i];
+      }
+      return true;
+    case GcodeType::G92:
+      for (int i = 0; i < 4; i++) {
+        if (present[i]) *axes[i] = values[i];
+      }
+      return true;
+    case GcodeType::G28:
+      for (int i = 0; i < 3; i++) {
+        if (present[i]) *axes[i] = 0.0f;
+      }
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Chauffe, ventilation et commentaires ne changent pas la position : ni parsing ni String
+char *GcodeParser::trackedStatement(char *line) {
+  char *p = line;
+  while (*p == ' ' || *p == '\t') p++;
+  bool extrusionMode = p[0] == 'M' && p[1] == '8' && (p[2] == '2' || p[2] == '3') && !(p[3] >= '0' && p[3] <= '9');
+  if (*p != 'G' && !extrusionMode) return nullptr;
+  char *end = strchr(p, ';');
+  if (!end) end = p + strlen(p);
+  while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) end--;
+  *end = '\0';
+  return p;
+}
+
+char *GcodeParser::trimLine(char *line) {
+  while (isBlank(*line)) line++;
+  char *end = line + strlen(line);
+  while (end > line && isBlank(end[-1])) end--;
+  *end = '\0';
+  return line;
+}
+
+char *GcodeParser::stripComment(char *line) {
+  char *comment = strchr(line, ';');
+  if (comment) *comment = '\0';
+  return trimLine(line);
+}
+
+void GcodeParser::applyToState(const MotionCommand &cmd) {
+  switch (static_cast<GcodeType>(cmd.code)) {
+    case GcodeType::M104:
+    case GcodeType::M109:
+      machineState.setHotendTarget(toCentiDegrees(cmd.s));
+      return;
+    case GcodeType::M140:
+    case GcodeType::M190:
+      machineState.setBedTarget(toCentiDegrees(cmd.s));
+      return;
+    default:
+      if (!trackPosition(cmd)) return;
+      break;
+  }
+  int32_t pos_um[4];
+  for (int i = 0; i < 4; i++) pos_um[i] = toMicrons(position[i]);
+  machineState.setPosition(pos_um);
+}
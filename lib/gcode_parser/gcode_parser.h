@@ -11,6 +11,8 @@ struct MotionCommand {
   int code;  // ex. 1 pour G1, 1004 pour M104
   float x, y, z, e, f, s; // Paramètres : X, Y, Z, E, F (vitesse), S (température/vitesse ventilateur)
   bool has_x, has_y, has_z, has_e, has_f, has_s; // Indicateurs de présence
+  float i, j;    // Centre d'un arc G2/G3, relatif au point de départ (mm)
+  bool has_i, has_j;
 };
 
 // Énumération des codes de commande supportés pour une impression 3D complète
@@ -41,6 +43,7 @@ enum class GcodeType {
   M112 = 1112,
   M114 = 1114,
   M115 = 1115,
+  M155 = 1155,
   M140 = 1140,
   M190 = 1190,
   M20 = 1020,
@@ -56,32 +59,68 @@ enum class GcodeType {
 };
 
 class GcodeParser {
+public:
+  enum class ParseResult { OK, INVALID_TYPE, UNSUPPORTED, INVALID };
+
 private:
   bool absolute_positioning; // G90 (true) ou G91 (false)
   bool absolute_extrusion;  // M82 (true) ou M83 (false)
-  bool parseParameters(String params, MotionCommand &cmd);
-  bool parseLinearMovementCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseArcMovementCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseSetPositionCommand(String params, MotionCommand &cmd);
-  bool parseHomingCommand(String params, MotionCommand &cmd);
-  bool parseLevelingCommand(String params, MotionCommand &cmd);
-  bool parsePositioningCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseTemperatureCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseFanCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseExtruderCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseMotorsCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseSDCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseReportingCommand(String params, MotionCommand &cmd, GcodeType code);
-  bool parseEmergencyCommand(String params, MotionCommand &cmd);
+  float position[4];        // Position commandée X, Y, Z, E (mm)
+  bool parseParameters(const char *params, MotionCommand &cmd);
+  bool parseLinearMovementCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseArcMovementCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseSetPositionCommand(const char *params, MotionCommand &cmd);
+  bool parseHomingCommand(const char *params, MotionCommand &cmd);
+  bool parseLevelingCommand(const char *params, MotionCommand &cmd);
+  bool parsePositioningCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseTemperatureCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseFanCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseExtruderCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseMotorsCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseSDCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseReportingCommand(const char *params, MotionCommand &cmd, GcodeType code);
+  bool parseEmergencyCommand(const char *params, MotionCommand &cmd);
+  static bool enqueueMotion(const MotionCommand &cmd);
+  // Sortie de MotionOptimizer vers motionQueue
+  static bool emitMotion(const MotionCommand &cmd, void *context);
 
 public:
-  GcodeParser() : absolute_positioning(true), absolute_extrusion(true) {}
+  GcodeParser() : absolute_positioning(true), absolute_extrusion(true), position{0.0f, 0.0f, 0.0f, 0.0f} {}
   void init();
-  void testParse(String cmd);
+  void testParse(const char *cmd);
+  // Parse une ligne sans commentaire ; le mode G90/G91 et M82/M83 est mis à jour.
+  // Aucune allocation : la même fonction sert au flux d'impression et à l'estimation.
+  ParseResult parseLine(const char *line, MotionCommand &cmd);
+  ParseResult parseLine(const String &line, MotionCommand &cmd) { return parseLine(line.c_str(), cmd); }
+  // Même vérification que parseLine sur un contexte jetable : aucun mode ni position
+  // modifié (voie immédiate de la console, avant que le flux HOST applique la ligne)
+  static ParseResult checkSyntax(const char *line, MotionCommand &cmd);
+  // Suit la position et les consignes commandées dans machineState
+  void applyToState(const MotionCommand &cmd);
+  // Position commandée seule, sans publication (aperçu, estimation) ; false si inchangée
+  bool trackPosition(const MotionCommand &cmd);
+  const float *currentPosition() const { return position; }
+  // Position reprise d'un autre contexte (GcodeScheduler, au changement de flux)
+  void setPosition(const float pos[4]) { memcpy(position, pos, sizeof(position)); }
+  // G90 et M82, comme au démarrage
+  void resetModes() {
+    absolute_positioning = true;
+    absolute_extrusion = true;
+  }
+  bool absolutePositioning() const { return absolute_positioning; }
+  bool absoluteExtrusion() const { return absolute_extrusion; }
+  // Instruction d'une ligne de job utile au suivi de position (G-code, M82/M83), sans
+  // commentaire ni blancs de fin ; nullptr pour tout le reste, écarté sans parser
+  static char *trackedStatement(char *line);
+  // Blancs de bord retirés sur place, comme String::trim()
+  static char *trimLine(char *line);
+  // Commentaire ';' coupé puis blancs de bord retirés : chaîne vide s'il ne reste rien
+  static char *stripComment(char *line);
+  static bool isReportingCommand(const MotionCommand &cmd);
+  static int rawCode(const MotionCommand &cmd) { return cmd.type == 'M' ? cmd.code - 1000 : cmd.code; }
   static void parserTask(void *pvParameters);
 };
 
 extern GcodeParser gcodeParser;
 extern QueueHandle_t gcodeQueue;
 extern QueueHandle_t motionQueue;
-extern SemaphoreHandle_t errorSemaphore;
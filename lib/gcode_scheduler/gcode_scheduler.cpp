@@ -0,0 +1,147 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_PARSER
+#include "gcode_scheduler.h"
+#include "heap_guard.h"
+#include "health_monitor.h"
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+GcodeScheduler gcodeScheduler;
+
+static const char *const streamNames[GCODE_STREAMS] = { "host", "ui", "sd" };
+
+GcodeScheduler::GcodeScheduler()
+    : queues(), stats(), last(GcodeStream::SD), paused(false), resetPending(false), pauses(0), preemptions(0),
+      consumer(nullptr) {}
+
+bool GcodeScheduler::init() {
+  queues[(int)GcodeStream::HOST] = heapGuard.createQueue(SCHED_HOST_QUEUE_LEN, GCODE_LINE_MAX);
+  queues[(int)GcodeStream::UI] = heapGuard.createQueue(SCHED_UI_QUEUE_LEN, GCODE_LINE_MAX);
+  queues[(int)GcodeStream::SD] = gcodeQueue;
+  for (int i = 0; i < GCODE_STREAMS; i++) {
+    if (!queues[i]) return false;
+  }
+  healthMonitor.watchQueue(queues[(int)GcodeStream::HOST], "hostQueue", SCHED_HOST_QUEUE_LEN);
+  healthMonitor.watchQueue(queues[(int)GcodeStream::UI], "uiQueue", SCHED_UI_QUEUE_LEN);
+  return true;
+}
+
+void GcodeScheduler::wake() {
+  if (consumer) xTaskNotifyGive(consumer);
+}
+
+bool GcodeScheduler::submit(GcodeStream stream, const char *line, TickType_t wait) {
+  QueueHandle_t queue = queues[(int)stream];
+  GcodeStreamStats &s = stats[(int)stream];
+  if (!queue || xQueueSend(queue, line, wait) != pdTRUE) {
+    s.full++;
+    return false;
+  }
+  uint32_t depth = uxQueueMessagesWaiting(queue);
+  if (depth > s.maxDepth) s.maxDepth = depth;
+  TRACE_COUNTER(GCODE_QUEUE_DEPTH, pending());
+  healthMonitor.noteQueue(queue);
+  wake();
+  return true;
+}
+
+bool GcodeScheduler::next(char *line, GcodeStream &stream, TickType_t wait) {
+  if (!consumer) consumer = xTaskGetCurrentTaskHandle();
+  while (1) {
+    for (int i = 0; i < GCODE_STREAMS; i++) {
+      if (i == (int)GcodeStream::SD && paused) continue;
+      if (xQueueReceive(queues[i], line, 0) != pdTRUE) continue;
+      stream = (GcodeStream)i;
+      stats[i].lines++;
+      // Première ligne d'un nouveau job : G90/M82 appliqués ici, ParserTask étant seul à
+      // se servir du contexte
+      if (stream == GcodeStream::SD && resetPending.exchange(false)) contexts[i].resetModes();
+      if (stream != GcodeStream::SD && !paused && uxQueueMessagesWaiting(queues[(int)GcodeStream::SD]) > 0) {
+        preemptions++;
+      }
+      if (stream != last) {
+        // Même machine : le nouveau flux part de la position laissée par le précédent
+        contexts[i].setPosition(contexts[(int)last].currentPosition());
+        last = stream;
+      }
+      return true;
+    }
+    // Chaque envoi et chaque reprise notifient : rien n'est perdu entre le tour et l'attente
+    if (ulTaskNotifyTake(pdTRUE, wait) == 0) return false;
+  }
+}
+
+bool GcodeScheduler::isStreamControl(const MotionCommand &cmd) {
+  return cmd.type == 'M' &&
+         (cmd.code == static_cast<int>(GcodeType::M24) || cmd.code == static_cast<int>(GcodeType::M25));
+}
+
+void GcodeScheduler::control(const MotionCommand &cmd) {
+  if (cmd.code == static_cast<int>(GcodeType::M25)) {
+    pause();
+  } else {
+    resume();
+  }
+}
+
+void GcodeScheduler::pause() {
+  if (paused) return;
+  paused = true;
+  pauses++;
+  DEBUG_PRINTF_AUTO("Flux SD en pause, %u lignes en attente", (unsigned)uxQueueMessagesWaiting(gcodeQueue));
+}
+
+void GcodeScheduler::resume() {
+  if (!paused) return;
+  paused = false;
+  DEBUG_PRINTF_AUTO("Reprise du flux SD");
+  wake();
+}
+
+bool GcodeScheduler::waitWhilePaused() {
+  while (paused && !faultBus.isHalted()) vTaskDelay(pdMS_TO_TICKS(SCHED_PAUSE_POLL_MS));
+  return !faultBus.isHalted();
+}
+
+void GcodeScheduler::beginJob() {
+  // Lignes restantes d'un job précédent écartées ; le nouveau part en G90/M82, remis par
+  // ParserTask avant sa première ligne
+  xQueueReset(queues[(int)GcodeStream::SD]);
+  resetPending = true;
+  paused = false;
+}
+
+void GcodeScheduler::discardAll() {
+  for (int i = 0; i < GCODE_STREAMS; i++) {
+    if (queues[i]) xQueueReset(queues[i]);
+  }
+  // SDTask ne doit pas rester suspendu sur un job abandonné
+  paused = false;
+}
+
+uint32_t GcodeScheduler::pending() const {
+  uint32_t n = 0;
+  for (int i = 0; i < GCODE_STREAMS; i++) {
+    if (queues[i]) n += uxQueueMessagesWaiting(queues[i]);
+  }
+  return n;
+}
+
+void GcodeScheduler::resetStats() {
+  memset(stats, 0, sizeof(stats));
+  pauses = 0;
+  preemptions = 0;
+}
+
+void GcodeScheduler::printReport() {
+  for (int i = 0; i < GCODE_STREAMS; i++) {
+    const GcodeStreamStats &s = stats[i];
+    reportLine("SCHED stream=%s depth=%u lines=%lu full=%lu max_depth=%lu\n", streamNames[i],
+               queues[i] ? (unsigned)uxQueueMessagesWaiting(queues[i]) : 0, (unsigned long)s.lines,
+               (unsigned long)s.full, (unsigned long)s.maxDepth);
+  }
+  reportLine("SCHED paused=%d pauses=%lu preemptions=%lu\n", paused ? 1 : 0, (unsigned long)pauses,
+             (unsigned long)preemptions);
+  Serial.println("OK");
+}
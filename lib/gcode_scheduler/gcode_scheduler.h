@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "../config.h"
+#include "gcode_parser.h"
+
+// Flux G-code concurrents vers l'unique ParserTask. Chaque source a sa file et son
+// contexte de parsing (G90/G91, M82/M83) : un G91 envoyé par l'hôte pendant l'impression
+// ne change plus le mode du fichier. La position commandée reste celle de la machine :
+// le contexte servi la reprend de celui servi juste avant.
+//  - HOST : lignes G/M de la liaison série, servies en premier
+//  - UI   : commandes de l'écran
+//  - SD   : job en cours (gcodeQueue), servi quand les deux autres files sont vides,
+//           suspendu par M25 jusqu'à M24
+// Voie immédiate : les rapports (M105, M114, M115, M155) et M24/M25 sont exécutés par
+// l'émetteur, sans attendre les lignes ni les mouvements déjà en file.
+
+enum class GcodeStream : uint8_t { HOST = 0, UI, SD };
+static const int GCODE_STREAMS = 3;
+
+struct GcodeStreamStats {
+  uint32_t lines;           // Lignes passées au parser
+  uint32_t full;            // Envois refusés faute de place dans le délai demandé
+  uint32_t maxDepth;        // Plus haut remplissage de la file observé à l'envoi
+};
+
+class GcodeScheduler {
+public:
+  GcodeScheduler();
+  // Files HOST et UI ; celle du flux SD est gcodeQueue, créée avant
+  bool init();
+  // Ligne sans commentaire vers la file du flux ; false si elle n'y entre pas dans wait
+  bool submit(GcodeStream stream, const char *line, TickType_t wait);
+  // ParserTask : ligne suivante par ordre de priorité, le flux SD étant ignoré pendant une
+  // pause ; false si rien n'arrive dans wait
+  bool next(char *line, GcodeStream &stream, TickType_t wait);
+  GcodeParser &context(GcodeStream stream) { return contexts[(int)stream]; }
+
+  // M24 / M25 : reprise et pause du flux SD
+  static bool isStreamControl(const MotionCommand &cmd);
+  void control(const MotionCommand &cmd);
+  void pause();
+  void resume();
+  bool isPaused() const { return paused; }
+  // SDTask : attend la reprise avant la ligne suivante ; false sur arrêt d'urgence
+  bool waitWhilePaused();
+  // Début d'un job : file SD vidée, pause levée ; le contexte SD repasse en G90/M82 à la
+  // première ligne du job servie par next()
+  void beginJob();
+  // Défaut, CLEAR_GCODE : lignes de tous les flux écartées
+  void discardAll();
+  // Lignes en attente, tous flux confondus
+  uint32_t pending() const;
+
+  void resetStats();
+  void printReport();
+
+private:
+  QueueHandle_t queues[GCODE_STREAMS];
+  GcodeParser contexts[GCODE_STREAMS];
+  GcodeStreamStats stats[GCODE_STREAMS];
+  GcodeStream last;         // Flux de la dernière ligne servie (ParserTask seul)
+  volatile bool paused;
+  std::atomic<bool> resetPending; // beginJob() → next() : modes SD à remettre à zéro
+  uint32_t pauses;
+  uint32_t preemptions;     // Lignes HOST/UI servies avant des lignes SD en attente
+  TaskHandle_t consumer;    // ParserTask, réveillé à chaque ligne et à la reprise
+
+  void wake();
+};
+
+extern GcodeScheduler gcodeScheduler;
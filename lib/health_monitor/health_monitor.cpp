@@ -0,0 +1,193 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "health_monitor.h"
+#include "fault_bus.h"
+#include "heap_guard.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <esp_heap_caps.h>
+
+HealthMonitor healthMonitor;
+
+HealthMonitor::HealthMonitor() : tasks(), taskCount(0), queues(), queueCount(0), heap(), heapAlerted(false),
+  lastTotalRunTime(0), lastRunTime(), mux(portMUX_INITIALIZER_UNLOCKED) {}
+
+HealthTaskInfo *HealthMonitor::findTask(TaskHandle_t handle) {
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (tasks[i].handle == handle) return &tasks[i];
+  }
+  return nullptr;
+}
+
+// Appelé sous mux
+HealthTaskInfo *HealthMonitor::addTask(TaskHandle_t handle) {
+  HealthTaskInfo *info = findTask(handle);
+  if (info || taskCount >= HEALTH_MAX_TASKS) return info;
+  info = &tasks[taskCount];
+  memset(info, 0, sizeof(*info));
+  info->handle = handle;
+  info->stackMinFree = UINT32_MAX;
+  info->seen = true;
+  strncpy(info->name, pcTaskGetName(handle), sizeof(info->name) - 1);
+  lastRunTime[taskCount] = 0;
+  taskCount++;
+  return info;
+}
+
+void HealthMonitor::watchTask(TaskHandle_t handle, uint32_t stackSize) {
+  if (!handle) return;
+  portENTER_CRITICAL(&mux);
+  HealthTaskInfo *info = addTask(handle);
+  if (info) info->stackSize = stackSize;
+  portEXIT_CRITICAL(&mux);
+}
+
+void HealthMonitor::watchQueue(QueueHandle_t handle, const char *name, uint16_t length) {
+  if (!handle || queueCount >= HEALTH_MAX_QUEUES) return;
+  HealthQueueInfo &q = queues[queueCount];
+  q.handle = handle;
+  q.name = name;
+  q.length = length;
+  q.maxDepth = 0;
+  q.alerted = false;
+  queueCount++;
+}
+
+void HealthMonitor::noteQueue(QueueHandle_t handle) {
+  for (uint8_t i = 0; i < queueCount; i++) {
+    if (queues[i].handle != handle) continue;
+    uint16_t depth = (uint16_t)uxQueueMessagesWaiting(handle);
+    // Course bénigne entre producteurs : au pire un pic sous-estimé d'un élément
+    if (depth > queues[i].maxDepth) queues[i].maxDepth = depth;
+    return;
+  }
+}
+
+// Toutes les tâches du système, déclarées ou non : une tâche de bibliothèque à court de
+// pile se voit aussi. La charge vient des compteurs de temps d'exécution FreeRTOS.
+void HealthMonitor::sampleTasks() {
+  static TaskStatus_t status[HEALTH_MAX_TASKS];
+  uint32_t totalRunTime = 0;
+  UBaseType_t n = uxTaskGetSystemState(status, HEALTH_MAX_TASKS, &totalRunTime);
+  if (n == 0) {
+    DEBUG_ERRORF_AUTO("Erreur: %u tâches pour %u places, HEALTH_MAX_TASKS à augmenter",
+                      (unsigned)uxTaskGetNumberOfTasks(), (unsigned)HEALTH_MAX_TASKS);
+    return;
+  }
+  portENTER_CRITICAL(&mux);
+  for (uint8_t i = 0; i < taskCount; i++) tasks[i].seen = false;
+  portEXIT_CRITICAL(&mux);
+  for (UBaseType_t i = 0; i < n; i++) {
+    uint32_t freeBytes = status[i].usStackHighWaterMark;   // Octets sur ESP-IDF
+    portENTER_CRITICAL(&mux);
+    HealthTaskInfo *info = addTask(status[i].xHandle);
+    if (!info) {
+      portEXIT_CRITICAL(&mux);
+      continue;
+    }
+    info->seen = true;
+    if (freeBytes < info->stackMinFree) info->stackMinFree = freeBytes;
+#if configGENERATE_RUN_TIME_STATS
+    size_t idx = info - tasks;
+    uint32_t elapsed = (totalRunTime - lastTotalRunTime) * portNUM_PROCESSORS;
+    uint32_t ran = status[i].ulRunTimeCounter - lastRunTime[idx];
+    info->cpuPermille = elapsed ? (uint16_t)((uint64_t)ran * 1000 / elapsed) : 0;
+    lastRunTime[idx] = status[i].ulRunTimeCounter;
+#endif
+    info->core = status[i].xCoreID == tskNO_AFFINITY ? -1 : (int8_t)status[i].xCoreID;
+    portEXIT_CRITICAL(&mux);
+    if (freeBytes < HEALTH_STACK_MIN_FREE && !info->alerted) {
+      info->alerted = true;
+      DEBUG_ERRORF_AUTO("Erreur: Pile de %s presque pleine (%lu octets libres)", info->name, (unsigned long)freeBytes);
+      faultBus.raise(FaultCode::STACK_LOW, FaultSource::HEALTH, (int32_t)freeBytes);
+    }
+  }
+  lastTotalRunTime = totalRunTime;
+  // Tâches terminées (étapes de démarrage, animation LED) : leur place est libérée
+  portENTER_CRITICAL(&mux);
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < taskCount; i++) {
+    if (!tasks[i].seen) continue;
+    tasks[kept] = tasks[i];
+    lastRunTime[kept] = lastRunTime[i];
+    kept++;
+  }
+  taskCount = kept;
+  portEXIT_CRITICAL(&mux);
+}
+
+void HealthMonitor::sampleHeap() {
+  const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  HealthHeapInfo h;
+  h.freeBytes = heap_caps_get_free_size(caps);
+  h.minFreeBytes = heap_caps_get_minimum_free_size(caps);
+  h.largestBlock = heap_caps_get_largest_free_block(caps);
+  h.fragmentationPct = h.freeBytes ? (uint8_t)(100 - (uint64_t)h.largestBlock * 100 / h.freeBytes) : 0;
+  h.psramFree = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+  portENTER_CRITICAL(&mux);
+  heap = h;
+  portEXIT_CRITICAL(&mux);
+  if (h.minFreeBytes < HEALTH_HEAP_MIN_FREE && !heapAlerted) {
+    heapAlerted = true;
+    DEBUG_ERRORF_AUTO("Erreur: Tas interne bas (minimum %lu octets)", (unsigned long)h.minFreeBytes);
+    faultBus.raise(FaultCode::HEAP_LOW, FaultSource::HEALTH, (int32_t)h.minFreeBytes);
+  }
+  heapGuard.check();
+}
+
+void HealthMonitor::sampleQueues() {
+  for (uint8_t i = 0; i < queueCount; i++) {
+    HealthQueueInfo &q = queues[i];
+    noteQueue(q.handle);
+    // Une file qui a été pleine a bloqué son producteur : signalé une fois
+    if (q.maxDepth >= q.length && !q.alerted) {
+      q.alerted = true;
+      DEBUG_PRINTF_AUTO("%s a atteint sa capacité (%u)", q.name, (unsigned)q.length);
+      faultBus.raise(FaultCode::QUEUE_SATURATED, FaultSource::HEALTH, q.length);
+    }
+  }
+}
+
+void HealthMonitor::sample() {
+  sampleTasks();
+  sampleHeap();
+  sampleQueues();
+}
+
+void HealthMonitor::healthTask(void *pvParameters) {
+  TickType_t lastWake = xTaskGetTickCount();
+  while (1) {
+    healthMonitor.sample();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(HEALTH_SAMPLE_MS));
+  }
+}
+
+void HealthMonitor::printReport() {
+  HealthHeapInfo h;
+  portENTER_CRITICAL(&mux);
+  h = heap;
+  portEXIT_CRITICAL(&mux);
+  reportLine("HEALTH uptime_ms=%lu heap_free=%lu heap_min=%lu heap_largest=%lu frag_pct=%u psram_free=%lu\n",
+             millis(), (unsigned long)h.freeBytes, (unsigned long)h.minFreeBytes, (unsigned long)h.largestBlock,
+             (unsigned)h.fragmentationPct, (unsigned long)h.psramFree);
+  for (uint8_t i = 0; i < taskCount; i++) {
+    HealthTaskInfo t;
+    portENTER_CRITICAL(&mux);
+    t = tasks[i];
+    portEXIT_CRITICAL(&mux);
+    if (t.stackMinFree == UINT32_MAX) continue;   // Pas encore échantillonnée
+#if configGENERATE_RUN_TIME_STATS
+    reportLine("TASK %-14s core=%d stack=%lu min_free=%lu cpu=%u.%u%%\n", t.name, t.core,
+               (unsigned long)t.stackSize, (unsigned long)t.stackMinFree, t.cpuPermille / 10, t.cpuPermille % 10);
+#else
+    // Sans compteurs de temps d'exécution, la charge est inconnue plutôt que nulle
+    reportLine("TASK %-14s core=%d stack=%lu min_free=%lu cpu=n/a\n", t.name, t.core,
+               (unsigned long)t.stackSize, (unsigned long)t.stackMinFree);
+#endif
+  }
+  for (uint8_t i = 0; i < queueCount; i++) {
+    const HealthQueueInfo &q = queues[i];
+    reportLine("QUEUE %-12s len=%u depth=%u max=%u\n", q.name, (unsigned)q.length,
+               (unsigned)uxQueueMessagesWaiting(q.handle), (unsigned)q.maxDepth);
+  }
+  Serial.println("OK");
+}
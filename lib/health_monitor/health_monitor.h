@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include "../config.h"
+
+// Surveillance périodique des tâches (marge de pile, charge CPU), du tas et des files.
+// Les seuils franchis deviennent des événements du bus de défauts ; HEALTH affiche le tout.
+struct HealthTaskInfo {
+  TaskHandle_t handle;
+  char name[16];
+  uint32_t stackSize;       // Octets alloués, 0 si la tâche n'a pas été déclarée
+  uint32_t stackMinFree;    // Plus petite marge observée, en octets
+  uint16_t cpuPermille;     // Sur la dernière période, tous cœurs confondus
+  int8_t core;
+  bool alerted;
+  bool seen;                // Présente au dernier échantillon, sinon supprimée
+};
+
+struct HealthQueueInfo {
+  QueueHandle_t handle;
+  const char *name;
+  uint16_t length;
+  uint16_t maxDepth;        // Plus haut niveau vu par les producteurs ou l'échantillonnage
+  bool alerted;
+};
+
+struct HealthHeapInfo {
+  uint32_t freeBytes;
+  uint32_t minFreeBytes;    // Minimum depuis le démarrage (heap_caps)
+  uint32_t largestBlock;
+  uint8_t fragmentationPct; // 100 - plus grand bloc / libre
+  uint32_t psramFree;
+};
+
+class HealthMonitor {
+private:
+  HealthTaskInfo tasks[HEALTH_MAX_TASKS];
+  uint8_t taskCount;
+  HealthQueueInfo queues[HEALTH_MAX_QUEUES];
+  uint8_t queueCount;
+  HealthHeapInfo heap;
+  bool heapAlerted;
+  uint32_t lastTotalRunTime;
+  uint32_t lastRunTime[HEALTH_MAX_TASKS];
+  portMUX_TYPE mux;
+
+  HealthTaskInfo *findTask(TaskHandle_t handle);
+  HealthTaskInfo *addTask(TaskHandle_t handle);
+  void sampleTasks();
+  void sampleHeap();
+  void sampleQueues();
+
+public:
+  HealthMonitor();
+  // Taille de pile déclarée à la création, pour afficher la marge en proportion
+  void watchTask(TaskHandle_t handle, uint32_t stackSize);
+  void watchQueue(QueueHandle_t handle, const char *name, uint16_t length);
+  // Appelé par les producteurs juste après un envoi : capture les pics entre deux échantillons
+  void noteQueue(QueueHandle_t handle);
+  void sample();
+  void printReport();
+  static void healthTask(void *pvParameters);
+};
+
+extern HealthMonitor healthMonitor;
@@ -0,0 +1,219 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "heap_guard.h"
+#include "fault_bus.h"
+#include <esp_heap_caps.h>
+#include <string.h>
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+HeapGuard heapGuard;
+
+HeapGuard::HeapGuard() : arenaUsed(0), mux(portMUX_INITIALIZER_UNLOCKED), locked(false), freeAtLock(0),
+  allocations(0), bytes(0), largest(0), checked(0), recent() {}
+
+#if STATIC_ALLOCATION
+#if defined(ARDUINO)
+// Enveloppes de l'éditeur de liens (-Wl,--wrap=..., environnements *_static) : les appels
+// du firmware, du cœur Arduino et d'ESP-IDF passent par ici avant l'allocateur. pvPortMalloc
+// appelle heap_caps_malloc, malloc et _malloc_r appellent heap_caps_malloc_default : aucune
+// allocation n'est comptée deux fois.
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+void *__real__malloc_r(struct _reent *r, size_t size);
+void *__real__calloc_r(struct _reent *r, size_t n, size_t size);
+void *__real__realloc_r(struct _reent *r, void *p, size_t size);
+void *__real_heap_caps_malloc(size_t size, uint32_t caps);
+void *__real_heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *__real_heap_caps_realloc(void *p, size_t size, uint32_t caps);
+
+void *__wrap_malloc(size_t size) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  heapGuard.noteAllocation(n * size, __builtin_return_address(0));
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real_realloc(p, size);
+}
+
+void *__wrap__malloc_r(struct _reent *r, size_t size) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real__malloc_r(r, size);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t n, size_t size) {
+  heapGuard.noteAllocation(n * size, __builtin_return_address(0));
+  return __real__calloc_r(r, n, size);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *p, size_t size) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real__realloc_r(r, p, size);
+}
+
+void *__wrap_heap_caps_malloc(size_t size, uint32_t caps) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real_heap_caps_malloc(size, caps);
+}
+
+void *__wrap_heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  heapGuard.noteAllocation(n * size, __builtin_return_address(0));
+  return __real_heap_caps_calloc(n, size, caps);
+}
+
+void *__wrap_heap_caps_realloc(void *p, size_t size, uint32_t caps) {
+  heapGuard.noteAllocation(size, __builtin_return_address(0));
+  return __real_heap_caps_realloc(p, size, caps);
+}
+}
+#else
+// Hôte : le tas compté du shim (host_heap.cpp) appelle ce crochet pour les tâches
+static void hostAllocation(size_t size, void *caller) {
+  heapGuard.noteAllocation(size, caller);
+}
+#endif
+#endif
+
+// Bloc aligné pris dans l'arène, jamais rendu
+void *HeapGuard::reserve(size_t size) {
+#if STATIC_ALLOCATION
+  size = (size + 15) & ~(size_t)15;
+  void *p = nullptr;
+  portENTER_CRITICAL(&mux);
+  if (!isLocked() && arenaUsed + size <= sizeof(arena)) {
+    p = arena + arenaUsed;
+    arenaUsed += size;
+  }
+  portEXIT_CRITICAL(&mux);
+  if (!p) {
+    DEBUG_ERRORF_AUTO("Erreur: Arène statique %s (%u octets demandés, %u/%u utilisés)",
+                      isLocked() ? "verrouillée" : "pleine", (unsigned)size, (unsigned)arenaUsed,
+                      (unsigned)sizeof(arena));
+  }
+  return p;
+#else
+  return nullptr;
+#endif
+}
+
+QueueHandle_t HeapGuard::createQueue(UBaseType_t length, UBaseType_t itemSize) {
+#if STATIC_ALLOCATION
+  StaticQueue_t *buffer = (StaticQueue_t *)reserve(sizeof(StaticQueue_t));
+  uint8_t *storage = itemSize ? (uint8_t *)reserve((size_t)length * itemSize) : nullptr;
+  if (!buffer || (itemSize && !storage)) return nullptr;
+  return xQueueCreateStatic(length, itemSize, storage, buffer);
+#else
+  return xQueueCreate(length, itemSize);
+#endif
+}
+
+// stackSize en octets, comme xTaskCreatePinnedToCore d'ESP-IDF
+bool HeapGuard::createTask(TaskFunction_t fn, const char *name, uint32_t stackSize, void *param,
+                           UBaseType_t priority, TaskHandle_t *handle, BaseType_t core) {
+#if STATIC_ALLOCATION
+  StaticTask_t *buffer = (StaticTask_t *)reserve(sizeof(StaticTask_t));
+  StackType_t *stack = (StackType_t *)reserve(stackSize);
+  if (!buffer || !stack) return false;
+  TaskHandle_t created = xTaskCreateStaticPinnedToCore(fn, name, stackSize, param, priority, stack, buffer, core);
+  if (handle) *handle = created;
+  return created != nullptr;
+#else
+  return xTaskCreatePinnedToCore(fn, name, stackSize, param, priority, handle, core) == pdPASS;
+#endif
+}
+
+SemaphoreHandle_t HeapGuard::createRecursiveMutex() {
+#if STATIC_ALLOCATION
+  StaticSemaphore_t *buffer = (StaticSemaphore_t *)reserve(sizeof(StaticSemaphore_t));
+  return buffer ? xSemaphoreCreateRecursiveMutexStatic(buffer) : nullptr;
+#else
+  return xSemaphoreCreateRecursiveMutex();
+#endif
+}
+
+void HeapGuard::lock() {
+#if STATIC_ALLOCATION
+  if (isLocked()) return;
+  freeAtLock = heap_caps_get_free_size(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+#if !defined(ARDUINO)
+  hostSetAllocationHook(hostAllocation);
+#endif
+  locked.store(true, std::memory_order_release);
+  DEBUG_PRINTF_AUTO("Tas verrouillé : %lu octets libres, arène %u/%u octets", (unsigned long)freeAtLock,
+                    (unsigned)arenaUsed, (unsigned)sizeof(arena));
+#endif
+}
+
+void HeapGuard::noteAllocation(size_t size, void *caller) {
+  if (!locked.load(std::memory_order_acquire)) return;
+  uint32_t index = allocations.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add((uint32_t)size, std::memory_order_relaxed);
+  uint32_t big = largest.load(std::memory_order_relaxed);
+  while (size > big && !largest.compare_exchange_weak(big, (uint32_t)size, std::memory_order_relaxed)) {
+  }
+  // Diagnostic seulement : deux allocations simultanées peuvent se partager une entrée
+  HeapAllocation &slot = recent[index % HEAP_GUARD_RECENT];
+  slot.size = (uint32_t)size;
+  slot.caller = (uintptr_t)caller;
+  const char *name = pcTaskGetName(NULL);
+  strncpy(slot.task, name ? name : "?", sizeof(slot.task) - 1);
+  slot.task[sizeof(slot.task) - 1] = '\0';
+}
+
+void HeapGuard::check() {
+  uint32_t n = allocations.load(std::memory_order_relaxed);
+  if (n == checked) return;
+  uint32_t fresh = n - checked;
+  checked = n;
+  const HeapAllocation &last = recent[(n - 1) % HEAP_GUARD_RECENT];
+  DEBUG_ERRORF_AUTO("Erreur: %lu allocation(s) après verrouillage du tas, dernière %lu octets (%s, 0x%08lx)",
+                    (unsigned long)fresh, (unsigned long)last.size, last.task, (unsigned long)last.caller);
+  faultBus.raise(FaultCode::HEAP_AFTER_LOCK, FaultSource::HEALTH, (int32_t)fresh);
+}
+
+void HeapGuard::getStats(HeapGuardStats &out) const {
+  out.arenaUsed = (uint32_t)arenaUsed;
+#if STATIC_ALLOCATION
+  out.arenaSize = sizeof(arena);
+#else
+  out.arenaSize = 0;
+#endif
+  out.freeAtLock = freeAtLock;
+  out.allocations = allocations.load(std::memory_order_relaxed);
+  out.bytes = bytes.load(std::memory_order_relaxed);
+  out.largest = largest.load(std::memory_order_relaxed);
+  out.locked = isLocked();
+}
+
+void HeapGuard::resetStats() {
+  allocations.store(0, std::memory_order_relaxed);
+  bytes.store(0, std::memory_order_relaxed);
+  largest.store(0, std::memory_order_relaxed);
+  checked = 0;
+  memset(recent, 0, sizeof(recent));
+}
+
+void HeapGuard::printReport() {
+  HeapGuardStats s;
+  getStats(s);
+  const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  reportLine("HEAP static=%d locked=%d arena_used=%lu arena_size=%lu free_at_lock=%lu free=%lu min_free=%lu "
+             "allocs=%lu bytes=%lu largest=%lu\n",
+             STATIC_ALLOCATION, s.locked ? 1 : 0, (unsigned long)s.arenaUsed, (unsigned long)s.arenaSize,
+             (unsigned long)s.freeAtLock, (unsigned long)heap_caps_get_free_size(caps),
+             (unsigned long)heap_caps_get_minimum_free_size(caps), (unsigned long)s.allocations,
+             (unsigned long)s.bytes, (unsigned long)s.largest);
+  uint32_t shown = s.allocations < HEAP_GUARD_RECENT ? s.allocations : HEAP_GUARD_RECENT;
+  for (uint32_t k = 0; k < shown; k++) {
+    HeapAllocation a = recent[(s.allocations - shown + k) % HEAP_GUARD_RECENT];
+    reportLine("ALLOC size=%lu task=%s caller=0x%08lx\n", (unsigned long)a.size, a.task, (unsigned long)a.caller);
+  }
+  Serial.println("OK");
+}
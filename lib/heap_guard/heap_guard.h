@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include "../config.h"
+
+// Mode STATIC_ALLOCATION (config.h) : files, tâches et mutex du firmware pris dans une
+// arène statique (xQueueCreateStatic, xTaskCreateStaticPinnedToCore), puis tas verrouillé
+// par lock() à la fin du démarrage. Chaque allocation qui suit, faite depuis une tâche, est
+// comptée avec sa taille, sa tâche et son appelant ; HealthTask lève HEAP_AFTER_LOCK à
+// chaque période qui en a vu de nouvelles. HEAP affiche le bilan.
+// Sans le mode, les mêmes appels créent les objets sur le tas et rien n'est compté.
+
+struct HeapAllocation {
+  uint32_t size;
+  uintptr_t caller;         // Adresse de retour de malloc (addr2line)
+  char task[16];
+};
+
+struct HeapGuardStats {
+  uint32_t arenaUsed;
+  uint32_t arenaSize;
+  uint32_t freeAtLock;      // Tas interne libre au verrouillage
+  uint32_t allocations;     // Depuis lock()
+  uint32_t bytes;
+  uint32_t largest;
+  bool locked;
+};
+
+class HeapGuard {
+public:
+  HeapGuard();
+  // Création dans l'arène en mode statique, sur le tas sinon ; nullptr / false si l'arène
+  // est pleine ou déjà verrouillée
+  QueueHandle_t createQueue(UBaseType_t length, UBaseType_t itemSize);
+  bool createTask(TaskFunction_t fn, const char *name, uint32_t stackSize, void *param, UBaseType_t priority,
+                  TaskHandle_t *handle, BaseType_t core);
+  SemaphoreHandle_t createRecursiveMutex();
+
+  // Fin du démarrage : à partir d'ici toute allocation est une anomalie
+  void lock();
+  bool isLocked() const { return locked.load(std::memory_order_acquire); }
+  // Appelé depuis malloc : ni allocation ni verrou
+  void noteAllocation(size_t size, void *caller);
+  // HealthTask : défaut si des allocations ont eu lieu depuis l'appel précédent
+  void check();
+  void getStats(HeapGuardStats &out) const;
+  void resetStats();
+  void printReport();
+
+private:
+#if STATIC_ALLOCATION
+  alignas(16) uint8_t arena[STATIC_ARENA_BYTES];
+#endif
+  size_t arenaUsed;
+  portMUX_TYPE mux;
+  std::atomic<bool> locked;
+  uint32_t freeAtLock;
+  std::atomic<uint32_t> allocations;
+  std::atomic<uint32_t> bytes;
+  std::atomic<uint32_t> largest;
+  uint32_t checked;         // allocations déjà signalées par check()
+  HeapAllocation recent[HEAP_GUARD_RECENT];
+
+  void *reserve(size_t size);
+};
+
+extern HeapGuard heapGuard;
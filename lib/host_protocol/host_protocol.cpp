@@ -0,0 +1,268 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_COMM
+#include "host_protocol.h"
+#include "sd_manager.h"
+#include "gcode_parser.h"
+#include "gcode_scheduler.h"
+#include "system_manager.h"
+#include "upload_manager.h"
+#include "checksum.h"
+#include "fault_bus.h"
+#include "health_monitor.h"
+#include "../debug_manager.h"
+
+HostProtocol hostProtocol;
+
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t codePos = 0;
+  size_t outPos = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (in[i] == 0) {
+      out[codePos] = code;
+      codePos = outPos++;
+      code = 1;
+    } else {
+      out[outPos++] = in[i];
+      if (++code == 0xFF) {
+        out[codePos] = code;
+        codePos = outPos++;
+        code = 1;
+      }
+    }
+  }
+  out[codePos] = code;
+  return outPos;
+}
+
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t inPos = 0;
+  size_t outPos = 0;
+  while (inPos < len) {
+    uint8_t code = in[inPos++];
+    if (code == 0 || inPos + code - 1 > len) return 0;
+    for (uint8_t i = 1; i < code; i++) out[outPos++] = in[inPos++];
+    if (code != 0xFF && inPos < len) out[outPos++] = 0;
+  }
+  return outPos;
+}
+
+HostProtocol::HostProtocol() : active(false), rxLen(0), rxOverflow(false), frameReceivedAt(0), stats() {}
+
+void HostProtocol::begin() {
+  rxLen = 0;
+  rxOverflow = false;
+  active = true;
+  DEBUG_PRINTF_AUTO("Protocole binaire activé");
+}
+
+void HostProtocol::end() {
+  active = false;
+  DEBUG_PRINTF_AUTO("Retour à la console texte");
+}
+
+void HostProtocol::poll() {
+  while (active && Serial.available() > 0) {
+    int b = Serial.read();
+    if (b < 0) break;
+    if (b == 0) {
+      // Délimiteur : une trame trop longue est comptée puis ignorée
+      if (rxOverflow) {
+        stats.frameErrors++;
+      } else if (rxLen > 0) {
+        handleFrame(rxLen);
+      }
+      rxLen = 0;
+      rxOverflow = false;
+    } else if (rxLen < sizeof(rxBuf)) {
+      rxBuf[rxLen++] = (uint8_t)b;
+    } else {
+      rxOverflow = true;
+    }
+  }
+}
+
+void HostProtocol::handleFrame(size_t len) {
+  frameReceivedAt = (uint32_t)esp_timer_get_time();
+  size_t n = cobsDecode(rxBuf, len, rxBuf);
+  if (n < 4 || n > MAX_RAW) {
+    stats.frameErrors++;
+    return;
+  }
+  uint16_t expected = rxBuf[n - 2] | (rxBuf[n - 1] << 8);
+  if (crc16(rxBuf, n - 2) != expected) {
+    stats.crcErrors++;
+    sendError(rxBuf[1], HostError::BAD_CRC);
+    return;
+  }
+  stats.framesIn++;
+  dispatch(rxBuf[0], rxBuf[1], rxBuf + 2, n - 4);
+}
+
+void HostProtocol::send(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len) {
+  uint8_t raw[HOST_PROTO_MAX_PAYLOAD + 4];
+  uint8_t encoded[sizeof(raw) + sizeof(raw) / 254 + 3];
+  if (len > HOST_PROTO_MAX_PAYLOAD) len = HOST_PROTO_MAX_PAYLOAD;
+  raw[0] = type;
+  raw[1] = seq;
+  memcpy(raw + 2, payload, len);
+  uint16_t crc = crc16(raw, len + 2);
+  raw[len + 2] = crc & 0xFF;
+  raw[len + 3] = crc >> 8;
+  // 0x00 en tête aussi : un texte de debug intercalé forme une trame invalide à part
+  encoded[0] = 0;
+  size_t n = cobsEncode(raw, len + 4, encoded + 1) + 1;
+  encoded[n++] = 0;
+  Serial.write(encoded, n);
+  stats.framesOut++;
+}
+
+void HostProtocol::sendError(uint8_t seq, HostError err) {
+  uint8_t code = (uint8_t)err;
+  send((uint8_t)HostPacket::ERROR, seq, &code, 1);
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+struct ListContext {
+  HostProtocol *proto;
+  uint8_t seq;
+};
+
+static bool sendFileEntry(const char *name, const StorageStat &st, void *ctx) {
+  if (st.isDir) return true;
+  ListContext *list = (ListContext *)ctx;
+  uint8_t payload[HOST_PROTO_MAX_PAYLOAD];
+  size_t nameLen = strlen(name);
+  if (nameLen > sizeof(payload) - 4) nameLen = sizeof(payload) - 4;
+  putU32(payload, st.size);
+  memcpy(payload + 4, name, nameLen);
+  list->proto->send((uint8_t)HostPacket::LIST_FILES | (uint8_t)HostPacket::RESPONSE, list->seq, payload, nameLen + 4);
+  return true;
+}
+
+void HostProtocol::dispatch(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len) {
+  uint8_t reply = type | (uint8_t)HostPacket::RESPONSE;
+  switch (static_cast<HostPacket>(type)) {
+    case HostPacket::PING:
+      if (len > HOST_PROTO_MAX_PAYLOAD) {
+        sendError(seq, HostError::BAD_PAYLOAD);
+        break;
+      }
+      send(reply, seq, payload, len);
+      break;
+    case HostPacket::STATUS: {
+      uint8_t out[12];
+      out[0] = (uint8_t)gcodeScheduler.pending();
+      out[1] = motionQueue ? uxQueueMessagesWaiting(motionQueue) : 0;
+      out[2] = sdQueue ? uxQueueMessagesWaiting(sdQueue) : 0;
+      out[3] = uploadManager.isActive() ? 1 : 0;
+      putU32(out + 4, millis());
+      putU32(out + 8, ESP.getFreeHeap());
+      send(reply, seq, out, sizeof(out));
+      break;
+    }
+    case HostPacket::STATS: {
+      uint8_t out[40];
+      FaultStats faults;
+      faultBus.getStats(faults);
+      putU32(out, stats.framesIn);
+      putU32(out + 4, stats.framesOut);
+      putU32(out + 8, stats.crcErrors);
+      putU32(out + 12, stats.frameErrors);
+      putU32(out + 16, stats.motionAccepted);
+      putU32(out + 20, stats.motionRejected);
+      putU32(out + 24, faults.emergencyStops);
+      putU32(out + 28, faults.haltLastUs);
+      putU32(out + 32, faults.haltMaxUs);
+      putU32(out + 36, faults.haltBoundUs);
+      send(reply, seq, out, sizeof(out));
+      break;
+    }
+    case HostPacket::LIST_FILES: {
+      ListContext ctx = { this, seq };
+      if (!sdManager.getStorage()->list("/", sendFileEntry, &ctx)) {
+        sendError(seq, HostError::STORAGE);
+        break;
+      }
+      send((uint8_t)HostPacket::LIST_END | (uint8_t)HostPacket::RESPONSE, seq, nullptr, 0);
+      break;
+    }
+    case HostPacket::READ_FILE: {
+      if (len == 0 || len > HOST_PROTO_MAX_PAYLOAD) {
+        sendError(seq, HostError::BAD_PAYLOAD);
+        break;
+      }
+      char name[HOST_PROTO_MAX_PAYLOAD + 1];
+      memcpy(name, payload, len);
+      name[len] = '\0';
+      sdManager.readFile(name);
+      send(reply, seq, nullptr, 0);
+      break;
+    }
+    case HostPacket::EMERGENCY_STOP:
+      faultBus.emergencyStop(FaultSource::HOST, frameReceivedAt);
+      send(reply, seq, nullptr, 0);
+      break;
+    case HostPacket::MOTION_BATCH:
+      handleMotionBatch(seq, payload, len);
+      break;
+    case HostPacket::PROTO_TEXT:
+      send(reply, seq, nullptr, 0);
+      end();
+      break;
+    default:
+      sendError(seq, HostError::UNKNOWN_TYPE);
+      break;
+  }
+}
+
+void HostProtocol::handleMotionBatch(uint8_t seq, const uint8_t *payload, size_t len) {
+  if (!motionQueue) {
+    sendError(seq, HostError::QUEUE_FULL);
+    return;
+  }
+  if (faultBus.isHalted()) {
+    sendError(seq, HostError::HALTED);
+    return;
+  }
+  size_t pos = 0;
+  uint8_t accepted = 0;
+  while (pos + 4 <= len) {
+    MotionCommand cmd = {0, 0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, false, false, false, false, false, false,
+                         0.0f, 0.0f, false, false};
+    cmd.type = (char)payload[pos];
+    cmd.code = payload[pos + 1] | (payload[pos + 2] << 8);
+    uint8_t mask = payload[pos + 3];
+    pos += 4;
+    float *fields[8] = { &cmd.x, &cmd.y, &cmd.z, &cmd.e, &cmd.f, &cmd.s, &cmd.i, &cmd.j };
+    bool *flags[8] = { &cmd.has_x, &cmd.has_y, &cmd.has_z, &cmd.has_e, &cmd.has_f, &cmd.has_s, &cmd.has_i, &cmd.has_j };
+    for (int i = 0; i < 8; i++) {
+      if (!(mask & (1 << i))) continue;
+      if (pos + 4 > len) {
+        sendError(seq, HostError::BAD_PAYLOAD);
+        return;
+      }
+      memcpy(fields[i], payload + pos, 4);
+      *flags[i] = true;
+      pos += 4;
+    }
+    if (cmd.type == 'M' && cmd.code == static_cast<int>(GcodeType::M112)) {
+      faultBus.emergencyStop(FaultSource::HOST, frameReceivedAt);
+      break;
+    }
+    // Jamais bloquant : l'hôte renvoie la suite à partir du nombre acceptés
+    if (xQueueSend(motionQueue, &cmd, 0) != pdTRUE) {
+      stats.motionRejected++;
+      break;
+    }
+    stats.motionAccepted++;
+    accepted++;
+  }
+  healthMonitor.noteQueue(motionQueue);
+  send((uint8_t)HostPacket::MOTION_BATCH | (uint8_t)HostPacket::RESPONSE, seq, &accepted, 1);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Canal binaire optionnel à côté de la console texte, activé par la commande "BINARY".
+// Paquet : type (u8) | seq (u8) | charge utile | CRC16 (u16 LE, sur type+seq+charge),
+// encodé en COBS et terminé par 0x00. La réponse reprend le seq de la requête avec
+// le type | 0x80 ; une requête PROTO_TEXT rend la liaison à la console texte.
+enum class HostPacket : uint8_t {
+  PING = 0x01,          // Écho de la charge utile
+  STATUS = 0x02,        // État des files et de l'upload
+  STATS = 0x03,         // Compteurs du protocole puis de l'arrêt d'urgence
+  LIST_FILES = 0x04,    // Une réponse par fichier {u32 taille, nom}, puis LIST_END
+  READ_FILE = 0x05,     // Nom du fichier à envoyer à sdQueue
+  MOTION_BATCH = 0x06,  // Commandes déjà parsées poussées dans motionQueue
+  PROTO_TEXT = 0x07,    // Retour à la console texte
+  LIST_END = 0x08,
+  EMERGENCY_STOP = 0x09, // Exécuté dès le décodage, sans passer par les files
+  RESPONSE = 0x80,
+  ERROR = 0xFF          // Charge utile : code HostError
+};
+
+enum class HostError : uint8_t {
+  BAD_CRC = 1,
+  BAD_FRAME = 2,
+  UNKNOWN_TYPE = 3,
+  BAD_PAYLOAD = 4,
+  QUEUE_FULL = 5,
+  STORAGE = 6,
+  HALTED = 7            // Arrêt d'urgence en cours, M999 sur la console texte
+};
+
+// Enregistrement MOTION_BATCH : type (u8 'G'/'M') | code (u16 LE, M décalés de 1000) |
+// masque (u8, bit0 X .. bit5 S, bit6 I, bit7 J) | un f32 LE par bit présent, F en mm/s comme
+// MotionCommand
+struct HostProtocolStats {
+  uint32_t framesIn;
+  uint32_t framesOut;
+  uint32_t crcErrors;
+  uint32_t frameErrors;
+  uint32_t motionAccepted;
+  uint32_t motionRejected;
+};
+
+class HostProtocol {
+private:
+  // Paquet décodé le plus long : type + seq + charge utile + CRC16, puis son surcoût COBS
+  static const size_t MAX_RAW = HOST_PROTO_MAX_PAYLOAD + 4;
+  static const size_t MAX_ENCODED = MAX_RAW + MAX_RAW / 254 + 1;
+
+  bool active;
+  uint8_t rxBuf[MAX_ENCODED];   // Au-delà, la trame est comptée en erreur et ignorée
+  size_t rxLen;
+  bool rxOverflow;
+  uint32_t frameReceivedAt;   // Délimiteur reçu, référence de latence de l'arrêt d'urgence
+  HostProtocolStats stats;
+
+  void handleFrame(size_t len);
+  void dispatch(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len);
+  void handleMotionBatch(uint8_t seq, const uint8_t *payload, size_t len);
+  void sendError(uint8_t seq, HostError err);
+
+public:
+  HostProtocol();
+  void begin();
+  void end();
+  bool isActive() const { return active; }
+  void poll();
+  void send(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len);
+  const HostProtocolStats &getStats() const { return stats; }
+};
+
+// Encodage COBS : out doit pouvoir contenir len + len / 254 + 1 octets
+size_t cobsEncode(const uint8_t *in, size_t len, uint8_t *out);
+// Décodage en place possible (out == in), 0 si la trame est invalide
+size_t cobsDecode(const uint8_t *in, size_t len, uint8_t *out);
+
+extern HostProtocol hostProtocol;
@@ -0,0 +1,260 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "kinematics.h"
+#include "machine_state.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <math.h>
+#include <string.h>
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+MachineKinematics machineKinematics;
+
+uint32_t Kinematics::segmentCount(const float from[4], const float to[4], float feed) const {
+  return 1;
+}
+
+bool Kinematics::segment(const float from[4], const float to[4], float feed, Sink sink, void *context) const {
+  return split(from, to, segmentCount(from, to, feed), sink, context);
+}
+
+bool Kinematics::split(const float from[4], const float to[4], uint32_t n, Sink sink, void *context) const {
+  if (n == 0) n = 1;
+  float step[4], pos[4], motor[4];
+  for (int i = 0; i < 4; i++) {
+    step[i] = (to[i] - from[i]) / (float)n;
+    pos[i] = from[i];
+  }
+  for (uint32_t k = 1; k <= n; k++) {
+    // Dernier segment sur to exactement : les pas cumulés ne dérivent pas
+    if (k == n) memcpy(pos, to, sizeof(pos));
+    else for (int i = 0; i < 4; i++) pos[i] += step[i];
+    if (!inverse(pos, motor)) return false;
+    motor[AXIS_E] = pos[AXIS_E];
+    if (!sink(motor, context)) return false;
+  }
+  return true;
+}
+
+bool CartesianKinematics::inverse(const float cart[3], float motor[3]) const {
+  motor[0] = cart[0];
+  motor[1] = cart[1];
+  motor[2] = cart[2];
+  return true;
+}
+
+bool CartesianKinematics::forward(const float motor[3], float cart[3]) const {
+  return inverse(motor, cart);
+}
+
+bool CoreXYKinematics::inverse(const float cart[3], float motor[3]) const {
+  motor[0] = cart[0] + cart[1];
+  motor[1] = cart[0] - cart[1];
+  motor[2] = cart[2];
+  return true;
+}
+
+bool CoreXYKinematics::forward(const float motor[3], float cart[3]) const {
+  cart[0] = 0.5f * (motor[0] + motor[1]);
+  cart[1] = 0.5f * (motor[0] - motor[1]);
+  cart[2] = motor[2];
+  return true;
+}
+
+DeltaKinematics::DeltaKinematics(float radius, float rod, uint16_t segmentsPerSecond, float minSegmentMm)
+    : towerRadius(radius), rodLength(rod), rodSq(rod * rod), sps(segmentsPerSecond), minSegment(minSegmentMm) {
+  static const float angles[3] = { 210.0f, 330.0f, 90.0f };
+  for (int i = 0; i < 3; i++) {
+    towerX[i] = radius * cosf(angles[i] * (float)M_PI / 180.0f);
+    towerY[i] = radius * sinf(angles[i] * (float)M_PI / 180.0f);
+  }
+}
+
+bool DeltaKinematics::inverse(const float cart[3], float motor[3]) const {
+  for (int i = 0; i < 3; i++) {
+    float dx = towerX[i] - cart[0], dy = towerY[i] - cart[1];
+    float h = rodSq - dx * dx - dy * dy;
+    if (h <= 0.0f) return false;
+    motor[i] = cart[2] + sqrtf(h);
+  }
+  return true;
+}
+
+bool DeltaKinematics::forward(const float motor[3], float cart[3]) const {
+  // Repère ex (A vers B), ey, ez centré sur le chariot A ; les trois sphères ont le même
+  // rayon, d'où x = d / 2
+  double p1[3] = { towerX[0], towerY[0], motor[0] };
+  double p12[3] = { towerX[1] - p1[0], towerY[1] - p1[1], motor[1] - p1[2] };
+  double p13[3] = { towerX[2] - p1[0], towerY[2] - p1[1], motor[2] - p1[2] };
+  double d = sqrt(p12[0] * p12[0] + p12[1] * p12[1] + p12[2] * p12[2]);
+  double ex[3] = { p12[0] / d, p12[1] / d, p12[2] / d };
+  double i = ex[0] * p13[0] + ex[1] * p13[1] + ex[2] * p13[2];
+  double eyRaw[3] = { p13[0] - i * ex[0], p13[1] - i * ex[1], p13[2] - i * ex[2] };
+  double eyLen = sqrt(eyRaw[0] * eyRaw[0] + eyRaw[1] * eyRaw[1] + eyRaw[2] * eyRaw[2]);
+  if (d <= 0.0 || eyLen <= 0.0) return false;
+  double ey[3] = { eyRaw[0] / eyLen, eyRaw[1] / eyLen, eyRaw[2] / eyLen };
+  double j = ey[0] * p13[0] + ey[1] * p13[1] + ey[2] * p13[2];
+  double ez[3] = { ex[1] * ey[2] - ex[2] * ey[1], ex[2] * ey[0] - ex[0] * ey[2], ex[0] * ey[1] - ex[1] * ey[0] };
+  double x = d / 2.0;
+  double y = ((i * i + j * j) / 2.0 - i * x) / j;
+  double h = (double)rodSq - x * x - y * y;
+  if (h < 0.0) return false;
+  // L'effecteur pend sous les chariots
+  double z = sqrt(h);
+  if (ez[2] > 0.0) z = -z;
+  for (int k = 0; k < 3; k++) cart[k] = (float)(p1[k] + x * ex[k] + y * ey[k] + z * ez[k]);
+  return true;
+}
+
+// Segments au rythme de sps, sans descendre sous minSegment mm : une racine par mouvement
+uint32_t DeltaKinematics::segmentCount(const float from[4], const float to[4], float feed) const {
+  float dx = to[0] - from[0], dy = to[1] - from[1], dz = to[2] - from[2];
+  float length = sqrtf(dx * dx + dy * dy + dz * dz);
+  if (length <= 0.0f || feed <= 0.0f) return 1;
+  float bySpeed = ceilf(length / feed * (float)sps);
+  float byLength = floorf(length / minSegment);
+  float n = bySpeed < byLength ? bySpeed : byLength;
+  return n < 1.0f ? 1 : (uint32_t)n;
+}
+
+MachineKinematics::MachineKinematics()
+    : cartesian(), corexy(), delta(DELTA_RADIUS_MM, DELTA_DIAGONAL_ROD_MM, DELTA_SEGMENTS_PER_SECOND,
+                                   DELTA_MIN_SEGMENT_MM),
+      models{ &cartesian, &corexy, &delta }, type((KinematicsType)KINEMATICS_TYPE_DEFAULT) {}
+
+bool MachineKinematics::select(KinematicsType t) {
+  MachineState s;
+  machineState.snapshot(s);
+  if (s.printing) {
+    DEBUG_ERRORF_AUTO("Erreur: Changement de cinématique refusé pendant l'impression");
+    return false;
+  }
+  // La position courante doit exister côté moteurs dans le nouveau modèle
+  float cart[3] = { s.pos_um[AXIS_X] / 1000.0f, s.pos_um[AXIS_Y] / 1000.0f, s.pos_um[AXIS_Z] / 1000.0f };
+  float motor[3];
+  if (!models[(int)t]->inverse(cart, motor)) {
+    DEBUG_ERRORF_AUTO("Erreur: Position X%.1f Y%.1f Z%.1f hors d'atteinte en %s", cart[0], cart[1], cart[2],
+                      models[(int)t]->name());
+    return false;
+  }
+  type = t;
+  DEBUG_PRINTF_AUTO("Cinématique : %s", active().name());
+  return true;
+}
+
+bool MachineKinematics::parseType(const char *name, KinematicsType &out) {
+  static const struct {
+    const char *name;
+    KinematicsType type;
+  } names[] = { { "CARTESIAN", KinematicsType::CARTESIAN },
+                { "COREXY", KinematicsType::COREXY },
+                { "DELTA", KinematicsType::DELTA } };
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (strcmp(name, names[i].name) == 0) {
+      out = names[i].type;
+      return true;
+    }
+  }
+  return false;
+}
+
+KinematicsTestResult MachineKinematics::selfTest(KinematicsType t) {
+  Kinematics &k = model(t);
+  KinematicsTestResult r = {};
+  const bool isDelta = t == KinematicsType::DELTA;
+  const float span = isDelta ? DELTA_PRINTABLE_RADIUS_MM : KINEMATICS_TEST_SPAN_MM;
+  const int steps = 10;
+  for (int zi = 0; zi <= 2; zi++) {
+    for (int yi = -steps; yi <= steps; yi++) {
+      for (int xi = -steps; xi <= steps; xi++) {
+        float cart[3] = { span * xi / steps, span * yi / steps, 0.2f + 100.0f * zi };
+        if (isDelta && cart[0] * cart[0] + cart[1] * cart[1] > span * span) continue;
+        r.points++;
+        float motor[3], back[3];
+        if (!k.inverse(cart, motor) || !k.forward(motor, back)) {
+          r.unreachable++;
+          continue;
+        }
+        for (int a = 0; a < 3; a++) {
+          float err = fabsf(back[a] - cart[a]) * 1000.0f;
+          if (err > r.maxErrorUm) r.maxErrorUm = err;
+        }
+      }
+    }
+  }
+  r.pass = r.unreachable == 0 && r.maxErrorUm <= KINEMATICS_TEST_TOLERANCE_UM;
+  return r;
+}
+
+static bool countSegment(const float motor[4], void *context) {
+  // Lecture du résultat : le compilateur ne peut pas écarter inverse()
+  float *sum = (float *)context;
+  *sum += motor[0] + motor[1] + motor[2];
+  return true;
+}
+
+KinematicsBenchResult MachineKinematics::bench(KinematicsType t) {
+  Kinematics &k = model(t);
+  KinematicsBenchResult r = {};
+  const float span = t == KinematicsType::DELTA ? DELTA_PRINTABLE_RADIUS_MM * 0.7f : KINEMATICS_TEST_SPAN_MM;
+  const float from[4] = { -span, -span * 0.5f, 0.2f, 0.0f };
+  const float to[4] = { span, span * 0.5f, 20.0f, 10.0f };
+  volatile float sum = 0.0f;
+  float local = 0.0f;
+  int64_t t0 = esp_timer_get_time();
+  bool ok = k.split(from, to, KINEMATICS_BENCH_SEGMENTS, countSegment, &local);
+  int64_t us = esp_timer_get_time() - t0;
+  sum = local;
+  (void)sum;
+  if (!ok) return r;
+  r.segments = KINEMATICS_BENCH_SEGMENTS;
+  r.nsPerSegment = us > 0 ? (float)us * 1000.0f / (float)KINEMATICS_BENCH_SEGMENTS : 0.0f;
+  r.cyclesPerSegment = (uint32_t)(r.nsPerSegment * (float)ESP.getCpuFreqMHz() / 1000.0f + 0.5f);
+  float perSecond = r.nsPerSegment > 0.0f ? 1e9f * KINEMATICS_CPU_BUDGET_PCT / 100.0f / r.nsPerSegment : 0.0f;
+  r.maxSegmentsPerS = perSecond > 4e9f ? UINT32_MAX : (uint32_t)perSecond;
+  r.maxFeedMmS = perSecond * KINEMATICS_MIN_SEGMENT_MM;
+  return r;
+}
+
+void MachineKinematics::printReport() {
+  Kinematics &k = active();
+  MachineState s;
+  machineState.snapshot(s);
+  float cart[3] = { s.pos_um[AXIS_X] / 1000.0f, s.pos_um[AXIS_Y] / 1000.0f, s.pos_um[AXIS_Z] / 1000.0f };
+  float motor[3] = { 0.0f, 0.0f, 0.0f };
+  bool reachable = k.inverse(cart, motor);
+  reportLine("KINEMATICS model=%s x=%.3f y=%.3f z=%.3f a=%.3f b=%.3f c=%.3f reachable=%d\n", k.name(), cart[0],
+             cart[1], cart[2], motor[0], motor[1], motor[2], reachable ? 1 : 0);
+  reportLine("KINEMATICS delta_radius=%.2f delta_rod=%.2f delta_sps=%u delta_min_segment_mm=%.2f\n",
+             delta.radius(), delta.rod(), (unsigned)delta.segmentsPerSecond(), DELTA_MIN_SEGMENT_MM);
+  Serial.println("OK");
+}
+
+bool MachineKinematics::printSelfTest() {
+  bool all = true;
+  for (int t = 0; t < 3; t++) {
+    KinematicsTestResult r = selfTest((KinematicsType)t);
+    all = all && r.pass;
+    reportLine("KIN_TEST model=%s points=%lu unreachable=%lu max_err_um=%.3f tolerance_um=%.1f pass=%d\n",
+               models[t]->name(), (unsigned long)r.points, (unsigned long)r.unreachable, r.maxErrorUm,
+               (float)KINEMATICS_TEST_TOLERANCE_UM, r.pass ? 1 : 0);
+  }
+  Serial.println(all ? "OK" : "ERROR: Kinematics self-test failed");
+  return all;
+}
+
+void MachineKinematics::printBench() {
+  uint32_t deltaMaxSps = 0;
+  for (int t = 0; t < 3; t++) {
+    KinematicsBenchResult r = bench((KinematicsType)t);
+    if ((KinematicsType)t == KinematicsType::DELTA) deltaMaxSps = r.maxSegmentsPerS;
+    reportLine("KIN_BENCH model=%s segments=%lu ns_per_segment=%.1f cycles_per_segment=%lu budget_pct=%d "
+               "max_segments_per_s=%lu max_feed_mm_s=%.0f\n",
+               models[t]->name(), (unsigned long)r.segments, r.nsPerSegment, (unsigned long)r.cyclesPerSegment,
+               KINEMATICS_CPU_BUDGET_PCT, (unsigned long)r.maxSegmentsPerS, r.maxFeedMmS);
+  }
+  // La delta découpe au rythme de DELTA_SEGMENTS_PER_SECOND quelle que soit la vitesse
+  reportLine("KIN_BENCH delta_sps=%u delta_sps_ok=%d\n", (unsigned)DELTA_SEGMENTS_PER_SECOND,
+             deltaMaxSps >= DELTA_SEGMENTS_PER_SECOND ? 1 : 0);
+  Serial.println("OK");
+}
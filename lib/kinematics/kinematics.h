@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../config.h"
+
+// Passage des coordonnées cartésiennes du G-code (mm) aux positions des moteurs (mm de
+// courroie ou de chariot, avant les pas/mm). MotionCommand reste cartésien : la
+// cinématique s'applique à la sortie de motionQueue, mouvement par mouvement.
+//  - cartésienne : X, Y, Z tels quels
+//  - CoreXY      : A = X + Y, B = X - Y, Z tel quel
+//  - delta       : chariots des tours A (210°), B (330°), C (90°) ; les droites ne le
+//                  sont plus côté moteurs, d'où un découpage en segments dans le temps
+// E passe toujours tel quel, interpolé avec le reste.
+
+enum class KinematicsType : uint8_t { CARTESIAN = 0, COREXY, DELTA };
+
+class Kinematics {
+public:
+  // Position moteurs d'une extrémité de segment (X/A, Y/B, Z/C, E)
+  typedef bool (*Sink)(const float motor[4], void *context);
+
+  virtual ~Kinematics() {}
+  virtual const char *name() const = 0;
+  // false hors du volume atteignable
+  virtual bool inverse(const float cart[3], float motor[3]) const = 0;
+  virtual bool forward(const float motor[3], float cart[3]) const = 0;
+  // Segments d'un mouvement de from à to en mm, à feed mm/s ; 1 si les droites le restent
+  virtual uint32_t segmentCount(const float from[4], const float to[4], float feed) const;
+  // Découpe le mouvement et passe chaque extrémité de segment à sink, la dernière étant
+  // exactement to. false si un point sort du volume ou si sink refuse.
+  bool segment(const float from[4], const float to[4], float feed, Sink sink, void *context) const;
+  // Même chose en n segments égaux : un pas ajouté par segment, sans racine cartésienne
+  bool split(const float from[4], const float to[4], uint32_t n, Sink sink, void *context) const;
+};
+
+class CartesianKinematics : public Kinematics {
+public:
+  const char *name() const override { return "cartesian"; }
+  bool inverse(const float cart[3], float motor[3]) const override;
+  bool forward(const float motor[3], float cart[3]) const override;
+};
+
+class CoreXYKinematics : public Kinematics {
+public:
+  const char *name() const override { return "corexy"; }
+  bool inverse(const float cart[3], float motor[3]) const override;
+  bool forward(const float motor[3], float cart[3]) const override;
+};
+
+class DeltaKinematics : public Kinematics {
+public:
+  DeltaKinematics(float radius, float rod, uint16_t segmentsPerSecond, float minSegmentMm);
+  const char *name() const override { return "delta"; }
+  // Trois racines par point, tours et rod² précalculés : rien d'autre par segment
+  bool inverse(const float cart[3], float motor[3]) const override;
+  // Trilatération des trois sphères (double : hors du chemin des segments)
+  bool forward(const float motor[3], float cart[3]) const override;
+  uint32_t segmentCount(const float from[4], const float to[4], float feed) const override;
+  float radius() const { return towerRadius; }
+  float rod() const { return rodLength; }
+  uint16_t segmentsPerSecond() const { return sps; }
+
+private:
+  float towerRadius, rodLength, rodSq;
+  float towerX[3], towerY[3];
+  uint16_t sps;
+  float minSegment;
+};
+
+struct KinematicsTestResult {
+  uint32_t points;
+  uint32_t unreachable;     // Points de la grille refusés par inverse()
+  float maxErrorUm;         // Plus grand écart cartésien après inverse puis forward
+  bool pass;
+};
+
+struct KinematicsBenchResult {
+  uint32_t segments;
+  float nsPerSegment;
+  uint32_t cyclesPerSegment;
+  uint32_t maxSegmentsPerS;  // Dans KINEMATICS_CPU_BUDGET_PCT d'un cœur
+  float maxFeedMmS;          // Avec des segments de KINEMATICS_MIN_SEGMENT_MM
+};
+
+class MachineKinematics {
+public:
+  MachineKinematics();
+  Kinematics &active() { return *models[(int)type]; }
+  KinematicsType activeType() const { return type; }
+  Kinematics &model(KinematicsType t) { return *models[(int)t]; }
+  // Refusé pendant une impression (les positions moteurs en cours changeraient de sens)
+  // et si la position courante est hors du volume atteignable du nouveau modèle
+  bool select(KinematicsType t);
+  static bool parseType(const char *name, KinematicsType &out);
+
+  // Aller-retour inverse/forward sur une grille du volume (rayon imprimable pour la delta)
+  KinematicsTestResult selfTest(KinematicsType t);
+  // Coût par segment : KINEMATICS_BENCH_SEGMENTS extrémités d'un mouvement en diagonale
+  KinematicsBenchResult bench(KinematicsType t);
+
+  void printReport();
+  // KINEMATICS TEST / BENCH : tous les modèles, une ligne chacun ; false si un test échoue
+  bool printSelfTest();
+  void printBench();
+
+private:
+  CartesianKinematics cartesian;
+  CoreXYKinematics corexy;
+  DeltaKinematics delta;
+  Kinematics *models[3];
+  volatile KinematicsType type;
+};
+
+extern MachineKinematics machineKinematics;
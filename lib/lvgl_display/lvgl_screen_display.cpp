@@ -1,29 +1,163 @@
 #include "lvgl_screen_display.h"
 #include <Arduino.h>
+#include "trace_recorder.h"
+#include "health_monitor.h"
+#include "heap_guard.h"
+#include "mem_placement.h"
+#include "../report_line.h"
 
-LVGL_Display::LVGL_Display() : tft(), disp(nullptr), draw_buf(nullptr), lastTick(0) {}
+LVGL_Display::LVGL_Display() : tft(), disp(nullptr), draw_buf(), mutex(nullptr), taskHandle(nullptr), stats(),
+    fpsWindowStart(0), fpsWindowFrames(0), statsMux(portMUX_INITIALIZER_UNLOCKED) {}
 LVGL_Display display;
-void LVGL_Display::begin() {
-    Serial.begin(115200);
-    delay(500);
-    // Initialisation de LVGL
+
+uint32_t LVGL_Display::tickCb() {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+bool LVGL_Display::begin() {
+    // Liaison série déjà ouverte dans setup() : aucune attente ici
+    mutex = heapGuard.createRecursiveMutex();
+    if (!mutex) {
+        Serial.println("ERROR: LVGL mutex allocation failed");
+        return false;
+    }
+    // Initialisation de LVGL, horloge lue directement sur esp_timer
     lv_init();
-    // Initialisation du buffer
-    draw_buf = new uint8_t[DRAW_BUF_SIZE];
-    // Création du display LVGL avec TFT_eSPI
-    disp = lv_tft_espi_create(SCREEN_HEIGHT, SCREEN_WIDTH, draw_buf, DRAW_BUF_SIZE);
-    lv_display_set_rotation(disp, LV_DISPLAY_ROTATION_90);
+    lv_tick_set_cb(tickCb);
+
+    // Paysage fait par le contrôleur (MADCTL) : LVGL rend directement dans l'orientation
+    // du balayage, sans rotation logicielle à chaque envoi
+    tft.begin();
+    tft.setRotation(1);
+    tft.setSwapBytes(false);
+    tft.initDMA();
+    // CS reste actif sur le bus de l'écran : chaque envoi n'est plus qu'un transfert DMA
+    tft.startWrite();
+
+    // Deux tampons partiels en SRAM interne accessible au DMA : LVGL rend dans l'un
+    // pendant que l'autre part sur le SPI
+#if STATIC_ALLOCATION
+    static DMA_ATTR uint8_t staticDrawBuf[2][DRAW_BUF_SIZE];
+    for (int i = 0; i < 2; i++) {
+        draw_buf[i] = staticDrawBuf[i];
+        memPlacement.track(draw_buf[i], DRAW_BUF_SIZE, MemClass::DMA, "lvgl_draw");
+    }
+#else
+    for (int i = 0; i < 2; i++) {
+        draw_buf[i] = (uint8_t *)memPlacement.alloc(DRAW_BUF_SIZE, MemClass::DMA, "lvgl_draw");
+    }
+#endif
+    if (!draw_buf[0] || !draw_buf[1]) {
+        Serial.println("ERROR: DMA draw buffers allocation failed");
+        return false;
+    }
+    disp = lv_display_create(SCREEN_WIDTH, SCREEN_HEIGHT);
+    // Octets déjà dans l'ordre du bus SPI : pas d'inversion à l'envoi
+    lv_display_set_color_format(disp, LV_COLOR_FORMAT_RGB565_SWAPPED);
+    lv_display_set_buffers(disp, draw_buf[0], draw_buf[1], DRAW_BUF_SIZE, LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_flush_cb(disp, flushCb);
+    lv_display_set_user_data(disp, this);
+    lv_display_add_event_cb(disp, refrReadyCb, LV_EVENT_REFR_READY, this);
 
-    Serial.println();
     Serial.println("LVGL Setup Completed.");
-    delay(500);
 
     // Intégration de l'interface EEZ Studio
     ui_init();
+    return true;
+}
+
+// Le transfert démarre puis LVGL est libéré aussitôt : il rend la zone suivante dans
+// l'autre tampon. Le seul point d'attente est ici, avant de réutiliser le bus.
+void LVGL_Display::flushCb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map) {
+    LVGL_Display *self = (LVGL_Display *)lv_display_get_user_data(disp);
+    uint32_t t0 = (uint32_t)esp_timer_get_time();
+    TRACE_BEGIN(LVGL_FLUSH);
+    self->tft.dmaWait();
+    uint32_t t1 = (uint32_t)esp_timer_get_time();
+    int32_t w = lv_area_get_width(area);
+    int32_t h = lv_area_get_height(area);
+    self->tft.pushImageDMA(area->x1, area->y1, w, h, (uint16_t *)px_map);
+    TRACE_END(LVGL_FLUSH);
+    lv_display_flush_ready(disp);
+    uint32_t t2 = (uint32_t)esp_timer_get_time();
+    portENTER_CRITICAL(&self->statsMux);
+    self->stats.flushes++;
+    self->stats.flushBytes += (uint32_t)(w * h * 2);
+    self->stats.dmaWaitTotalUs += t1 - t0;
+    self->stats.flushTotalUs += t2 - t0;
+    if (t2 - t0 > self->stats.flushMaxUs) self->stats.flushMaxUs = t2 - t0;
+    portEXIT_CRITICAL(&self->statsMux);
+}
+
+void LVGL_Display::refrReadyCb(lv_event_t *e) {
+    LVGL_Display *self = (LVGL_Display *)lv_event_get_user_data(e);
+    uint32_t now = millis();
+    portENTER_CRITICAL(&self->statsMux);
+    self->stats.frames++;
+    self->fpsWindowFrames++;
+    if (now - self->fpsWindowStart >= 1000) {
+        self->stats.fps = self->fpsWindowFrames * 1000 / (now - self->fpsWindowStart);
+        self->fpsWindowFrames = 0;
+        self->fpsWindowStart = now;
+    }
+    portEXIT_CRITICAL(&self->statsMux);
+}
+
+void LVGL_Display::renderTask(void *pvParameters) {
+    LVGL_Display *self = (LVGL_Display *)pvParameters;
+    while (1) {
+        uint32_t wait = LVGL_MAX_SLEEP_MS;
+        if (self->lock()) {
+            uint32_t t0 = (uint32_t)esp_timer_get_time();
+            TRACE_BEGIN(LVGL_LOOP);
+            wait = lv_timer_handler();
+            TRACE_END(LVGL_LOOP);
+            uint32_t elapsed = (uint32_t)esp_timer_get_time() - t0;
+            self->unlock();
+            portENTER_CRITICAL(&self->statsMux);
+            self->stats.renderCalls++;
+            self->stats.renderTotalUs += elapsed;
+            if (elapsed > self->stats.renderMaxUs) self->stats.renderMaxUs = elapsed;
+            portEXIT_CRITICAL(&self->statsMux);
+        }
+        // Dort jusqu'au prochain timer LVGL plutôt qu'un delay(5) fixe
+        if (wait == LV_NO_TIMER_READY || wait > LVGL_MAX_SLEEP_MS) wait = LVGL_MAX_SLEEP_MS;
+        vTaskDelay(pdMS_TO_TICKS(wait ? wait : 1));
+    }
+}
+
+void LVGL_Display::startTask() {
+    if (!disp || taskHandle) return;
+    fpsWindowStart = millis();
+    // Cœur 1 avec la chaîne G-code : le cœur 0 garde les tâches système et le Wi-Fi
+    heapGuard.createTask(renderTask, "LvglTask", LVGL_TASK_STACK, this, LVGL_TASK_PRIORITY, &taskHandle, 1);
+    healthMonitor.watchTask(taskHandle, LVGL_TASK_STACK);
+}
+
+bool LVGL_Display::lock(TickType_t timeout) {
+    return mutex && xSemaphoreTakeRecursive(mutex, timeout) == pdTRUE;
+}
+
+void LVGL_Display::unlock() {
+    if (mutex) xSemaphoreGiveRecursive(mutex);
+}
+
+void LVGL_Display::getStats(DisplayStats &out) {
+    portENTER_CRITICAL(&statsMux);
+    out = stats;
+    portEXIT_CRITICAL(&statsMux);
 }
 
-void LVGL_Display::update() {
-    lv_tick_inc(millis() - lastTick);
-    lastTick = millis();
-    lv_timer_handler();
+void LVGL_Display::printStats() {
+    DisplayStats s;
+    getStats(s);
+    unsigned long flushAvg = s.flushes ? (unsigned long)(s.flushTotalUs / s.flushes) : 0;
+    unsigned long waitAvg = s.flushes ? (unsigned long)(s.dmaWaitTotalUs / s.flushes) : 0;
+    unsigned long renderAvg = s.renderCalls ? (unsigned long)(s.renderTotalUs / s.renderCalls) : 0;
+    reportLine("DISPLAY fps=%lu frames=%lu flushes=%lu flush_kb=%lu flush_avg_us=%lu flush_max_us=%lu "
+               "dma_wait_avg_us=%lu render_avg_us=%lu render_max_us=%lu\n",
+               (unsigned long)s.fps, (unsigned long)s.frames, (unsigned long)s.flushes,
+               (unsigned long)(s.flushBytes / 1024), flushAvg, (unsigned long)s.flushMaxUs, waitAvg, renderAvg,
+               (unsigned long)s.renderMaxUs);
+    Serial.println("OK");
 }
@@ -6,21 +6,51 @@
 #include "../lvgl_user_interface/src/ui/ui.h"  // EEZ export
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
-// Configuration de l'écran
-#define SCREEN_WIDTH  320
-#define SCREEN_HEIGHT 240
-#define DRAW_BUF_SIZE (SCREEN_WIDTH * SCREEN_HEIGHT / 10 * (LV_COLOR_DEPTH / 8))
+#include <freertos/semphr.h>
+#include "../config.h"  // SCREEN_WIDTH, SCREEN_HEIGHT, DRAW_BUF_SIZE
+#define LVGL_TASK_STACK     8192
+#define LVGL_TASK_PRIORITY  2
+#define LVGL_MAX_SLEEP_MS   30    // Réveil minimal même sans timer LVGL échu
+
+// Mesures de rendu, affichées par la commande DISPLAY
+struct DisplayStats {
+    uint32_t frames;          // Rafraîchissements complets (LV_EVENT_REFR_READY)
+    uint32_t fps;             // Sur la dernière seconde
+    uint32_t flushes;
+    uint64_t flushBytes;
+    uint32_t flushMaxUs;      // Temps passé dans flushCb (attente DMA comprise)
+    uint64_t flushTotalUs;
+    uint64_t dmaWaitTotalUs;  // Rendu qui n'a pas pu recouvrir le transfert précédent
+    uint32_t renderMaxUs;     // Un appel à lv_timer_handler
+    uint64_t renderTotalUs;
+    uint32_t renderCalls;
+};
 
 class LVGL_Display {
 public:
     LVGL_Display();                 // Constructeur
-    void begin();                   // Initialise l'écran et LVGL
-    void update();                  // Met à jour LVGL
+    bool begin();                   // Initialise l'écran et LVGL ; false sans tampons DMA
+    void startTask();               // Lance la tâche de rendu (après la création de l'UI)
+    // Tout appel LVGL hors de la tâche de rendu doit être encadré par lock()/unlock()
+    bool lock(TickType_t timeout = portMAX_DELAY);
+    void unlock();
+    void getStats(DisplayStats &out);
+    void printStats();
 private:
     TFT_eSPI tft;
     lv_display_t *disp;
-    uint8_t *draw_buf;
-    uint32_t lastTick;
+    uint8_t *draw_buf[2];
+    SemaphoreHandle_t mutex;
+    TaskHandle_t taskHandle;
+    DisplayStats stats;
+    uint32_t fpsWindowStart;
+    uint32_t fpsWindowFrames;
+    portMUX_TYPE statsMux;
+
+    static void flushCb(lv_display_t *disp, const lv_area_t *area, uint8_t *px_map);
+    static void refrReadyCb(lv_event_t *e);
+    static uint32_t tickCb();
+    static void renderTask(void *pvParameters);
 };
 
 extern LVGL_Display display;
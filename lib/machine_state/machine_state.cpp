@@ -0,0 +1,196 @@
+#include "machine_state.h"
+#include "../report_line.h"
+
+static_assert(sizeof(MachineState) % sizeof(uint32_t) == 0, "MachineState doit se copier mot à mot");
+
+MachineStateStore machineState;
+
+MachineStateStore::MachineStateStore() : sequence(0), shadow(), writerMux(portMUX_INITIALIZER_UNLOCKED),
+  statReads(0), statRetries(0), statMaxRetries(0) {
+  for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+}
+
+// Appelé sous writerMux, après modification de shadow
+void MachineStateStore::publish() {
+  uint32_t seq = sequence.load(std::memory_order_relaxed);
+  sequence.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  uint32_t raw[WORDS];
+  memcpy(raw, &shadow, sizeof(raw));
+  for (size_t i = 0; i < WORDS; i++) words[i].store(raw[i], std::memory_order_relaxed);
+  sequence.store(seq + 2, std::memory_order_release);
+}
+
+uint32_t MachineStateStore::snapshot(MachineState &out) {
+  uint32_t raw[WORDS];
+  uint32_t retries = 0;
+  uint32_t before, after;
+  while (1) {
+    before = sequence.load(std::memory_order_acquire);
+    if (!(before & 1)) {
+      for (size_t i = 0; i < WORDS; i++) raw[i] = words[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence.load(std::memory_order_relaxed);
+      if (before == after) break;
+    }
+    retries++;
+  }
+  memcpy(&out, raw, sizeof(out));
+  statReads.fetch_add(1, std::memory_order_relaxed);
+  if (retries) {
+    statRetries.fetch_add(retries, std::memory_order_relaxed);
+    uint32_t prev = statMaxRetries.load(std::memory_order_relaxed);
+    while (retries > prev && !statMaxRetries.compare_exchange_weak(prev, retries, std::memory_order_relaxed)) {}
+  }
+  return before;
+}
+
+void MachineStateStore::getReadStats(MachineStateReadStats &out) const {
+  out.reads = statReads.load(std::memory_order_relaxed);
+  out.retries = statRetries.load(std::memory_order_relaxed);
+  out.maxRetries = statMaxRetries.load(std::memory_order_relaxed);
+}
+
+void MachineStateStore::resetReadStats() {
+  statReads.store(0, std::memory_order_relaxed);
+  statRetries.store(0, std::memory_order_relaxed);
+  statMaxRetries.store(0, std::memory_order_relaxed);
+}
+
+void MachineStateStore::setPosition(const int32_t pos_um[4]) {
+  portENTER_CRITICAL(&writerMux);
+  memcpy(shadow.pos_um, pos_um, sizeof(shadow.pos_um));
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+void MachineStateStore::setHotend(int16_t current_cdeg, int16_t target_cdeg) {
+  portENTER_CRITICAL(&writerMux);
+  shadow.hotend_cdeg = current_cdeg;
+  shadow.hotend_target_cdeg = target_cdeg;
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+void MachineStateStore::setHotendTarget(int16_t target_cdeg) {
+  portENTER_CRITICAL(&writerMux);
+  shadow.hotend_target_cdeg = target_cdeg;
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+void MachineStateStore::setBed(int16_t current_cdeg, int16_t target_cdeg) {
+  portENTER_CRITICAL(&writerMux);
+  shadow.bed_cdeg = current_cdeg;
+  shadow.bed_target_cdeg = target_cdeg;
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+void MachineStateStore::setBedTarget(int16_t target_cdeg) {
+  portENTER_CRITICAL(&writerMux);
+  shadow.bed_target_cdeg = target_cdeg;
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+void MachineStateStore::setSdProgress(uint32_t bytes, uint32_t size, bool printing) {
+  portENTER_CRITICAL(&writerMux);
+  shadow.sd_bytes = bytes;
+  shadow.sd_size = size;
+  shadow.printing = printing;
+  publish();
+  portEXIT_CRITICAL(&writerMux);
+}
+
+struct SnapshotStressWriter {
+  MachineStateStore *store;
+  volatile bool *stop;
+  volatile uint32_t writes;
+  volatile bool done;
+  int32_t id;
+};
+
+// Chaque publication garde ses champs égaux entre eux : un mélange de deux versions se voit
+static void snapshotStressWriterTask(void *pvParameters) {
+  SnapshotStressWriter *w = (SnapshotStressWriter *)pvParameters;
+  int32_t v = w->id;
+  while (!*w->stop) {
+    int32_t pos[4] = { v, v, v, v };
+    w->store->setPosition(pos);
+    w->store->setSdProgress((uint32_t)v, (uint32_t)v, v & 1);
+    w->writes = w->writes + 2;
+    v += 2;
+    // Laisse passer IDLE pour le chien de garde des tâches
+    if ((w->writes & 0x3FF) == 0) vTaskDelay(1);
+  }
+  w->done = true;
+  vTaskDelete(NULL);
+}
+
+bool MachineStateStore::stressTest(uint32_t duration_ms, MachineStateStressResult &result) {
+  // Instance statique, hors de la pile de SnapTest ; ses compteurs repartent de zéro à
+  // chaque passe (un seul test à la fois, garanti par stressRunning ou par l'appelant)
+  static MachineStateStore store;
+  store.resetReadStats();
+  memset(&result, 0, sizeof(result));
+  volatile bool stop = false;
+  SnapshotStressWriter writers[2] = { { &store, &stop, 0, false, 0 }, { &store, &stop, 0, false, 1 } };
+  bool started = true;
+  for (int core = 0; core < 2; core++) {
+    if (xTaskCreatePinnedToCore(snapshotStressWriterTask, "SnapWriter", 2048, &writers[core], 1, NULL, core) != pdPASS) {
+      // Rien n'attendra cet écrivain : le lecteur ne doit pas bloquer sur son drapeau
+      writers[core].done = true;
+      started = false;
+    }
+  }
+  uint32_t start = millis();
+  MachineState s;
+  while (started && millis() - start < duration_ms) {
+    uint32_t t0 = (uint32_t)esp_timer_get_time();
+    store.snapshot(s);
+    uint32_t dt = (uint32_t)esp_timer_get_time() - t0;
+    if (dt > result.readMaxUs) result.readMaxUs = dt;
+    if (s.pos_um[0] != s.pos_um[1] || s.pos_um[1] != s.pos_um[2] || s.pos_um[2] != s.pos_um[3] ||
+        s.sd_bytes != s.sd_size) {
+      result.torn++;
+    }
+  }
+  stop = true;
+  while (!writers[0].done || !writers[1].done) vTaskDelay(1);
+  MachineStateReadStats rs;
+  store.getReadStats(rs);
+  result.reads = rs.reads;
+  result.writes = writers[0].writes + writers[1].writes;
+  result.retries = rs.retries;
+  result.maxRetries = rs.maxRetries;
+  return started;
+}
+
+static std::atomic<bool> stressRunning(false);
+
+static void snapshotStressTask(void *pvParameters) {
+  uint32_t duration_ms = (uint32_t)(uintptr_t)pvParameters;
+  MachineStateStressResult r;
+  if (!MachineStateStore::stressTest(duration_ms, r)) {
+    Serial.println("ERROR: TEST_SNAPSHOT writer task creation failed");
+  } else {
+    reportLine("%s: TEST_SNAPSHOT reads=%lu writes=%lu retries=%lu max_retries=%lu read_max_us=%lu torn=%lu\n",
+               r.torn ? "ERROR" : "OK", (unsigned long)r.reads, (unsigned long)r.writes, (unsigned long)r.retries,
+               (unsigned long)r.maxRetries, (unsigned long)r.readMaxUs, (unsigned long)r.torn);
+  }
+  stressRunning.store(false, std::memory_order_release);
+  vTaskDelete(NULL);
+}
+
+bool MachineStateStore::startStressTest(uint32_t duration_ms) {
+  bool expected = false;
+  if (!stressRunning.compare_exchange_strong(expected, true)) return false;
+  // CommTask continue de lire la liaison pendant le test : le lecteur a sa tâche, priorité 1
+  if (xTaskCreatePinnedToCore(snapshotStressTask, "SnapTest", 3072, (void *)(uintptr_t)duration_ms, 1, NULL,
+                              tskNO_AFFINITY) != pdPASS) {
+    stressRunning.store(false, std::memory_order_release);
+    return false;
+  }
+  return true;
+}
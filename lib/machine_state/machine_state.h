@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// État machine partagé entre les tâches : valeurs entières pour que les rapports
+// se formatent sans flottants (positions en µm, températures en centièmes de °C)
+struct MachineState {
+  int32_t pos_um[4];          // X, Y, Z, E commandés
+  int16_t hotend_cdeg;
+  int16_t hotend_target_cdeg;
+  int16_t bed_cdeg;
+  int16_t bed_target_cdeg;
+  uint32_t sd_bytes;          // Octets du fichier en cours déjà lus
+  uint32_t sd_size;
+  bool printing;
+};
+
+enum MachineAxis { AXIS_X = 0, AXIS_Y, AXIS_Z, AXIS_E };
+
+struct MachineStateReadStats {
+  uint32_t reads;
+  uint32_t retries;          // Lectures recommencées car un écrivain publiait
+  uint32_t maxRetries;
+};
+
+struct MachineStateStressResult {
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t retries;
+  uint32_t maxRetries;
+  uint32_t readMaxUs;
+  uint32_t torn;             // Copies mélangeant deux publications
+};
+
+// Publication par seqlock : les lecteurs (UI, rapports) ne prennent aucun verrou et
+// n'interfèrent jamais avec les écrivains ; ils recopient l'état et recommencent si une
+// publication a eu lieu pendant la copie. Seuls les écrivains se sérialisent entre eux,
+// le temps de recopier quelques mots.
+class MachineStateStore {
+private:
+  static const size_t WORDS = sizeof(MachineState) / sizeof(uint32_t);
+  std::atomic<uint32_t> sequence;      // Impair pendant une publication
+  std::atomic<uint32_t> words[WORDS];  // État publié, lu mot à mot
+  MachineState shadow;                 // Copie de travail des écrivains
+  portMUX_TYPE writerMux;
+  std::atomic<uint32_t> statReads;
+  std::atomic<uint32_t> statRetries;
+  std::atomic<uint32_t> statMaxRetries;
+
+  void publish();
+
+public:
+  MachineStateStore();
+  // Copie cohérente, sans verrou ; renvoie le numéro de version (pair) pour que l'UI
+  // puisse sauter un rafraîchissement quand rien n'a changé
+  uint32_t snapshot(MachineState &out);
+  uint32_t version() const { return sequence.load(std::memory_order_acquire); }
+  void setPosition(const int32_t pos_um[4]);
+  void setHotend(int16_t current_cdeg, int16_t target_cdeg);
+  void setHotendTarget(int16_t target_cdeg);
+  void setBed(int16_t current_cdeg, int16_t target_cdeg);
+  void setBedTarget(int16_t target_cdeg);
+  void setSdProgress(uint32_t bytes, uint32_t size, bool printing);
+  void getReadStats(MachineStateReadStats &out) const;
+  void resetReadStats();
+  // Écrivains sur les deux cœurs contre le lecteur appelant, sur une instance à part, et
+  // décompte des lectures incohérentes ; les compteurs ne portent que sur cet appel.
+  // false si un écrivain n'a pas pu être créé
+  static bool stressTest(uint32_t duration_ms, MachineStateStressResult &result);
+  // Commande TEST_SNAPSHOT : le test tourne dans sa propre tâche, qui affiche le bilan ;
+  // false si un test est déjà en cours ou si la tâche n'a pas pu être créée
+  static bool startStressTest(uint32_t duration_ms);
+};
+
+extern MachineStateStore machineState;
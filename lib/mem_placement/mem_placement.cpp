@@ -0,0 +1,169 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "mem_placement.h"
+#include "heap_guard.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <string.h>
+#if defined(ARDUINO)
+#if __has_include(<esp_memory_utils.h>)
+#include <esp_memory_utils.h>
+#else
+#include <soc/soc_memory_layout.h>
+#endif
+#endif
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+MemPlacement memPlacement;
+
+static const char *const classNames[] = { "dma", "hot", "bulk" };
+static const char *const regionNames[] = { "internal", "psram" };
+
+static uint32_t capsFor(MemClass cls) {
+  switch (cls) {
+    case MemClass::DMA: return MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL;
+    case MemClass::HOT: return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    default: return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+  }
+}
+
+MemPlacement::MemPlacement() : entries(), entryCount(0), fallbacks(0), costs(), mux(portMUX_INITIALIZER_UNLOCKED) {}
+
+void MemPlacement::init() {
+  measure();
+}
+
+MemRegion MemPlacement::regionOf(const void *p) {
+#if defined(ARDUINO)
+  return esp_ptr_external_ram(p) ? MemRegion::PSRAM : MemRegion::INTERNAL;
+#else
+  return MemRegion::INTERNAL;
+#endif
+}
+
+void MemPlacement::record(const char *tag, MemClass cls, MemRegion region, size_t size) {
+  portENTER_CRITICAL(&mux);
+  MemPlacementEntry *e = nullptr;
+  for (size_t i = 0; i < entryCount && !e; i++) {
+    if (entries[i].region == region && entries[i].cls == cls && strcmp(entries[i].tag, tag) == 0) e = &entries[i];
+  }
+  if (!e && entryCount < MEM_PLACEMENT_TAGS) {
+    e = &entries[entryCount++];
+    e->tag = tag;
+    e->cls = cls;
+    e->region = region;
+  }
+  if (e) {
+    e->count++;
+    e->bytes += (uint32_t)size;
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+void *MemPlacement::alloc(size_t size, MemClass cls, const char *tag) {
+  MemRegion region = cls == MemClass::BULK ? MemRegion::PSRAM : MemRegion::INTERNAL;
+  void *p = heap_caps_malloc(size, capsFor(cls));
+  if (!p && cls == MemClass::BULK) {
+    // Sans PSRAM (ou pleine) : le cache tient en SRAM interne, au détriment du reste
+    p = heap_caps_malloc(size, capsFor(MemClass::HOT));
+    region = MemRegion::INTERNAL;
+    if (p) {
+      // Allocations concurrentes depuis plusieurs tâches : compteur sous mux, comme record()
+      portENTER_CRITICAL(&mux);
+      fallbacks++;
+      portEXIT_CRITICAL(&mux);
+      DEBUG_PRINTF_AUTO("Tampon %s (%u octets) en SRAM interne faute de PSRAM", tag, (unsigned)size);
+    }
+  }
+  if (!p) {
+    DEBUG_ERRORF_AUTO("Erreur: Allocation %s de %u octets (%s) impossible", tag, (unsigned)size,
+                      classNames[(int)cls]);
+    return nullptr;
+  }
+  record(tag, cls, region, size);
+  return p;
+}
+
+void MemPlacement::track(const void *p, size_t size, MemClass cls, const char *tag) {
+  if (p) record(tag, cls, regionOf(p), size);
+}
+
+// Sonde de size octets (puissance de 2) : au-delà du cache de données pour la PSRAM,
+// sinon seul le cache serait mesuré. Meilleur de trois passages, la tâche pouvant être
+// interrompue.
+bool MemPlacement::probe(uint32_t caps, size_t size, MemRegionCost &out) {
+  memset(&out, 0, sizeof(out));
+  if (heap_caps_get_total_size(caps) == 0) return false;
+  uint32_t *buf = (uint32_t *)heap_caps_malloc(size, caps);
+  if (!buf) return false;
+  const size_t words = size / sizeof(uint32_t);
+  volatile uint32_t sink = 0;
+  int64_t bestRead = INT64_MAX, bestWrite = INT64_MAX, bestRandom = INT64_MAX;
+  for (int pass = 0; pass < 3; pass++) {
+    int64_t t0 = esp_timer_get_time();
+    memset(buf, pass, size);
+    int64_t t1 = esp_timer_get_time();
+    uint32_t sum = 0;
+    for (size_t i = 0; i < words; i++) sum += buf[i];
+    int64_t t2 = esp_timer_get_time();
+    // Générateur congruentiel : des sauts qui ne suivent aucune ligne de cache
+    uint32_t x = 12345;
+    for (uint32_t i = 0; i < MEM_PROBE_RANDOM_READS; i++) {
+      x = x * 1664525u + 1013904223u;
+      sum += buf[(x >> 8) & (words - 1)];
+    }
+    int64_t t3 = esp_timer_get_time();
+    sink = sink + sum;
+    if (t1 - t0 < bestWrite) bestWrite = t1 - t0;
+    if (t2 - t1 < bestRead) bestRead = t2 - t1;
+    if (t3 - t2 < bestRandom) bestRandom = t3 - t2;
+  }
+  heap_caps_free(buf);
+  // Octets par µs * 1000 = Ko/s (1 Ko = 1000 octets)
+  out.probeBytes = (uint32_t)size;
+  out.writeKBps = (uint32_t)(size * 1000 / (bestWrite > 0 ? bestWrite : 1));
+  out.readKBps = (uint32_t)(size * 1000 / (bestRead > 0 ? bestRead : 1));
+  out.randomNs = (uint32_t)(bestRandom * 1000 / MEM_PROBE_RANDOM_READS);
+  return true;
+}
+
+bool MemPlacement::measure() {
+  if (heapGuard.isLocked()) return false;
+  MemRegionCost internal, psram;
+  probe(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MEM_PROBE_INTERNAL_BYTES, internal);
+  probe(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MEM_PROBE_PSRAM_BYTES, psram);
+  costs[(int)MemRegion::INTERNAL] = internal;
+  costs[(int)MemRegion::PSRAM] = psram;
+  DEBUG_PRINTF_AUTO("Coût d'accès : interne %lu Ko/s, PSRAM %lu Ko/s en lecture", (unsigned long)internal.readKBps,
+                    (unsigned long)psram.readKBps);
+  return true;
+}
+
+void MemPlacement::printReport() {
+  const uint32_t regionCaps[2] = { MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT };
+  uint32_t placed[2] = { 0, 0 };
+  portENTER_CRITICAL(&mux);
+  size_t n = entryCount;
+  MemPlacementEntry copy[MEM_PLACEMENT_TAGS];
+  memcpy(copy, entries, n * sizeof(MemPlacementEntry));
+  uint32_t fallbackCount = fallbacks;
+  portEXIT_CRITICAL(&mux);
+  for (size_t i = 0; i < n; i++) placed[(int)copy[i].region] += copy[i].bytes;
+
+  for (int r = 0; r < 2; r++) {
+    const MemRegionCost &c = costs[r];
+    reportLine("MEM region=%s total=%lu free=%lu largest=%lu placed=%lu probe=%lu read_kbps=%lu write_kbps=%lu "
+               "random_ns=%lu\n",
+               regionNames[r], (unsigned long)heap_caps_get_total_size(regionCaps[r]),
+               (unsigned long)heap_caps_get_free_size(regionCaps[r]),
+               (unsigned long)heap_caps_get_largest_free_block(regionCaps[r]), (unsigned long)placed[r],
+               (unsigned long)c.probeBytes, (unsigned long)c.readKBps, (unsigned long)c.writeKBps,
+               (unsigned long)c.randomNs);
+  }
+  for (size_t i = 0; i < n; i++) {
+    reportLine("PLACE tag=%s class=%s region=%s count=%u bytes=%lu\n", copy[i].tag, classNames[(int)copy[i].cls],
+               regionNames[(int)copy[i].region], (unsigned)copy[i].count, (unsigned long)copy[i].bytes);
+  }
+  reportLine("MEM fallbacks=%lu\n", (unsigned long)fallbackCount);
+  Serial.println("OK");
+}
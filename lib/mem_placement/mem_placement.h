@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include "../config.h"
+
+// Placement des gros tampons selon leur usage, pour la PSRAM octale (8 Mo) de la carte :
+//  - DMA  : lu par un périphérique (tampons de rendu LVGL), SRAM interne DMA seulement
+//  - HOT  : accès serrés sur le chemin du mouvement, SRAM interne seulement
+//  - BULK : caches, images, décodage ; PSRAM, SRAM interne en dernier recours
+// Chaque tampon porte une étiquette (chaîne littérale) ; MEM affiche la place prise par
+// étiquette et par région, avec le coût d'accès mesuré de chaque région au démarrage.
+
+enum class MemClass : uint8_t { DMA, HOT, BULK };
+enum class MemRegion : uint8_t { INTERNAL, PSRAM };
+
+struct MemRegionCost {
+  uint32_t probeBytes;      // 0 : région absente ou mesure impossible
+  uint32_t readKBps;        // Lecture séquentielle par mots de 32 bits
+  uint32_t writeKBps;       // Écriture séquentielle (memset)
+  uint32_t randomNs;        // Lecture de 32 bits à une adresse pseudo-aléatoire
+};
+
+struct MemPlacementEntry {
+  const char *tag;
+  MemClass cls;
+  MemRegion region;
+  uint16_t count;
+  uint32_t bytes;
+};
+
+class MemPlacement {
+public:
+  MemPlacement();
+  // Mesure des régions ; à appeler au démarrage, avant le verrouillage du tas
+  void init();
+  // nullptr si la classe ne trouve pas de place (BULK se rabat sur la SRAM interne)
+  void *alloc(size_t size, MemClass cls, const char *tag);
+  // Tampon statique placé par l'éditeur de liens (DMA_ATTR, EXT_RAM_ATTR) : compté seulement
+  void track(const void *p, size_t size, MemClass cls, const char *tag);
+  // false si le tas est verrouillé : la mesure alloue ses sondes
+  bool measure();
+  const MemRegionCost &cost(MemRegion region) const { return costs[(int)region]; }
+  void printReport();
+
+private:
+  MemPlacementEntry entries[MEM_PLACEMENT_TAGS];
+  size_t entryCount;
+  uint32_t fallbacks;       // BULK servis en SRAM interne faute de PSRAM
+  MemRegionCost costs[2];
+  portMUX_TYPE mux;
+
+  void record(const char *tag, MemClass cls, MemRegion region, size_t size);
+  static MemRegion regionOf(const void *p);
+  static bool probe(uint32_t caps, size_t size, MemRegionCost &out);
+};
+
+extern MemPlacement memPlacement;
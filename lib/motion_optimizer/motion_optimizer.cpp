@@ -0,0 +1,219 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_PARSER
+#include "motion_optimizer.h"
+#include "machine_state.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <math.h>
+#include <string.h>
+
+MotionOptimizer motionOptimizer;
+
+MotionOptimizer::MotionOptimizer()
+    : sink(nullptr), sinkContext(nullptr), enabled(OPTIMIZER_ENABLED_DEFAULT), stats(), cmds(), px(), py(), count(0),
+      runCode(0), runZ(0.0f), runFeed(0.0f), runAbsE(true), endE(0.0f), runLength(0.0f), runExtrusion(0.0f),
+      runRelativeE(0.0), fitsLine(false), fitsArc(false), arcCx(0.0f), arcCy(0.0f), arcClockwise(false), feed(-1.0f),
+      residualE(0.0) {}
+
+void MotionOptimizer::setSink(Sink sink, void *context) {
+  this->sink = sink;
+  sinkContext = context;
+}
+
+void MotionOptimizer::resetStats() {
+  memset(&stats, 0, sizeof(stats));
+}
+
+void MotionOptimizer::printStats() {
+  MotionOptimizerStats s = stats;
+  float reduction = s.commandsIn ? 100.0f * (1.0f - (float)s.commandsOut / (float)s.commandsIn) : 0.0f;
+  reportLine("OPTIMIZE enabled=%d in=%lu out=%lu lines=%lu arcs=%lu merged=%lu reduction_pct=%.1f\n",
+             enabled ? 1 : 0, (unsigned long)s.commandsIn, (unsigned long)s.commandsOut,
+             (unsigned long)s.linesMerged, (unsigned long)s.arcsFitted, (unsigned long)s.segmentsMerged, reduction);
+  Serial.println("OK");
+}
+
+bool MotionOptimizer::emit(const MotionCommand &cmd) {
+  stats.commandsOut++;
+  return sink ? sink(cmd, sinkContext) : true;
+}
+
+// G0/G1 en XY à Z constant, en G90 : les autres commandes coupent la suite
+bool MotionOptimizer::mergeable(const MotionCommand &cmd, const float start[4], const float end[4],
+                                bool absolutePositioning) const {
+  if (cmd.type != 'G' || (cmd.code != (int)GcodeType::G0 && cmd.code != (int)GcodeType::G1)) return false;
+  if (!absolutePositioning || cmd.has_s || end[AXIS_Z] != start[AXIS_Z]) return false;
+  float dx = end[AXIS_X] - start[AXIS_X], dy = end[AXIS_Y] - start[AXIS_Y];
+  return dx * dx + dy * dy > 1e-8f;
+}
+
+bool MotionOptimizer::compatible(const MotionCommand &cmd, const float start[4], const float end[4],
+                                 bool absoluteExtrusion) const {
+  if (count == 0 || count >= OPTIMIZER_MAX_SEGMENTS) return false;
+  if (cmd.code != runCode || end[AXIS_Z] != runZ || absoluteExtrusion != runAbsE || feed != runFeed) return false;
+  float de = end[AXIS_E] - start[AXIS_E];
+  if (runExtrusion == 0.0f || de == 0.0f) return runExtrusion == de;
+  // Même extrusion par mm : la fusion ne déplace pas de matière le long du trajet
+  float dx = end[AXIS_X] - start[AXIS_X], dy = end[AXIS_Y] - start[AXIS_Y];
+  float ratio = runExtrusion / runLength;
+  return fabsf(de / sqrtf(dx * dx + dy * dy) - ratio) <= OPTIMIZER_E_RATIO_TOLERANCE * fabsf(ratio);
+}
+
+void MotionOptimizer::begin(const MotionCommand &cmd, const float start[4], const float end[4],
+                            bool absoluteExtrusion) {
+  count = 1;
+  px[0] = start[AXIS_X];
+  py[0] = start[AXIS_Y];
+  px[1] = end[AXIS_X];
+  py[1] = end[AXIS_Y];
+  runCode = cmd.code;
+  runZ = end[AXIS_Z];
+  runFeed = feed;
+  runAbsE = absoluteExtrusion;
+  runLength = 0.0f;
+  runExtrusion = 0.0f;
+  runRelativeE = 0.0;
+  fitsLine = true;
+  fitsArc = false;
+  cmds[0] = cmd;
+  accumulate(cmd, start, end);
+}
+
+void MotionOptimizer::accumulate(const MotionCommand &cmd, const float start[4], const float end[4]) {
+  float dx = end[AXIS_X] - start[AXIS_X], dy = end[AXIS_Y] - start[AXIS_Y];
+  runLength += sqrtf(dx * dx + dy * dy);
+  runExtrusion += end[AXIS_E] - start[AXIS_E];
+  if (cmd.has_e) runRelativeE += cmd.e;
+  endE = end[AXIS_E];
+}
+
+// Points intermédiaires à la tolérance de la droite départ-arrivée, sans retour en arrière
+bool MotionOptimizer::checkLine() const {
+  float dx = px[count] - px[0], dy = py[count] - py[0];
+  float length = sqrtf(dx * dx + dy * dy);
+  if (length < 1e-4f) return false;
+  dx /= length;
+  dy /= length;
+  for (uint8_t k = 1; k <= count; k++) {
+    if ((px[k] - px[k - 1]) * dx + (py[k] - py[k - 1]) * dy <= 0.0f) return false;
+    if (k < count && fabsf((px[k] - px[0]) * dy - (py[k] - py[0]) * dx) > OPTIMIZER_LINE_TOLERANCE_MM) return false;
+  }
+  return true;
+}
+
+// Cercle par le départ, le point du milieu et l'arrivée ; chaque point et chaque corde
+// doivent y rester à la tolérance, en tournant toujours dans le même sens
+bool MotionOptimizer::checkArc(float &cx, float &cy, bool &clockwise) const {
+  if (count < 2 || runFeed <= 0.0f) return false;
+  // Calcul relatif au départ : la précision float reste au micron sur tout le plateau
+  float bx = px[count / 2] - px[0], by = py[count / 2] - py[0];
+  float ex = px[count] - px[0], ey = py[count] - py[0];
+  float d = 2.0f * (bx * ey - by * ex);
+  if (fabsf(d) < 1e-9f) return false;
+  float b2 = bx * bx + by * by, e2 = ex * ex + ey * ey;
+  float ux = (ey * b2 - by * e2) / d;
+  float uy = (bx * e2 - ex * b2) / d;
+  float r = sqrtf(ux * ux + uy * uy);
+  if (r < OPTIMIZER_ARC_MIN_RADIUS_MM || r > OPTIMIZER_ARC_MAX_RADIUS_MM) return false;
+
+  float sweep = 0.0f;
+  float vx = -ux, vy = -uy;
+  for (uint8_t k = 1; k <= count; k++) {
+    float wx = px[k] - px[0] - ux, wy = py[k] - py[0] - uy;
+    if (fabsf(sqrtf(wx * wx + wy * wy) - r) > OPTIMIZER_ARC_TOLERANCE_MM) return false;
+    float step = atan2f(vx * wy - vy * wx, vx * wx + vy * wy);
+    // Même sens de rotation, pas plus d'un quart de tour par segment
+    if (step == 0.0f || fabsf(step) > (float)M_PI_2 || (k > 1 && (step > 0.0f) != (sweep > 0.0f))) return false;
+    // Flèche de la corde : écart entre le segment d'origine et l'arc
+    float halfChord = r * sinf(0.5f * fabsf(step));
+    if (r - sqrtf(r * r - halfChord * halfChord) > OPTIMIZER_ARC_TOLERANCE_MM) return false;
+    sweep += step;
+    vx = wx;
+    vy = wy;
+  }
+  // Un tour complet rendrait l'arc ambigu (départ = arrivée)
+  if (fabsf(sweep) > 2.0f * (float)M_PI - 0.01f) return false;
+  cx = px[0] + ux;
+  cy = py[0] + uy;
+  clockwise = sweep < 0.0f;
+  return true;
+}
+
+bool MotionOptimizer::push(const MotionCommand &cmd, const float start[4], const float end[4],
+                           bool absolutePositioning, bool absoluteExtrusion) {
+  stats.commandsIn++;
+  if (cmd.type == 'G' && cmd.code <= (int)GcodeType::G3 && cmd.has_f) feed = cmd.f;
+  if (!enabled || !mergeable(cmd, start, end, absolutePositioning)) {
+    bool ok = flush();
+    return emit(cmd) && ok;
+  }
+  if (compatible(cmd, start, end, absoluteExtrusion)) {
+    // Essai avec le nouveau point : gardé si la suite reste une droite ou un arc
+    px[count + 1] = end[AXIS_X];
+    py[count + 1] = end[AXIS_Y];
+    count++;
+    float cx = 0.0f, cy = 0.0f;
+    bool clockwise = false;
+    bool line = checkLine();
+    bool arc = !line && checkArc(cx, cy, clockwise);
+    if (line || arc) {
+      cmds[count - 1] = cmd;
+      accumulate(cmd, start, end);
+      fitsLine = line;
+      fitsArc = arc;
+      arcCx = cx;
+      arcCy = cy;
+      arcClockwise = clockwise;
+      return true;
+    }
+    count--;
+  }
+  bool ok = flush();
+  begin(cmd, start, end, absoluteExtrusion);
+  return ok;
+}
+
+bool MotionOptimizer::flush() {
+  if (count == 0) return true;
+  uint8_t n = count;
+  count = 0;
+  if (n == 1 || (!fitsLine && !(fitsArc && n >= OPTIMIZER_ARC_MIN_SEGMENTS))) {
+    // Rien à gagner : segments d'origine, inchangés
+    bool ok = true;
+    for (uint8_t k = 0; k < n; k++) ok = emit(cmds[k]) && ok;
+    return ok;
+  }
+
+  MotionCommand out = {'G', runCode, px[n], py[n], 0.0f, 0.0f, runFeed, 0.0f, true, true, false, false,
+                       cmds[0].has_f, false, 0.0f, 0.0f, false, false};
+  bool hasE = false;
+  for (uint8_t k = 0; k < n; k++) hasE = hasE || cmds[k].has_e;
+  if (hasE) {
+    out.has_e = true;
+    if (runAbsE) {
+      out.e = endE;
+    } else {
+      // Somme des E relatifs, le reste d'arrondi passe à la fusion suivante
+      double total = runRelativeE + residualE;
+      out.e = (float)total;
+      residualE = total - out.e;
+    }
+  }
+  if (fitsLine) {
+    stats.linesMerged++;
+  } else {
+    out.code = arcClockwise ? (int)GcodeType::G2 : (int)GcodeType::G3;
+    out.has_f = true;   // Requis par le parser pour G2/G3
+    out.i = arcCx - px[0];
+    out.j = arcCy - py[0];
+    out.has_i = out.has_j = true;
+    stats.arcsFitted++;
+  }
+  stats.segmentsMerged += n;
+  DEBUG_TRACEF_AUTO("%u segments émis en G%d", (unsigned)n, out.code);
+  return emit(out);
+}
+
+void MotionOptimizer::discard() {
+  count = 0;
+  residualE = 0.0;
+}
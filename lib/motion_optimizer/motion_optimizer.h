@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include "gcode_parser.h"
+#include "../config.h"
+
+// Étage optionnel entre le parser et motionQueue : les suites de G0/G1 courts du slicer
+// sont regroupées, en une seule droite si les points restent à OPTIMIZER_LINE_TOLERANCE_MM
+// du segment, sinon en un arc G2/G3 s'ils restent (cordes comprises) à
+// OPTIMIZER_ARC_TOLERANCE_MM d'un cercle. Une suite garde même Z, même F, même sens et
+// même extrusion par mm ; le point d'arrivée est celui du dernier segment.
+// L'extrusion est conservée : en M82 la commande fusionnée reprend le E absolu final, en
+// M83 la somme des E relatifs est émise avec report du reste d'arrondi à la fusion suivante.
+// Le même code sert au firmware (ParserTask) et au prétraitement sur l'hôte.
+
+struct MotionOptimizerStats {
+  uint32_t commandsIn;      // Commandes reçues
+  uint32_t commandsOut;     // Commandes émises
+  uint32_t linesMerged;     // Droites émises à la place de plusieurs segments
+  uint32_t arcsFitted;      // Arcs G2/G3 émis
+  uint32_t segmentsMerged;  // Segments absorbés par ces droites et arcs
+};
+
+class MotionOptimizer {
+public:
+  typedef bool (*Sink)(const MotionCommand &cmd, void *context);
+
+  MotionOptimizer();
+  void setSink(Sink sink, void *context);
+  // Prise en compte à la prochaine commande : la suite en attente est d'abord émise
+  void setEnabled(bool on) { enabled = on; }
+  bool isEnabled() const { return enabled; }
+
+  // Commande parsée, avec les positions absolues commandées avant et après
+  // (GcodeParser::currentPosition) et les modes G90/G91 et M82/M83 en vigueur.
+  // false si le sink a refusé une commande.
+  bool push(const MotionCommand &cmd, const float start[4], const float end[4], bool absolutePositioning,
+            bool absoluteExtrusion);
+  // Émet la suite en attente (flux interrompu, fin de job)
+  bool flush();
+  // Abandonne la suite en attente (arrêt d'urgence)
+  void discard();
+  bool hasPending() const { return count > 0; }
+
+  const MotionOptimizerStats &getStats() const { return stats; }
+  void resetStats();
+  void printStats();
+
+private:
+  Sink sink;
+  void *sinkContext;
+  volatile bool enabled;
+  MotionOptimizerStats stats;
+
+  // Suite en attente : cmds[k] mène de (px[k], py[k]) à (px[k + 1], py[k + 1])
+  MotionCommand cmds[OPTIMIZER_MAX_SEGMENTS];
+  float px[OPTIMIZER_MAX_SEGMENTS + 1];
+  float py[OPTIMIZER_MAX_SEGMENTS + 1];
+  uint8_t count;
+  int runCode;
+  float runZ;
+  float runFeed;
+  bool runAbsE;
+  float endE;               // E absolu après le dernier segment (M82)
+  float runLength;          // mm en XY
+  float runExtrusion;       // E avancé sur la suite
+  double runRelativeE;      // Somme des E relatifs (M83)
+  bool fitsLine;
+  bool fitsArc;
+  float arcCx, arcCy;
+  bool arcClockwise;
+
+  float feed;               // F modal (mm/s), négatif tant qu'inconnu
+  double residualE;         // Reste d'arrondi des E relatifs déjà émis
+
+  bool mergeable(const MotionCommand &cmd, const float start[4], const float end[4], bool absolutePositioning) const;
+  bool compatible(const MotionCommand &cmd, const float start[4], const float end[4], bool absoluteExtrusion) const;
+  void begin(const MotionCommand &cmd, const float start[4], const float end[4], bool absoluteExtrusion);
+  void accumulate(const MotionCommand &cmd, const float start[4], const float end[4]);
+  bool checkLine() const;
+  bool checkArc(float &cx, float &cy, bool &clockwise) const;
+  bool emit(const MotionCommand &cmd);
+};
+
+extern MotionOptimizer motionOptimizer;
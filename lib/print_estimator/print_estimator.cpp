@@ -0,0 +1,445 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
+#include "print_estimator.h"
+#include "gcode_parser.h"
+#include "machine_state.h"
+#include "sd_manager.h"
+#include "heap_guard.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+static_assert(sizeof(EstimateCacheHeader) == 24, "EstimateCacheHeader ne doit pas avoir de remplissage");
+static_assert(sizeof(EstimateProfilePoint) == 8, "EstimateProfilePoint ne doit pas avoir de remplissage");
+static const char ESTIMATE_MAGIC[4] = { 'E', 'S', 'T', '1' };
+
+PrintEstimator printEstimator;
+
+PlannerModel::PlannerModel() {
+  reset();
+}
+
+void PlannerModel::reset() {
+  tail = 0;
+  count = 0;
+  hasLast = false;
+  lastNominalSq = 0.0f;
+  seconds = 0.0;
+}
+
+void PlannerModel::addMove(const float delta[4], float feed) {
+  float xyzSq = delta[AXIS_X] * delta[AXIS_X] + delta[AXIS_Y] * delta[AXIS_Y] + delta[AXIS_Z] * delta[AXIS_Z];
+  float de = delta[AXIS_E];
+  bool extruderOnly = xyzSq < 1e-12f;
+  float length = extruderOnly ? fabsf(de) : sqrtf(xyzSq);
+  if (length < 1e-6f) return;
+
+  // F s'applique au trajet XYZ, chaque axe restant sous sa vitesse maximale
+  static const float maxFeed[4] = { PLANNER_MAX_FEED_XY_MM_S, PLANNER_MAX_FEED_XY_MM_S, PLANNER_MAX_FEED_Z_MM_S,
+                                    PLANNER_MAX_FEED_E_MM_S };
+  float speed = feed > 0.0f ? feed : PLANNER_DEFAULT_FEED_MM_S;
+  for (int i = 0; i < 4; i++) {
+    float d = fabsf(delta[i]);
+    if (d > 0.0f && speed * d > maxFeed[i] * length) speed = maxFeed[i] * length / d;
+  }
+  float accel = extruderOnly ? PLANNER_RETRACT_ACCEL_MM_S2 : (de != 0.0f ? PLANNER_ACCEL_MM_S2 : PLANNER_TRAVEL_ACCEL_MM_S2);
+
+  float norm = 1.0f / sqrtf(xyzSq + de * de);
+  float unit[4];
+  for (int i = 0; i < 4; i++) unit[i] = delta[i] * norm;
+
+  Block b;
+  b.length = length;
+  b.accel = accel;
+  b.nominalSq = speed * speed;
+  if (count == 0 || !hasLast) {
+    // Départ à l'arrêt
+    b.maxEntrySq = 0.0f;
+  } else {
+    // Écart de jonction : vitesse pour laquelle l'arc inscrit dans l'angle reste à
+    // PLANNER_JUNCTION_DEV_MM du sommet, sous l'accélération du bloc
+    float cosTheta = 0.0f;
+    for (int i = 0; i < 4; i++) cosTheta -= lastUnit[i] * unit[i];
+    float junctionSq;
+    if (cosTheta > 0.999999f) {
+      junctionSq = 0.0f;        // Demi-tour
+    } else if (cosTheta < -0.999999f) {
+      junctionSq = FLT_MAX;     // Tout droit
+    } else {
+      float sinHalf = sqrtf(0.5f * (1.0f - cosTheta));
+      junctionSq = accel * PLANNER_JUNCTION_DEV_MM * sinHalf / (1.0f - sinHalf);
+    }
+    b.maxEntrySq = fminf(junctionSq, fminf(b.nominalSq, lastNominalSq));
+  }
+  b.entrySq = b.maxEntrySq;
+  blocks[(tail + count) % PLANNER_BUFFER_BLOCKS] = b;
+  count++;
+  memcpy(lastUnit, unit, sizeof(lastUnit));
+  lastNominalSq = b.nominalSq;
+  hasLast = true;
+
+  recalculate();
+  if (count == PLANNER_BUFFER_BLOCKS) retire();
+}
+
+// Passe arrière depuis l'arrêt supposé après le dernier bloc, puis passe avant depuis le
+// bloc le plus ancien, dont la vitesse d'entrée est déjà engagée
+void PlannerModel::recalculate() {
+  float nextSq = 0.0f;
+  for (int k = count - 1; k > 0; k--) {
+    Block &b = blocks[(tail + k) % PLANNER_BUFFER_BLOCKS];
+    b.entrySq = fminf(b.maxEntrySq, nextSq + 2.0f * b.accel * b.length);
+    nextSq = b.entrySq;
+  }
+  for (int k = 0; k + 1 < count; k++) {
+    const Block &b = blocks[(tail + k) % PLANNER_BUFFER_BLOCKS];
+    Block &n = blocks[(tail + k + 1) % PLANNER_BUFFER_BLOCKS];
+    float reachableSq = b.entrySq + 2.0f * b.accel * b.length;
+    if (n.entrySq > reachableSq) n.entrySq = reachableSq;
+  }
+}
+
+void PlannerModel::retire() {
+  const Block &b = blocks[tail];
+  float exitSq = count > 1 ? blocks[(tail + 1) % PLANNER_BUFFER_BLOCKS].entrySq : 0.0f;
+  seconds += blockTime(b, exitSq);
+  tail = (tail + 1) % PLANNER_BUFFER_BLOCKS;
+  count--;
+}
+
+void PlannerModel::flush() {
+  while (count) retire();
+  hasLast = false;
+}
+
+// Trapèze (ou triangle si la vitesse nominale n'est pas atteinte)
+float PlannerModel::blockTime(const Block &b, float exitSq) {
+  float vi = sqrtf(b.entrySq), vf = sqrtf(exitSq), vn = sqrtf(b.nominalSq);
+  float accelDist = (b.nominalSq - b.entrySq) / (2.0f * b.accel);
+  float decelDist = (b.nominalSq - exitSq) / (2.0f * b.accel);
+  if (accelDist + decelDist <= b.length) {
+    return (vn - vi) / b.accel + (vn - vf) / b.accel + (b.length - accelDist - decelDist) / vn;
+  }
+  float vp = sqrtf(0.5f * (2.0f * b.accel * b.length + b.entrySq + exitSq));
+  if (vp < vi) vp = vi;
+  if (vp < vf) vp = vf;
+  return (vp - vi) / b.accel + (vp - vf) / b.accel;
+}
+
+PrintEstimator::PrintEstimator()
+    : readBuffer(), work(), workPoints(0), jobPath(), jobSize(0), jobStartMs(0), jobActive(false), profile(),
+      profilePoints(0), jobSeconds(0.0f), refOffset(0), refSeconds(0.0f), refMs(0), refSet(false),
+      mux(portMUX_INITIALIZER_UNLOCKED), requests(nullptr) {}
+
+static bool readFully(StorageFile *file, uint8_t *buf, size_t len) {
+  while (len > 0) {
+    int n = file->read(buf, len);
+    if (n <= 0) return false;
+    buf += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool PrintEstimator::cachePath(const char *path, char *out, size_t size) {
+  return storageSidecarPath(path, ".est", out, size);
+}
+
+bool PrintEstimator::estimate(Storage *storage, const char *path, EstimateResult &result) {
+  uint32_t t0 = millis();
+  memset(&result, 0, sizeof(result));
+  StorageStat st;
+  if (!storage || !storage->stat(path, st) || st.isDir) {
+    DEBUG_ERRORF_AUTO("Erreur: Job introuvable pour l'estimation: %s", path);
+    return false;
+  }
+  result.bytes = st.size;
+  char cache[96];
+  bool haveCache = cachePath(path, cache, sizeof(cache));
+  if (haveCache && loadCache(storage, cache, st.size, result)) {
+    result.cached = true;
+  } else {
+    if (!simulate(storage, path, result)) return false;
+    if (haveCache) saveCache(storage, cache, result);
+  }
+  result.elapsedMs = millis() - t0;
+  return true;
+}
+
+bool PrintEstimator::loadCache(Storage *storage, const char *cache, uint32_t sourceSize, EstimateResult &result) {
+  StorageFile *file = storage->open(cache, StorageMode::READ);
+  if (!file) return false;
+  EstimateCacheHeader header;
+  bool valid = readFully(file, (uint8_t *)&header, sizeof(header)) &&
+               memcmp(header.magic, ESTIMATE_MAGIC, sizeof(ESTIMATE_MAGIC)) == 0 &&
+               header.sourceSize == sourceSize && header.points <= ESTIMATE_PROFILE_POINTS &&
+               readFully(file, (uint8_t *)work, header.points * sizeof(EstimateProfilePoint));
+  file->close();
+  if (!valid) {
+    DEBUG_PRINTF_AUTO("Cache d'estimation %s périmé, nouveau calcul", cache);
+    workPoints = 0;
+    return false;
+  }
+  workPoints = header.points;
+  result.moves = header.moves;
+  result.seconds = header.seconds;
+  result.filamentMm = header.filamentMm;
+  return true;
+}
+
+void PrintEstimator::saveCache(Storage *storage, const char *cache, const EstimateResult &result) {
+  EstimateCacheHeader header;
+  memcpy(header.magic, ESTIMATE_MAGIC, sizeof(ESTIMATE_MAGIC));
+  header.sourceSize = result.bytes;
+  header.moves = result.moves;
+  header.seconds = result.seconds;
+  header.filamentMm = result.filamentMm;
+  header.points = workPoints;
+  header.reserved = 0;
+  StorageFile *file = storage->open(cache, StorageMode::WRITE);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer le cache d'estimation %s", cache);
+    return;
+  }
+  size_t profileBytes = workPoints * sizeof(EstimateProfilePoint);
+  bool ok = file->write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            file->write((const uint8_t *)work, profileBytes) == profileBytes;
+  file->close();
+  if (!ok) {
+    DEBUG_ERRORF_AUTO("Erreur: Écriture du cache d'estimation %s", cache);
+    storage->remove(cache);
+  }
+}
+
+// Le job passe par un GcodeParser neuf, comme au début d'une impression ; les lignes
+// sans effet sur la position sont écartées avant le parsing
+// Arc G2/G3 découpé en cordes de PLANNER_ARC_SEGMENT_MM comme le ferait le planificateur,
+// Z et E répartis sur l'angle ; arrivée confondue avec le départ = cercle complet
+static void addArc(PlannerModel &model, const float from[4], const float to[4], const MotionCommand &cmd,
+                   float feed) {
+  float cx = from[AXIS_X] + cmd.i, cy = from[AXIS_Y] + cmd.j;
+  float r = hypotf(from[AXIS_X] - cx, from[AXIS_Y] - cy);
+  float a0 = atan2f(from[AXIS_Y] - cy, from[AXIS_X] - cx);
+  float sweep = atan2f(to[AXIS_Y] - cy, to[AXIS_X] - cx) - a0;
+  if (cmd.code == (int)GcodeType::G2) {
+    if (sweep >= 0.0f) sweep -= 2.0f * (float)M_PI;
+  } else if (sweep <= 0.0f) {
+    sweep += 2.0f * (float)M_PI;
+  }
+  int segments = (int)ceilf(fabsf(sweep) * r / PLANNER_ARC_SEGMENT_MM);
+  if (segments < 1) segments = 1;
+  float prev[4];
+  memcpy(prev, from, sizeof(prev));
+  for (int k = 1; k <= segments; k++) {
+    float t = (float)k / (float)segments;
+    float point[4];
+    if (k == segments) {
+      memcpy(point, to, sizeof(point));
+    } else {
+      point[AXIS_X] = cx + r * cosf(a0 + sweep * t);
+      point[AXIS_Y] = cy + r * sinf(a0 + sweep * t);
+      point[AXIS_Z] = from[AXIS_Z] + (to[AXIS_Z] - from[AXIS_Z]) * t;
+      point[AXIS_E] = from[AXIS_E] + (to[AXIS_E] - from[AXIS_E]) * t;
+    }
+    float delta[4];
+    for (int i = 0; i < 4; i++) delta[i] = point[i] - prev[i];
+    model.addMove(delta, feed);
+    memcpy(prev, point, sizeof(prev));
+  }
+}
+
+bool PrintEstimator::simulate(Storage *storage, const char *path, EstimateResult &result) {
+  StorageFile *file = storage->open(path, StorageMode::READ);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir %s pour l'estimation", path);
+    return false;
+  }
+  GcodeParser parser;
+  PlannerModel model;
+  const float *pos = parser.currentPosition();
+  StorageLineReader reader(file, readBuffer, sizeof(readBuffer));
+  char line[COMM_LINE_MAX];
+  float feed = PLANNER_DEFAULT_FEED_MM_S;
+  double filament = 0.0;
+  // Un point du profil tous les size / ESTIMATE_PROFILE_POINTS octets, le dernier pour la fin
+  uint32_t step = result.bytes / (ESTIMATE_PROFILE_POINTS - 1);
+  if (step == 0) step = 1;
+  uint32_t nextMark = 0;
+  workPoints = 0;
+  bool truncated = false;
+  while (reader.readLine(line, sizeof(line), &truncated) >= 0) {
+    result.lines++;
+    // Commande coupée (pas de ';' avant la coupure) : ignorée plutôt que mal interprétée
+    if (truncated && !strchr(line, ';')) continue;
+    if (reader.offset() >= nextMark && workPoints < ESTIMATE_PROFILE_POINTS - 1) {
+      work[workPoints].offset = reader.offset();
+      work[workPoints].seconds = (float)model.elapsed();
+      workPoints++;
+      nextMark += step;
+    }
+    char *statement = GcodeParser::trackedStatement(line);
+    if (!statement) continue;
+    MotionCommand cmd;
+    if (parser.parseLine(statement, cmd) != GcodeParser::ParseResult::OK) continue;
+    if (cmd.type == 'G' && cmd.has_f) feed = cmd.f;
+    float before[4];
+    memcpy(before, pos, sizeof(before));
+    if (!parser.trackPosition(cmd) || cmd.code == (int)GcodeType::G92) continue;
+    float delta[4];
+    for (int i = 0; i < 4; i++) delta[i] = pos[i] - before[i];
+    filament += delta[AXIS_E];
+    if (cmd.has_i || cmd.has_j) {
+      addArc(model, before, pos, cmd, feed);
+    } else {
+      model.addMove(delta, cmd.code == (int)GcodeType::G28 ? PLANNER_HOMING_FEED_MM_S : feed);
+    }
+    result.moves++;
+  }
+  file->close();
+  model.flush();
+  result.seconds = (float)model.elapsed();
+  result.filamentMm = (float)filament;
+  work[workPoints].offset = result.bytes;
+  work[workPoints].seconds = result.seconds;
+  workPoints++;
+  return true;
+}
+
+void PrintEstimator::beginJob(const char *path, uint32_t size) {
+  portENTER_CRITICAL(&mux);
+  strncpy(jobPath, path, sizeof(jobPath) - 1);
+  jobPath[sizeof(jobPath) - 1] = '\0';
+  jobSize = size;
+  jobStartMs = millis();
+  jobActive = true;
+  profilePoints = 0;
+  jobSeconds = 0.0f;
+  refSet = false;
+  portEXIT_CRITICAL(&mux);
+  // Cache relu ou calcul complet : dans les deux cas hors de SDTask
+  if (!request(path, false)) {
+    DEBUG_ERRORF_AUTO("Erreur: File d'estimation pleine, pas d'ETA pour %s", path);
+  }
+}
+
+void PrintEstimator::endJob() {
+  portENTER_CRITICAL(&mux);
+  jobActive = false;
+  portEXIT_CRITICAL(&mux);
+}
+
+void PrintEstimator::installProfile(const char *path, const EstimateResult &result) {
+  portENTER_CRITICAL(&mux);
+  if (jobActive && strcmp(jobPath, path) == 0 && result.bytes == jobSize) {
+    memcpy(profile, work, workPoints * sizeof(EstimateProfilePoint));
+    profilePoints = workPoints;
+    jobSeconds = result.seconds;
+    // Premier point du profil au-delà de la durée de calage
+    refOffset = jobSize;
+    for (uint16_t i = 0; i < profilePoints; i++) {
+      if (profile[i].seconds >= ESTIMATE_ETA_SETTLE_S) {
+        refOffset = profile[i].offset;
+        break;
+      }
+    }
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+// Interpolation linéaire dans le profil, à appeler sous mux
+float PrintEstimator::secondsAt(uint32_t offset) const {
+  if (profilePoints == 0) return 0.0f;
+  if (offset <= profile[0].offset) return profile[0].seconds;
+  for (uint16_t i = 1; i < profilePoints; i++) {
+    if (offset <= profile[i].offset) {
+      const EstimateProfilePoint &a = profile[i - 1], &b = profile[i];
+      float t = b.offset > a.offset ? (float)(offset - a.offset) / (float)(b.offset - a.offset) : 1.0f;
+      return a.seconds + t * (b.seconds - a.seconds);
+    }
+  }
+  return profile[profilePoints - 1].seconds;
+}
+
+void PrintEstimator::update(uint32_t offset) {
+  portENTER_CRITICAL(&mux);
+  if (jobActive && profilePoints && !refSet && offset >= refOffset) {
+    refSeconds = secondsAt(offset);
+    refMs = millis();
+    refSet = true;
+  }
+  portEXIT_CRITICAL(&mux);
+}
+
+bool PrintEstimator::eta(uint32_t offset, EstimateEta &out) {
+  uint32_t now = millis();
+  portENTER_CRITICAL(&mux);
+  bool active = jobActive;
+  out.progress = jobSize ? (float)offset / (float)jobSize : 0.0f;
+  out.elapsedS = (now - jobStartMs) / 1000.0f;
+  out.estimateS = jobSeconds;
+  out.known = profilePoints > 0;
+  out.factor = 1.0f;
+  out.remainingS = 0.0f;
+  if (out.known) {
+    float at = secondsAt(offset);
+    // Rythme réel mesuré depuis le repère, sur au moins ESTIMATE_ETA_SETTLE_S estimées
+    if (refSet && at - refSeconds >= ESTIMATE_ETA_SETTLE_S) {
+      out.factor = ((now - refMs) / 1000.0f) / (at - refSeconds);
+    }
+    out.remainingS = (jobSeconds - at) * out.factor;
+    if (out.remainingS < 0.0f) out.remainingS = 0.0f;
+  }
+  portEXIT_CRITICAL(&mux);
+  return active;
+}
+
+void PrintEstimator::printEta() {
+  MachineState s;
+  machineState.snapshot(s);
+  EstimateEta e;
+  if (!eta(s.sd_bytes, e)) {
+    Serial.println("ERROR: No job running");
+    return;
+  }
+  reportLine("ETA file=%s progress_pct=%.1f elapsed_s=%.0f estimate_s=%.0f remaining_s=%.0f factor=%.2f known=%d\n",
+             jobPath, e.progress * 100.0f, e.elapsedS, e.estimateS, e.remainingS, e.factor, e.known ? 1 : 0);
+  Serial.println("OK");
+}
+
+struct EstimateRequest {
+  char path[SD_PATH_MAX];
+  bool report;
+};
+
+bool PrintEstimator::init() {
+  if (!requests) requests = heapGuard.createQueue(ESTIMATE_QUEUE_LENGTH, sizeof(EstimateRequest));
+  return requests != nullptr;
+}
+
+bool PrintEstimator::request(const char *path, bool report) {
+  EstimateRequest req;
+  if (!requests || strlen(path) >= sizeof(req.path)) return false;
+  strcpy(req.path, path);
+  req.report = report;
+  return xQueueSend(requests, &req, 0) == pdTRUE;
+}
+
+// Priorité minimale, comme les aperçus : un gros job occupe le cœur 0 plusieurs secondes
+void PrintEstimator::estimateTask(void *pvParameters) {
+  EstimateRequest req;
+  while (1) {
+    if (xQueueReceive(printEstimator.requests, &req, portMAX_DELAY) != pdTRUE) continue;
+    EstimateResult result;
+    if (!printEstimator.estimate(sdManager.getStorage(), req.path, result)) {
+      if (req.report) reportLine("ERROR: Estimate failed for %s\n", req.path);
+      continue;
+    }
+    printEstimator.installProfile(req.path, result);
+    if (!req.report) continue;
+    reportLine("ESTIMATE file=%s bytes=%lu lines=%lu moves=%lu time_s=%.1f filament_mm=%.1f ms=%lu cached=%d\n",
+               req.path, (unsigned long)result.bytes, (unsigned long)result.lines, (unsigned long)result.moves,
+               result.seconds, result.filamentMm, (unsigned long)result.elapsedMs, result.cached ? 1 : 0);
+    Serial.println("OK");
+  }
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "storage.h"
+#include "../config.h"
+
+// Durée et filament d'un job avant impression. Le fichier passe par le GcodeParser du
+// firmware (mêmes règles, même état modal G90/G91 et M82/M83), puis par un modèle
+// cinématique du planificateur : trapèzes d'accélération, vitesse de jonction par écart de
+// jonction, anticipation sur PLANNER_BUFFER_BLOCKS blocs. Les attentes de chauffe
+// (M109/M190) ne sont pas comptées.
+// Le résultat et un profil durée/octets sont mis en cache à côté du job (.est). Pendant
+// l'impression, le profil convertit la progression SD en durée restante, corrigée par
+// l'écart constaté entre durée réelle et durée estimée.
+
+class PlannerModel {
+public:
+  PlannerModel();
+  void reset();
+  // Mouvement en mm (X, Y, Z, E) à la vitesse demandée en mm/s
+  void addMove(const float delta[4], float feed);
+  // Exécute les blocs restants jusqu'à l'arrêt final
+  void flush();
+  // Durée des blocs déjà sortis du tampon
+  double elapsed() const { return seconds; }
+
+private:
+  struct Block {
+    float length;       // mm, XYZ (E pour un mouvement d'extrudeur seul)
+    float accel;        // mm/s²
+    float nominalSq;    // Vitesses au carré (mm²/s²)
+    float maxEntrySq;
+    float entrySq;
+  };
+  Block blocks[PLANNER_BUFFER_BLOCKS];
+  uint8_t tail;         // Bloc le plus ancien : vitesse d'entrée figée
+  uint8_t count;
+  float lastUnit[4];
+  float lastNominalSq;
+  bool hasLast;
+  double seconds;
+
+  void recalculate();
+  void retire();
+  static float blockTime(const Block &b, float exitSq);
+};
+
+struct EstimateResult {
+  uint32_t bytes;
+  uint32_t lines;       // Lignes lues (0 si le cache a servi)
+  uint32_t moves;
+  float seconds;        // Durée des mouvements
+  float filamentMm;     // Avance E nette : les rétractions réamorcées s'annulent
+  uint32_t elapsedMs;
+  bool cached;
+};
+
+// Durée estimée pour atteindre un octet du job
+struct EstimateProfilePoint {
+  uint32_t offset;
+  float seconds;
+};
+
+// En-tête du fichier .est, suivi de points EstimateProfilePoint
+struct EstimateCacheHeader {
+  char magic[4];        // "EST1"
+  uint32_t sourceSize;
+  uint32_t moves;
+  float seconds;
+  float filamentMm;
+  uint16_t points;
+  uint16_t reserved;
+};
+
+struct EstimateEta {
+  float progress;       // Fraction du job lue
+  float elapsedS;       // Depuis le début du job
+  float estimateS;      // Durée totale estimée, 0 si inconnue
+  float remainingS;     // Corrigée du rapport réel / estimé
+  float factor;
+  bool known;
+};
+
+class PrintEstimator {
+public:
+  PrintEstimator();
+  // Estimation du job path, relue depuis le cache s'il est encore valide
+  bool estimate(Storage *storage, const char *path, EstimateResult &result);
+  // "dir/job.gcode" -> "dir/job.est"
+  static bool cachePath(const char *path, char *out, size_t size);
+
+  // Suivi du job lu par SDTask : profil pris dans le cache, sinon calculé en tâche de fond
+  void beginJob(const char *path, uint32_t size);
+  // Progression de SDTask : repère le point d'où l'ETA suit le rythme réel
+  void update(uint32_t offset);
+  void endJob();
+  bool eta(uint32_t offset, EstimateEta &out);
+  void printEta();
+
+  bool init();
+  // Demande traitée par EstimateTask ; report affiche le résultat sur la console
+  bool request(const char *path, bool report);
+  static void estimateTask(void *pvParameters);
+
+private:
+  uint8_t readBuffer[512];
+  EstimateProfilePoint work[ESTIMATE_PROFILE_POINTS];   // Profil du calcul en cours
+  uint16_t workPoints;
+  // Job en cours, protégé par mux
+  char jobPath[SD_PATH_MAX];
+  uint32_t jobSize;
+  uint32_t jobStartMs;
+  bool jobActive;
+  EstimateProfilePoint profile[ESTIMATE_PROFILE_POINTS];
+  uint16_t profilePoints;
+  float jobSeconds;
+  // Repère posé une fois ESTIMATE_ETA_SETTLE_S estimées passées : la chauffe du début
+  // n'entre pas dans la correction
+  uint32_t refOffset;
+  float refSeconds;
+  uint32_t refMs;
+  bool refSet;
+  portMUX_TYPE mux;
+  QueueHandle_t requests;
+
+  bool loadCache(Storage *storage, const char *cache, uint32_t sourceSize, EstimateResult &result);
+  void saveCache(Storage *storage, const char *cache, const EstimateResult &result);
+  bool simulate(Storage *storage, const char *path, EstimateResult &result);
+  void installProfile(const char *path, const EstimateResult &result);
+  float secondsAt(uint32_t offset) const;
+};
+
+extern PrintEstimator printEstimator;
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// Ligne formatée vers la console : rapports, réponses et acquittements. Serial.printf passe
+// par malloc au-delà de 64 octets, ce que STATIC_ALLOCATION interdit après le verrouillage
+// du tas : tout le formatage console de lib/ passe par ici, sur la pile de l'appelant.
+// Une ligne plus longue que REPORT_LINE_MAX - 1 est tronquée en gardant son '\n'.
+static const size_t REPORT_LINE_MAX = 256;
+
+inline void reportLine(const char *format, ...) {
+  char line[REPORT_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  if (n < 0) return;
+  size_t len = (size_t)n;
+  if (len >= sizeof(line)) {
+    len = sizeof(line) - 1;
+    if (format[strlen(format) - 1] == '\n') line[len - 1] = '\n';
+  }
+  Serial.write((const uint8_t *)line, len);
+}
@@ -0,0 +1,146 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_COMM
+#include "report_manager.h"
+#include "../debug_manager.h"
+
+ReportManager reportManager;
+
+static const char FIRMWARE_INFO[] =
+  "FIRMWARE_NAME:projet_licence PROTOCOL_VERSION:1.0 MACHINE_TYPE:ESP32-S3 EXTRUDER_COUNT:1\n"
+  "Cap:AUTOREPORT_TEMP:1\n"
+  "Cap:AUTOREPORT_POSITION:1\n"
+  "Cap:BINARY_FILE_TRANSFER:1\n"
+  "ok\n";
+
+// Écrit value / 10^decimals en décimal, sans printf ni flottant ; retourne la fin
+static char *formatFixed(char *p, int32_t value, int decimals) {
+  if (value < 0) {
+    *p++ = '-';
+    value = -value;
+  }
+  char digits[12];
+  int n = 0;
+  uint32_t v = (uint32_t)value;
+  do {
+    digits[n++] = '0' + (v % 10);
+    v /= 10;
+  } while (v || n <= decimals);
+  while (n > decimals) *p++ = digits[--n];
+  if (decimals > 0) {
+    *p++ = '.';
+    while (n > 0) *p++ = digits[--n];
+  }
+  return p;
+}
+
+static char *appendText(char *p, const char *text) {
+  while (*text) *p++ = *text++;
+  return p;
+}
+
+ReportManager::ReportManager() : intervalMs(0), droppedFrames(0), taskHandle(nullptr) {}
+
+void ReportManager::init() {
+  intervalMs = 0;
+  droppedFrames = 0;
+}
+
+size_t ReportManager::formatTemperatures(char *buf, const MachineState &s) {
+  char *p = buf;
+  p = appendText(p, "T:");
+  p = formatFixed(p, s.hotend_cdeg, 2);
+  p = appendText(p, " /");
+  p = formatFixed(p, s.hotend_target_cdeg, 2);
+  p = appendText(p, " B:");
+  p = formatFixed(p, s.bed_cdeg, 2);
+  p = appendText(p, " /");
+  p = formatFixed(p, s.bed_target_cdeg, 2);
+  return p - buf;
+}
+
+size_t ReportManager::formatPosition(char *buf, const MachineState &s) {
+  static const char *const labels[4] = { "X:", " Y:", " Z:", " E:" };
+  char *p = buf;
+  for (int i = 0; i < 4; i++) {
+    p = appendText(p, labels[i]);
+    p = formatFixed(p, s.pos_um[i], 3);
+  }
+  return p - buf;
+}
+
+size_t ReportManager::formatAutoReport(char *buf) {
+  MachineState s;
+  machineState.snapshot(s);
+  char *p = buf;
+  p += formatTemperatures(p, s);
+  *p++ = ' ';
+  p += formatPosition(p, s);
+  p = appendText(p, " SD:");
+  p = formatFixed(p, s.sd_bytes, 0);
+  *p++ = '/';
+  p = formatFixed(p, s.sd_size, 0);
+  *p++ = '\n';
+  return p - buf;
+}
+
+// Auto-report M155 seulement : une trame non sollicitée peut sauter un tour
+bool ReportManager::writeNonBlocking(const char *buf, size_t len) {
+  if ((size_t)Serial.availableForWrite() < len) {
+    droppedFrames++;
+    return false;
+  }
+  Serial.write((const uint8_t *)buf, len);
+  return true;
+}
+
+void ReportManager::setInterval(uint32_t seconds) {
+  intervalMs = seconds * 1000;
+  if (taskHandle) xTaskNotifyGive(taskHandle);
+  DEBUG_PRINTF_AUTO("Auto-report: intervalle %lu s", (unsigned long)seconds);
+}
+
+void ReportManager::handleCommand(const MotionCommand &cmd) {
+  MachineState s;
+  char buf[REPORT_BUFFER_SIZE];
+  char *p = buf;
+  switch (static_cast<GcodeType>(cmd.code)) {
+    case GcodeType::M105:
+      machineState.snapshot(s);
+      p = appendText(p, "ok ");
+      p += formatTemperatures(p, s);
+      *p++ = '\n';
+      break;
+    case GcodeType::M114:
+      machineState.snapshot(s);
+      p += formatPosition(p, s);
+      p = appendText(p, "\nok\n");
+      break;
+    case GcodeType::M115:
+      // Réponse constante, écrite telle quelle
+      Serial.write((const uint8_t *)FIRMWARE_INFO, sizeof(FIRMWARE_INFO) - 1);
+      return;
+    case GcodeType::M155:
+      setInterval(cmd.has_s ? (uint32_t)cmd.s : 1);
+      p = appendText(p, "ok\n");
+      break;
+    default:
+      return;
+  }
+  // Réponse attendue par l'hôte (ok compris) : jamais perdue, quitte à attendre le TX
+  Serial.write((const uint8_t *)buf, p - buf);
+}
+
+void ReportManager::reportTask(void *pvParameters) {
+  reportManager.taskHandle = xTaskGetCurrentTaskHandle();
+  while (1) {
+    uint32_t interval = reportManager.intervalMs;
+    if (interval == 0) {
+      // Auto-report désactivé : attente d'un M155
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    // Réveillé à l'échéance, ou plus tôt si M155 change l'intervalle
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval)) != 0) continue;
+    size_t len = reportManager.formatAutoReport(reportManager.autoBuffer);
+    reportManager.writeNonBlocking(reportManager.autoBuffer, len);
+  }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include "gcode_parser.h"
+#include "machine_state.h"
+
+// Rapports M105/M114/M115 et auto-report M155 S<secondes>.
+// Les trames sont formatées en entiers dans un buffer préalloué. Les réponses aux
+// commandes (ok compris) sont toujours écrites, quitte à attendre le buffer TX série ;
+// seul l'auto-report, non sollicité, est abandonné s'il n'y tient pas (droppedFrames).
+class ReportManager {
+private:
+  static const size_t REPORT_BUFFER_SIZE = 160;
+  // Tampon de ReportTask seul ; les réponses de handleCommand, appelée depuis CommTask
+  // comme depuis ParserTask, sont formatées sur la pile de l'appelant
+  char autoBuffer[REPORT_BUFFER_SIZE];
+  volatile uint32_t intervalMs;
+  volatile uint32_t droppedFrames;
+  TaskHandle_t taskHandle;
+
+  size_t formatTemperatures(char *p, const MachineState &s);
+  size_t formatPosition(char *p, const MachineState &s);
+  size_t formatAutoReport(char *buf);
+  bool writeNonBlocking(const char *buf, size_t len);
+
+public:
+  ReportManager();
+  void init();
+  void handleCommand(const MotionCommand &cmd);
+  void setInterval(uint32_t seconds);
+  uint32_t getDroppedFrames() const { return droppedFrames; }
+  static void reportTask(void *pvParameters);
+};
+
+extern ReportManager reportManager;
@@ -1,65 +1,142 @@
-
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
 #include "sd_manager.h"
 #include "../config.h"
-#include <SdFat.h>
+#include "storage.h"
+#if defined(ARDUINO)
+#include "storage_sdfat.h"
+#endif
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include "../debug_manager.h"
 #include "system_manager.h"
+#include "machine_state.h"
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "health_monitor.h"
+#include "print_estimator.h"
+#include "gcode_parser.h"
+#include "gcode_scheduler.h"
 
 extern QueueHandle_t sdQueue;
 extern QueueHandle_t gcodeQueue;
-extern SemaphoreHandle_t errorSemaphore;
 
-SdFat SD;
 SDManager sdManager;
 
+#if defined(ARDUINO)
+SDManager::SDManager() : storage(&sdFatStorage) {}
+#else
+SDManager::SDManager() : storage(nullptr) {}
+#endif
+
+// État du fichier en cours d'écriture : les données sont regroupées par blocs de
+// SD_WRITE_CHUNK_SIZE pour que chaque écriture SD couvre des secteurs entiers
+static StorageFile *writeFile = nullptr;
+static char writeName[SD_PATH_MAX] = "";
+static uint8_t writeBuffer[SD_WRITE_CHUNK_SIZE];
+static size_t writeBufferLen = 0;
+static uint32_t writeTotal = 0;
+
+static bool flushWriteBuffer() {
+  if (writeBufferLen == 0) return true;
+  if (writeFile->write(writeBuffer, writeBufferLen) != writeBufferLen) return false;
+  writeBufferLen = 0;
+  return true;
+}
+
 void SDManager::sdTask(void *pvParameters) {
-  String filename;
+  char filename[SD_PATH_MAX];
   while (1) {
-    if (xQueueReceive(sdQueue, &filename, portMAX_DELAY) == pdTRUE) {
-      xQueueReset(gcodeQueue);
-      DEBUG_PRINTF_AUTO("gcodeQueue vidée avant lecture de %s", filename.c_str());
+    if (xQueueReceive(sdQueue, filename, portMAX_DELAY) == pdTRUE) {
+      // Seul le flux SD repart de zéro : les lignes de l'hôte en attente restent
+      gcodeScheduler.beginJob();
 
-      File32 file = SD.open(filename.c_str(), FILE_READ);
+      StorageFile *file = sdManager.storage->open(filename, StorageMode::READ);
       if (file) {
-        DEBUG_PRINTF_AUTO("Lecture du fichier %s", filename.c_str());
+        DEBUG_PRINTF_AUTO("Lecture du fichier %s", filename);
+        StorageLineReader reader(file, sdManager.readBuffer, sizeof(sdManager.readBuffer));
+        uint32_t fileSize = file->size();
+        machineState.setSdProgress(0, fileSize, true);
+        printEstimator.beginJob(filename, fileSize);
         char buffer[512];
-        while (file.available()) {
-          int bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
-          buffer[bytesRead] = '\0';
-          String line = String(buffer);
-          line.trim();
-          if (line.isEmpty()) {
-            DEBUG_PRINTF_AUTO("Debug: Ligne vide ignorée");
-            continue;
+        while (1) {
+          TRACE_BEGIN(SD_LINE_READ);
+          bool truncated = false;
+          int lineLen = reader.readLine(buffer, sizeof(buffer), &truncated);
+          TRACE_END(SD_LINE_READ);
+          if (lineLen < 0) break;
+          if (faultBus.isHalted()) {
+            DEBUG_PRINTF_AUTO("Lecture de %s interrompue par l'arrêt d'urgence", filename);
+            break;
           }
-          if (line.startsWith(";")) {
-            DEBUG_PRINTF_AUTO("Debug: Ignored line: '%s'", line.c_str());
+          // M112 dans le fichier : arrêt immédiat, sans attendre les commandes déjà en file
+          if (FaultBus::isEmergencyStopLine(buffer)) {
+            faultBus.emergencyStop(FaultSource::SD, (uint32_t)esp_timer_get_time());
+            break;
+          }
+          machineState.setSdProgress(reader.offset(), fileSize, true);
+          printEstimator.update(reader.offset());
+          // Ligne coupée : sans ';' dans ce qui reste, c'est la commande elle-même qui l'est
+          if (truncated && !strchr(buffer, ';')) {
+            DEBUG_ERRORF_AUTO("Erreur: Ligne de plus de %u caractères ignorée à l'octet %lu",
+                              (unsigned)(sizeof(buffer) - 1), (unsigned long)reader.offset());
+            faultBus.raise(FaultCode::PARSE_INVALID, FaultSource::SD, (int32_t)reader.offset());
+            Serial.println("ERROR: Line too long");
             continue;
           }
-          int commentPos = line.indexOf(';');
-          if (commentPos != -1) {
-            line = line.substring(0, commentPos);
-            line.trim();
+          if (truncated) {
+            DEBUG_TRACEF_AUTO("Debug: Commentaire tronqué à l'octet %lu", (unsigned long)reader.offset());
+          }
+          // Découpée sur place dans buffer : aucune String par ligne
+          char *line = GcodeParser::stripComment(buffer);
+          if (!*line) {
+            DEBUG_TRACEF_AUTO("Debug: Ligne vide ou commentaire ignoré");
+            continue;
           }
-          if (line.isEmpty()) {
-            DEBUG_PRINTF_AUTO("Debug: Ligne vide après suppression du commentaire");
+          size_t length = strlen(line);
+          if (length >= GCODE_LINE_MAX) {
+            DEBUG_ERRORF_AUTO("Erreur: Ligne de %u caractères ignorée (max %d)", (unsigned)length, GCODE_LINE_MAX - 1);
+            faultBus.raise(FaultCode::PARSE_INVALID, FaultSource::SD, (int32_t)length);
+            Serial.println("ERROR: Line too long");
             continue;
           }
-          DEBUG_PRINTF_AUTO("Debug: Envoi ligne à gcodeQueue: '%s'", line.c_str());
-          if (xQueueSend(gcodeQueue, &line, pdMS_TO_TICKS(5000)) != pdTRUE) {
-            DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer à gcodeQueue après 5s");
-            if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-            Serial.println("ERROR: Failed to send to gcodeQueue");
+          // M25 : la lecture s'arrête ici, la ligne part à la reprise
+          if (!gcodeScheduler.waitWhilePaused()) {
+            DEBUG_PRINTF_AUTO("Lecture de %s interrompue pendant la pause", filename);
+            break;
+          }
+          DEBUG_TRACEF_AUTO("Debug: Envoi ligne à gcodeQueue: '%s'", line);
+          char item[GCODE_LINE_MAX];
+          memcpy(item, line, length + 1);
+          TRACE_BEGIN(SD_ENQUEUE);
+          // Aucune ligne du job n'est perdue : on attend tant que l'arrêt d'urgence ne coupe
+          // pas la lecture. En pause (M25), ParserTask ne vide plus la file : attente normale
+          bool sent = false;
+          bool reported = false;
+          while (!faultBus.isHalted()) {
+            if (gcodeScheduler.submit(GcodeStream::SD, item, pdMS_TO_TICKS(5000))) {
+              sent = true;
+              break;
+            }
+            if (gcodeScheduler.isPaused() || reported) continue;
+            DEBUG_ERRORF_AUTO("Erreur: gcodeQueue toujours pleine après 5s, nouvel essai");
+            faultBus.raise(FaultCode::QUEUE_FULL, FaultSource::SD, uxQueueMessagesWaiting(gcodeQueue));
+            Serial.println("ERROR: gcodeQueue full, retrying");
+            reported = true;
+          }
+          TRACE_END(SD_ENQUEUE);
+          if (!sent) {
+            DEBUG_PRINTF_AUTO("Lecture de %s interrompue par l'arrêt d'urgence", filename);
+            break;
           }
           vTaskDelay(pdMS_TO_TICKS(10));
         }
-        file.close();
-        DEBUG_PRINTF_AUTO("Fin de lecture de %s", filename.c_str());
+        file->close();
+        machineState.setSdProgress(fileSize, fileSize, false);
+        printEstimator.endJob();
+        DEBUG_PRINTF_AUTO("Fin de lecture de %s", filename);
       } else {
-        DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir %s", filename.c_str());
-        if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+        DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir %s", filename);
+        faultBus.raise(FaultCode::SD_OPEN, FaultSource::SD);
         Serial.println("ERROR: Failed to open file");
       }
     }
@@ -68,9 +145,9 @@ void SDManager::sdTask(void *pvParameters) {
 }
 
 bool SDManager::init() {
-  if (!SD.begin(CS_GPIO, SPI_HALF_SPEED)) {
-    DEBUG_PRINTF_AUTO("Erreur: Initialisation SD échouée");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+  if (!storage || !storage->begin()) {
+    DEBUG_ERRORF_AUTO("Erreur: Initialisation SD échouée");
+    faultBus.raise(FaultCode::SD_INIT, FaultSource::SD);
     Serial.println("ERROR: SD initialization failed");
     return false;
   }
@@ -78,91 +155,176 @@ bool SDManager::init() {
   return true;
 }
 
-void SDManager::readFile(String filename) {
-  filename.trim();
-  if (filename.isEmpty()) {
-    DEBUG_PRINTF_AUTO("Erreur: Nom de fichier vide");
+void SDManager::readFile(const char *filename) {
+  if (!*filename) {
+    DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide");
     Serial.println("ERROR: Empty filename");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    faultBus.raise(FaultCode::BAD_FILENAME, FaultSource::SD);
+    return;
+  }
+  size_t length = strlen(filename);
+  if (length >= SD_PATH_MAX) {
+    DEBUG_ERRORF_AUTO("Erreur: Chemin trop long: %s", filename);
+    Serial.println("ERROR: Filename too long");
+    faultBus.raise(FaultCode::BAD_FILENAME, FaultSource::SD);
     return;
   }
-  if (xQueueSend(sdQueue, &filename, pdMS_TO_TICKS(100)) != pdTRUE) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible d'envoyer filename à sdQueue");
+  char path[SD_PATH_MAX];
+  memcpy(path, filename, length + 1);
+  if (xQueueSend(sdQueue, path, pdMS_TO_TICKS(100)) != pdTRUE) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible d'envoyer filename à sdQueue");
     Serial.println("ERROR: Failed to send to sdQueue");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    faultBus.raise(FaultCode::QUEUE_FULL, FaultSource::SD, uxQueueMessagesWaiting(sdQueue));
   }
+  healthMonitor.noteQueue(sdQueue);
 }
 
-void SDManager::testReadSD(String filename) {
-  filename.trim();
-  if (filename.isEmpty()) {
+void SDManager::testReadSD(const char *filename) {
+  if (!*filename) {
     DEBUG_PRINTF_AUTO("Test: Nom de fichier vide");
     Serial.println("ERROR: Empty filename");
     return;
   }
-  File32 file = SD.open(filename.c_str(), FILE_READ);
+  StorageFile *file = storage->open(filename, StorageMode::READ);
   if (file) {
-    DEBUG_PRINTF_AUTO("Test: Lecture de %s", filename.c_str());
+    DEBUG_PRINTF_AUTO("Test: Lecture de %s", filename);
+    uint8_t chunk[512];
+    StorageLineReader reader(file, chunk, sizeof(chunk));
     char buffer[512];
-    while (file.available()) {
-      int bytesRead = file.readBytesUntil('\n', buffer, sizeof(buffer) - 1);
-      buffer[bytesRead] = '\0';
-      String line = String(buffer);
-      line.trim();
-      if (line.isEmpty()) {
-        DEBUG_PRINTF_AUTO("Debug: Ligne vide ignorée");
+    while (reader.readLine(buffer, sizeof(buffer)) >= 0) {
+      // Exécuté par CommTask : M112 reste lu pendant tout le fichier
+      faultBus.pollConsole();
+      char *line = GcodeParser::stripComment(buffer);
+      if (!*line) {
+        DEBUG_TRACEF_AUTO("Debug: Ligne vide ou commentaire ignoré");
         continue;
       }
-      if (line.startsWith(";")) {
-        DEBUG_PRINTF_AUTO("Debug: Ignored line: '%s'", line.c_str());
-        continue;
-      }
-      int commentPos = line.indexOf(';');
-      if (commentPos != -1) {
-        line = line.substring(0, commentPos);
-        line.trim();
-      }
-      if (line.isEmpty()) {
-        DEBUG_PRINTF_AUTO("Debug: Ligne vide après suppression du commentaire");
-        continue;
-      }
-      DEBUG_PRINTF_AUTO("Ligne: %s", line.c_str());
+      DEBUG_PRINTF_AUTO("Ligne: %s", line);
     }
-    file.close();
-    DEBUG_PRINTF_AUTO("Test: Fin de lecture de %s", filename.c_str());
+    file->close();
+    DEBUG_PRINTF_AUTO("Test: Fin de lecture de %s", filename);
   } else {
-    DEBUG_PRINTF_AUTO("Test: Erreur ouverture %s", filename.c_str());
+    DEBUG_PRINTF_AUTO("Test: Erreur ouverture %s", filename);
     Serial.println("ERROR: Failed to open file");
   }
 }
 
-void SDManager::listFiles() {
-  File32 dir = SD.open("/");
-  if (!dir) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible d'ouvrir le répertoire racine");
-    Serial.println("ERROR: Failed to open root directory");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-    return;
+static bool printFileEntry(const char *name, const StorageStat &st, void *ctx) {
+  faultBus.pollConsole();
+  if (!st.isDir) {
+    DEBUG_PRINTF_AUTO("Fichier: %s", name);
+    Serial.print("File: ");
+    Serial.println(name);
+    *(bool *)ctx = true;
   }
+  return true;
+}
+
+void SDManager::listFiles() {
   DEBUG_PRINTF_AUTO("Liste des fichiers sur la carte SD:");
   Serial.println("Files on SD card:");
   bool foundFiles = false;
-  char fileName[256]; // Buffer pour stocker le nom du fichier
-  File32 file;
-  while (file.openNext(&dir, FILE_READ)) {
-    if (!file.isDir()) {
-      file.getName(fileName, sizeof(fileName));
-      DEBUG_PRINTF_AUTO("Fichier: %s", fileName);
-      Serial.print("File: ");
-      Serial.println(fileName);
-      foundFiles = true;
-    }
-    file.close();
+  if (!storage->list("/", printFileEntry, &foundFiles)) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir le répertoire racine");
+    Serial.println("ERROR: Failed to open root directory");
+    faultBus.raise(FaultCode::SD_LIST, FaultSource::SD);
+    return;
   }
-  dir.close();
   if (!foundFiles) {
     DEBUG_PRINTF_AUTO("Aucun fichier trouvé sur la carte SD");
     Serial.println("No files found on SD card");
   }
   Serial.println("OK: File list completed");
-}
\ No newline at end of file
+}
+
+bool SDManager::beginWrite(const char *filename, uint32_t expectedSize) {
+  if (!*filename) {
+    DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour l'écriture");
+    return false;
+  }
+  if (writeFile) {
+    DEBUG_ERRORF_AUTO("Erreur: Écriture déjà en cours sur %s", writeName);
+    return false;
+  }
+  if (strlen(filename) >= sizeof(writeName)) {
+    DEBUG_ERRORF_AUTO("Erreur: Chemin trop long: %s", filename);
+    faultBus.raise(FaultCode::BAD_FILENAME, FaultSource::SD);
+    return false;
+  }
+  writeFile = storage->open(filename, StorageMode::WRITE);
+  if (!writeFile) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer %s", filename);
+    faultBus.raise(FaultCode::SD_WRITE, FaultSource::SD);
+    return false;
+  }
+  // Clusters contigus : la FAT n'est plus parcourue à chaque nouveau cluster
+  if (expectedSize > 0 && !writeFile->preAllocate(expectedSize)) {
+    DEBUG_PRINTF_AUTO("Pré-allocation de %lu octets impossible, écriture sans pré-allocation", (unsigned long)expectedSize);
+  }
+  strcpy(writeName, filename);
+  writeBufferLen = 0;
+  writeTotal = 0;
+  DEBUG_PRINTF_AUTO("Écriture de %s ouverte (%lu octets annoncés)", filename, (unsigned long)expectedSize);
+  return true;
+}
+
+bool SDManager::write(const uint8_t *data, size_t len) {
+  if (!writeFile) return false;
+  while (len > 0) {
+    // Buffer vide et au moins un bloc complet : écriture directe sans copie
+    if (writeBufferLen == 0 && len >= SD_WRITE_CHUNK_SIZE) {
+      size_t direct = len - (len % SD_WRITE_CHUNK_SIZE);
+      if (writeFile->write(data, direct) != direct) {
+        DEBUG_ERRORF_AUTO("Erreur: Écriture SD échouée sur %s", writeName);
+        faultBus.raise(FaultCode::SD_WRITE, FaultSource::SD);
+        return false;
+      }
+      data += direct;
+      len -= direct;
+      writeTotal += direct;
+      continue;
+    }
+    size_t n = SD_WRITE_CHUNK_SIZE - writeBufferLen;
+    if (n > len) n = len;
+    memcpy(writeBuffer + writeBufferLen, data, n);
+    writeBufferLen += n;
+    writeTotal += n;
+    data += n;
+    len -= n;
+    if (writeBufferLen == SD_WRITE_CHUNK_SIZE && !flushWriteBuffer()) {
+      DEBUG_ERRORF_AUTO("Erreur: Écriture SD échouée sur %s", writeName);
+      faultBus.raise(FaultCode::SD_WRITE, FaultSource::SD);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SDManager::endWrite(uint32_t *bytesWritten) {
+  if (!writeFile) return false;
+  bool ok = flushWriteBuffer();
+  // Libère les clusters pré-alloués au-delà des données réellement reçues
+  ok = writeFile->truncate(writeTotal) && ok;
+  ok = writeFile->close() && ok;
+  writeFile = nullptr;
+  if (bytesWritten) *bytesWritten = writeTotal;
+  if (ok) {
+    DEBUG_PRINTF_AUTO("Écriture de %s terminée (%lu octets)", writeName, (unsigned long)writeTotal);
+  } else {
+    DEBUG_ERRORF_AUTO("Erreur: Finalisation de %s échouée", writeName);
+    faultBus.raise(FaultCode::SD_WRITE, FaultSource::SD);
+  }
+  writeName[0] = '\0';
+  return ok;
+}
+
+void SDManager::abortWrite() {
+  if (!writeFile) return;
+  writeFile->close();
+  writeFile = nullptr;
+  storage->remove(writeName);
+  DEBUG_PRINTF_AUTO("Écriture de %s annulée, fichier supprimé", writeName);
+  writeName[0] = '\0';
+  writeBufferLen = 0;
+  writeTotal = 0;
+}
@@ -2,14 +2,28 @@
 #pragma once
 
 #include <Arduino.h>
+#include "storage.h"
 
 class SDManager {
 private:
+  Storage *storage;
+  uint8_t readBuffer[512]; // Blocs lus par sdTask
+
 public:
+  SDManager();
+  // Backend de stockage (SdFat sur la carte, POSIX/mmap sur l'hôte), à choisir avant init()
+  void setStorage(Storage *backend) { storage = backend; }
+  Storage *getStorage() { return storage; }
   bool init();
-  void readFile(String filename);
-  void testReadSD(String filename);
+  // Chemins sans blancs de bord
+  void readFile(const char *filename);
+  void testReadSD(const char *filename);
   void listFiles();
+  // Écriture (upload M28/M29) : un seul fichier ouvert en écriture à la fois
+  bool beginWrite(const char *filename, uint32_t expectedSize);
+  bool write(const uint8_t *data, size_t len);
+  bool endWrite(uint32_t *bytesWritten);
+  void abortWrite();
   static void sdTask(void *pvParameters);
 };
 
@@ -12,6 +12,7 @@ TFT_eSPI tft = TFT_eSPI();  // Invoke custom library with default width and heig
 // -------------------------------------------------------------------------------
 // Touchscreen
 #include <XPT2046_Touchscreen.h>
+#include "../report_line.h"
 // Touchscreen pins
 //#define XPT2046_IRQ  -1 // T_IRQ not connected
 #define XPT2046_MOSI 2   // T_DIN
@@ -58,15 +59,15 @@ void drawCalibrationArrowBottomRight(uint8_t size) {
 
 // Print Touchscreen info about X, Y and Pressure (Z) on the Serial Monitor
 void printTouchToSerial(uint8_t sample, int16_t touchX, int16_t touchY, int16_t touchZ) {
-  Serial.printf("Nr sample: %2d | X = %4d | Y = %4d | Z = %4d\n", sample, touchX, touchY, touchZ);
+  reportLine("Nr sample: %2d | X = %4d | Y = %4d | Z = %4d\n", sample, touchX, touchY, touchZ);
 }
 
 void printCalibrationData(int32_t av_X_TL, int32_t av_Y_TL, int32_t av_X_BR, int32_t av_Y_BR) {
   Serial.println(F("--== Calibration Data ==--"));
-  Serial.printf("x0 %4d x1 %4d y0 %4d y1 %4d\n", av_X_TL, av_X_BR, av_Y_TL, av_Y_BR);
+  reportLine("x0 %4d x1 %4d y0 %4d y1 %4d\n", av_X_TL, av_X_BR, av_Y_TL, av_Y_BR);
   Serial.println(F("use this mapping:"));
-  Serial.printf("x = map(p.x, %d, %d, 1, SCREEN_WIDTH);\n", av_X_TL, av_X_BR);
-  Serial.printf("y = map(p.y, %d, %d, 1, SCREEN_HEIGHT);\n", av_Y_TL, av_Y_BR);
+  reportLine("x = map(p.x, %d, %d, 1, SCREEN_WIDTH);\n", av_X_TL, av_X_BR);
+  reportLine("y = map(p.y, %d, %d, 1, SCREEN_HEIGHT);\n", av_Y_TL, av_Y_BR);
   Serial.println(F("--== Calibration Data End ==--"));
 }
 
@@ -0,0 +1,86 @@
+#include "storage.h"
+#include <string.h>
+#include <stdio.h>
+
+bool storageSidecarPath(const char *path, const char *suffix, char *out, size_t size) {
+  const char *slash = strrchr(path, '/');
+  const char *dot = strrchr(path, '.');
+  size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - path) : strlen(path);
+  int n = snprintf(out, size, "%.*s%s", (int)stem, path, suffix);
+  return n > 0 && (size_t)n < size;
+}
+
+struct RankedScan {
+  uint32_t rank;
+  uint32_t from;
+  StorageScanCallback cb;
+  void *ctx;
+};
+
+static bool rankedScanEntry(const char *name, const StorageStat &st, void *ctx) {
+  RankedScan *scan = (RankedScan *)ctx;
+  uint32_t at = scan->rank++;
+  return at < scan->from || scan->cb(name, st, at, scan->ctx);
+}
+
+bool Storage::scan(const char *path, uint32_t from, StorageScanCallback cb, void *ctx) {
+  RankedScan scan = { 0, from, cb, ctx };
+  return list(path, rankedScanEntry, &scan);
+}
+
+StorageLineReader::StorageLineReader(StorageFile *file, uint8_t *buffer, size_t capacity)
+  : file(file), buffer(buffer), capacity(capacity), window(nullptr), windowLen(0), pos(0), consumed(0), eof(false) {
+  const uint8_t *mapped = file->data();
+  if (mapped) {
+    // Fichier projeté en mémoire : la fenêtre couvre tout le fichier
+    window = mapped + file->position();
+    windowLen = file->size() - file->position();
+    eof = true;
+  }
+}
+
+bool StorageLineReader::refill() {
+  if (eof) return false;
+  int n = file->read(buffer, capacity);
+  if (n <= 0) {
+    eof = true;
+    return false;
+  }
+  window = buffer;
+  windowLen = n;
+  pos = 0;
+  return true;
+}
+
+int StorageLineReader::readLine(char *out, size_t outSize, bool *truncated) {
+  size_t len = 0;
+  bool any = false, cut = false;
+  while (true) {
+    if (pos >= windowLen && !refill()) {
+      if (!any) return -1;
+      break;
+    }
+    any = true;
+    const uint8_t *start = window + pos;
+    size_t avail = windowLen - pos;
+    const uint8_t *nl = (const uint8_t *)memchr(start, '\n', avail);
+    size_t chunk = nl ? (size_t)(nl - start) : avail;
+    size_t room = outSize - 1 - len;
+    size_t copy = chunk < room ? chunk : room;
+    memcpy(out + len, start, copy);
+    len += copy;
+    // Ligne trop longue : on rend ce qui tient, la suite est écartée jusqu'au '\n' pour
+    // ne jamais être prise pour une ligne
+    if (copy < chunk) cut = true;
+    pos += chunk;
+    consumed += chunk;
+    if (nl) {
+      pos++;
+      consumed++;
+      break;
+    }
+  }
+  out[len] = '\0';
+  if (truncated) *truncated = cut;
+  return (int)len;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Abstraction du stockage des fichiers G-code : SdFat sur la carte, fichiers POSIX
+// ou mmap sur l'hôte. Les fichiers ouverts viennent d'un pool fixe de chaque backend
+// (aucune allocation), et doivent être rendus avec close().
+
+enum class StorageMode {
+  READ,
+  WRITE   // Création, ou troncature si le fichier existe
+};
+
+struct StorageStat {
+  uint32_t size;
+  bool isDir;
+};
+
+// Retourne false pour arrêter le parcours
+typedef bool (*StorageListCallback)(const char *name, const StorageStat &st, void *ctx);
+// Parcours reprenable : at est la position opaque à passer à scan() pour repartir de cette entrée
+typedef bool (*StorageScanCallback)(const char *name, const StorageStat &st, uint32_t at, void *ctx);
+
+class StorageFile {
+public:
+  virtual ~StorageFile() {}
+  virtual int read(uint8_t *buf, size_t len) = 0;     // Octets lus, 0 en fin de fichier, -1 en erreur
+  virtual bool seek(uint32_t pos) = 0;
+  virtual uint32_t position() = 0;
+  virtual uint32_t size() = 0;
+  virtual size_t write(const uint8_t *data, size_t len) = 0;
+  virtual bool preAllocate(uint32_t size) { return false; }
+  virtual bool truncate(uint32_t size) = 0;
+  virtual bool close() = 0;
+  // Accès direct au contenu (backend mmap), nullptr si le backend copie
+  virtual const uint8_t *data() { return nullptr; }
+
+protected:
+  friend class StoragePool;
+  std::atomic<bool> inUse{false};
+};
+
+class Storage {
+public:
+  virtual ~Storage() {}
+  virtual bool begin() = 0;
+  virtual StorageFile *open(const char *path, StorageMode mode) = 0;
+  virtual bool stat(const char *path, StorageStat &st) = 0;
+  virtual bool list(const char *path, StorageListCallback cb, void *ctx) = 0;
+  // Parcours depuis une position rendue par un scan précédent (0 : début du répertoire).
+  // Par défaut les positions sont des rangs, et les entrées précédentes sont relues.
+  virtual bool scan(const char *path, uint32_t from, StorageScanCallback cb, void *ctx);
+  virtual bool remove(const char *path) = 0;
+};
+
+// Réservation d'un emplacement libre dans le pool de fichiers d'un backend
+class StoragePool {
+public:
+  template <typename T, size_t N>
+  static T *acquire(T (&files)[N]) {
+    for (size_t i = 0; i < N; i++) {
+      bool expected = false;
+      if (files[i].inUse.compare_exchange_strong(expected, true)) return &files[i];
+    }
+    return nullptr;
+  }
+  static void release(StorageFile *file) { file->inUse.store(false); }
+};
+
+// Fichier annexe d'un job (aperçu, miniature...) : "dir/job.gcode" + ".thb" -> "dir/job.thb".
+// false si le chemin obtenu ne tient pas dans out.
+bool storageSidecarPath(const char *path, const char *suffix, char *out, size_t size);
+
+// Découpage en lignes par lecture de blocs : un appel read() par bloc au lieu d'un
+// par octet, et aucune copie intermédiaire quand le backend expose data()
+class StorageLineReader {
+public:
+  StorageLineReader(StorageFile *file, uint8_t *buffer, size_t capacity);
+  // Copie la ligne suivante (sans '\n'), -1 en fin de fichier. Une ligne plus longue que
+  // outSize - 1 est coupée, le reste écarté jusqu'au '\n', et *truncated passe à true.
+  int readLine(char *out, size_t outSize, bool *truncated = nullptr);
+  uint32_t offset() const { return consumed; }
+
+private:
+  StorageFile *file;
+  uint8_t *buffer;
+  size_t capacity;
+  const uint8_t *window;
+  size_t windowLen;
+  size_t pos;
+  uint32_t consumed;
+  bool eof;
+  bool refill();
+};
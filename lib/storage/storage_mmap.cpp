@@ -0,0 +1,65 @@
+#if !defined(ARDUINO)
+
+#include "storage_mmap.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Fichier vide : mmap refuse une longueur nulle, on pointe sur un octet statique
+static const uint8_t emptyFile[1] = { 0 };
+
+int MmapStorageFile::read(uint8_t *buf, size_t len) {
+  size_t left = length - cursor;
+  if (len > left) len = left;
+  memcpy(buf, base + cursor, len);
+  cursor += len;
+  return (int)len;
+}
+
+bool MmapStorageFile::seek(uint32_t pos) {
+  if (pos > length) return false;
+  cursor = pos;
+  return true;
+}
+
+bool MmapStorageFile::close() {
+  if (base != emptyFile) munmap((void *)base, length);
+  base = nullptr;
+  length = cursor = 0;
+  StoragePool::release(this);
+  return true;
+}
+
+StorageFile *MmapStorage::open(const char *path, StorageMode mode) {
+  if (mode == StorageMode::WRITE) return PosixStorage::open(path, mode);
+  MmapStorageFile *f = StoragePool::acquire(mapped);
+  if (!f) return nullptr;
+  char full[PATH_MAX];
+  int fd = resolve(path, full) ? ::open(full, O_RDONLY) : -1;
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) ::close(fd);
+    StoragePool::release(f);
+    return nullptr;
+  }
+  f->length = (uint32_t)st.st_size;
+  f->cursor = 0;
+  if (f->length == 0) {
+    f->base = emptyFile;
+  } else {
+    void *p = mmap(nullptr, f->length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      StoragePool::release(f);
+      return nullptr;
+    }
+    madvise(p, f->length, MADV_SEQUENTIAL);
+    f->base = (const uint8_t *)p;
+  }
+  ::close(fd);
+  return f;
+}
+
+#endif
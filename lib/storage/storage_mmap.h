@@ -0,0 +1,34 @@
+#pragma once
+
+#if !defined(ARDUINO)
+
+#include "storage_posix.h"
+
+// Backend hôte sans copie : les fichiers lus sont projetés en mémoire et
+// StorageLineReader découpe les lignes directement dans la projection.
+// L'écriture, le listing et stat() passent par le backend POSIX.
+class MmapStorageFile : public StorageFile {
+public:
+  const uint8_t *base = nullptr;
+  uint32_t length = 0;
+  uint32_t cursor = 0;
+  int read(uint8_t *buf, size_t len) override;
+  bool seek(uint32_t pos) override;
+  uint32_t position() override { return cursor; }
+  uint32_t size() override { return length; }
+  size_t write(const uint8_t *data, size_t len) override { return 0; }
+  bool truncate(uint32_t size) override { return false; }
+  bool close() override;
+  const uint8_t *data() override { return base; }
+};
+
+class MmapStorage : public PosixStorage {
+public:
+  explicit MmapStorage(const char *root) : PosixStorage(root) {}
+  StorageFile *open(const char *path, StorageMode mode) override;
+
+private:
+  MmapStorageFile mapped[STORAGE_MAX_OPEN_FILES];
+};
+
+#endif
@@ -0,0 +1,102 @@
+#if !defined(ARDUINO)
+
+#include "storage_posix.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int PosixStorageFile::read(uint8_t *buf, size_t len) {
+  return (int)::read(fd, buf, len);
+}
+
+bool PosixStorageFile::seek(uint32_t pos) {
+  return lseek(fd, pos, SEEK_SET) == (off_t)pos;
+}
+
+uint32_t PosixStorageFile::position() {
+  return (uint32_t)lseek(fd, 0, SEEK_CUR);
+}
+
+uint32_t PosixStorageFile::size() {
+  struct stat st;
+  return fstat(fd, &st) == 0 ? (uint32_t)st.st_size : 0;
+}
+
+size_t PosixStorageFile::write(const uint8_t *data, size_t len) {
+  ssize_t n = ::write(fd, data, len);
+  return n < 0 ? 0 : (size_t)n;
+}
+
+bool PosixStorageFile::preAllocate(uint32_t size) {
+  return posix_fallocate(fd, 0, size) == 0;
+}
+
+bool PosixStorageFile::truncate(uint32_t size) {
+  return ftruncate(fd, size) == 0;
+}
+
+bool PosixStorageFile::close() {
+  bool ok = ::close(fd) == 0;
+  fd = -1;
+  StoragePool::release(this);
+  return ok;
+}
+
+bool PosixStorage::resolve(const char *path, char *out) const {
+  int n = snprintf(out, PATH_MAX, "%s%s%s", root.c_str(), path[0] == '/' ? "" : "/", path);
+  return n >= 0 && n < PATH_MAX;
+}
+
+bool PosixStorage::begin() {
+  struct stat st;
+  return ::stat(root.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+StorageFile *PosixStorage::open(const char *path, StorageMode mode) {
+  PosixStorageFile *f = StoragePool::acquire(files);
+  if (!f) return nullptr;
+  int flags = (mode == StorageMode::WRITE) ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+  char full[PATH_MAX];
+  f->fd = resolve(path, full) ? ::open(full, flags, 0644) : -1;
+  if (f->fd < 0) {
+    StoragePool::release(f);
+    return nullptr;
+  }
+  return f;
+}
+
+bool PosixStorage::stat(const char *path, StorageStat &st) {
+  struct stat s;
+  char full[PATH_MAX];
+  if (!resolve(path, full) || ::stat(full, &s) != 0) return false;
+  st.size = (uint32_t)s.st_size;
+  st.isDir = S_ISDIR(s.st_mode);
+  return true;
+}
+
+bool PosixStorage::list(const char *path, StorageListCallback cb, void *ctx) {
+  char dirPath[PATH_MAX], full[PATH_MAX];
+  if (!resolve(path, dirPath)) return false;
+  DIR *dir = opendir(dirPath);
+  if (!dir) return false;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') continue;
+    struct stat s;
+    int n = snprintf(full, sizeof(full), "%s/%s", dirPath, entry->d_name);
+    if (n < 0 || n >= (int)sizeof(full) || ::stat(full, &s) != 0) continue;
+    StorageStat st = { (uint32_t)s.st_size, (bool)S_ISDIR(s.st_mode) };
+    if (!cb(entry->d_name, st, ctx)) break;
+  }
+  closedir(dir);
+  return true;
+}
+
+bool PosixStorage::remove(const char *path) {
+  char full[PATH_MAX];
+  return resolve(path, full) && unlink(full) == 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+
+#if !defined(ARDUINO)
+
+#include "storage.h"
+#include "../config.h"
+#include <limits.h>
+#include <string>
+
+// Backend hôte : un répertoire tient lieu de carte SD ("/job.gcode" -> <racine>/job.gcode)
+class PosixStorageFile : public StorageFile {
+public:
+  int fd = -1;
+  int read(uint8_t *buf, size_t len) override;
+  bool seek(uint32_t pos) override;
+  uint32_t position() override;
+  uint32_t size() override;
+  size_t write(const uint8_t *data, size_t len) override;
+  bool preAllocate(uint32_t size) override;
+  bool truncate(uint32_t size) override;
+  bool close() override;
+};
+
+class PosixStorage : public Storage {
+public:
+  explicit PosixStorage(const char *root) : root(root) {}
+  bool begin() override;
+  StorageFile *open(const char *path, StorageMode mode) override;
+  bool stat(const char *path, StorageStat &st) override;
+  bool list(const char *path, StorageListCallback cb, void *ctx) override;
+  bool remove(const char *path) override;
+
+protected:
+  std::string root;
+  // Chemin hôte dans out (PATH_MAX octets) sans passer par le tas ; false s'il déborde
+  bool resolve(const char *path, char *out) const;
+
+private:
+  PosixStorageFile files[STORAGE_MAX_OPEN_FILES];
+};
+
+#endif
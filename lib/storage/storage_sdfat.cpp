@@ -0,0 +1,178 @@
+#if defined(ARDUINO)
+
+#include "storage_sdfat.h"
+#include "heap_guard.h"
+
+SdFatStorage sdFatStorage(CS_GPIO, SPI_HALF_SPEED);
+
+void SdFatStorage::lock() {
+  if (mutex) xSemaphoreTakeRecursive(mutex, portMAX_DELAY);
+}
+
+void SdFatStorage::unlock() {
+  if (mutex) xSemaphoreGiveRecursive(mutex);
+}
+
+int SdFatStorageFile::read(uint8_t *buf, size_t len) {
+  owner->lock();
+  int n = file.read(buf, len);
+  owner->unlock();
+  return n;
+}
+
+bool SdFatStorageFile::seek(uint32_t pos) {
+  owner->lock();
+  bool ok = file.seekSet(pos);
+  owner->unlock();
+  return ok;
+}
+
+uint32_t SdFatStorageFile::position() {
+  owner->lock();
+  uint32_t pos = file.curPosition();
+  owner->unlock();
+  return pos;
+}
+
+uint32_t SdFatStorageFile::size() {
+  owner->lock();
+  uint32_t n = file.fileSize();
+  owner->unlock();
+  return n;
+}
+
+size_t SdFatStorageFile::write(const uint8_t *data, size_t len) {
+  owner->lock();
+  size_t n = file.write(data, len);
+  owner->unlock();
+  return n;
+}
+
+bool SdFatStorageFile::preAllocate(uint32_t size) {
+  owner->lock();
+  bool ok = file.preAllocate(size);
+  owner->unlock();
+  return ok;
+}
+
+bool SdFatStorageFile::truncate(uint32_t size) {
+  owner->lock();
+  bool ok = file.truncate(size);
+  owner->unlock();
+  return ok;
+}
+
+bool SdFatStorageFile::close() {
+  owner->lock();
+  bool ok = file.close();
+  owner->unlock();
+  StoragePool::release(this);
+  return ok;
+}
+
+bool SdFatStorage::begin() {
+  if (!mutex) mutex = heapGuard.createRecursiveMutex();
+  if (!mutex) return false;
+  lock();
+  bool ok = sd.begin(csPin, spiSpeed);
+  unlock();
+  return ok;
+}
+
+StorageFile *SdFatStorage::open(const char *path, StorageMode mode) {
+  SdFatStorageFile *f = StoragePool::acquire(files);
+  if (!f) return nullptr;
+  int flags = (mode == StorageMode::WRITE) ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+  f->owner = this;
+  lock();
+  f->file = sd.open(path, flags);
+  bool ok = (bool)f->file;
+  unlock();
+  if (!ok) {
+    StoragePool::release(f);
+    return nullptr;
+  }
+  return f;
+}
+
+bool SdFatStorage::stat(const char *path, StorageStat &st) {
+  lock();
+  File32 file = sd.open(path, O_RDONLY);
+  bool ok = (bool)file;
+  if (ok) {
+    st.size = file.fileSize();
+    st.isDir = file.isDir();
+    file.close();
+  }
+  unlock();
+  return ok;
+}
+
+bool SdFatStorage::list(const char *path, StorageListCallback cb, void *ctx) {
+  lock();
+  File32 dir = sd.open(path, O_RDONLY);
+  unlock();
+  if (!dir) return false;
+  char name[256];
+  File32 file;
+  while (1) {
+    lock();
+    bool more = file.openNext(&dir, O_RDONLY);
+    StorageStat st = { 0, false };
+    if (more) {
+      st.size = file.fileSize();
+      st.isDir = file.isDir();
+      file.getName(name, sizeof(name));
+      file.close();
+    }
+    unlock();
+    if (!more || !cb(name, st, ctx)) break;
+  }
+  lock();
+  dir.close();
+  unlock();
+  return true;
+}
+
+// Position = décalage dans le fichier répertoire, avant les entrées LFN et supprimées qui
+// précèdent : une reprise n'a rien à relire
+bool SdFatStorage::scan(const char *path, uint32_t from, StorageScanCallback cb, void *ctx) {
+  lock();
+  File32 dir = sd.open(path, O_RDONLY);
+  bool ok = dir && dir.isDir() && dir.seekSet(from);
+  if (dir && !ok) dir.close();
+  uint32_t at = ok ? dir.curPosition() : 0;
+  unlock();
+  if (!ok) return false;
+  char name[256];
+  File32 file;
+  while (1) {
+    lock();
+    bool more = file.openNext(&dir, O_RDONLY);
+    StorageStat st = { 0, false };
+    uint32_t next = 0;
+    if (more) {
+      st.size = file.fileSize();
+      st.isDir = file.isDir();
+      file.getName(name, sizeof(name));
+      file.close();
+      next = dir.curPosition();
+    }
+    unlock();
+    if (!more || !cb(name, st, at, ctx)) break;
+    at = next;
+  }
+  lock();
+  dir.close();
+  unlock();
+  return true;
+}
+
+bool SdFatStorage::remove(const char *path) {
+  lock();
+  bool ok = sd.remove(path);
+  unlock();
+  return ok;
+}
+
+#endif
@@ -0,0 +1,54 @@
+#pragma once
+
+#if defined(ARDUINO)
+
+#include <SdFat.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "storage.h"
+#include "../config.h"
+
+class SdFatStorage;
+
+class SdFatStorageFile : public StorageFile {
+public:
+  File32 file;
+  SdFatStorage *owner = nullptr;
+  int read(uint8_t *buf, size_t len) override;
+  bool seek(uint32_t pos) override;
+  uint32_t position() override;
+  uint32_t size() override;
+  size_t write(const uint8_t *data, size_t len) override;
+  bool preAllocate(uint32_t size) override;
+  bool truncate(uint32_t size) override;
+  bool close() override;
+};
+
+// SdFat n'est pas réentrant : SDTask, CommTask (upload, READ_FILE) et les lecteurs de
+// l'UI (navigateur, miniatures, aperçu) passent par un même mutex récursif, pris autour
+// de chaque appel, fichiers ouverts compris. list()/scan() ne le prennent que le temps de
+// lire chaque entrée : un grand répertoire ne bloque pas les lectures du job, et les
+// rappels, exécutés mutex relâché, peuvent prendre le verrou de l'écran sans l'imbriquer.
+class SdFatStorage : public Storage {
+public:
+  SdFatStorage(uint8_t csPin, uint32_t spiSpeed) : csPin(csPin), spiSpeed(spiSpeed), mutex(nullptr) {}
+  bool begin() override;
+  StorageFile *open(const char *path, StorageMode mode) override;
+  bool stat(const char *path, StorageStat &st) override;
+  bool list(const char *path, StorageListCallback cb, void *ctx) override;
+  bool scan(const char *path, uint32_t from, StorageScanCallback cb, void *ctx) override;
+  bool remove(const char *path) override;
+  void lock();
+  void unlock();
+
+private:
+  SdFat sd;
+  uint8_t csPin;
+  uint32_t spiSpeed;
+  SemaphoreHandle_t mutex;    // Créé par begin(), avant tout accès à la carte
+  SdFatStorageFile files[STORAGE_MAX_OPEN_FILES];
+};
+
+extern SdFatStorage sdFatStorage;
+
+#endif
@@ -1,32 +1,44 @@
-
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
 #include "system_manager.h"
 #include "sd_manager.h"
 #include "comm_manager.h"
 #include "gcode_parser.h"
+#include "gcode_scheduler.h"
+#include "report_manager.h"
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "boot_sequencer.h"
+#include "health_monitor.h"
+#include "print_estimator.h"
+#include "heap_guard.h"
+#if defined(ARDUINO)
+#include "toolpath_preview.h"
+#include "thumbnail.h"
+#include "file_browser.h"
+#endif
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
-#include <freertos/semphr.h>
+#include "../config.h"
 #include "../debug_manager.h"
 #include <FastLED.h>
+#include <debug_logger.h>
 
 #define LED_PIN    48
 #define NUM_LEDS   1
 #define COLOR_ORDER GRB
-#define STABILITY_DELAY 3000
 
 QueueHandle_t gcodeQueue = NULL;
 QueueHandle_t sdQueue = NULL;
 QueueHandle_t motionQueue = NULL;
-SemaphoreHandle_t errorSemaphore = NULL;
 SystemManager systemManager;
 CRGB leds[NUM_LEDS];
 
-void SystemManager::stabilisation() {
-  FastLED.addLeds<WS2812, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS);
-  unsigned long startTime = millis();
+// Respiration bleue tant que le démarrage n'est pas terminé, puis vert (ou rouge si une
+// étape a échoué) pendant une seconde. Tâche à part : plus rien n'attend l'animation.
+void SystemManager::statusLedTask(void *pvParameters) {
   const uint16_t breathingPeriod = 1200;
-  while (millis() - startTime < STABILITY_DELAY) {
+  while (!bootSequencer.isReady()) {
     float progress = (float)(millis() % breathingPeriod) / breathingPeriod;
     uint8_t brightness = 32 + 223 * (0.5f * (1 + sinf(progress * 2 * 3.14159f)));
     leds[0] = CRGB::Blue;
@@ -34,73 +46,135 @@ void SystemManager::stabilisation() {
     FastLED.show();
     vTaskDelay(pdMS_TO_TICKS(20));
   }
-  leds[0] = CRGB::Green;
+  leds[0] = bootSequencer.hasFailures() ? CRGB::Red : CRGB::Green;
   FastLED.show();
   vTaskDelay(pdMS_TO_TICKS(1000));
-  leds[0] = CRGB::Black;
-  FastLED.show();
+  // Un arrêt d'urgence entre-temps garde la LED rouge
+  if (!faultBus.isHalted() && !bootSequencer.hasFailures()) {
+    leds[0] = CRGB::Black;
+    FastLED.show();
+  }
   DEBUG_PRINTF_AUTO("Système stabilisé");
+  vTaskDelete(NULL);
+}
+
+void SystemManager::startStatusLed() {
+  FastLED.addLeds<WS2812, LED_PIN, COLOR_ORDER>(leds, NUM_LEDS);
+  heapGuard.createTask(statusLedTask, "StatusLed", 2048, NULL, 1, NULL, 0);
+}
+
+// Sortie coupée par l'arrêt d'urgence, dans la tâche qui l'a détecté
+static void haltIndicator() {
+  leds[0] = CRGB::Red;
+  FastLED.show();
 }
 
 void SystemManager::systemTask(void *pvParameters) {
+  FaultEvent event;
   while (1) {
-    if (xSemaphoreTake(errorSemaphore, pdMS_TO_TICKS(1000)) == pdTRUE) {
-      DEBUG_PRINTF_AUTO("Erreur détectée, arrêt d'urgence");
-      leds[0] = CRGB::Red;
-      FastLED.show();
-      xQueueReset(sdQueue);
-      xQueueReset(gcodeQueue);
+    if (!faultBus.receive(event, portMAX_DELAY)) continue;
+    traceRecorder.record(TraceType::INSTANT, TraceId::SYSTEM_FAULT, (int32_t)event.code);
+    DEBUG_ERRORF_AUTO("Erreur: Défaut %s (source %s, détail %ld) à %lu µs", FaultBus::codeName(event.code),
+                      FaultBus::sourceName(event.source), (long)event.detail, (unsigned long)event.timestamp_us);
+    if (event.code == FaultCode::EMERGENCY_STOP || event.source == FaultSource::HEALTH) {
+      // Sorties déjà coupées par emergencyStop() ; les alertes de surveillance ne
+      // justifient pas de vider les files
+      continue;
     }
-    vTaskDelay(pdMS_TO_TICKS(100));
+    leds[0] = CRGB::Red;
+    FastLED.show();
+    xQueueReset(sdQueue);
+    gcodeScheduler.discardAll();
   }
 }
 
-void SystemManager::init() {
+bool SystemManager::initQueues() {
+  // Tâche de vidage du journal différé : les messages précédents attendent dans l'anneau
+  debugLogger.begin();
   DEBUG_PRINTF_AUTO("Initialisation du System Manager");
-  stabilisation();
-  gcodeQueue = xQueueCreate(10, sizeof(String));
-  sdQueue = xQueueCreate(5, sizeof(String));
-  motionQueue = xQueueCreate(10, sizeof(MotionCommand));
-  if (!gcodeQueue || !sdQueue || !motionQueue) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible de créer les queues");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-    return;
+  if (!faultBus.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer le bus de défauts");
+    return false;
   }
-  DEBUG_PRINTF_AUTO("Queues créées avec succès");
-  errorSemaphore = xSemaphoreCreateBinary();
-  if (!errorSemaphore) {
-    DEBUG_PRINTF_AUTO("Erreur: Impossible de créer les sémaphores");
-    return;
+  faultBus.addHaltHandler(haltIndicator);
+  // Tampons de taille fixe : une String recopiée octet par octet partagerait son tas avec
+  // l'émetteur, qui le libère aussitôt
+  gcodeQueue = heapGuard.createQueue(10, GCODE_LINE_MAX);
+  sdQueue = heapGuard.createQueue(5, SD_PATH_MAX);
+  motionQueue = heapGuard.createQueue(10, sizeof(MotionCommand));
+  if (!gcodeQueue || !sdQueue || !motionQueue || !gcodeScheduler.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer les queues");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+    return false;
   }
-  DEBUG_PRINTF_AUTO("Sémaphores créés avec succès");
-  if (!sdManager.init()) {
-    DEBUG_PRINTF_AUTO("Erreur: Échec init SDManager");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
-    return;
+  DEBUG_PRINTF_AUTO("Queues créées avec succès");
+  healthMonitor.watchQueue(gcodeQueue, "gcodeQueue", 10);
+  healthMonitor.watchQueue(sdQueue, "sdQueue", 5);
+  healthMonitor.watchQueue(motionQueue, "motionQueue", 10);
+  return true;
+}
+
+// Crée la tâche et la déclare au moniteur avec sa taille de pile
+bool SystemManager::startTask(TaskFunction_t fn, const char *name, uint32_t stackSize, UBaseType_t priority,
+                              BaseType_t core, TaskHandle_t &handle) {
+  if (!heapGuard.createTask(fn, name, stackSize, NULL, priority, &handle, core)) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer %s", name);
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+    return false;
   }
+  healthMonitor.watchTask(handle, stackSize);
+  return true;
+}
+
+bool SystemManager::startTasks() {
   gcodeParser.init();
-  commManager.init();
-  xTaskCreatePinnedToCore(
-    CommManager::commTask, "CommTask", 4096, NULL, 1, NULL, 1
-  );
-  xTaskCreatePinnedToCore(
-    SDManager::sdTask, "SDTask", 4096, NULL, 1, NULL, 1
-  );
-  xTaskCreatePinnedToCore(
-    GcodeParser::parserTask, "ParserTask", 4096, NULL, 3, NULL, 1
-  );
-  xTaskCreatePinnedToCore(
-    systemTask, "SystemTask", 2048, NULL, 1, NULL, 1
-  );
-  delay(1000);
+  reportManager.init();
+  if (!printEstimator.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer la file des estimations");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+  }
+#if defined(ARDUINO)
+  if (!toolpathPreview.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer la file des aperçus");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+  }
+  if (!thumbnailCache.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer la file des miniatures");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+  }
+  if (!fileBrowser.init()) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer la file de l'explorateur");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
+  }
+#endif
+  bool ok = startTask(CommManager::commTask, "CommTask", 4096, 1, 1, commTaskHandle);
+  ok &= startTask(SDManager::sdTask, "SDTask", 4096, 1, 1, sdTaskHandle);
+  ok &= startTask(GcodeParser::parserTask, "ParserTask", 4096, 3, 1, parserTaskHandle);
+  ok &= startTask(systemTask, "SystemTask", 2048, 1, 1, systemTaskHandle);
+  // Auto-report et surveillance sur le cœur 0, à l'écart de la chaîne Comm → SD → Parser
+  ok &= startTask(ReportManager::reportTask, "ReportTask", 2048, 1, 0, reportTaskHandle);
+  ok &= startTask(HealthMonitor::healthTask, "HealthTask", 3072, 1, 0, healthTaskHandle);
+  // Estimations en priorité idle, comme les aperçus
+  ok &= startTask(PrintEstimator::estimateTask, "EstimateTask", ESTIMATE_TASK_STACK, tskIDLE_PRIORITY, 0,
+                  estimateTaskHandle);
+#if defined(ARDUINO)
+  // Priorité idle : un aperçu de plusieurs secondes ne doit rien retarder
+  ok &= startTask(ToolpathPreview::previewTask, "PreviewTask", PREVIEW_TASK_STACK, tskIDLE_PRIORITY, 0,
+                  previewTaskHandle);
+  ok &= startTask(ThumbnailCache::thumbnailTask, "ThumbTask", THUMB_TASK_STACK, tskIDLE_PRIORITY, 0,
+                  thumbTaskHandle);
+  // Priorité 1 : une page manquante s'affiche pendant le défilement, avant les aperçus
+  ok &= startTask(FileBrowser::browserTask, "BrowseTask", FILE_BROWSER_TASK_STACK, 1, 0, browseTaskHandle);
+#endif
+  return ok;
 }
 
 void SystemManager::testSystem() {
   DEBUG_PRINTF_AUTO("Test System Manager: Vérification des ressources");
-  if (gcodeQueue && sdQueue && motionQueue && errorSemaphore) {
+  if (gcodeQueue && sdQueue && motionQueue && faultBus.isReady()) {
     DEBUG_PRINTF_AUTO("Toutes les ressources sont initialisées");
   } else {
-    DEBUG_PRINTF_AUTO("Erreur: Certaines ressources non initialisées");
-    if (errorSemaphore) xSemaphoreGive(errorSemaphore);
+    DEBUG_ERRORF_AUTO("Erreur: Certaines ressources non initialisées");
+    faultBus.raise(FaultCode::INIT_FAILED, FaultSource::SYSTEM);
   }
 }
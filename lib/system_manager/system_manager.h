@@ -6,15 +6,29 @@
 class SystemManager {
 private:
   static void systemTask(void *pvParameters);
+  static void statusLedTask(void *pvParameters);
+  TaskHandle_t commTaskHandle = nullptr;
+  TaskHandle_t sdTaskHandle = nullptr;
+  TaskHandle_t parserTaskHandle = nullptr;
+  TaskHandle_t systemTaskHandle = nullptr;
+  TaskHandle_t reportTaskHandle = nullptr;
+  TaskHandle_t healthTaskHandle = nullptr;
+  TaskHandle_t estimateTaskHandle = nullptr;
+  TaskHandle_t previewTaskHandle = nullptr;
+  TaskHandle_t thumbTaskHandle = nullptr;
+  TaskHandle_t browseTaskHandle = nullptr;
+  bool startTask(TaskFunction_t fn, const char *name, uint32_t stackSize, UBaseType_t priority,
+                 BaseType_t core, TaskHandle_t &handle);
 
 public:
-  void init();
+  // Étapes du démarrage (voir BootSequencer dans main.cpp)
+  bool initQueues();
+  bool startTasks();
+  void startStatusLed();
   void testSystem();
-  void stabilisation();
 };
 
 extern SystemManager systemManager;
 extern QueueHandle_t gcodeQueue;
 extern QueueHandle_t sdQueue;
 extern QueueHandle_t motionQueue;
-extern SemaphoreHandle_t errorSemaphore;
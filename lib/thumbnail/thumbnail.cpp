@@ -0,0 +1,640 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
+#include "thumbnail.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <Arduino.h>
+#include <string.h>
+#include <stdlib.h>
+#include "mem_placement.h"
+#if defined(ARDUINO)
+#include "sd_manager.h"
+#include "heap_guard.h"
+#include "lvgl_screen_display.h"
+#endif
+// tinfl (miniz) est en ROM sur l'ESP32-S3 ; sans lui, seul QOI est décodé
+#if __has_include(<esp32s3/rom/miniz.h>)
+#include <esp32s3/rom/miniz.h>
+#define THUMB_PNG 1
+#elif __has_include(<rom/miniz.h>)
+#include <rom/miniz.h>
+#define THUMB_PNG 1
+#elif __has_include(<miniz.h>)
+#include <miniz.h>
+#define THUMB_PNG 1
+#else
+#define THUMB_PNG 0
+#endif
+
+static_assert(sizeof(ThumbnailCacheHeader) == 20, "ThumbnailCacheHeader ne doit pas avoir de remplissage");
+static const char THUMB_MAGIC[4] = { 'T', 'H', 'B', '1' };
+static const size_t THUMB_PIXELS_BYTES = THUMB_MAX_W * THUMB_MAX_H * sizeof(uint16_t);
+static const uint32_t PNG_MAX_WIDTH = 1024;   // Lignes brutes gardées en mémoire : 2 x (1 + 4 x largeur)
+
+ThumbnailCache thumbnailCache;
+
+ThumbnailCache::ThumbnailCache() : entries(), useClock(0), insertions(0), readBuffer(), data(nullptr), pixels(nullptr),
+  scratch(nullptr), inflater(nullptr)
+#if defined(ARDUINO)
+  , requests(nullptr)
+#endif
+{}
+
+// Les images sont lues par LVGL : toute modification du LRU se fait sous son verrou
+static bool lockUi() {
+#if defined(ARDUINO)
+  return display.lock();
+#else
+  return true;
+#endif
+}
+
+static void unlockUi() {
+#if defined(ARDUINO)
+  display.unlock();
+#endif
+}
+
+static uint32_t be32(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Réduction d'un facteur entier au fil du décodage, pixels transparents posés sur THUMB_BG_COLOR
+struct PixelSink {
+  uint16_t *out;
+  uint32_t step, outW, outH;
+
+  bool begin(uint32_t w, uint32_t h, uint16_t &width, uint16_t &height) {
+    if (w == 0 || h == 0 || w > 4096 || h > 4096) return false;
+    step = 1;
+    while ((w + step - 1) / step > THUMB_MAX_W || (h + step - 1) / step > THUMB_MAX_H) step++;
+    outW = (w + step - 1) / step;
+    outH = (h + step - 1) / step;
+    width = (uint16_t)outW;
+    height = (uint16_t)outH;
+    return true;
+  }
+
+  void put(uint32_t x, uint32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+    if (x % step || y % step) return;
+    if (a != 255) {
+      const uint8_t br = (THUMB_BG_COLOR >> 16) & 0xFF, bg = (THUMB_BG_COLOR >> 8) & 0xFF, bb = THUMB_BG_COLOR & 0xFF;
+      r = (uint8_t)((r * a + br * (255 - a)) / 255);
+      g = (uint8_t)((g * a + bg * (255 - a)) / 255);
+      b = (uint8_t)((b * a + bb * (255 - a)) / 255);
+    }
+    out[(y / step) * outW + x / step] = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+  }
+};
+
+bool ThumbnailCache::decodeQoi(const uint8_t *d, size_t len, uint16_t *out, uint16_t &width, uint16_t &height,
+                               uint16_t &sourceWidth, uint16_t &sourceHeight) {
+  if (len < 14 + 8 || memcmp(d, "qoif", 4) != 0) return false;
+  uint32_t w = be32(d + 4), h = be32(d + 8);
+  PixelSink sink = { out, 1, 0, 0 };
+  if (!sink.begin(w, h, width, height)) return false;
+  sourceWidth = (uint16_t)w;
+  sourceHeight = (uint16_t)h;
+  uint8_t index[64][4];
+  memset(index, 0, sizeof(index));
+  uint8_t px[4] = { 0, 0, 0, 255 };
+  size_t p = 14;
+  const size_t end = len - 8;   // Marqueur de fin
+  uint32_t run = 0;
+  for (uint32_t i = 0, n = w * h; i < n; i++) {
+    if (run > 0) {
+      run--;
+    } else {
+      if (p >= end) return false;
+      uint8_t b1 = d[p++];
+      if (b1 == 0xFE) {
+        if (p + 3 > end) return false;
+        memcpy(px, d + p, 3);
+        p += 3;
+      } else if (b1 == 0xFF) {
+        if (p + 4 > end) return false;
+        memcpy(px, d + p, 4);
+        p += 4;
+      } else if ((b1 & 0xC0) == 0x00) {
+        memcpy(px, index[b1], 4);
+      } else if ((b1 & 0xC0) == 0x40) {
+        px[0] += ((b1 >> 4) & 0x03) - 2;
+        px[1] += ((b1 >> 2) & 0x03) - 2;
+        px[2] += (b1 & 0x03) - 2;
+      } else if ((b1 & 0xC0) == 0x80) {
+        if (p >= end) return false;
+        uint8_t b2 = d[p++];
+        int vg = (b1 & 0x3F) - 32;
+        px[0] += vg - 8 + ((b2 >> 4) & 0x0F);
+        px[1] += vg;
+        px[2] += vg - 8 + (b2 & 0x0F);
+      } else {
+        run = b1 & 0x3F;   // Ce pixel compte pour le premier de la série
+      }
+      memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+    }
+    sink.put(i % w, i / w, px[0], px[1], px[2], px[3]);
+  }
+  return true;
+}
+
+#if THUMB_PNG
+struct PngInflater {
+  tinfl_decompressor decompressor;
+  uint8_t dict[TINFL_LZ_DICT_SIZE];   // Fenêtre circulaire : la sortie de tinfl y boucle
+  uint8_t rows[2][1 + 4 * PNG_MAX_WIDTH];
+};
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  return pb <= pc ? b : c;
+}
+
+static bool unfilter(uint8_t *cur, const uint8_t *prev, size_t len, size_t bpp) {
+  uint8_t filter = cur[0];
+  uint8_t *x = cur + 1;
+  const uint8_t *up = prev + 1;
+  for (size_t i = 0; i < len; i++) {
+    uint8_t a = i >= bpp ? x[i - bpp] : 0;
+    uint8_t c = i >= bpp ? up[i - bpp] : 0;
+    switch (filter) {
+      case 0: break;
+      case 1: x[i] += a; break;
+      case 2: x[i] += up[i]; break;
+      case 3: x[i] += (uint8_t)((a + up[i]) / 2); break;
+      case 4: x[i] += paeth(a, up[i], c); break;
+      default: return false;
+    }
+  }
+  return true;
+}
+
+// Morceaux IDAT consécutifs, lus sans copie dans le PNG décodé du base64
+struct PngChunks {
+  const uint8_t *d;
+  size_t len, next;
+
+  bool find(const char *type, const uint8_t *&body, uint32_t &size) {
+    while (next + 12 <= len) {
+      uint32_t n = be32(d + next);
+      const uint8_t *t = d + next + 4;
+      if (n > len - next - 12) return false;
+      next += 12 + n;
+      if (memcmp(t, type, 4) == 0) {
+        body = t + 4;
+        size = n;
+        return true;
+      }
+      if (memcmp(t, "IEND", 4) == 0) return false;
+    }
+    return false;
+  }
+
+  bool nextIs(const char *type) const {
+    return next + 8 <= len && memcmp(d + next + 4, type, 4) == 0;
+  }
+};
+#endif
+
+bool ThumbnailCache::decodePng(const uint8_t *d, size_t len, uint16_t *out, uint16_t &width, uint16_t &height,
+                               uint16_t &sourceWidth, uint16_t &sourceHeight) {
+#if THUMB_PNG
+  static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  if (len < 8 + 25 || memcmp(d, SIGNATURE, 8) != 0) return false;
+  PngChunks chunks = { d, len, 8 };
+  const uint8_t *body;
+  uint32_t size;
+  if (!chunks.find("IHDR", body, size) || size < 13) return false;
+  uint32_t w = be32(body), h = be32(body + 4);
+  uint8_t depth = body[8], colorType = body[9], interlace = body[12];
+  // Ce qu'écrivent les slicers : 8 bits, non entrelacé, gris/RGB avec ou sans alpha
+  size_t channels = colorType == 0 ? 1 : colorType == 2 ? 3 : colorType == 4 ? 2 : colorType == 6 ? 4 : 0;
+  if (depth != 8 || interlace != 0 || channels == 0 || w > PNG_MAX_WIDTH) return false;
+  PixelSink sink = { out, 1, 0, 0 };
+  if (!sink.begin(w, h, width, height)) return false;
+  sourceWidth = (uint16_t)w;
+  sourceHeight = (uint16_t)h;
+  if (!inflater) inflater = memPlacement.alloc(sizeof(PngInflater), MemClass::BULK, "thumb_inflater");
+  if (!inflater) return false;
+  PngInflater &z = *(PngInflater *)inflater;
+  const size_t rowBytes = 1 + channels * w;
+  uint8_t *cur = z.rows[0], *prev = z.rows[1];
+  memset(prev, 0, rowBytes);
+  size_t rowFill = 0;
+  uint32_t y = 0;
+
+  const uint8_t *in;
+  uint32_t inLeft;
+  if (!chunks.find("IDAT", in, inLeft)) return false;
+  tinfl_init(&z.decompressor);
+  size_t dictOfs = 0;
+  while (y < h) {
+    bool moreInput = chunks.nextIs("IDAT");
+    size_t inBytes = inLeft, outBytes = TINFL_LZ_DICT_SIZE - dictOfs;
+    tinfl_status status = tinfl_decompress(&z.decompressor, in, &inBytes, z.dict, z.dict + dictOfs, &outBytes,
+                                           TINFL_FLAG_PARSE_ZLIB_HEADER | (moreInput ? TINFL_FLAG_HAS_MORE_INPUT : 0));
+    in += inBytes;
+    inLeft -= (uint32_t)inBytes;
+    // Lignes filtrées reconstituées au fil de la sortie, sans tampon image intermédiaire
+    const uint8_t *src = z.dict + dictOfs;
+    size_t avail = outBytes;
+    while (avail > 0 && y < h) {
+      size_t take = rowBytes - rowFill < avail ? rowBytes - rowFill : avail;
+      memcpy(cur + rowFill, src, take);
+      rowFill += take;
+      src += take;
+      avail -= take;
+      if (rowFill < rowBytes) break;
+      if (!unfilter(cur, prev, rowBytes - 1, channels)) return false;
+      const uint8_t *px = cur + 1;
+      for (uint32_t x = 0; x < w; x++, px += channels) {
+        switch (channels) {
+          case 1: sink.put(x, y, px[0], px[0], px[0], 255); break;
+          case 2: sink.put(x, y, px[0], px[0], px[0], px[1]); break;
+          case 3: sink.put(x, y, px[0], px[1], px[2], 255); break;
+          default: sink.put(x, y, px[0], px[1], px[2], px[3]); break;
+        }
+      }
+      uint8_t *t = prev;
+      prev = cur;
+      cur = t;
+      rowFill = 0;
+      y++;
+    }
+    dictOfs = (dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+    if (status < TINFL_STATUS_DONE) return false;
+    if (status == TINFL_STATUS_DONE) break;
+    if (status == TINFL_STATUS_NEEDS_MORE_INPUT && inLeft == 0 && !chunks.find("IDAT", in, inLeft)) return false;
+  }
+  return y == h;
+#else
+  return false;
+#endif
+}
+
+// Décodage base64 au fil des lignes : "; " déjà retiré, blancs et '=' ignorés
+struct Base64Sink {
+  uint8_t *out;
+  size_t capacity, len;
+  uint32_t acc;
+  uint8_t bits;
+  bool overflow;
+
+  void feed(const char *s) {
+    for (; *s; s++) {
+      char c = *s;
+      int v;
+      if (c >= 'A' && c <= 'Z') v = c - 'A';
+      else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+      else if (c >= '0' && c <= '9') v = c - '0' + 52;
+      else if (c == '+') v = 62;
+      else if (c == '/') v = 63;
+      else continue;
+      acc = (acc << 6) | (uint32_t)v;
+      bits += 6;
+      if (bits >= 8) {
+        bits -= 8;
+        if (len < capacity) out[len++] = (uint8_t)(acc >> bits);
+        else overflow = true;
+      }
+    }
+  }
+};
+
+// "thumbnail begin 220x124 12345", "thumbnail_QOI begin ...", "thumbnail_JPG begin ..."
+static bool parseThumbnailTag(const char *p, const char *verb, ThumbnailFormat &format, uint32_t &w, uint32_t &h,
+                              uint32_t &len) {
+  if (strncmp(p, "thumbnail", 9) != 0) return false;
+  p += 9;
+  format = ThumbnailFormat::PNG;
+  if (*p == '_') {
+    if (strncmp(p, "_PNG", 4) == 0) format = ThumbnailFormat::PNG;
+    else if (strncmp(p, "_QOI", 4) == 0) format = ThumbnailFormat::QOI;
+    else format = ThumbnailFormat::NONE;   // JPG : pas de décodeur
+    while (*p && *p != ' ') p++;
+  }
+  while (*p == ' ') p++;
+  size_t n = strlen(verb);
+  if (strncmp(p, verb, n) != 0) return false;
+  if (strcmp(verb, "begin") != 0) return true;
+  unsigned long tw, th, tlen;
+  if (sscanf(p + n, " %lux%lu %lu", &tw, &th, &tlen) != 3) return false;
+  w = (uint32_t)tw;
+  h = (uint32_t)th;
+  len = (uint32_t)tlen;
+  return true;
+}
+
+// Un bloc remplace le précédent s'il couvre mieux THUMB_MAX_W x THUMB_MAX_H : le plus petit
+// qui le couvre (moins à décoder), sinon le plus grand
+static bool betterThumbnail(uint32_t w, uint32_t h, uint32_t bestW, uint32_t bestH) {
+  if (bestW == 0) return true;
+  bool covers = w >= THUMB_MAX_W || h >= THUMB_MAX_H;
+  bool bestCovers = bestW >= THUMB_MAX_W || bestH >= THUMB_MAX_H;
+  if (covers != bestCovers) return covers;
+  return covers ? w * h < bestW * bestH : w * h > bestW * bestH;
+}
+
+bool ThumbnailCache::allocate() {
+  if (!data) data = (uint8_t *)memPlacement.alloc(THUMB_DATA_MAX, MemClass::BULK, "thumb_data");
+  if (!pixels) pixels = (uint16_t *)memPlacement.alloc(THUMB_PIXELS_BYTES, MemClass::BULK, "thumb_decode");
+  if (!scratch) scratch = (uint16_t *)memPlacement.alloc(THUMB_PIXELS_BYTES, MemClass::BULK, "thumb_decode");
+  return data && pixels && scratch;
+}
+
+bool ThumbnailCache::extract(Storage *storage, const char *path, ThumbnailInfo &info) {
+  StorageFile *file = storage->open(path, StorageMode::READ);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir %s pour la miniature", path);
+    return false;
+  }
+  StorageLineReader reader(file, readBuffer, sizeof(readBuffer));
+  char line[COMM_LINE_MAX];
+  enum { SEARCH, COLLECT, SKIP } state = SEARCH;
+  Base64Sink b64 = { data, THUMB_DATA_MAX, 0, 0, 0, false };
+  uint32_t blockW = 0, blockH = 0;
+  bool found = false;
+  while (reader.offset() < THUMB_SCAN_BYTES && reader.readLine(line, sizeof(line)) >= 0) {
+    const char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0' || *p == '\r') continue;
+    if (*p != ';') {
+      if (state == SEARCH) break;   // Premier G-code : les miniatures sont toutes avant
+      state = SEARCH;               // Bloc non terminé : ignoré
+      continue;
+    }
+    p++;
+    while (*p == ' ') p++;
+    ThumbnailFormat format;
+    uint32_t w = 0, h = 0, len = 0;
+    if (state != SEARCH) {
+      if (!parseThumbnailTag(p, "end", format, w, h, len)) {
+        if (state == COLLECT) b64.feed(p);
+        continue;
+      }
+      if (state == COLLECT && !b64.overflow) {
+        uint16_t outW, outH, srcW, srcH;
+        bool ok = (b64.len >= 4 && memcmp(data, "qoif", 4) == 0)
+                    ? decodeQoi(data, b64.len, scratch, outW, outH, srcW, srcH)
+                    : decodePng(data, b64.len, scratch, outW, outH, srcW, srcH);
+        if (ok) {
+          // Meilleure image gardée : la suivante se décode dans l'autre tampon
+          uint16_t *t = pixels;
+          pixels = scratch;
+          scratch = t;
+          info.width = outW;
+          info.height = outH;
+          info.sourceWidth = srcW;
+          info.sourceHeight = srcH;
+          info.format = memcmp(data, "qoif", 4) == 0 ? ThumbnailFormat::QOI : ThumbnailFormat::PNG;
+          found = true;
+        } else {
+          DEBUG_PRINTF_AUTO("Miniature %lux%lu de %s illisible", (unsigned long)blockW, (unsigned long)blockH, path);
+        }
+      }
+      state = SEARCH;
+      continue;
+    }
+    if (!parseThumbnailTag(p, "begin", format, w, h, len)) continue;
+    // Taille annoncée en base64 : 3 octets pour 4 caractères
+    bool fits = format != ThumbnailFormat::NONE && len / 4 * 3 <= THUMB_DATA_MAX;
+    if (fits && betterThumbnail(w, h, found ? info.sourceWidth : 0, found ? info.sourceHeight : 0)) {
+      b64.len = 0;
+      b64.bits = 0;
+      b64.acc = 0;
+      b64.overflow = false;
+      blockW = w;
+      blockH = h;
+      state = COLLECT;
+    } else {
+      state = SKIP;
+    }
+  }
+  info.scannedBytes = reader.offset();
+  file->close();
+  return found;
+}
+
+bool ThumbnailCache::loadCache(Storage *storage, const char *cache, uint32_t sourceSize, ThumbnailInfo &info) {
+  StorageFile *file = storage->open(cache, StorageMode::READ);
+  if (!file) return false;
+  ThumbnailCacheHeader header;
+  bool valid = file->read((uint8_t *)&header, sizeof(header)) == (int)sizeof(header) &&
+               memcmp(header.magic, THUMB_MAGIC, sizeof(THUMB_MAGIC)) == 0 && header.sourceSize == sourceSize &&
+               header.width <= THUMB_MAX_W && header.height <= THUMB_MAX_H;
+  if (valid) {
+    size_t bytes = (size_t)header.width * header.height * sizeof(uint16_t);
+    uint8_t *dst = (uint8_t *)pixels;
+    while (valid && bytes > 0) {
+      int n = file->read(dst, bytes);
+      valid = n > 0;
+      if (valid) {
+        dst += n;
+        bytes -= (size_t)n;
+      }
+    }
+  }
+  file->close();
+  if (!valid) return false;
+  info.width = header.width;
+  info.height = header.height;
+  info.sourceWidth = header.sourceWidth;
+  info.sourceHeight = header.sourceHeight;
+  info.format = (ThumbnailFormat)header.format;
+  return true;
+}
+
+// Un job sans miniature est aussi mis en cache (width = 0) : il n'est pas relu à chaque visite
+void ThumbnailCache::saveCache(Storage *storage, const char *cache, uint32_t sourceSize, const ThumbnailInfo &info) {
+  ThumbnailCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, THUMB_MAGIC, sizeof(THUMB_MAGIC));
+  header.sourceSize = sourceSize;
+  header.width = info.width;
+  header.height = info.height;
+  header.sourceWidth = info.sourceWidth;
+  header.sourceHeight = info.sourceHeight;
+  header.format = (uint8_t)info.format;
+  StorageFile *file = storage->open(cache, StorageMode::WRITE);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer le cache de miniature %s", cache);
+    return;
+  }
+  size_t bytes = (size_t)info.width * info.height * sizeof(uint16_t);
+  bool ok = file->write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            file->write((const uint8_t *)pixels, bytes) == bytes;
+  file->close();
+  if (!ok) {
+    DEBUG_ERRORF_AUTO("Erreur: Écriture du cache de miniature %s", cache);
+    storage->remove(cache);
+  }
+}
+
+uint32_t ThumbnailCache::hashPath(const char *path) {
+  uint32_t h = 2166136261u;
+  for (; *path; path++) h = (h ^ (uint8_t)*path) * 16777619u;
+  return h;
+}
+
+ThumbnailCache::Entry *ThumbnailCache::find(const char *path, uint32_t key) {
+  for (size_t i = 0; i < THUMB_LRU_ENTRIES; i++) {
+    if (entries[i].used && entries[i].key == key && strcmp(entries[i].path, path) == 0) return &entries[i];
+  }
+  return nullptr;
+}
+
+ThumbnailState ThumbnailCache::lookup(const char *path, const lv_image_dsc_t **image) {
+  Entry *e = find(path, hashPath(path));
+  if (!e) return ThumbnailState::MISSING;
+  e->lastUse = ++useClock;
+  if (!e->hasImage) return ThumbnailState::NONE;
+  if (image) *image = &e->dsc;
+  return ThumbnailState::READY;
+}
+
+// Éviction du moins récemment affiché ; l'image décodée est copiée dans son tampon.
+// Un chemin trop long pour l'entrée n'est pas gardé (request() le refuse déjà).
+void ThumbnailCache::insert(const char *path, uint32_t key, uint32_t sourceSize, const ThumbnailInfo &info) {
+  if (strlen(path) >= SD_PATH_MAX) return;
+  if (!lockUi()) return;
+  Entry *e = find(path, key);
+  if (!e) {
+    e = &entries[0];
+    for (size_t i = 0; i < THUMB_LRU_ENTRIES; i++) {
+      if (!entries[i].used) {
+        e = &entries[i];
+        break;
+      }
+      if (entries[i].lastUse < e->lastUse) e = &entries[i];
+    }
+  }
+  bool hasImage = info.width > 0;
+  if (hasImage && !e->pixels) e->pixels = (uint16_t *)memPlacement.alloc(THUMB_PIXELS_BYTES, MemClass::BULK, "thumb_lru");
+  if (hasImage && !e->pixels) hasImage = false;
+  // Même descripteur, nouveau contenu : LVGL ne doit pas resservir l'ancienne image
+  if (e->used && e->hasImage) lv_image_cache_drop(&e->dsc);
+  e->key = key;
+  strcpy(e->path, path);
+  e->sourceSize = sourceSize;
+  e->lastUse = ++useClock;
+  e->sourceWidth = info.sourceWidth;
+  e->sourceHeight = info.sourceHeight;
+  e->format = info.format;
+  e->used = true;
+  e->hasImage = hasImage;
+  if (hasImage) {
+    memcpy(e->pixels, pixels, (size_t)info.width * info.height * sizeof(uint16_t));
+    memset(&e->dsc, 0, sizeof(e->dsc));
+    e->dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+    e->dsc.header.cf = LV_COLOR_FORMAT_RGB565;
+    e->dsc.header.w = info.width;
+    e->dsc.header.h = info.height;
+    e->dsc.header.stride = info.width * sizeof(uint16_t);
+    e->dsc.data_size = (uint32_t)info.width * info.height * sizeof(uint16_t);
+    e->dsc.data = (const uint8_t *)e->pixels;
+  }
+  insertions++;
+  unlockUi();
+}
+
+bool ThumbnailCache::load(Storage *storage, const char *path, ThumbnailInfo &info) {
+  uint32_t t0 = millis();
+  memset(&info, 0, sizeof(info));
+  StorageStat st;
+  if (!storage || !storage->stat(path, st) || st.isDir) {
+    DEBUG_ERRORF_AUTO("Erreur: Job introuvable pour la miniature: %s", path);
+    return false;
+  }
+  uint32_t key = hashPath(path);
+  Entry *e = find(path, key);
+  if (e && e->sourceSize == st.size) {
+    info.width = e->hasImage ? (uint16_t)e->dsc.header.w : 0;
+    info.height = e->hasImage ? (uint16_t)e->dsc.header.h : 0;
+    info.sourceWidth = e->sourceWidth;
+    info.sourceHeight = e->sourceHeight;
+    info.format = e->format;
+    info.source = 1;
+    info.elapsedMs = millis() - t0;
+    return true;
+  }
+  if (!allocate()) {
+    DEBUG_ERRORF_AUTO("Erreur: Allocation des tampons de miniature");
+    return false;
+  }
+  char cache[96];
+  bool haveCache = storageSidecarPath(path, ".thb", cache, sizeof(cache));
+  if (haveCache && loadCache(storage, cache, st.size, info)) {
+    info.source = 2;
+  } else {
+    if (!extract(storage, path, info)) {
+      info.width = info.height = 0;
+      info.format = ThumbnailFormat::NONE;
+    }
+    if (haveCache) saveCache(storage, cache, st.size, info);
+  }
+  insert(path, key, st.size, info);
+  info.elapsedMs = millis() - t0;
+  return true;
+}
+
+#if defined(ARDUINO)
+struct ThumbnailRequest {
+  char path[SD_PATH_MAX];
+  bool report;
+};
+
+bool ThumbnailCache::init() {
+  if (!requests) requests = heapGuard.createQueue(THUMB_QUEUE_LENGTH, sizeof(ThumbnailRequest));
+#if STATIC_ALLOCATION
+  // Tas verrouillé après le démarrage : tampons de décodage et images du LRU pris ici
+#if THUMB_PNG
+  if (!inflater) inflater = memPlacement.alloc(sizeof(PngInflater), MemClass::BULK, "thumb_inflater");
+  if (!inflater) return false;
+#endif
+  for (size_t i = 0; i < THUMB_LRU_ENTRIES; i++) {
+    if (!entries[i].pixels) entries[i].pixels = (uint16_t *)memPlacement.alloc(THUMB_PIXELS_BYTES, MemClass::BULK, "thumb_lru");
+    if (!entries[i].pixels) return false;
+  }
+  if (!allocate()) return false;
+#endif
+  return requests != nullptr;
+}
+
+bool ThumbnailCache::request(const char *path, bool report) {
+  ThumbnailRequest req;
+  if (!requests || strlen(path) >= sizeof(req.path)) return false;
+  strcpy(req.path, path);
+  req.report = report;
+  return xQueueSend(requests, &req, 0) == pdTRUE;
+}
+
+static const char *thumbnailFormatName(ThumbnailFormat format) {
+  switch (format) {
+    case ThumbnailFormat::PNG: return "png";
+    case ThumbnailFormat::QOI: return "qoi";
+    default: return "none";
+  }
+}
+
+// Priorité idle comme PreviewTask : le décodage PNG d'un gros en-tête prend plusieurs ms
+void ThumbnailCache::thumbnailTask(void *pvParameters) {
+  static const char *const SOURCES[] = { "decoded", "lru", "sd" };
+  ThumbnailRequest req;
+  while (1) {
+    if (xQueueReceive(thumbnailCache.requests, &req, portMAX_DELAY) != pdTRUE) continue;
+    ThumbnailInfo info;
+    bool ok = thumbnailCache.load(sdManager.getStorage(), req.path, info);
+    if (!req.report) continue;
+    if (!ok) {
+      reportLine("ERROR: Thumbnail failed for %s\n", req.path);
+      continue;
+    }
+    reportLine("THUMB file=%s found=%d w=%u h=%u src_w=%u src_h=%u format=%s source=%s scanned=%lu ms=%lu\n",
+               req.path, info.width > 0 ? 1 : 0, (unsigned)info.width, (unsigned)info.height,
+               (unsigned)info.sourceWidth, (unsigned)info.sourceHeight, thumbnailFormatName(info.format),
+               SOURCES[info.source], (unsigned long)info.scannedBytes, (unsigned long)info.elapsedMs);
+    Serial.println("OK");
+  }
+}
+#endif
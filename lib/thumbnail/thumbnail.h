@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <lvgl.h>
+#include "storage.h"
+#include "../config.h"
+#if defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+// Miniatures intégrées par les slicers (PrusaSlicer, Cura, OrcaSlicer) dans des blocs
+// "; thumbnail[_PNG|_QOI] begin WxH len" en tête de fichier. Seul l'en-tête est lu
+// (THUMB_SCAN_BYTES au plus, arrêt à la première ligne de G-code), le base64 est décodé
+// au fil des lignes dans un tampon fixe, puis le PNG ou QOI directement en RGB565.
+// Le résultat est mis en cache à côté du job (.thb) et dans un LRU en PSRAM.
+
+enum class ThumbnailFormat : uint8_t { NONE = 0, PNG, QOI };
+
+enum class ThumbnailState : uint8_t {
+  MISSING,   // Pas encore chargée : request() la fera décoder
+  NONE,      // Le job n'a pas de miniature exploitable
+  READY
+};
+
+struct ThumbnailInfo {
+  uint16_t width, height;         // Image décodée
+  uint16_t sourceWidth, sourceHeight;
+  ThumbnailFormat format;
+  uint8_t source;                 // 0 = décodée, 1 = LRU, 2 = cache SD
+  uint32_t scannedBytes;          // En-tête lu (0 si un cache a servi)
+  uint32_t elapsedMs;
+};
+
+// En-tête du fichier .thb, suivi de width * height pixels RGB565 (aucun si width == 0)
+struct ThumbnailCacheHeader {
+  char magic[4];                  // "THB1"
+  uint32_t sourceSize;
+  uint16_t width, height;
+  uint16_t sourceWidth, sourceHeight;
+  uint8_t format;
+  uint8_t reserved[3];
+};
+
+class ThumbnailCache {
+public:
+  ThumbnailCache();
+  // Lecture seule du LRU, sans E/S : à appeler sous le verrou LVGL. L'image reste valide
+  // jusqu'à son éviction ; version() change à chaque insertion pour rafraîchir l'UI.
+  ThumbnailState lookup(const char *path, const lv_image_dsc_t **image);
+  uint32_t version() const { return insertions; }
+  // Cache SD ou extraction, puis insertion dans le LRU
+  bool load(Storage *storage, const char *path, ThumbnailInfo &info);
+
+  // Décodeurs, exposés pour les tests : out reçoit au plus THUMB_MAX_W x THUMB_MAX_H pixels
+  static bool decodeQoi(const uint8_t *data, size_t len, uint16_t *out, uint16_t &width, uint16_t &height,
+                        uint16_t &sourceWidth, uint16_t &sourceHeight);
+  bool decodePng(const uint8_t *data, size_t len, uint16_t *out, uint16_t &width, uint16_t &height,
+                 uint16_t &sourceWidth, uint16_t &sourceHeight);
+
+#if defined(ARDUINO)
+  bool init();
+  // Décodage par ThumbnailTask ; report affiche le résultat sur la console
+  bool request(const char *path, bool report);
+  static void thumbnailTask(void *pvParameters);
+#endif
+
+private:
+  // Une entrée sert un chemin identique, pas seulement le même hachage : deux jobs en
+  // collision FNV-1a partageraient sinon la même miniature
+  struct Entry {
+    uint32_t key;                 // FNV-1a du chemin, filtre avant la comparaison
+    char path[SD_PATH_MAX];
+    uint32_t sourceSize;
+    uint32_t lastUse;
+    uint16_t sourceWidth, sourceHeight;
+    ThumbnailFormat format;
+    bool used;
+    bool hasImage;
+    lv_image_dsc_t dsc;
+    uint16_t *pixels;
+  };
+  Entry entries[THUMB_LRU_ENTRIES];
+  uint32_t useClock;
+  volatile uint32_t insertions;
+  uint8_t readBuffer[512];
+  uint8_t *data;                  // Miniature encodée (THUMB_DATA_MAX)
+  uint16_t *pixels;               // Meilleure image décodée
+  uint16_t *scratch;              // Image en cours de décodage
+  void *inflater;                 // Décompresseur et dictionnaire PNG, alloués au premier PNG
+#if defined(ARDUINO)
+  QueueHandle_t requests;
+#endif
+
+  bool allocate();
+  bool extract(Storage *storage, const char *path, ThumbnailInfo &info);
+  bool loadCache(Storage *storage, const char *cache, uint32_t sourceSize, ThumbnailInfo &info);
+  void saveCache(Storage *storage, const char *cache, uint32_t sourceSize, const ThumbnailInfo &info);
+  void insert(const char *path, uint32_t key, uint32_t sourceSize, const ThumbnailInfo &info);
+  Entry *find(const char *path, uint32_t key);
+  static uint32_t hashPath(const char *path);
+};
+
+extern ThumbnailCache thumbnailCache;
@@ -0,0 +1,297 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
+#include "toolpath_preview.h"
+#include "gcode_parser.h"
+#include "machine_state.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "mem_placement.h"
+#if defined(ARDUINO)
+#include "sd_manager.h"
+#include "heap_guard.h"
+#include "lvgl_screen_display.h"
+#endif
+
+static_assert(sizeof(PreviewCacheHeader) == 20, "PreviewCacheHeader ne doit pas avoir de remplissage");
+static const char PREVIEW_MAGIC[4] = { 'P', 'V', 'W', '1' };
+
+ToolpathPreview toolpathPreview;
+
+ToolpathPreview::ToolpathPreview() : canvas(), work(nullptr), readBuffer()
+#if defined(ARDUINO)
+  , requests(nullptr), image(nullptr), imageDsc(), pixels(nullptr)
+#endif
+{}
+
+static bool readFully(StorageFile *file, uint8_t *buf, size_t len) {
+  while (len > 0) {
+    int n = file->read(buf, len);
+    if (n <= 0) return false;
+    buf += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool ToolpathPreview::cachePath(const char *path, int16_t layer, char *out, size_t size) {
+  char suffix[16];
+  if (layer == PREVIEW_ALL_LAYERS) strcpy(suffix, ".pvw");
+  else snprintf(suffix, sizeof(suffix), ".L%d.pvw", layer);
+  return storageSidecarPath(path, suffix, out, size);
+}
+
+bool ToolpathPreview::render(Storage *storage, const char *path, int16_t layer, PreviewResult &result) {
+  uint32_t t0 = millis();
+  memset(&result, 0, sizeof(result));
+  result.layer = layer;
+  StorageStat st;
+  if (!storage || !storage->stat(path, st) || st.isDir) {
+    DEBUG_ERRORF_AUTO("Erreur: Job introuvable pour l'aperçu: %s", path);
+    return false;
+  }
+  result.bytes = st.size;
+  char cache[96];
+  bool haveCache = cachePath(path, layer, cache, sizeof(cache));
+  if (haveCache && loadCache(storage, cache, st.size, layer, result)) {
+    result.cached = true;
+  } else {
+    if (!rasterize(storage, path, layer, result)) return false;
+    if (haveCache) saveCache(storage, cache, result);
+  }
+  result.elapsedMs = millis() - t0;
+  return true;
+}
+
+bool ToolpathPreview::loadCache(Storage *storage, const char *cache, uint32_t sourceSize, int16_t layer,
+                                PreviewResult &result) {
+  StorageFile *file = storage->open(cache, StorageMode::READ);
+  if (!file) return false;
+  PreviewCacheHeader header;
+  bool valid = readFully(file, (uint8_t *)&header, sizeof(header)) &&
+               memcmp(header.magic, PREVIEW_MAGIC, sizeof(PREVIEW_MAGIC)) == 0 &&
+               header.sourceSize == sourceSize && header.layer == layer &&
+               header.width == PREVIEW_SIZE && header.height == PREVIEW_SIZE &&
+               readFully(file, canvas, sizeof(canvas));
+  file->close();
+  if (!valid) {
+    DEBUG_PRINTF_AUTO("Cache d'aperçu %s périmé, nouveau rendu", cache);
+    return false;
+  }
+  result.layers = header.layers;
+  result.segments = header.segments;
+  return true;
+}
+
+void ToolpathPreview::saveCache(Storage *storage, const char *cache, const PreviewResult &result) {
+  PreviewCacheHeader header;
+  memcpy(header.magic, PREVIEW_MAGIC, sizeof(PREVIEW_MAGIC));
+  header.sourceSize = result.bytes;
+  header.layer = result.layer;
+  header.layers = result.layers;
+  header.width = PREVIEW_SIZE;
+  header.height = PREVIEW_SIZE;
+  header.segments = result.segments;
+  StorageFile *file = storage->open(cache, StorageMode::WRITE);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible de créer le cache d'aperçu %s", cache);
+    return;
+  }
+  bool ok = file->write((const uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+            file->write(canvas, sizeof(canvas)) == sizeof(canvas);
+  file->close();
+  if (!ok) {
+    // Un cache tronqué serait rejeté à la lecture, mais autant ne pas le laisser
+    DEBUG_ERRORF_AUTO("Erreur: Écriture du cache d'aperçu %s", cache);
+    storage->remove(cache);
+  }
+}
+
+// Plateau centré dans le canevas, Y vers le haut comme vu de dessus
+void ToolpathPreview::toPixel(float x, float y, int32_t &px, int32_t &py) const {
+  const float bed = PREVIEW_BED_X_MM > PREVIEW_BED_Y_MM ? PREVIEW_BED_X_MM : PREVIEW_BED_Y_MM;
+  const float scale = (PREVIEW_SIZE - 1) / bed;
+  const float ox = ((PREVIEW_SIZE - 1) - PREVIEW_BED_X_MM * scale) / 2;
+  const float oy = ((PREVIEW_SIZE - 1) - PREVIEW_BED_Y_MM * scale) / 2;
+  float fx = ox + x * scale;
+  float fy = (PREVIEW_SIZE - 1) - (oy + y * scale);
+  // Hors plateau : borné pour que Bresenham ne parcoure pas des milliers de pixels invisibles
+  if (fx < -PREVIEW_SIZE) fx = -PREVIEW_SIZE;
+  if (fx > 2 * PREVIEW_SIZE) fx = 2 * PREVIEW_SIZE;
+  if (fy < -PREVIEW_SIZE) fy = -PREVIEW_SIZE;
+  if (fy > 2 * PREVIEW_SIZE) fy = 2 * PREVIEW_SIZE;
+  px = (int32_t)lroundf(fx);
+  py = (int32_t)lroundf(fy);
+}
+
+// Bresenham entier ; une couche plus haute recouvre les précédentes
+void ToolpathPreview::drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t value) {
+  int32_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int32_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  while (true) {
+    if (x0 >= 0 && x0 < PREVIEW_SIZE && y0 >= 0 && y0 < PREVIEW_SIZE) {
+      uint16_t &px = work[y0 * PREVIEW_SIZE + x0];
+      if (value > px) px = value;
+    }
+    if (x0 == x1 && y0 == y1) break;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+// Couches ramenées sur 1..255 une fois leur nombre connu
+void ToolpathPreview::normalize(uint16_t maxValue) {
+  for (size_t i = 0; i < sizeof(canvas); i++) {
+    uint16_t v = work[i];
+    if (v == 0) canvas[i] = 0;
+    else if (maxValue <= 1) canvas[i] = 255;
+    else canvas[i] = (uint8_t)(1 + (uint32_t)(v - 1) * 254 / (maxValue - 1));
+  }
+}
+
+bool ToolpathPreview::rasterize(Storage *storage, const char *path, int16_t layer, PreviewResult &result) {
+  if (!work) work = (uint16_t *)memPlacement.alloc(PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t), MemClass::BULK, "preview_work");
+  if (!work) {
+    DEBUG_ERRORF_AUTO("Erreur: Allocation du canevas d'aperçu");
+    return false;
+  }
+  StorageFile *file = storage->open(path, StorageMode::READ);
+  if (!file) {
+    DEBUG_ERRORF_AUTO("Erreur: Impossible d'ouvrir %s pour l'aperçu", path);
+    return false;
+  }
+  memset(work, 0, PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t));
+  // Contexte de parsing propre : G90/M82 et position à zéro, comme au début d'un job
+  GcodeParser parser;
+  const float *pos = parser.currentPosition();
+  StorageLineReader reader(file, readBuffer, sizeof(readBuffer));
+  char line[COMM_LINE_MAX];
+  int32_t layerIndex = -1;
+  float layerZ = 0.0f;
+  uint16_t maxValue = 0;
+  bool truncated = false;
+  while (reader.readLine(line, sizeof(line), &truncated) >= 0) {
+    result.lines++;
+    // Commande coupée (pas de ';' avant la coupure) : ignorée plutôt que mal interprétée
+    if (truncated && !strchr(line, ';')) continue;
+    char *statement = GcodeParser::trackedStatement(line);
+    if (!statement) continue;
+    MotionCommand cmd;
+    if (parser.parseLine(statement, cmd) != GcodeParser::ParseResult::OK) continue;
+    float x0 = pos[AXIS_X], y0 = pos[AXIS_Y], e0 = pos[AXIS_E];
+    if (!parser.trackPosition(cmd) || cmd.code > (int)GcodeType::G3) continue;
+    // Segment extrudé : E avance et la tête bouge en XY (une réamorce seule ne trace rien)
+    if (pos[AXIS_E] <= e0 || (pos[AXIS_X] == x0 && pos[AXIS_Y] == y0)) continue;
+    if (layerIndex < 0 || fabsf(pos[AXIS_Z] - layerZ) > 0.001f) {
+      layerIndex++;
+      layerZ = pos[AXIS_Z];
+    }
+    uint16_t value;
+    if (layer == PREVIEW_ALL_LAYERS) {
+      value = layerIndex < 65534 ? (uint16_t)(layerIndex + 1) : 65535;
+    } else if (layerIndex > layer) {
+      break;   // Couche demandée terminée : le reste du fichier n'est pas lu
+    } else if (layerIndex == layer) {
+      value = 2;
+    } else if (layerIndex == layer - 1) {
+      value = 1;   // Couche du dessous en sourdine, pour situer la couche demandée
+    } else {
+      continue;
+    }
+    int32_t px0, py0, px1, py1;
+    toPixel(x0, y0, px0, py0);
+    toPixel(pos[AXIS_X], pos[AXIS_Y], px1, py1);
+    drawLine(px0, py0, px1, py1, value);
+    result.segments++;
+    if (value > maxValue) maxValue = value;
+  }
+  file->close();
+  result.layers = (uint16_t)(layerIndex + 1);
+  if (layer != PREVIEW_ALL_LAYERS && layerIndex < layer) {
+    DEBUG_ERRORF_AUTO("Erreur: %s n'a que %ld couches", path, (long)(layerIndex + 1));
+    return false;
+  }
+  normalize(maxValue);
+  return true;
+}
+
+#if defined(ARDUINO)
+struct PreviewRequest {
+  char path[64];
+  int16_t layer;
+};
+
+bool ToolpathPreview::init() {
+  if (!requests) requests = heapGuard.createQueue(PREVIEW_QUEUE_LENGTH, sizeof(PreviewRequest));
+#if STATIC_ALLOCATION
+  // Tas verrouillé après le démarrage : les tampons ne sont plus pris au premier rendu
+  if (!work) work = (uint16_t *)memPlacement.alloc(PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t), MemClass::BULK, "preview_work");
+  if (!pixels) pixels = (uint16_t *)memPlacement.alloc(PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t), MemClass::BULK, "preview_pixels");
+  if (!work || !pixels) return false;
+#endif
+  return requests != nullptr;
+}
+
+bool ToolpathPreview::request(const char *path, int16_t layer) {
+  PreviewRequest req;
+  if (!requests || strlen(path) >= sizeof(req.path)) return false;
+  strcpy(req.path, path);
+  req.layer = layer;
+  return xQueueSend(requests, &req, 0) == pdTRUE;
+}
+
+// Bleu pour les premières couches, orange pour les dernières, gris foncé pour le vide
+static uint16_t shadeToRgb565(uint8_t shade) {
+  if (shade == 0) return 0x2104;
+  uint16_t r = 4 + 27 * shade / 255;
+  uint16_t g = 16 + 24 * shade / 255;
+  uint16_t b = 28 - 28 * shade / 255;
+  return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+void ToolpathPreview::show() {
+  if (!pixels) pixels = (uint16_t *)memPlacement.alloc(PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t), MemClass::BULK, "preview_pixels");
+  // Écran absent ou pas encore initialisé : le rendu reste disponible pour la console
+  if (!pixels || !objects.main || !display.lock()) return;
+  for (size_t i = 0; i < sizeof(canvas); i++) pixels[i] = shadeToRgb565(canvas[i]);
+  imageDsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+  imageDsc.header.cf = LV_COLOR_FORMAT_RGB565;
+  imageDsc.header.w = PREVIEW_SIZE;
+  imageDsc.header.h = PREVIEW_SIZE;
+  imageDsc.header.stride = PREVIEW_SIZE * sizeof(uint16_t);
+  imageDsc.data_size = PREVIEW_SIZE * PREVIEW_SIZE * sizeof(uint16_t);
+  imageDsc.data = (const uint8_t *)pixels;
+  if (!image) {
+    image = lv_image_create(objects.main);
+    lv_obj_align(image, LV_ALIGN_BOTTOM_RIGHT, -4, -4);
+  }
+  // Même descripteur, contenu neuf : l'ancienne image ne doit pas rester en cache
+  lv_image_cache_drop(&imageDsc);
+  lv_image_set_src(image, &imageDsc);
+  lv_obj_invalidate(image);
+  display.unlock();
+}
+
+// Priorité minimale : un gros job occupe le cœur 0 plusieurs secondes sans affamer
+// la tâche idle (watchdog) ni retarder les rapports et la surveillance
+void ToolpathPreview::previewTask(void *pvParameters) {
+  PreviewRequest req;
+  while (1) {
+    if (xQueueReceive(toolpathPreview.requests, &req, portMAX_DELAY) != pdTRUE) continue;
+    PreviewResult result;
+    if (!toolpathPreview.render(sdManager.getStorage(), req.path, req.layer, result)) {
+      reportLine("ERROR: Preview failed for %s\n", req.path);
+      continue;
+    }
+    toolpathPreview.show();
+    reportLine("PREVIEW file=%s layer=%d layers=%u lines=%lu segments=%lu bytes=%lu ms=%lu cached=%d\n",
+               req.path, (int)result.layer, (unsigned)result.layers, (unsigned long)result.lines,
+               (unsigned long)result.segments, (unsigned long)result.bytes, (unsigned long)result.elapsedMs,
+               result.cached ? 1 : 0);
+    Serial.println("OK");
+  }
+}
+#endif
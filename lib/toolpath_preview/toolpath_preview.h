@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "storage.h"
+#include "../config.h"
+#if defined(ARDUINO)
+#include <lvgl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
+// Aperçu d'un job : le fichier est lu en flux par un GcodeParser dédié et les segments
+// extrudés sont tracés en XY (Bresenham) dans un canevas réduit de PREVIEW_SIZE².
+// Le résultat est mis en cache sur la SD à côté du job : un seul rendu par fichier.
+
+#define PREVIEW_ALL_LAYERS (-1)
+
+struct PreviewResult {
+  int16_t layer;        // Couche demandée, PREVIEW_ALL_LAYERS pour tout le job
+  uint16_t layers;      // Couches vues (jusqu'à la couche demandée en mode couche unique)
+  uint32_t lines;       // Lignes lues (0 si le cache a servi)
+  uint32_t segments;    // Segments extrudés tracés
+  uint32_t bytes;       // Taille du job
+  uint32_t elapsedMs;
+  bool cached;
+};
+
+// En-tête du fichier .pvw, suivi de width * height teintes (0 = vide, 1..255 = hauteur)
+struct PreviewCacheHeader {
+  char magic[4];        // "PVW1"
+  uint32_t sourceSize;  // Pas de date sur la SD : un job réécrit change (presque toujours) de taille
+  int16_t layer;
+  uint16_t layers;
+  uint16_t width;
+  uint16_t height;
+  uint32_t segments;
+};
+
+class ToolpathPreview {
+public:
+  ToolpathPreview();
+  // Rendu du job path, relu depuis le cache s'il est encore valide
+  bool render(Storage *storage, const char *path, int16_t layer, PreviewResult &result);
+  // Teintes du dernier rendu, PREVIEW_SIZE * PREVIEW_SIZE octets ligne par ligne
+  const uint8_t *shades() const { return canvas; }
+  // "dir/job.gcode" -> "dir/job.pvw", ou "dir/job.L12.pvw" pour une couche
+  static bool cachePath(const char *path, int16_t layer, char *out, size_t size);
+
+#if defined(ARDUINO)
+  bool init();
+  // Demande traitée par PreviewTask : la console n'attend pas la fin du rendu
+  bool request(const char *path, int16_t layer);
+  static void previewTask(void *pvParameters);
+#endif
+
+private:
+  uint8_t canvas[PREVIEW_SIZE * PREVIEW_SIZE];
+  uint16_t *work;       // Couche + 1 par pixel pendant le rendu, alloué au premier rendu
+  uint8_t readBuffer[512];
+
+  bool loadCache(Storage *storage, const char *cache, uint32_t sourceSize, int16_t layer, PreviewResult &result);
+  void saveCache(Storage *storage, const char *cache, const PreviewResult &result);
+  bool rasterize(Storage *storage, const char *path, int16_t layer, PreviewResult &result);
+  void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t value);
+  void toPixel(float x, float y, int32_t &px, int32_t &py) const;
+  void normalize(uint16_t maxValue);
+
+#if defined(ARDUINO)
+  QueueHandle_t requests;
+  lv_obj_t *image;
+  lv_image_dsc_t imageDsc;
+  uint16_t *pixels;     // RGB565 affiché par LVGL
+  void show();
+#endif
+};
+
+extern ToolpathPreview toolpathPreview;
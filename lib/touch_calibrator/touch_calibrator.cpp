@@ -0,0 +1,342 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SYSTEM
+#include "touch_calibrator.h"
+#include <math.h>
+#include <string.h>
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <Preferences.h>
+#include "touchscreen_driver.h"
+#include "lvgl_screen_display.h"
+#include "../touch_config.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+#endif
+
+TouchCalibrator touchCalibrator;
+
+static const int32_t AFFINE_GAIN_LIMIT = 1L << 17;
+static const int32_t AFFINE_OFFSET_LIMIT = 1L << 29;
+
+static double det3(const double m[3][3]) {
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+         m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+// Cramer sur le système normal 3x3 : solution[i] = det(A avec la colonne i remplacée) / det(A)
+static void cramer3(const double a[3][3], double det, const double rhs[3], double out[3]) {
+  for (int col = 0; col < 3; col++) {
+    double m[3][3];
+    memcpy(m, a, sizeof(m));
+    for (int row = 0; row < 3; row++) m[row][col] = rhs[row];
+    out[col] = det3(m) / det;
+  }
+}
+
+static bool toQ16(double v, int32_t limit, int32_t &out) {
+  double q = v * 65536.0;
+  if (!(q > -limit && q < limit)) return false;   // Rejette aussi NaN
+  out = (int32_t)lround(q);
+  return true;
+}
+
+bool TouchCalibrator::solve(const TouchCalPoint *points, uint8_t count, TouchAffine &out, float *residualPx) {
+  if (count < 3) return false;
+  // Bruts centrés : le système normal reste bien conditionné malgré des carrés ~1e7
+  double cx = 0, cy = 0;
+  for (uint8_t i = 0; i < count; i++) {
+    cx += points[i].rawX;
+    cy += points[i].rawY;
+  }
+  cx /= count;
+  cy /= count;
+  double ata[3][3] = {};
+  double atx[3] = {}, aty[3] = {};
+  for (uint8_t i = 0; i < count; i++) {
+    double row[3] = { points[i].rawX - cx, points[i].rawY - cy, 1.0 };
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) ata[r][c] += row[r] * row[c];
+      atx[r] += row[r] * points[i].screenX;
+      aty[r] += row[r] * points[i].screenY;
+    }
+  }
+  double det = det3(ata);
+  // Points alignés (ou confondus) : aucune transformation unique
+  double scale = ata[0][0] * ata[1][1];
+  if (scale <= 0 || fabs(det) < 1e-9 * scale * count) return false;
+  double sx[3], sy[3];
+  cramer3(ata, det, atx, sx);
+  cramer3(ata, det, aty, sy);
+  // Retour aux bruts non centrés : c' = c - a·cx - b·cy
+  TouchAffine m;
+  if (!toQ16(sx[0], AFFINE_GAIN_LIMIT, m.a) || !toQ16(sx[1], AFFINE_GAIN_LIMIT, m.b) ||
+      !toQ16(sx[2] - sx[0] * cx - sx[1] * cy, AFFINE_OFFSET_LIMIT, m.c) ||
+      !toQ16(sy[0], AFFINE_GAIN_LIMIT, m.d) || !toQ16(sy[1], AFFINE_GAIN_LIMIT, m.e) ||
+      !toQ16(sy[2] - sy[0] * cx - sy[1] * cy, AFFINE_OFFSET_LIMIT, m.f)) {
+    return false;
+  }
+  if (residualPx) {
+    // Mesuré avec la matrice Q16 réellement appliquée par le pilote
+    double sum = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      int32_t x, y;
+      touchAffineApply(m, points[i].rawX, points[i].rawY, x, y);
+      double ex = x - points[i].screenX, ey = y - points[i].screenY;
+      sum += ex * ex + ey * ey;
+    }
+    *residualPx = (float)sqrt(sum / count);
+  }
+  out = m;
+  return true;
+}
+
+TouchAffine TouchCalibrator::fromLegacyRange(int32_t xMin, int32_t xMax, int32_t yMin, int32_t yMax,
+                                             int32_t width, int32_t height) {
+  TouchAffine m;
+  m.a = (int32_t)(((int64_t)width << 16) / (xMax - xMin));
+  m.b = 0;
+  m.c = -xMin * m.a;
+  m.d = 0;
+  m.e = (int32_t)(((int64_t)height << 16) / (yMax - yMin));
+  m.f = -yMin * m.e;
+  return m;
+}
+
+TouchCalTestResult TouchCalibrator::selfTest(uint8_t testCase, int32_t width, int32_t height) {
+  struct Case {
+    double ax, bx, cx, ay, by, cy;   // écran = (ax·rx + bx·ry + cx, ay·rx + by·ry + cy)
+    uint8_t points;
+  };
+  const double r = 3.0 * M_PI / 180.0;
+  const Case cases[TOUCH_CAL_TEST_CASES] = {
+    { 0.1016, 0, -53.3, 0, 0.0697, -26.8, 3 },
+    { 0, -0.0930, 356.0, 0.0771, 0, -29.6, 5 },
+    { -0.098 * cos(r), 0.098 * sin(r) + 0.002, 340.0, 0.072 * sin(r), 0.072 * cos(r), -25.0, 5 },
+  };
+  static const int8_t NOISE[5][2] = { { 2, -1 }, { -2, 1 }, { 1, 2 }, { -1, -2 }, { 0, 1 } };
+  static const uint8_t T[5][2] = { { 10, 10 }, { 90, 10 }, { 90, 90 }, { 10, 90 }, { 50, 50 } };
+  TouchCalTestResult result = {};
+  if (testCase >= TOUCH_CAL_TEST_CASES) return result;
+  const Case &c = cases[testCase];
+  // Points bruts obtenus par l'inverse de la transformation exacte
+  double det = c.ax * c.by - c.bx * c.ay;
+  TouchCalPoint pts[5];
+  for (uint8_t i = 0; i < c.points; i++) {
+    double sx = T[i][0] * (width - 1) / 100.0, sy = T[i][1] * (height - 1) / 100.0;
+    double u = sx - c.cx, v = sy - c.cy;
+    bool noisy = c.points > 3;
+    pts[i].screenX = (int16_t)lround(sx);
+    pts[i].screenY = (int16_t)lround(sy);
+    pts[i].rawX = (int16_t)lround((c.by * u - c.bx * v) / det) + (noisy ? NOISE[i][0] : 0);
+    pts[i].rawY = (int16_t)lround((c.ax * v - c.ay * u) / det) + (noisy ? NOISE[i][1] : 0);
+  }
+  TouchAffine m;
+  bool solved = solve(pts, c.points, m, &result.residualPx);
+  double maxErr = 0;
+  for (int32_t rx = 0; solved && rx < 4096; rx += 64) {
+    for (int32_t ry = 0; ry < 4096; ry += 64) {
+      double ex = c.ax * rx + c.bx * ry + c.cx, ey = c.ay * rx + c.by * ry + c.cy;
+      // Seule la partie visible de la dalle compte
+      if (ex < 0 || ex >= width || ey < 0 || ey >= height) continue;
+      int32_t x, y;
+      touchAffineApply(m, rx, ry, x, y);
+      double err = sqrt((x - ex) * (x - ex) + (y - ey) * (y - ey));
+      if (err > maxErr) maxErr = err;
+    }
+  }
+  result.points = c.points;
+  result.maxErrorPx = (float)maxErr;
+  result.pass = solved && maxErr < 2.0;
+  return result;
+}
+
+bool TouchCalibrator::rejectsCollinear() {
+  TouchCalPoint line[3] = { { 100, 100, 10, 10 }, { 200, 200, 20, 20 }, { 300, 300, 30, 30 } };
+  TouchAffine unused;
+  return !solve(line, 3, unused);
+}
+
+TouchCalTestResult TouchCalibrator::legacyTest(int32_t xMin, int32_t xMax, int32_t yMin, int32_t yMax, int32_t width,
+                                               int32_t height) {
+  TouchAffine m = fromLegacyRange(xMin, xMax, yMin, yMax, width, height);
+  TouchCalTestResult result = {};
+  double maxErr = 0;
+  for (int32_t rx = xMin; rx <= xMax; rx += 7) {
+    for (int32_t ry = yMin; ry <= yMax; ry += 7) {
+      // Ancien pilote : map(x, TOUCH_X_MIN, TOUCH_X_MAX, 0, SCREEN_WIDTH), division tronquée
+      int32_t ex = (rx - xMin) * width / (xMax - xMin);
+      int32_t ey = (ry - yMin) * height / (yMax - yMin);
+      int32_t x, y;
+      touchAffineApply(m, rx, ry, x, y);
+      double err = sqrt((double)(x - ex) * (x - ex) + (double)(y - ey) * (y - ey));
+      if (err > maxErr) maxErr = err;
+    }
+  }
+  result.maxErrorPx = (float)maxErr;
+  result.pass = maxErr <= 1.5;
+  return result;
+}
+
+#if defined(ARDUINO)
+static const char *const NVS_NAMESPACE = "touch";
+static const char *const NVS_KEY = "affine";
+static const uint32_t NVS_MAGIC = 0x31414354;   // "TCA1"
+
+struct StoredAffine {
+  uint32_t magic;
+  TouchAffine m;
+};
+
+bool TouchCalibrator::load(TouchAffine &out) {
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, true)) return false;
+  StoredAffine stored;
+  bool ok = prefs.getBytesLength(NVS_KEY) == sizeof(stored) &&
+            prefs.getBytes(NVS_KEY, &stored, sizeof(stored)) == sizeof(stored) && stored.magic == NVS_MAGIC;
+  prefs.end();
+  if (ok) out = stored.m;
+  return ok;
+}
+
+bool TouchCalibrator::save(const TouchAffine &m) {
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return false;
+  StoredAffine stored = { NVS_MAGIC, m };
+  bool ok = prefs.putBytes(NVS_KEY, &stored, sizeof(stored)) == sizeof(stored);
+  prefs.end();
+  return ok;
+}
+
+void TouchCalibrator::erase() {
+  Preferences prefs;
+  if (!prefs.begin(NVS_NAMESPACE, false)) return;
+  prefs.remove(NVS_KEY);
+  prefs.end();
+}
+
+bool TouchCalibrator::start() {
+  bool expected = false;
+  if (!running.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) return false;
+#if STATIC_ALLOCATION
+  if (!taskHandle) {
+    taskHandle = xTaskCreateStaticPinnedToCore(calibrationTask, "TouchCalTask", TOUCH_CAL_TASK_STACK, this, 1,
+                                               taskStack, &taskBuffer, 0);
+  }
+  if (taskHandle) xTaskNotifyGive(taskHandle);
+  bool started = taskHandle != nullptr;
+#else
+  // La tâche se supprime à la fin ; chaque calibration a une pile neuve
+  bool started = xTaskCreatePinnedToCore(calibrationTask, "TouchCalTask", TOUCH_CAL_TASK_STACK, this, 1, nullptr, 0) ==
+                 pdPASS;
+#endif
+  if (!started) running.store(false, std::memory_order_release);
+  return started;
+}
+
+// Attend un appui complet commencé après l'affichage de la cible
+static bool waitPress(uint32_t since, int16_t &rawX, int16_t &rawY) {
+  uint32_t t0 = millis();
+  while (millis() - t0 < TOUCH_CAL_TIMEOUT_MS) {
+    if (touchscreenDriver.pressSequence() != since) {
+      touchscreenDriver.lastPressRaw(rawX, rawY);
+      return true;
+    }
+    vTaskDelay(pdMS_TO_TICKS(20));
+  }
+  return false;
+}
+
+void TouchCalibrator::calibrationTask(void *pvParameters) {
+  TouchCalibrator *self = (TouchCalibrator *)pvParameters;
+#if STATIC_ALLOCATION
+  while (1) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->calibrate();
+    self->running.store(false, std::memory_order_release);
+  }
+#else
+  self->calibrate();
+  self->running.store(false, std::memory_order_release);
+  vTaskDelete(NULL);
+#endif
+}
+
+void TouchCalibrator::calibrate() {
+  static const uint8_t TARGETS[5][2] = {
+    { TOUCH_CAL_MARGIN_PCT, TOUCH_CAL_MARGIN_PCT }, { 100 - TOUCH_CAL_MARGIN_PCT, TOUCH_CAL_MARGIN_PCT },
+    { 100 - TOUCH_CAL_MARGIN_PCT, 100 - TOUCH_CAL_MARGIN_PCT }, { TOUCH_CAL_MARGIN_PCT, 100 - TOUCH_CAL_MARGIN_PCT },
+    { 50, 50 }
+  };
+  static_assert(TOUCH_CAL_POINTS >= 3 && TOUCH_CAL_POINTS <= 5, "TOUCH_CAL_POINTS : de 3 à 5 cibles");
+  TouchCalPoint points[TOUCH_CAL_POINTS];
+  lv_obj_t *overlay = nullptr, *target = nullptr, *label = nullptr;
+  // Calque du dessus : les appuis de calibration n'atteignent pas les boutons de l'UI
+  if (display.lock()) {
+    overlay = lv_obj_create(lv_layer_top());
+    lv_obj_set_size(overlay, SCREEN_WIDTH, SCREEN_HEIGHT);
+    lv_obj_set_pos(overlay, 0, 0);
+    lv_obj_set_style_pad_all(overlay, 0, 0);
+    lv_obj_set_style_border_width(overlay, 0, 0);
+    lv_obj_set_style_radius(overlay, 0, 0);
+    lv_obj_set_style_bg_color(overlay, lv_color_hex(0x000000), 0);
+    lv_obj_set_style_bg_opa(overlay, LV_OPA_COVER, 0);
+    target = lv_obj_create(overlay);
+    lv_obj_set_size(target, 9, 9);
+    lv_obj_set_style_border_width(target, 0, 0);
+    lv_obj_set_style_bg_color(target, lv_color_hex(0xFF2020), 0);
+    label = lv_label_create(overlay);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xFFFFFF), 0);
+    lv_obj_align(label, LV_ALIGN_CENTER, 0, 40);
+    display.unlock();
+  }
+  bool ok = overlay != nullptr;
+  for (uint8_t i = 0; ok && i < TOUCH_CAL_POINTS; i++) {
+    TouchCalPoint &p = points[i];
+    p.screenX = (int16_t)(TARGETS[i][0] * (SCREEN_WIDTH - 1) / 100);
+    p.screenY = (int16_t)(TARGETS[i][1] * (SCREEN_HEIGHT - 1) / 100);
+    uint32_t since = touchscreenDriver.pressSequence();
+    if (display.lock()) {
+      lv_obj_set_pos(target, p.screenX - 4, p.screenY - 4);
+      lv_label_set_text_fmt(label, "Touch the target %u/%u", (unsigned)(i + 1), (unsigned)TOUCH_CAL_POINTS);
+      display.unlock();
+    }
+    ok = waitPress(since, p.rawX, p.rawY);
+    if (ok) DEBUG_PRINTF_AUTO("Calibration: cible %u (%d,%d) brut (%d,%d)", i + 1, p.screenX, p.screenY, p.rawX, p.rawY);
+  }
+  if (overlay && display.lock()) {
+    lv_obj_delete(overlay);
+    display.unlock();
+  }
+  TouchAffine m;
+  float residual = 0;
+  if (!ok) {
+    Serial.println("ERROR: Calibration timed out");
+  } else if (!TouchCalibrator::solve(points, TOUCH_CAL_POINTS, m, &residual)) {
+    Serial.println("ERROR: Calibration points are degenerate");
+  } else if (residual > TOUCH_CAL_MAX_RESIDUAL) {
+    reportLine("ERROR: Calibration rejected, residual_px=%.2f\n", residual);
+  } else {
+    touchscreenDriver.setCalibration(m, true);
+    bool saved = save(m);
+    if (!saved) DEBUG_ERRORF_AUTO("Erreur: Écriture de la calibration en NVS");
+    reportLine("OK: Calibration applied residual_px=%.2f saved=%d\n", residual, saved ? 1 : 0);
+  }
+}
+
+void TouchCalibrator::printSelfTest() {
+  bool pass = true;
+  for (uint8_t k = 0; k < TOUCH_CAL_TEST_CASES; k++) {
+    TouchCalTestResult r = selfTest(k, SCREEN_WIDTH, SCREEN_HEIGHT);
+    pass &= r.pass;
+    reportLine("TEST_CALIB case=%u points=%u residual_px=%.2f max_err_px=%.2f ok=%d\n", (unsigned)k,
+               (unsigned)r.points, r.residualPx, r.maxErrorPx, r.pass ? 1 : 0);
+  }
+  bool rejected = rejectsCollinear();
+  pass &= rejected;
+  reportLine("TEST_CALIB case=collinear rejected=%d\n", rejected ? 1 : 0);
+  TouchCalTestResult legacy = legacyTest(TOUCH_X_MIN, TOUCH_X_MAX, TOUCH_Y_MIN, TOUCH_Y_MAX, SCREEN_WIDTH, SCREEN_HEIGHT);
+  pass &= legacy.pass;
+  reportLine("TEST_CALIB case=legacy max_err_px=%.2f ok=%d\n", legacy.maxErrorPx, legacy.pass ? 1 : 0);
+  Serial.println(pass ? "OK" : "ERROR: TEST_CALIB failed");
+}
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "../config.h"
+#if defined(ARDUINO)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// Calibration affine du tactile : écran = M · brut, six coefficients Q16.16
+//   x = (a·rx + b·ry + c) >> 16
+//   y = (d·rx + e·ry + f) >> 16
+// La rotation, l'inversion d'axes et le cisaillement de la dalle sont absorbés par M.
+// Bornes vérifiées par solve() : |a|, |b|, |d|, |e| < 2^17 et |c|, |f| < 2^29 gardent la
+// somme dans un int32 pour des bruts sur 12 bits.
+struct TouchAffine {
+  int32_t a, b, c;
+  int32_t d, e, f;
+};
+
+struct TouchCalPoint {
+  int16_t rawX, rawY;        // Médiane brute du XPT2046 (0..4095)
+  int16_t screenX, screenY;  // Cible affichée, en pixels
+};
+
+inline void touchAffineApply(const TouchAffine &m, int32_t rx, int32_t ry, int32_t &sx, int32_t &sy) {
+  // Décalage arithmétique : arrondi vers -inf, sans importance une fois borné à l'écran
+  sx = (m.a * rx + m.b * ry + m.c + 0x8000) >> 16;
+  sy = (m.d * rx + m.e * ry + m.f + 0x8000) >> 16;
+}
+
+// Vérification des calculs, sur cible (TEST_CALIB) comme sur l'hôte (host/touch_cal)
+struct TouchCalTestResult {
+  uint8_t points;
+  float residualPx;         // RMS sur les points du cas (0 pour la plage historique)
+  float maxErrorPx;         // Plus grand écart à la transformation exacte sur la dalle visible
+  bool pass;
+};
+
+static const uint8_t TOUCH_CAL_TEST_CASES = 3;
+
+class TouchCalibrator {
+public:
+  // Moindres carrés sur n >= 3 points (exact pour 3) ; false si les points sont alignés
+  // ou si un coefficient sort des bornes Q16. residualPx : écart RMS sur les points.
+  static bool solve(const TouchCalPoint *points, uint8_t count, TouchAffine &out, float *residualPx = nullptr);
+  // Matrice équivalente aux anciennes constantes TOUCH_X_MIN... de touch_config.h
+  static TouchAffine fromLegacyRange(int32_t xMin, int32_t xMax, int32_t yMin, int32_t yMax, int32_t width, int32_t height);
+
+  // Transformations connues (échelle, rotation de 90°, rotation + cisaillement + miroir),
+  // points bruts bruités de ±2 : la matrice retrouvée est comparée à l'exacte
+  static TouchCalTestResult selfTest(uint8_t testCase, int32_t width, int32_t height);
+  // Trois points alignés : solve() doit refuser
+  static bool rejectsCollinear();
+  // fromLegacyRange() contre l'ancien map() du pilote, à 1 px près
+  static TouchCalTestResult legacyTest(int32_t xMin, int32_t xMax, int32_t yMin, int32_t yMax, int32_t width,
+                                       int32_t height);
+
+#if defined(ARDUINO)
+  // NVS (Preferences) : chargée au démarrage, écrite après une calibration acceptée
+  bool load(TouchAffine &out);
+  bool save(const TouchAffine &m);
+  void erase();
+  // Calibration interactive : cibles affichées par-dessus l'UI, dans sa propre tâche ;
+  // false si une calibration est déjà en cours
+  bool start();
+  bool isRunning() const { return running.load(std::memory_order_acquire); }
+  // Commande TEST_CALIB : selfTest(), rejectsCollinear() et legacyTest() sur l'écran
+  static void printSelfTest();
+
+private:
+  std::atomic<bool> running{false};
+#if STATIC_ALLOCATION
+  // Tâche créée au premier start() puis réveillée à chaque calibration : ses tampons ne
+  // servent jamais à une nouvelle tâche pendant que la précédente finit de se supprimer
+  TaskHandle_t taskHandle = nullptr;
+  StaticTask_t taskBuffer;
+  StackType_t taskStack[TOUCH_CAL_TASK_STACK / sizeof(StackType_t)];
+#endif
+  void calibrate();
+  static void calibrationTask(void *pvParameters);
+#endif
+};
+
+extern TouchCalibrator touchCalibrator;
@@ -1,13 +1,12 @@
 #ifndef TOUCH_CONFIG_H
 #define TOUCH_CONFIG_H
-// x = map(p.x, 517, 3651, 1, SCREEN_WIDTH);
-// y = map(p.y, 382, 3827, 1, SCREEN_HEIGHT);
+// Plage brute utilisée tant qu'aucune calibration TOUCH_CAL n'est enregistrée en NVS
 #define TOUCH_X_MIN 525
 #define TOUCH_X_MAX 3675
 #define TOUCH_Y_MIN 385
 #define TOUCH_Y_MAX 3825
 
-#define SCREEN_WIDTH  240
-#define SCREEN_HEIGHT 320
+// Coordonnées rendues dans la résolution LVGL (paysage 320x240, voir config.h)
+#include "config.h"
 
 #endif
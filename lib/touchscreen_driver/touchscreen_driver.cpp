@@ -1,12 +1,20 @@
 #include "touchscreen_driver.h"
 #include "../touch_config.h"
 #include <Arduino.h>
+#include "trace_recorder.h"
+#include "health_monitor.h"
+#include "heap_guard.h"
+#include "../report_line.h"
 
-Touchscreen_Driver::Touchscreen_Driver() : touchscreen(XPT2046_CS), touchscreenSPI(VSPI) {}
+Touchscreen_Driver::Touchscreen_Driver() : touchscreen(XPT2046_CS), touchscreenSPI(TOUCH_SPI_HOST), taskHandle(nullptr),
+    published(0), wakeups(0), samples(0), presses(0), reads(0), pressSeq(0), pressRaw(0), calibration(),
+    activeCalibration(0), calibrated(false), windowX(), windowY(), windowCount(0), windowPos(0), filteredX(0),
+    filteredY(0) {}
 Touchscreen_Driver touchscreenDriver;
 void Touchscreen_Driver::initTouchscreen() {
     // Start SPI for the touchscreen
     touchscreenSPI.begin(XPT2046_CLK, XPT2046_MISO, XPT2046_MOSI, XPT2046_CS);
+    // PENIRQ is handled here, not by the library (one ISR per pin)
     touchscreen.begin(touchscreenSPI);
     // Set touchscreen rotation to match display (portrait mode, adjust if needed)
     touchscreen.setRotation(2); // DISPLAY_PORTRAIT_MODE
@@ -14,43 +22,167 @@ void Touchscreen_Driver::initTouchscreen() {
 
 void Touchscreen_Driver::begin() {
     initTouchscreen();
+    // Matrix saved by TOUCH_CAL, or the fixed range of touch_config.h until the first calibration
+    TouchAffine m;
+    if (touchCalibrator.load(m)) {
+        setCalibration(m, true);
+    } else {
+        setCalibration(TouchCalibrator::fromLegacyRange(TOUCH_X_MIN, TOUCH_X_MAX, TOUCH_Y_MIN, TOUCH_Y_MAX,
+                                                        SCREEN_WIDTH, SCREEN_HEIGHT), false);
+    }
+    // Core 0: the SPI reads never compete with LVGL rendering on core 1
+    heapGuard.createTask(touchTask, "TouchTask", TOUCH_TASK_STACK, this, TOUCH_TASK_PRIORITY, &taskHandle, 0);
+    healthMonitor.watchTask(taskHandle, TOUCH_TASK_STACK);
+#if XPT2046_IRQ >= 0
+    pinMode(XPT2046_IRQ, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(XPT2046_IRQ), penIrq, FALLING);
+#endif
     Serial.println("Touchscreen setup completed.");
 }
 
-void Touchscreen_Driver::read(lv_indev_t *indev, lv_indev_data_t *data) {
-    static int16_t last_x = 0;
-    static int16_t last_y = 0;
-
-    if (touchscreen.touched()) {
-        TS_Point p = touchscreen.getPoint();
-        int16_t x = p.x;
-        int16_t y = p.y;
-        int16_t z = p.z;
-
-        // Only process touch if pressure exceeds threshold
-        if (z > THRESHOLD_Z) {
-            // Map raw coordinates to screen coordinates
-            x = map(x, TOUCH_X_MIN, TOUCH_X_MAX, 0, SCREEN_WIDTH);
-            y = map(y, TOUCH_Y_MIN, TOUCH_Y_MAX, 0, SCREEN_HEIGHT);
-
-            // Ensure coordinates are within screen bounds
-            x = constrain(x, 0, SCREEN_WIDTH - 1);
-            y = constrain(y, 0, SCREEN_HEIGHT - 1);
-
-            data->point.x = x;
-            data->point.y = y;
-            data->state = LV_INDEV_STATE_PRESSED;
-
-            last_x = x;
-            last_y = y;
+void IRAM_ATTR Touchscreen_Driver::penIrq() {
+    TaskHandle_t task = touchscreenDriver.taskHandle;
+    if (!task) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+bool Touchscreen_Driver::sample(int16_t &x, int16_t &y) {
+    TRACE_SCOPE(TOUCH_READ);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    TS_Point p = touchscreen.getPoint();
+    if (p.z <= THRESHOLD_Z) return false;
+    x = p.x;
+    y = p.y;
+    return true;
+}
+
+int16_t Touchscreen_Driver::median(const int16_t *values, uint8_t count) {
+    int16_t sorted[TOUCH_MEDIAN_WINDOW];
+    for (uint8_t i = 0; i < count; i++) {
+        int16_t v = values[i];
+        uint8_t j = i;
+        for (; j > 0 && sorted[j - 1] > v; j--) sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    return sorted[count / 2];
+}
+
+void Touchscreen_Driver::publish(int32_t x, int32_t y, bool pressed) {
+    x = constrain(x, 0, SCREEN_WIDTH - 1);
+    y = constrain(y, 0, SCREEN_HEIGHT - 1);
+    uint32_t packed = ((uint32_t)x & 0x7FFF) | (((uint32_t)y & 0x7FFF) << 15) | (pressed ? 0x80000000u : 0);
+    published.store(packed, std::memory_order_release);
+}
+
+// The median of the last raw samples rejects the spikes of a light or sliding contact,
+// the calibration matrix maps it to the screen and the IIR removes the jitter left.
+// A press is only reported once the window has TOUCH_MIN_SAMPLES samples, a release
+// after TOUCH_RELEASE_SAMPLES light ones.
+void Touchscreen_Driver::track() {
+    windowCount = 0;
+    windowPos = 0;
+    uint8_t light = 0;
+    bool pressed = false;
+    int16_t rawX = 0, rawY = 0;
+    const TouchAffine m = calibration[activeCalibration.load(std::memory_order_acquire)];
+    TickType_t lastWake = xTaskGetTickCount();
+    while (light < TOUCH_RELEASE_SAMPLES) {
+        int16_t x, y;
+        if (sample(x, y)) {
+            light = 0;
+            windowX[windowPos] = x;
+            windowY[windowPos] = y;
+            windowPos = (windowPos + 1) % TOUCH_MEDIAN_WINDOW;
+            if (windowCount < TOUCH_MEDIAN_WINDOW) windowCount++;
+            if (windowCount >= TOUCH_MIN_SAMPLES) {
+                rawX = median(windowX, windowCount);
+                rawY = median(windowY, windowCount);
+                int32_t mx, my;
+                touchAffineApply(m, rawX, rawY, mx, my);
+                mx *= 16;
+                my *= 16;
+                if (!pressed) {
+                    // No smoothing from a stale position on a new press
+                    filteredX = mx;
+                    filteredY = my;
+                    pressed = true;
+                    presses.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    filteredX += (mx - filteredX) / (1 << TOUCH_IIR_SHIFT);
+                    filteredY += (my - filteredY) / (1 << TOUCH_IIR_SHIFT);
+                }
+                publish((filteredX + 8) / 16, (filteredY + 8) / 16, true);
+            }
         } else {
-            data->point.x = last_x;
-            data->point.y = last_y;
-            data->state = LV_INDEV_STATE_RELEASED;
+            light++;
         }
-    } else {
-        data->point.x = last_x;
-        data->point.y = last_y;
-        data->state = LV_INDEV_STATE_RELEASED;
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(TOUCH_SAMPLE_MS));
+    }
+    if (!pressed) return;
+    // Release keeps the last position, as LVGL expects
+    published.fetch_and(0x7FFFFFFFu, std::memory_order_release);
+    pressRaw.store((uint32_t)(uint16_t)rawX | ((uint32_t)(uint16_t)rawY << 16), std::memory_order_relaxed);
+    pressSeq.fetch_add(1, std::memory_order_release);
+}
+
+void Touchscreen_Driver::touchTask(void *pvParameters) {
+    Touchscreen_Driver *self = (Touchscreen_Driver *)pvParameters;
+    while (1) {
+#if XPT2046_IRQ >= 0
+        // The conversions of the last press toggle PENIRQ: their notifications are dropped,
+        // and a pen already down again is caught by the level rather than the missed edge
+        ulTaskNotifyTake(pdTRUE, 0);
+        if (digitalRead(XPT2046_IRQ) != LOW) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+        vTaskDelay(pdMS_TO_TICKS(TOUCH_IDLE_POLL_MS));
+        if (!self->touchscreen.touched()) continue;
+#endif
+        self->wakeups.fetch_add(1, std::memory_order_relaxed);
+        self->track();
     }
-}
\ No newline at end of file
+}
+
+// Called from LVGL's indev callback: a single atomic load, no SPI transaction
+void Touchscreen_Driver::read(lv_indev_t *indev, lv_indev_data_t *data) {
+    reads.fetch_add(1, std::memory_order_relaxed);
+    uint32_t packed = published.load(std::memory_order_acquire);
+    data->point.x = (int32_t)(packed & 0x7FFF);
+    data->point.y = (int32_t)((packed >> 15) & 0x7FFF);
+    data->state = (packed & 0x80000000u) ? LV_INDEV_STATE_PRESSED : LV_INDEV_STATE_RELEASED;
+}
+
+void Touchscreen_Driver::setCalibration(const TouchAffine &m, bool isCalibrated) {
+    uint8_t next = activeCalibration.load(std::memory_order_relaxed) ^ 1;
+    calibration[next] = m;
+    activeCalibration.store(next, std::memory_order_release);
+    calibrated = isCalibrated;
+}
+
+void Touchscreen_Driver::lastPressRaw(int16_t &x, int16_t &y) const {
+    uint32_t packed = pressRaw.load(std::memory_order_relaxed);
+    x = (int16_t)(packed & 0xFFFF);
+    y = (int16_t)(packed >> 16);
+}
+
+void Touchscreen_Driver::getStats(TouchStats &out) {
+    out.wakeups = wakeups.load(std::memory_order_relaxed);
+    out.samples = samples.load(std::memory_order_relaxed);
+    out.presses = presses.load(std::memory_order_relaxed);
+    out.reads = reads.load(std::memory_order_relaxed);
+}
+
+void Touchscreen_Driver::printStats() {
+    TouchStats s;
+    getStats(s);
+    uint32_t packed = published.load(std::memory_order_acquire);
+    reportLine("TOUCH irq=%d wakeups=%lu samples=%lu presses=%lu reads=%lu x=%lu y=%lu pressed=%d\n",
+               XPT2046_IRQ >= 0 ? 1 : 0, (unsigned long)s.wakeups, (unsigned long)s.samples,
+               (unsigned long)s.presses, (unsigned long)s.reads, (unsigned long)(packed & 0x7FFF),
+               (unsigned long)((packed >> 15) & 0x7FFF), (packed & 0x80000000u) ? 1 : 0);
+    const TouchAffine &m = calibration[activeCalibration.load(std::memory_order_acquire)];
+    reportLine("TOUCH_CAL source=%s a=%ld b=%ld c=%ld d=%ld e=%ld f=%ld\n", calibrated ? "nvs" : "default",
+               (long)m.a, (long)m.b, (long)m.c, (long)m.d, (long)m.e, (long)m.f);
+    Serial.println("OK");
+}
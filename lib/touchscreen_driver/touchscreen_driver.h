@@ -4,27 +4,86 @@
 #include <XPT2046_Touchscreen.h>
 #include <SPI.h>
 #include <lvgl.h>
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "touch_calibrator.h"
 
 // Touchscreen pin configuration
 #define XPT2046_MOSI 2   // T_DIN
 #define XPT2046_MISO 41  // T_OUT
 #define XPT2046_CLK  42  // T_CLK
 #define XPT2046_CS   1   // T_CS
+#define XPT2046_IRQ  40  // T_IRQ (PENIRQ, active low), -1 if not wired: the task then polls
 
-// Predefined calibration values (to be adjusted based on your touchscreen)
+// Minimum pressure for a sample to count as a touch
 #define THRESHOLD_Z 500
 
-#define VSPI FSPI // Use VSPI for ILI9341, HSPI for ILI9488
+// Sampling task
+#define TOUCH_TASK_STACK       3072
+#define TOUCH_TASK_PRIORITY    2
+#define TOUCH_SAMPLE_MS        4    // Period while pressed (the XPT2046 library caches reads for 3 ms)
+#define TOUCH_IDLE_POLL_MS     20   // Only used when XPT2046_IRQ is -1
+#define TOUCH_MEDIAN_WINDOW    5    // Raw samples per median, odd
+#define TOUCH_MIN_SAMPLES      3    // Samples before a press is reported (debounce)
+#define TOUCH_RELEASE_SAMPLES  2    // Consecutive light samples before a release is reported
+#define TOUCH_IIR_SHIFT        2    // Smoothing after the median: new = old + (median - old) / 4
+
+// SPI controller of the touch panel. FSPI (SPI2) is the SD card bus, whose SdFat driver
+// reroutes the controller to its own pins: the touch panel gets HSPI (SPI3) to itself
+#define TOUCH_SPI_HOST HSPI
+
+// Counters shown by the TOUCH command
+struct TouchStats {
+    uint32_t wakeups;     // PENIRQ notifications (or idle polls)
+    uint32_t samples;     // SPI reads done by the task
+    uint32_t presses;
+    uint32_t reads;       // LVGL indev reads, none of which touch the bus
+};
+
 class Touchscreen_Driver {
 public:
     Touchscreen_Driver();           // Constructor
-    void begin();                   // Initialize touchscreen
-    void read(lv_indev_t *indev, lv_indev_data_t *data); // Read touchscreen data for LVGL
+    void begin();                   // Initialize touchscreen and start the sampling task
+    void read(lv_indev_t *indev, lv_indev_data_t *data); // Latest filtered point for LVGL (no SPI)
+    void getStats(TouchStats &out);
+    void printStats();
+    // Raw to screen transform; calibrated is false for the touch_config.h fallback
+    void setCalibration(const TouchAffine &m, bool calibrated);
+    // Completed presses and the raw median of the last one, for TOUCH_CAL
+    uint32_t pressSequence() const { return pressSeq.load(std::memory_order_acquire); }
+    void lastPressRaw(int16_t &x, int16_t &y) const;
 
 private:
     XPT2046_Touchscreen touchscreen;
     SPIClass touchscreenSPI;
+    TaskHandle_t taskHandle;
+    // x (15 bits) | y (15 bits) << 15 | pressed << 31, written only by the sampling task
+    std::atomic<uint32_t> published;
+    std::atomic<uint32_t> wakeups;
+    std::atomic<uint32_t> samples;
+    std::atomic<uint32_t> presses;
+    std::atomic<uint32_t> reads;
+    std::atomic<uint32_t> pressSeq;
+    std::atomic<uint32_t> pressRaw;     // x | y << 16, stored before pressSeq is bumped
+    // Written into the inactive slot then switched, so the task never sees half a matrix
+    TouchAffine calibration[2];
+    std::atomic<uint8_t> activeCalibration;
+    bool calibrated;
+    int16_t windowX[TOUCH_MEDIAN_WINDOW];
+    int16_t windowY[TOUCH_MEDIAN_WINDOW];
+    uint8_t windowCount;
+    uint8_t windowPos;
+    int32_t filteredX;              // Q4 fixed point
+    int32_t filteredY;
+
     void initTouchscreen();         // Initialize SPI and touchscreen
+    bool sample(int16_t &x, int16_t &y); // One raw read (0..4095), false if pressure is below THRESHOLD_Z
+    void track();                   // Samples until the pen is lifted
+    void publish(int32_t x, int32_t y, bool pressed);
+    static int16_t median(const int16_t *values, uint8_t count);
+    static void IRAM_ATTR penIrq();
+    static void touchTask(void *pvParameters);
 };
 extern Touchscreen_Driver touchscreenDriver;
-#endif
\ No newline at end of file
+#endif
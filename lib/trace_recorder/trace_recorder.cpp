@@ -0,0 +1,88 @@
+#include "trace_recorder.h"
+#include "fault_bus.h"
+#include "../report_line.h"
+
+static_assert((TRACE_BUFFER_RECORDS & (TRACE_BUFFER_RECORDS - 1)) == 0, "TRACE_BUFFER_RECORDS doit être une puissance de 2");
+
+static const char *const TRACE_NAMES[] = {
+  "CommCommand", "SdLineRead", "SdEnqueue", "ParserParse", "ParserEnqueue", "SystemFault",
+  "LvglLoop", "LvglFlush", "TouchRead", "gcodeQueue", "motionQueue", "TaskRun"
+};
+static_assert(sizeof(TRACE_NAMES) / sizeof(TRACE_NAMES[0]) == (size_t)TraceId::COUNT, "Nom manquant dans TRACE_NAMES");
+
+TraceRecorder traceRecorder;
+
+TraceRecorder::TraceRecorder() : head(0), enabled(false), overheadNs(0) {
+  for (size_t i = 0; i < TRACE_MAX_TASKS; i++) tasks[i].store(nullptr);
+}
+
+// Recherche linéaire sans verrou (quelques tâches) ; une tâche inconnue prend la première
+// case libre par compare-exchange, une autre tâche qui l'a prise avant elle est ignorée
+uint8_t TraceRecorder::taskIndex(TaskHandle_t task) {
+  for (size_t i = 0; i < TRACE_MAX_TASKS; i++) {
+    TaskHandle_t seen = tasks[i].load(std::memory_order_acquire);
+    if (seen == nullptr) {
+      if (tasks[i].compare_exchange_strong(seen, task, std::memory_order_acq_rel)) return (uint8_t)i;
+    }
+    if (seen == task) return (uint8_t)i;
+  }
+  return TRACE_TASK_OTHER;
+}
+
+void TraceRecorder::start() {
+  if (overheadNs == 0) measureOverhead();
+  head.store(0);
+  enabled = true;
+}
+
+void TraceRecorder::stop() {
+  enabled = false;
+}
+
+// Coût d'un enregistrement, mesuré sur 1000 appels puis annulé
+void TraceRecorder::measureOverhead() {
+  const int samples = 1000;
+  bool wasEnabled = enabled;
+  enabled = true;
+  uint32_t saved = head.load();
+  int64_t t0 = esp_timer_get_time();
+  for (int i = 0; i < samples; i++) record(TraceType::INSTANT, TraceId::TASK_RUN, i);
+  int64_t t1 = esp_timer_get_time();
+  head.store(saved);
+  enabled = wasEnabled;
+  overheadNs = (uint32_t)((t1 - t0) * 1000 / samples);
+}
+
+void TraceRecorder::dump() {
+  bool wasEnabled = enabled;
+  enabled = false;
+  uint32_t total = head.load();
+  uint32_t count = total < TRACE_BUFFER_RECORDS ? total : TRACE_BUFFER_RECORDS;
+  uint32_t first = total - count;
+  reportLine("TRACE_BEGIN records=%lu lost=%lu overhead_ns=%lu\n", (unsigned long)count,
+             (unsigned long)(total - count), (unsigned long)overheadNs);
+  for (size_t i = 0; i < (size_t)TraceId::COUNT; i++) {
+    reportLine("N %u %s\n", (unsigned)i, TRACE_NAMES[i]);
+  }
+  for (size_t i = 0; i < TRACE_MAX_TASKS; i++) {
+    TaskHandle_t task = tasks[i].load(std::memory_order_acquire);
+    if (task) reportLine("T %u %s\n", (unsigned)i, pcTaskGetName(task));
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    // Vidage lent (UART) exécuté par CommTask : M112 reste lu entre deux lignes
+    faultBus.pollConsole();
+    const TraceRecord &r = records[(first + i) & (TRACE_BUFFER_RECORDS - 1)];
+    reportLine("E %lu %u %u %u %ld %u\n", (unsigned long)r.timestamp_us, r.type, r.id, r.core, (long)r.value,
+               r.task);
+  }
+  Serial.println("TRACE_END");
+  enabled = wasEnabled;
+}
+
+extern "C" void traceRecorderTaskSwitchedIn(uint32_t taskNumber) {
+  traceRecorder.record(TraceType::BEGIN, TraceId::TASK_RUN, taskNumber);
+}
+
+extern "C" void traceRecorderTaskSwitchedOut(uint32_t taskNumber) {
+  traceRecorder.record(TraceType::END, TraceId::TASK_RUN, taskNumber);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "../config.h"
+
+// Enregistreur de traces en RAM : événements début/fin et compteurs horodatés à la µs,
+// vidés par la commande TRACE_DUMP puis convertis par tools/trace_to_chrome.py
+enum class TraceType : uint8_t { BEGIN = 0, END = 1, COUNTER = 2, INSTANT = 3 };
+
+enum class TraceId : uint8_t {
+  COMM_COMMAND = 0,   // Traitement d'une commande console
+  SD_LINE_READ,       // Lecture d'une ligne sur la carte
+  SD_ENQUEUE,         // Attente de place dans gcodeQueue
+  PARSER_PARSE,
+  PARSER_ENQUEUE,     // Attente de place dans motionQueue
+  SYSTEM_FAULT,
+  LVGL_LOOP,          // lv_timer_handler
+  LVGL_FLUSH,
+  TOUCH_READ,
+  GCODE_QUEUE_DEPTH,  // Compteurs
+  MOTION_QUEUE_DEPTH,
+  TASK_RUN,           // Commutations de tâche (si les hooks FreeRTOS sont branchés)
+  COUNT
+};
+
+struct TraceRecord {
+  uint32_t timestamp_us;
+  int32_t value;
+  uint8_t type;
+  uint8_t id;
+  uint8_t core;
+  uint8_t task;   // Indice dans la table des tâches (TRACE_TASK_OTHER si pleine)
+};
+
+static const uint8_t TRACE_TASK_OTHER = 0xFF;
+
+class TraceRecorder {
+private:
+  TraceRecord records[TRACE_BUFFER_RECORDS];
+  std::atomic<uint32_t> head;
+  volatile bool enabled;
+  uint32_t overheadNs;
+  // Tâches vues par record(), dans l'ordre d'apparition : l'indice sert de piste (tid)
+  // à tools/trace_to_chrome.py, qui sépare ainsi les tâches épinglées sur un même cœur
+  std::atomic<TaskHandle_t> tasks[TRACE_MAX_TASKS];
+  uint8_t taskIndex(TaskHandle_t task);
+
+public:
+  TraceRecorder();
+  void start();
+  void stop();
+  bool isEnabled() const { return enabled; }
+  // Écrase les plus anciens événements quand l'anneau est plein
+  inline void record(TraceType type, TraceId id, int32_t value = 0) {
+    if (!enabled) return;
+    uint32_t idx = head.fetch_add(1, std::memory_order_relaxed) & (TRACE_BUFFER_RECORDS - 1);
+    TraceRecord &r = records[idx];
+    r.timestamp_us = (uint32_t)esp_timer_get_time();
+    r.value = value;
+    r.type = (uint8_t)type;
+    r.id = (uint8_t)id;
+    r.core = (uint8_t)xPortGetCoreID();
+    r.task = taskIndex(xTaskGetCurrentTaskHandle());
+  }
+  void measureOverhead();
+  void dump();
+};
+
+// Hooks à appeler depuis traceTASK_SWITCHED_IN/OUT quand FreeRTOS est compilé avec
+// (impossible avec le noyau précompilé d'Arduino : les tâches tracent alors leurs phases)
+extern "C" void traceRecorderTaskSwitchedIn(uint32_t taskNumber);
+extern "C" void traceRecorderTaskSwitchedOut(uint32_t taskNumber);
+
+extern TraceRecorder traceRecorder;
+
+class TraceScope {
+public:
+  explicit TraceScope(TraceId id) : id(id) { traceRecorder.record(TraceType::BEGIN, id); }
+  ~TraceScope() { traceRecorder.record(TraceType::END, id); }
+
+private:
+  TraceId id;
+};
+
+#if TRACE_ENABLED
+#define TRACE_BEGIN(id)          traceRecorder.record(TraceType::BEGIN, TraceId::id)
+#define TRACE_END(id)            traceRecorder.record(TraceType::END, TraceId::id)
+#define TRACE_COUNTER(id, value) traceRecorder.record(TraceType::COUNTER, TraceId::id, (int32_t)(value))
+#define TRACE_SCOPE(id)          TraceScope traceScope_##id(TraceId::id)
+#else
+#define TRACE_BEGIN(id)
+#define TRACE_END(id)
+#define TRACE_COUNTER(id, value)
+#define TRACE_SCOPE(id)
+#endif
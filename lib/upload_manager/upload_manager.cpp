@@ -0,0 +1,265 @@
+#define DEBUG_MODULE_LEVEL DEBUG_LEVEL_SD
+#include "upload_manager.h"
+#include "sd_manager.h"
+#include "checksum.h"
+#include "fault_bus.h"
+#include "../report_line.h"
+#include "../debug_manager.h"
+
+static_assert((UPLOAD_WINDOW & (UPLOAD_WINDOW - 1)) == 0, "UPLOAD_WINDOW doit être une puissance de 2");
+static_assert(UPLOAD_BLOCK_SIZE <= 0xFFFF, "UPLOAD_BLOCK_SIZE doit tenir sur 16 bits");
+
+static const uint8_t UPLOAD_MAGIC1 = 0xA5;
+static const uint8_t UPLOAD_MAGIC2 = 0x5A;
+
+UploadManager uploadManager;
+
+UploadManager::UploadManager() : active(false), state(RxState::MAGIC1), rxCount(0), rxSeq(0), rxLen(0),
+  rxTarget(nullptr), textLen(0), textOverflow(false), baseSeq(0), baseNaked(false), fileCrc(0), bytesReceived(0),
+  blocksReceived(0), duplicates(0), crcErrors(0), startTime(0), lastActivity(0) {}
+
+bool UploadManager::begin(const char *args) {
+  if (active) {
+    Serial.println("ERROR: Upload already in progress");
+    return false;
+  }
+  const char *space = strchr(args, ' ');
+  size_t nameLength = space ? (size_t)(space - args) : strlen(args);
+  uint32_t expectedSize = space ? (uint32_t)strtol(space + 1, nullptr, 10) : 0;
+  if (nameLength == 0) {
+    DEBUG_ERRORF_AUTO("Erreur: Nom de fichier vide pour M28");
+    Serial.println("ERROR: Empty filename");
+    return false;
+  }
+  char filename[SD_PATH_MAX];
+  if (nameLength >= sizeof(filename)) {
+    DEBUG_ERRORF_AUTO("Erreur: Chemin trop long pour M28");
+    Serial.println("ERROR: Filename too long");
+    return false;
+  }
+  memcpy(filename, args, nameLength);
+  filename[nameLength] = '\0';
+  if (!sdManager.beginWrite(filename, expectedSize)) {
+    Serial.println("ERROR: Failed to open file for writing");
+    return false;
+  }
+
+  memset(slotFull, 0, sizeof(slotFull));
+  state = RxState::MAGIC1;
+  textLen = 0;
+  textOverflow = false;
+  baseSeq = 0;
+  baseNaked = false;
+  fileCrc = 0;
+  bytesReceived = blocksReceived = duplicates = crcErrors = 0;
+  startTime = lastActivity = millis();
+  active = true;
+
+  DEBUG_PRINTF_AUTO("Upload de %s démarré", filename);
+  reportLine("OK: UPLOAD_READY block=%u window=%u\n", (unsigned)UPLOAD_BLOCK_SIZE, (unsigned)UPLOAD_WINDOW);
+  return true;
+}
+
+void UploadManager::poll() {
+  if (!active) return;
+  int available = Serial.available();
+  if (available <= 0) {
+    if (millis() - lastActivity > UPLOAD_TIMEOUT_MS) abort("timeout");
+    return;
+  }
+  lastActivity = millis();
+  while (available > 0 && active) {
+    if (state == RxState::PAYLOAD) {
+      // Charge utile lue en bloc directement dans l'emplacement de la fenêtre
+      size_t want = rxLen - rxCount;
+      if (want > (size_t)available) want = available;
+      size_t got = Serial.readBytes(rxTarget + rxCount, want);
+      rxCount += got;
+      available -= got;
+      if (rxCount == rxLen) {
+        state = RxState::CRC;
+        rxCount = 0;
+      }
+      if (got == 0) break;
+      continue;
+    }
+    int b = Serial.read();
+    if (b < 0) break;
+    available--;
+    processByte((uint8_t)b);
+  }
+}
+
+void UploadManager::processByte(uint8_t b) {
+  switch (state) {
+    case RxState::MAGIC1:
+      if (b == UPLOAD_MAGIC1) {
+        state = RxState::MAGIC2;
+        textLen = 0;
+        textOverflow = false;
+      } else if (b == '\n') {
+        textLine[textLen] = '\0';
+        textLen = 0;
+        if (!textOverflow) handleTextLine();
+        textOverflow = false;
+      } else if (b != '\r') {
+        if (textLen < sizeof(textLine) - 1) textLine[textLen++] = (char)b;
+        else textOverflow = true;
+      }
+      break;
+    case RxState::MAGIC2:
+      state = (b == UPLOAD_MAGIC2) ? RxState::HEADER : RxState::MAGIC1;
+      rxCount = 0;
+      break;
+    case RxState::HEADER:
+      header[rxCount++] = b;
+      if (rxCount == sizeof(header)) {
+        rxSeq = header[0] | (header[1] << 8);
+        rxLen = header[2] | (header[3] << 8);
+        rxCount = 0;
+        if (rxLen > UPLOAD_BLOCK_SIZE) {
+          // En-tête corrompu : on se resynchronise sur le prochain marqueur
+          crcErrors++;
+          state = RxState::MAGIC1;
+          break;
+        }
+        uint16_t offset = rxSeq - baseSeq;
+        uint16_t idx = rxSeq & (UPLOAD_WINDOW - 1);
+        rxTarget = (offset < UPLOAD_WINDOW && !slotFull[idx]) ? slots[idx] : scratch;
+        state = (rxLen == 0) ? RxState::CRC : RxState::PAYLOAD;
+      }
+      break;
+    case RxState::PAYLOAD:
+      break;
+    case RxState::CRC:
+      crcBytes[rxCount++] = b;
+      if (rxCount == sizeof(crcBytes)) {
+        state = RxState::MAGIC1;
+        rxCount = 0;
+        handleFrame();
+      }
+      break;
+  }
+}
+
+// "M29", éventuellement précédé de "N<n>" et suivi d'une somme "*<n>" ou d'un commentaire
+static bool isEndLine(const char *line) {
+  const char *p = line;
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p == 'N' || *p == 'n') {
+    p++;
+    while (*p >= '0' && *p <= '9') p++;
+    while (*p == ' ' || *p == '\t') p++;
+  }
+  if ((*p != 'M' && *p != 'm') || p[1] != '2' || p[2] != '9') return false;
+  p += 3;
+  return *p == '\0' || *p == ' ' || *p == '\t' || *p == '*' || *p == ';';
+}
+
+void UploadManager::handleTextLine() {
+  if (isEndLine(textLine)) {
+    if (windowPending()) {
+      // Des blocs suivants attendent le bloc manquant : les écarter tronquerait le fichier
+      reportLine("ERROR: Upload incomplete, missing block %u\n", baseSeq);
+      reportLine("NAK %u\n", baseSeq);
+      return;
+    }
+    finish();
+  } else if (FaultBus::isEmergencyStopLine(textLine)) {
+    // Hors trame : l'arrêt d'urgence reste disponible pendant l'upload
+    faultBus.emergencyStop(FaultSource::UPLOAD, (uint32_t)esp_timer_get_time());
+    abort("emergency stop");
+  }
+}
+
+bool UploadManager::windowPending() const {
+  for (size_t i = 0; i < UPLOAD_WINDOW; i++) {
+    if (slotFull[i]) return true;
+  }
+  return false;
+}
+
+void UploadManager::handleFrame() {
+  uint32_t expected = crcBytes[0] | (crcBytes[1] << 8) | (crcBytes[2] << 16) | ((uint32_t)crcBytes[3] << 24);
+  uint32_t crc = crc32Update(0, header, sizeof(header));
+  crc = crc32Update(crc, rxTarget, rxLen);
+  if (crc != expected) {
+    crcErrors++;
+    reportLine("NAK %u\n", rxSeq);
+    return;
+  }
+
+  uint16_t offset = rxSeq - baseSeq;
+  if (rxLen == 0) {
+    // Fin de transfert : acceptée seulement quand tous les blocs précédents sont écrits
+    if (offset == 0) {
+      finish();
+    } else {
+      reportLine("NAK %u\n", baseSeq);
+    }
+    return;
+  }
+  if (offset >= 0x8000) {
+    // Bloc déjà écrit : l'ACK précédent a été perdu
+    duplicates++;
+    reportLine("ACK %u\n", rxSeq);
+    return;
+  }
+  if (offset >= UPLOAD_WINDOW) {
+    reportLine("NAK %u\n", baseSeq);
+    return;
+  }
+  uint16_t idx = rxSeq & (UPLOAD_WINDOW - 1);
+  if (slotFull[idx]) {
+    duplicates++;
+  } else {
+    slotLen[idx] = rxLen;
+    slotFull[idx] = true;
+    blocksReceived++;
+  }
+  reportLine("ACK %u\n", rxSeq);
+
+  // Trou devant ce bloc : on ne redemande que le bloc manquant, une seule fois
+  if (offset != 0 && !slotFull[baseSeq & (UPLOAD_WINDOW - 1)] && !baseNaked) {
+    baseNaked = true;
+    reportLine("NAK %u\n", baseSeq);
+  }
+  if (!drainWindow()) abort("SD write failed");
+}
+
+bool UploadManager::drainWindow() {
+  uint16_t idx = baseSeq & (UPLOAD_WINDOW - 1);
+  while (slotFull[idx]) {
+    if (!sdManager.write(slots[idx], slotLen[idx])) return false;
+    fileCrc = crc32Update(fileCrc, slots[idx], slotLen[idx]);
+    bytesReceived += slotLen[idx];
+    slotFull[idx] = false;
+    baseSeq++;
+    baseNaked = false;
+    idx = baseSeq & (UPLOAD_WINDOW - 1);
+  }
+  return true;
+}
+
+void UploadManager::finish() {
+  uint32_t written = 0;
+  bool ok = sdManager.endWrite(&written);
+  active = false;
+  unsigned long elapsed = millis() - startTime;
+  if (!ok) {
+    Serial.println("ERROR: Failed to finalize file");
+    return;
+  }
+  unsigned long rate = elapsed ? (unsigned long)((uint64_t)written * 1000 / elapsed) : 0;
+  DEBUG_PRINTF_AUTO("Upload terminé: %lu octets en %lu ms (%lu o/s)", (unsigned long)written, elapsed, rate);
+  reportLine("OK: UPLOAD_DONE bytes=%lu crc32=%08lx ms=%lu rate=%lu dup=%lu crcerr=%lu\n",
+             (unsigned long)written, (unsigned long)fileCrc, elapsed, rate,
+             (unsigned long)duplicates, (unsigned long)crcErrors);
+}
+
+void UploadManager::abort(const char *reason) {
+  sdManager.abortWrite();
+  active = false;
+  DEBUG_ERRORF_AUTO("Erreur: Upload annulé (%s)", reason);
+  reportLine("ERROR: Upload aborted (%s)\n", reason);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <Arduino.h>
+#include "../config.h"
+
+// Upload binaire vers la SD déclenché par "M28 <fichier> [taille]".
+// Trame : 0xA5 0x5A | seq (u16 LE) | len (u16 LE) | données | CRC32 (u32 LE, sur seq+len+données)
+// Réponses texte : "ACK <seq>", "NAK <seq>" (retransmission sélective), puis
+// "OK: UPLOAD_DONE ..." sur une trame de longueur nulle ou la ligne "M29" (numérotée ou
+// non), refusée tant que des blocs attendent un bloc manquant dans la fenêtre.
+class UploadManager {
+private:
+  enum class RxState { MAGIC1, MAGIC2, HEADER, PAYLOAD, CRC };
+
+  bool active;
+  RxState state;
+  uint8_t header[4];
+  uint8_t crcBytes[4];
+  size_t rxCount;
+  uint16_t rxSeq;
+  uint16_t rxLen;
+  uint8_t *rxTarget;
+  char textLine[UPLOAD_TEXT_LINE_MAX];
+  size_t textLen;
+  bool textOverflow;        // Ligne trop longue : ni M29 ni M112, ignorée jusqu'à '\n'
+
+  // Fenêtre de réception : le bloc seq occupe l'emplacement seq % UPLOAD_WINDOW
+  uint8_t slots[UPLOAD_WINDOW][UPLOAD_BLOCK_SIZE];
+  uint16_t slotLen[UPLOAD_WINDOW];
+  bool slotFull[UPLOAD_WINDOW];
+  uint8_t scratch[UPLOAD_BLOCK_SIZE];
+  uint16_t baseSeq;
+  bool baseNaked;
+
+  uint32_t fileCrc;
+  uint32_t bytesReceived;
+  uint32_t blocksReceived;
+  uint32_t duplicates;
+  uint32_t crcErrors;
+  unsigned long startTime;
+  unsigned long lastActivity;
+
+  void processByte(uint8_t b);
+  void handleTextLine();
+  bool windowPending() const;
+  void handleFrame();
+  bool drainWindow();
+  void finish();
+  void abort(const char *reason);
+
+public:
+  UploadManager();
+  // "<fichier> [taille]", sans blancs de bord
+  bool begin(const char *args);
+  bool isActive() const { return active; }
+  void poll();
+};
+
+extern UploadManager uploadManager;
@@ -2,22 +2,55 @@
 #include <lvgl_screen_display.h>
 #include <touchscreen_driver.h>
 #include "touch_event_handler.h"
+#include "../lib/config.h"
+#include "system_manager.h"
+#include "sd_manager.h"
+#include "comm_manager.h"
+#include "boot_sequencer.h"
+#include "heap_guard.h"
+#include "mem_placement.h"
 // #include <touch_calibration.h>
-// #include "system_manager.h"
 TouchEventHandler touchEventHandler(touchscreenDriver);
-void setup() {
-  Serial.begin(115200);
-  // put your setup code here, to run once:
-  display.begin();
+
+static bool bootQueues() { return systemManager.initQueues(); }
+static bool bootSd() { return sdManager.init(); }
+static bool bootTasks() { return systemManager.startTasks(); }
+// Sans tampons DMA, l'étape échoue : "input" est sautée et BOOT le signale
+static bool bootDisplay() { return display.begin(); }
+static bool bootTouch() {
   touchscreenDriver.begin();
+  return true;
+}
+static bool bootInput() {
   touchEventHandler.begin();
   touchEventHandler.attachButtonEvent(objects.button_test);
-  // systemManager.init();
+  return true;
+}
+
+void setup() {
+  commManager.init();
+  // Coût d'accès SRAM/PSRAM mesuré tant que le tas est libre (MEM)
+  memPlacement.init();
+  systemManager.startStatusLed();
+  // Écran, SD (FSPI) et tactile (HSPI) sur des contrôleurs SPI distincts : en parallèle.
+  // La calibration du tactile est en NVS, il n'attend pas la carte.
+  BootStageId queues = bootSequencer.addStage("queues", bootQueues);
+  BootStageId sd = bootSequencer.addStage("sd", bootSd, bootDep(queues));
+  BootStageId tasks = bootSequencer.addStage("tasks", bootTasks, bootDep(queues));
+  BootStageId screen = bootSequencer.addStage("display", bootDisplay, 0, 8192);
+  BootStageId touch = bootSequencer.addStage("touch", bootTouch);
+  bootSequencer.addStage("input", bootInput, bootDep(screen) | bootDep(touch));
+  // Les tâches démarrent sans carte SD : seules les commandes SD échoueront
+  bootSequencer.runAfter(tasks, sd);
+  bootSequencer.run();
+  // LVGL a sa propre tâche : démarrée une fois l'UI et l'entrée tactile créées
+  display.startTask();
+  // Fin du démarrage : en mode STATIC_ALLOCATION, toute allocation suivante est signalée
+  heapGuard.lock();
 }
 
 void loop() {
-  // put your main code here, to run repeatedly:
-  display.update();
-  delay(5);
+  // Plus rien à faire dans loopTask : sa pile retourne au tas
   // touch_calibration_loop();
-}
\ No newline at end of file
+  vTaskDelete(NULL);
+}
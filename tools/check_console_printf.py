@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""Vérifie qu'aucun Serial.printf ne reste dans lib/ ni src/.
+
+Serial.printf passe par malloc au-delà de 64 octets : en STATIC_ALLOCATION, chaque
+rapport console lèverait HEAP_AFTER_LOCK après le verrouillage du tas. Les lignes
+formatées passent par reportLine() (lib/report_line.h), sur la pile de l'appelant.
+
+Lancé avant chaque compilation par PlatformIO (extra_scripts = pre:...), ou seul :
+    tools/check_console_printf.py
+Code de sortie 1 et liste des occurrences si la règle n'est pas respectée.
+"""
+import os
+import re
+import sys
+
+PATTERN = re.compile(r"\bSerial\s*\.\s*printf\s*\(")
+DIRS = ("lib", "src")
+EXTENSIONS = (".h", ".hpp", ".c", ".cpp")
+
+
+def scan(root):
+    hits = []
+    for top in DIRS:
+        for base, _, files in os.walk(os.path.join(root, top)):
+            for name in sorted(files):
+                if not name.endswith(EXTENSIONS):
+                    continue
+                path = os.path.join(base, name)
+                with open(path, encoding="utf-8", errors="replace") as f:
+                    for number, line in enumerate(f, 1):
+                        if PATTERN.search(line):
+                            hits.append("%s:%d: %s" % (os.path.relpath(path, root), number, line.strip()))
+    return hits
+
+
+def check(root):
+    hits = scan(root)
+    for hit in hits:
+        print("Serial.printf interdit (utiliser reportLine) : " + hit, file=sys.stderr)
+    return not hits
+
+
+try:
+    Import("env")  # noqa: F821 - fourni par PlatformIO (SCons)
+    if not check(env.subst("$PROJECT_DIR")):  # noqa: F821
+        env.Exit(1)  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        sys.exit(0 if check(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))) else 1)
@@ -0,0 +1,205 @@
+#!/usr/bin/env python3
+"""Client du protocole binaire (COBS + CRC16) et mesure de latence / débit.
+
+    tools/host_proto.py /dev/ttyACM0 status
+    tools/host_proto.py /dev/ttyACM0 list
+    tools/host_proto.py /dev/pts/5 bench --count 2000 --size 64
+    tools/host_proto.py /dev/pts/5 motion --count 5000 --batch 12
+    tools/host_proto.py /dev/ttyACM0 estop
+
+La commande texte "BINARY" active le canal, la requête PROTO_TEXT le referme à la fin.
+"""
+import argparse
+import os
+import struct
+import sys
+import time
+
+from printer_link import Reader, open_port
+
+PING, STATUS, STATS, LIST_FILES, READ_FILE, MOTION_BATCH, PROTO_TEXT, LIST_END, EMERGENCY_STOP = range(1, 10)
+RESPONSE = 0x80
+ERROR = 0xFF
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray()
+    block = bytearray()
+    for b in data:
+        if b == 0:
+            out += bytes([len(block) + 1]) + block
+            block = bytearray()
+        else:
+            block.append(b)
+            if len(block) == 254:
+                out += b"\xff" + block
+                block = bytearray()
+    out += bytes([len(block) + 1]) + block
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data):
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code != 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Link:
+    def __init__(self, port, baud):
+        self.fd = open_port(port, baud)
+        self.reader = Reader(self.fd)
+        self.seq = 0
+        os.write(self.fd, b"BINARY\n")
+        while True:
+            line = self.reader.read_line(3.0)
+            if line is None:
+                sys.exit("pas de réponse à BINARY")
+            if line.startswith("OK: BINARY"):
+                break
+
+    def send(self, ptype, payload=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        raw = bytes([ptype, self.seq]) + payload
+        raw += struct.pack("<H", crc16(raw))
+        os.write(self.fd, b"\x00" + cobs_encode(raw) + b"\x00")
+        return self.seq
+
+    def receive(self, timeout=2.0):
+        """Prochain paquet valide (type, seq, charge utile) ; le texte intercalé est ignoré."""
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            chunk = self.reader.read_until(b"\x00", deadline - time.monotonic())
+            if chunk is None:
+                break
+            raw = cobs_decode(chunk) if chunk else None
+            if not raw or len(raw) < 4 or crc16(raw[:-2]) != struct.unpack("<H", raw[-2:])[0]:
+                continue
+            return raw[0], raw[1], raw[2:-2]
+        sys.exit("délai de réponse dépassé")
+
+    def request(self, ptype, payload=b""):
+        seq = self.send(ptype, payload)
+        while True:
+            rtype, rseq, body = self.receive()
+            if rseq != seq:
+                continue
+            if rtype == ERROR:
+                sys.exit("erreur carte, code %d" % body[0])
+            return rtype, body
+
+    def close(self):
+        self.request(PROTO_TEXT)
+        os.close(self.fd)
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100.0))]
+
+
+def cmd_status(link, args):
+    _, body = link.request(STATUS)
+    gq, mq, sq, upload, uptime, heap = struct.unpack("<BBBBII", body)
+    print("gcodeQueue=%d motionQueue=%d sdQueue=%d upload=%d uptime=%d ms heap=%d" % (gq, mq, sq, upload, uptime, heap))
+
+
+def cmd_stats(link, args):
+    _, body = link.request(STATS)
+    names = ("framesIn", "framesOut", "crcErrors", "frameErrors", "motionAccepted", "motionRejected",
+             "emergencyStops", "haltLastUs", "haltMaxUs", "haltBoundUs")
+    for name, value in zip(names, struct.unpack("<%dI" % (len(body) // 4), body)):
+        print("%-15s %d" % (name, value))
+
+
+def cmd_list(link, args):
+    seq = link.send(LIST_FILES)
+    while True:
+        rtype, rseq, body = link.receive()
+        if rseq != seq:
+            continue
+        if rtype == LIST_END | RESPONSE:
+            break
+        if rtype == ERROR:
+            sys.exit("erreur carte, code %d" % body[0])
+        print("%10d  %s" % (struct.unpack("<I", body[:4])[0], body[4:].decode(errors="replace")))
+
+
+def cmd_bench(link, args):
+    payload = bytes(range(256))[:args.size]
+    rtts = []
+    start = time.monotonic()
+    for _ in range(args.count):
+        t0 = time.monotonic()
+        _, body = link.request(PING, payload)
+        rtts.append((time.monotonic() - t0) * 1e3)
+        if body != payload:
+            sys.exit("écho corrompu")
+    elapsed = time.monotonic() - start
+    print("%d ping de %d octets : %.0f req/s, %.0f o/s utiles" % (args.count, args.size, args.count / elapsed,
+                                                               2 * args.count * args.size / elapsed))
+    print("latence ms : p50 %.2f  p95 %.2f  p99 %.2f  max %.2f" % (percentile(rtts, 50), percentile(rtts, 95),
+                                                                   percentile(rtts, 99), max(rtts)))
+
+
+def cmd_motion(link, args):
+    # G1 X Y E F en mm/s : 4 + 16 octets par commande
+    record = struct.pack("<BHB4f", ord("G"), 1, 0b11011, 10.0, 20.0, 0.05, 50.0)
+    sent = 0
+    rejected_batches = 0
+    start = time.monotonic()
+    while sent < args.count:
+        n = min(args.batch, args.count - sent)
+        _, body = link.request(MOTION_BATCH, record * n)
+        sent += body[0]
+        if body[0] < n:
+            rejected_batches += 1
+            time.sleep(0.001)
+    elapsed = time.monotonic() - start
+    print("%d commandes en %.2f s : %.0f cmd/s (%d lots partiellement refusés)"
+          % (sent, elapsed, sent / elapsed, rejected_batches))
+
+
+def cmd_estop(link, args):
+    # Arrêt d'urgence puis relevé des latences mesurées par la carte ; M999 sur la console pour reprendre
+    t0 = time.monotonic()
+    link.request(EMERGENCY_STOP)
+    rtt = (time.monotonic() - t0) * 1e3
+    _, body = link.request(STATS)
+    stops, last_us, max_us, bound_us = struct.unpack("<4I", body[24:40])
+    print("arrêt d'urgence : aller-retour %.2f ms, carte %d µs (max %d µs, borne %d µs, %d arrêts)"
+          % (rtt, last_us, max_us, bound_us, stops))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port")
+    parser.add_argument("command", choices=("status", "stats", "list", "bench", "motion", "estop"))
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--count", type=int, default=1000)
+    parser.add_argument("--size", type=int, default=32)
+    parser.add_argument("--batch", type=int, default=12)
+    args = parser.parse_args()
+    link = Link(args.port, args.baud)
+    globals()["cmd_" + args.command](link, args)
+    link.close()
+
+
+if __name__ == "__main__":
+    main()
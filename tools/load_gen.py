@@ -0,0 +1,440 @@
+#!/usr/bin/env python3
+"""Générateur de charge série et rejeu de sessions : débit, latences et renvois du flux G-code.
+
+Trois modes :
+  stream  envoie un fichier G-code ligne à ligne, numéroté "N<n> <commande>*<somme>" comme
+          un hôte Marlin, avec au plus --window lignes sans "ok" et au plus --rate lignes/s ;
+  replay  rejoue une session enregistrée, au rythme d'origine (--speed 1) ou au plus vite
+          (--speed 0) ;
+  record  s'intercale entre un hôte (Pronterface, OctoPrint...) et l'imprimante via un pty,
+          et enregistre la session horodatée pour la rejouer.
+
+Le bruit (--noise-rate : un octet de la commande altéré) et les pertes (--drop-rate : ligne
+jamais envoyée) sont tirés d'un générateur initialisé par --seed. À fenêtre 1, deux passes
+injectent donc les mêmes fautes aux mêmes lignes. Le "ok" de la carte arrive quand la ligne
+entre dans la file du flux HOST de GcodeScheduler (file propre à l'hôte, distincte de celle
+du job SD) : le débit mesuré est celui de la liaison et de cette file, pas celui du
+mouvement. Le rapport CSV (--csv) contient une ligne par commande, avec le nombre de
+tentatives, l'aller-retour de la dernière tentative et le délai total depuis le premier envoi.
+
+    tools/load_gen.py /dev/ttyACM0 stream job.gcode --window 4 --csv run.csv
+    tools/load_gen.py /dev/pts/5 stream job.gcode --noise-rate 0.01 --drop-rate 0.01
+    tools/load_gen.py /dev/ttyACM0 record bug.session --link /tmp/printer
+    tools/load_gen.py /tmp/vprinter replay bug.session --speed 0 --csv replay.csv
+
+Les commandes qui changent le mode de la liaison (M28, M29, BINARY) ne sont pas rejouées.
+"""
+import argparse
+import collections
+import csv
+import os
+import random
+import re
+import select
+import sys
+import time
+import tty
+
+from printer_link import Reader, open_port
+
+GCODE = re.compile(r"^[GM]\d")
+NUMBERED = re.compile(r"^N\d+\s*(.*?)\s*\*\d+\s*$")
+UNSAFE = ("M28", "M29", "BINARY")
+
+
+def checksum(text):
+    value = 0
+    for b in text.encode():
+        value ^= b
+    return value
+
+
+def strip_line(line):
+    """Commande telle que l'hôte l'a voulue : sans numéro, somme ni commentaire."""
+    line = line.strip()
+    match = NUMBERED.match(line)
+    if match:
+        line = match.group(1)
+    return line.split(";", 1)[0].strip()
+
+
+def load_gcode(path):
+    commands = []
+    with open(path, errors="replace") as f:
+        for raw in f:
+            line = strip_line(raw)
+            if line:
+                commands.append((None, line))
+    return commands
+
+
+def load_session(path):
+    commands = []
+    with open(path, errors="replace") as f:
+        for raw in f:
+            if raw.startswith("#"):
+                continue
+            fields = raw.rstrip("\n").split(" ", 2)
+            if len(fields) < 3 or fields[1] != ">":
+                continue
+            line = strip_line(fields[2])
+            # Numérotation et compteurs STREAM_* : propres à la passe, refaits au rejeu
+            if not line or line.startswith("M110") or line.startswith("STREAM_"):
+                continue
+            if line.split()[0] in UNSAFE:
+                print("ignorée au rejeu : %s" % line, file=sys.stderr)
+                continue
+            commands.append((float(fields[0]), line))
+    if commands:
+        first = commands[0][0]
+        commands = [(at - first, line) for at, line in commands]
+    return commands
+
+
+class Command:
+    def __init__(self, index, text, at):
+        self.index = index
+        self.text = text
+        self.at = at
+        # Les lignes G/M sont acquittées par "ok", les commandes console par OK:/ERROR:
+        self.gcode = bool(GCODE.match(text)) and not text.startswith("M112")
+        self.attempts = 0
+        self.first_sent = None
+        self.sent = None
+        self.done_at = None
+        self.status = ""
+        self.reply = ""
+
+
+class Transmission:
+    def __init__(self, command, ordinal):
+        self.command = command
+        self.ordinal = ordinal
+        self.rejected = False
+        self.error = ""
+
+
+class Streamer:
+    def __init__(self, fd, args, commands):
+        self.fd = fd
+        self.reader = Reader(fd)
+        self.args = args
+        self.commands = [Command(i, text, at) for i, (at, text) in enumerate(commands)]
+        self.rng = random.Random(args.seed)
+        self.next = 0
+        self.inflight = collections.deque()
+        self.ordinal = 0
+        self.last_ordinal = {}
+        self.done = 0
+        self.transmissions = self.resends = self.timeouts = self.errors = 0
+        self.noise = self.drops = 0
+        self.last_activity = time.monotonic()
+
+    def numbered(self):
+        return not self.args.plain
+
+    def wire(self, command):
+        if not self.numbered():
+            return command.text, 0
+        head = "N%d " % (command.index + 1)
+        body = head + command.text
+        return "%s*%d" % (body, checksum(body)), len(head)
+
+    def transmit(self, command, now):
+        if command.attempts:
+            self.resends += 1
+        command.attempts += 1
+        command.sent = now
+        if command.first_sent is None:
+            command.first_sent = now
+        self.transmissions += 1
+        self.ordinal += 1
+        self.last_ordinal[command.index] = self.ordinal
+        self.last_activity = now
+        text, start = self.wire(command)
+        # Deux tirages par envoi, qu'ils servent ou non : la suite reste reproductible
+        drop = self.rng.random() < self.args.drop_rate
+        noisy = self.rng.random() < self.args.noise_rate
+        if drop:
+            self.drops += 1
+            if not self.numbered():
+                # Sans numérotation, la carte ne peut pas réclamer la ligne : elle est perdue
+                self.finish(command, now, "dropped", "")
+            return
+        data = bytearray((text + "\n").encode())
+        # Jamais le premier octet : une ligne qui ne commence plus par N ou G/M n'aurait pas de "ok"
+        start = max(start, 1)
+        if noisy and len(data) - 1 > start:
+            self.noise += 1
+            pos = self.rng.randrange(start, len(data) - 1)
+            value = data[pos]
+            while value == data[pos]:
+                value = self.rng.randrange(0x21, 0x7F)
+            data[pos] = value
+        self.inflight.append(Transmission(command, self.ordinal))
+        os.write(self.fd, bytes(data))
+
+    def finish(self, command, now, status, reply):
+        command.done_at = now
+        command.status = status
+        command.reply = reply
+        self.done += 1
+
+    def pump(self, now, start):
+        """Envoie ce que la fenêtre et le cadencement autorisent ; rend la prochaine échéance."""
+        while self.next < len(self.commands):
+            command = self.commands[self.next]
+            if len(self.inflight) >= self.args.window:
+                return None
+            # Une commande console attend que la fenêtre soit vide, et la bloque jusqu'à sa réponse
+            if self.inflight and (not command.gcode or not self.inflight[-1].command.gcode):
+                return None
+            if command.attempts == 0:
+                if command.at is not None and self.args.speed > 0:
+                    due = start + command.at / self.args.speed
+                elif self.args.rate > 0:
+                    due = start + command.index / self.args.rate
+                else:
+                    due = now
+                if due > now:
+                    return due
+            self.transmit(command, now)
+            self.next += 1
+        return None
+
+    def on_line(self, line, now):
+        self.last_activity = now
+        head = self.inflight[0] if self.inflight else None
+        if line.startswith("Resend:"):
+            self.on_resend(line, head)
+            return
+        if "Last Line:" in line:
+            return
+        if line.startswith("ok"):
+            if head and (head.command.gcode or head.rejected):
+                self.acknowledge(now, line)
+            return
+        if line.startswith("OK:") or line.startswith("ERROR"):
+            if head and not head.command.gcode and not head.rejected:
+                self.acknowledge(now, line)
+            elif line.startswith("ERROR"):
+                # Erreur d'une ligne G/M (son "ok" suit) ou du parser, en différé
+                self.errors += 1
+                if head:
+                    head.error = line
+
+    def on_resend(self, line, head):
+        try:
+            index = int(line.split(":", 1)[1]) - 1
+        except ValueError:
+            return
+        if head is None:
+            return
+        head.rejected = True
+        # Les réponses aux lignes parties avant le renvoi de <index> sont périmées
+        if 0 <= index < self.next and self.last_ordinal.get(index, 0) <= head.ordinal:
+            self.next = index
+
+    def acknowledge(self, now, line):
+        sent = self.inflight.popleft()
+        if sent.rejected:
+            return
+        command = sent.command
+        if sent.error:
+            self.finish(command, now, "error", sent.error)
+        elif line.startswith("ERROR"):
+            self.errors += 1
+            self.finish(command, now, "error", line)
+        else:
+            self.finish(command, now, "ok", line)
+
+    def check_timeouts(self, now):
+        head = self.inflight[0] if self.inflight else None
+        idle = now - self.last_activity
+        if head and not head.command.gcode and not head.rejected and idle > self.args.quiet:
+            # Commande console sans OK:/ERROR: final (STATS, HEALTH...) : finie quand la carte se tait
+            self.inflight.popleft()
+            self.finish(head.command, now, "quiet", "")
+            return
+        if idle < self.args.timeout:
+            return
+        if not head and self.next < len(self.commands):
+            return
+        self.timeouts += 1
+        self.last_activity = now
+        self.inflight.clear()
+        pending = [c.index for c in self.commands if c.done_at is None]
+        if not pending:
+            return
+        if self.numbered():
+            self.next = min(self.next, pending[0])
+        else:
+            self.finish(self.commands[pending[0]], now, "timeout", "")
+
+    def run(self):
+        self.drain()
+        if self.numbered():
+            self.request("M110 N0", "ok")
+        self.request("STREAM_RESET", "OK")
+        start = time.monotonic()
+        while self.done < len(self.commands):
+            now = time.monotonic()
+            due = self.pump(now, start)
+            wait = 0.05 if due is None else max(0.0, min(0.05, due - now))
+            line = self.reader.read_line(wait)
+            now = time.monotonic()
+            if line:
+                self.on_line(line, now)
+            else:
+                self.check_timeouts(now)
+        elapsed = time.monotonic() - start
+        return elapsed, self.request("STREAM_STATS", "STREAM ")
+
+    def drain(self):
+        while self.reader.read_line(0.2) is not None:
+            pass
+
+    def request(self, text, prefix, timeout=1.0):
+        os.write(self.fd, (text + "\n").encode())
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            line = self.reader.read_line(deadline - time.monotonic())
+            if line is None:
+                break
+            if line.startswith(prefix):
+                return line
+            if line.startswith("ERROR"):
+                break
+        return None
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(p * len(ordered)))]
+
+
+def report(streamer, elapsed, firmware, args):
+    commands = streamer.commands
+    rtts = [(c.done_at - c.sent) * 1000.0 for c in commands if c.status in ("ok", "error")]
+    fields = [
+        ("mode", args.mode), ("file", os.path.basename(args.file)),
+        ("lines", len(commands)), ("ok", sum(c.status == "ok" for c in commands)),
+        ("elapsed_s", "%.3f" % elapsed),
+        ("lines_per_s", "%.1f" % (len(commands) / elapsed if elapsed else 0.0)),
+        ("sent", streamer.transmissions), ("resends", streamer.resends),
+        ("resend_rate", "%.4f" % (streamer.resends / float(streamer.transmissions or 1))),
+        ("noise", streamer.noise), ("drops", streamer.drops),
+        ("timeouts", streamer.timeouts), ("errors", streamer.errors),
+        ("rtt_p50_ms", "%.2f" % percentile(rtts, 0.50)), ("rtt_p95_ms", "%.2f" % percentile(rtts, 0.95)),
+        ("rtt_p99_ms", "%.2f" % percentile(rtts, 0.99)), ("rtt_max_ms", "%.2f" % max(rtts or [0.0])),
+    ]
+    if firmware:
+        # Compteurs de la carte (STREAM_STATS) : les renvois qu'elle a demandés
+        counters = dict(kv.split("=") for kv in firmware.split()[1:] if "=" in kv)
+        fields.append(("fw_resends", counters.get("resends", "?")))
+        fields.append(("fw_queue_waits", counters.get("queue_waits", "?")))
+    print("LOADGEN " + " ".join("%s=%s" % kv for kv in fields))
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["index", "line", "command", "attempts", "first_sent_s", "rtt_ms", "total_ms",
+                             "status", "reply"])
+            origin = min(c.first_sent for c in commands if c.first_sent is not None)
+            for c in commands:
+                sent = c.first_sent - origin if c.first_sent is not None else ""
+                rtt = "%.3f" % ((c.done_at - c.sent) * 1000.0) if c.status in ("ok", "error") else ""
+                total = "%.3f" % ((c.done_at - c.first_sent) * 1000.0) if c.done_at and c.first_sent else ""
+                writer.writerow([c.index, c.index + 1, c.text, c.attempts, "%.6f" % sent if sent != "" else "",
+                                 rtt, total, c.status, c.reply])
+    return 0 if all(c.status in ("ok", "quiet") for c in commands) else 1
+
+
+def stream(args):
+    commands = load_session(args.file) if args.mode == "replay" else load_gcode(args.file)
+    if not commands:
+        sys.exit("aucune commande dans %s" % args.file)
+    fd = open_port(args.port, args.baud)
+    streamer = Streamer(fd, args, commands)
+    elapsed, firmware = streamer.run()
+    os.close(fd)
+    return report(streamer, elapsed, firmware, args)
+
+
+def record(args):
+    """Proxy pty <-> imprimante : chaque ligne est horodatée, '>' vers la carte, '<' retour."""
+    fd = open_port(args.port, args.baud)
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    # Sans client, la sortie de la carte vers le pty est perdue plutôt que bloquante
+    os.set_blocking(master, False)
+    name = os.ttyname(slave)
+    if args.link:
+        if os.path.islink(args.link):
+            os.unlink(args.link)
+        os.symlink(name, args.link)
+    print("enregistrement : hôte sur %s -> %s, Ctrl-C pour terminer" % (args.link or name, args.port))
+    pending = {master: b"", fd: b""}
+    counts = {master: 0, fd: 0}
+    start = None
+    with open(args.file, "w") as out:
+        out.write("# load_gen session port=%s baud=%d\n" % (args.port, args.baud))
+        try:
+            while True:
+                ready, _, _ = select.select([master, fd], [], [])
+                for src in ready:
+                    try:
+                        data = os.read(src, 4096)
+                    except OSError:
+                        data = b""
+                    if not data:
+                        continue
+                    try:
+                        os.write(fd if src == master else master, data)
+                    except BlockingIOError:
+                        pass
+                    now = time.monotonic()
+                    if start is None:
+                        start = now
+                    lines = (pending[src] + data).split(b"\n")
+                    pending[src] = lines.pop()
+                    for line in lines:
+                        text = line.decode(errors="replace").rstrip("\r")
+                        out.write("%.6f %s %s\n" % (now - start, ">" if src == master else "<", text))
+                        counts[src] += 1
+                out.flush()
+        except KeyboardInterrupt:
+            pass
+    if args.link and os.path.islink(args.link):
+        os.unlink(args.link)
+    print("%s : %d lignes de l'hôte, %d de la carte" % (args.file, counts[master], counts[fd]))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="port série ou pty de l'imprimante")
+    parser.add_argument("mode", choices=("stream", "replay", "record"))
+    parser.add_argument("file", help="G-code à envoyer, session à rejouer ou à enregistrer")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--window", type=int, default=1, help="lignes envoyées sans 'ok' (défaut: 1)")
+    parser.add_argument("--rate", type=float, default=0.0, help="lignes/s au plus (0: au rythme des 'ok')")
+    parser.add_argument("--speed", type=float, default=1.0, help="rejeu : facteur de vitesse, 0 au plus vite")
+    parser.add_argument("--plain", action="store_true", help="lignes sans numéro ni somme de contrôle")
+    parser.add_argument("--noise-rate", type=float, default=0.0, help="proportion de lignes altérées")
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="proportion de lignes non envoyées")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--timeout", type=float, default=5.0, help="silence (s) avant renvoi")
+    parser.add_argument("--quiet", type=float, default=0.5, help="silence (s) qui termine une commande console")
+    parser.add_argument("--csv", help="rapport par commande")
+    parser.add_argument("--link", help="record : lien symbolique vers le pty côté hôte")
+    args = parser.parse_args()
+    if args.window < 1:
+        parser.error("--window doit valoir au moins 1")
+    sys.exit(record(args) if args.mode == "record" else stream(args))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,48 @@
+"""Accès brut à la liaison série de l'imprimante (port réel ou pty), sans pyserial."""
+import os
+import select
+import termios
+import time
+
+BAUD_CONSTANTS = {
+    9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+    57600: termios.B57600, 115200: termios.B115200, 230400: termios.B230400,
+}
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    attrs = termios.tcgetattr(fd)
+    attrs[0] = 0                                   # iflag
+    attrs[1] = 0                                   # oflag
+    attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+    attrs[3] = 0                                   # lflag : mode brut
+    speed = BAUD_CONSTANTS.get(baud, termios.B115200)
+    attrs[4] = attrs[5] = speed
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+class Reader:
+    """Tampon de réception partagé entre lecture par ligne et par délimiteur."""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.buf = b""
+
+    def read_until(self, delim, timeout):
+        deadline = time.monotonic() + timeout
+        while delim not in self.buf:
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                return None
+            ready, _, _ = select.select([self.fd], [], [], remaining)
+            if ready:
+                self.buf += os.read(self.fd, 4096)
+        chunk, self.buf = self.buf.split(delim, 1)
+        return chunk
+
+    def read_line(self, timeout):
+        line = self.read_until(b"\n", timeout)
+        return None if line is None else line.decode(errors="replace").strip()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Upload d'un fichier sur la carte SD de l'imprimante via M28/M29 (protocole binaire fenêtré).
+
+Trame envoyée : 0xA5 0x5A | seq u16 | len u16 | données | CRC32 u32 (little endian,
+CRC sur seq+len+données). La carte répond "ACK <seq>" / "NAK <seq>" ligne par ligne et
+termine par "OK: UPLOAD_DONE bytes=... crc32=...", vérifié ici contre le fichier local.
+
+Fonctionne sur un port série réel comme sur un pty (imprimante virtuelle) :
+    tools/sd_upload.py /dev/ttyACM0 job.gcode
+    tools/sd_upload.py /dev/pts/5 job.gcode --name /job.gcode --corrupt-rate 0.01
+"""
+import argparse
+import os
+import random
+import struct
+import sys
+import time
+import zlib
+
+from printer_link import Reader, open_port
+
+MAGIC = b"\xa5\x5a"
+
+
+def frame(seq, payload, corrupt=False):
+    header = struct.pack("<HH", seq & 0xFFFF, len(payload))
+    crc = zlib.crc32(header + payload) & 0xFFFFFFFF
+    if corrupt:
+        crc ^= 0x1
+    return MAGIC + header + payload + struct.pack("<I", crc)
+
+
+def wait_for(reader, prefix, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        line = reader.read_line(deadline - time.monotonic())
+        if line is None:
+            break
+        if line.startswith("ERROR"):
+            sys.exit("carte: " + line)
+        if line.startswith(prefix):
+            return line
+    sys.exit("délai dépassé en attente de '%s'" % prefix)
+
+
+def upload(args):
+    data = open(args.file, "rb").read()
+    name = args.name or "/" + os.path.basename(args.file)
+    fd = open_port(args.port, args.baud)
+    reader = Reader(fd)
+    os.write(fd, ("M28 %s %d\n" % (name, len(data))).encode())
+    ready = wait_for(reader, "OK: UPLOAD_READY", 5.0)
+    fields = dict(kv.split("=") for kv in ready.split()[2:])
+    block, window = int(fields["block"]), int(fields["window"])
+
+    blocks = [data[i:i + block] for i in range(0, len(data), block)]
+    acked = [False] * len(blocks)
+    sent_at = {}
+    base = next_seq = 0
+    resent = 0
+    start = time.monotonic()
+
+    def send(seq):
+        nonlocal resent
+        if seq in sent_at:
+            resent += 1
+        sent_at[seq] = time.monotonic()
+        if random.random() < args.drop_rate:
+            return
+        os.write(fd, frame(seq, blocks[seq], random.random() < args.corrupt_rate))
+
+    while base < len(blocks):
+        while next_seq < len(blocks) and next_seq < base + window:
+            send(next_seq)
+            next_seq += 1
+        line = reader.read_line(args.ack_timeout)
+        if line is None:
+            # Aucune réponse : seuls les blocs non acquittés de la fenêtre sont renvoyés
+            for seq in range(base, next_seq):
+                if not acked[seq]:
+                    send(seq)
+            continue
+        kind, _, value = line.partition(" ")
+        if kind not in ("ACK", "NAK"):
+            if line.startswith("ERROR"):
+                sys.exit("carte: " + line)
+            continue
+        # Le numéro de séquence fait 16 bits : on le replace dans la fenêtre courante
+        seq = base + ((int(value) - base) & 0xFFFF)
+        if seq >= len(blocks):
+            continue
+        if kind == "ACK":
+            acked[seq] = True
+            while base < len(blocks) and acked[base]:
+                base += 1
+        elif not acked[seq]:
+            send(seq)
+
+    os.write(fd, frame(len(blocks), b""))
+    done = wait_for(reader, "OK: UPLOAD_DONE", 30.0)
+    elapsed = time.monotonic() - start
+    fields = dict(kv.split("=") for kv in done.split()[2:])
+    local_crc = "%08x" % (zlib.crc32(data) & 0xFFFFFFFF)
+    ok = int(fields["bytes"]) == len(data) and fields["crc32"] == local_crc
+    rate = len(data) / elapsed if elapsed else 0
+    link = args.baud / 10.0
+    print("%s: %d octets en %.2f s, %.0f o/s (%.0f%% du débit série), %d blocs renvoyés"
+          % (name, len(data), elapsed, rate, 100.0 * rate / link, resent))
+    print("crc32 local %s / carte %s -> %s" % (local_crc, fields["crc32"], "OK" if ok else "ÉCHEC"))
+    os.close(fd)
+    return 0 if ok else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="port série ou pty de l'imprimante")
+    parser.add_argument("file", help="fichier local à envoyer")
+    parser.add_argument("--name", help="chemin sur la carte (défaut: /<nom du fichier>)")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--ack-timeout", type=float, default=0.5)
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="proportion de blocs non envoyés")
+    parser.add_argument("--corrupt-rate", type=float, default=0.0, help="proportion de blocs au CRC faux")
+    sys.exit(upload(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Conversion d'un vidage TRACE_DUMP en trace JSON Chrome (chrome://tracing, ui.perfetto.dev).
+
+Le vidage est lu depuis un fichier déjà capturé ou directement sur la liaison série :
+    tools/trace_to_chrome.py --port /dev/ttyACM0 -o trace.json
+    tools/trace_to_chrome.py dump.txt -o trace.json
+
+Une piste par tâche FreeRTOS (tid = indice de tâche, lignes "T" du vidage) : deux tâches
+épinglées sur le même cœur ne s'imbriquent plus sur une même piste. Le cœur reste dans les
+arguments de chaque événement. Les compteurs (profondeur des queues) en événements "C".
+Un vidage ancien, sans colonne tâche, retombe sur une piste par cœur.
+"""
+import argparse
+import json
+import os
+import sys
+
+from printer_link import Reader, open_port
+
+PHASES = {0: "B", 1: "E", 2: "C", 3: "i"}
+TASK_OTHER = 255
+
+
+def capture(port, baud, timeout):
+    fd = open_port(port, baud)
+    reader = Reader(fd)
+    os.write(fd, b"TRACE_DUMP\n")
+    lines = []
+    started = False
+    while True:
+        line = reader.read_line(timeout)
+        if line is None:
+            sys.exit("délai dépassé pendant la lecture du vidage")
+        if line.startswith("TRACE_BEGIN"):
+            started = True
+        if started:
+            lines.append(line)
+        if line == "TRACE_END":
+            break
+    os.close(fd)
+    return lines
+
+
+def convert(lines):
+    names = {}
+    tasks = {}
+    per_core = False
+    events = []
+    header = {}
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "TRACE_BEGIN":
+            header = dict(kv.split("=") for kv in fields[1:])
+        elif fields[0] == "N":
+            names[int(fields[1])] = fields[2]
+        elif fields[0] == "T":
+            tasks[int(fields[1])] = " ".join(fields[2:])
+        elif fields[0] == "E":
+            ts, kind, ident, core, value = (int(v) for v in fields[1:6])
+            if len(fields) > 6:
+                tid = int(fields[6])
+            else:
+                tid = core
+                per_core = True
+            name = names.get(ident, "id%d" % ident)
+            event = {"name": name, "ph": PHASES.get(kind, "i"), "ts": ts, "pid": 0, "tid": tid}
+            if kind == 2:
+                event["args"] = {name: value}
+            elif kind == 3:
+                event["s"] = "t"
+                event["args"] = {"value": value, "core": core}
+            else:
+                event["args"] = {"value": value, "core": core} if value else {"core": core}
+            events.append(event)
+    # Les horodatages 32 bits rebouclent après ~71 min : on déplie avant de trier
+    offset = 0
+    previous = None
+    for event in events:
+        if previous is not None and event["ts"] + offset < previous - (1 << 31):
+            offset += 1 << 32
+        event["ts"] += offset
+        previous = event["ts"]
+    events.sort(key=lambda e: e["ts"])
+    for tid in sorted({e["tid"] for e in events}):
+        if per_core:
+            label = "core %d" % tid
+        elif tid == TASK_OTHER:
+            label = "other"
+        else:
+            label = tasks.get(tid, "task %d" % tid)
+        events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": tid,
+                       "args": {"name": label}})
+    return {"traceEvents": events, "displayTimeUnit": "ms", "otherData": header}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("dump", nargs="?", help="fichier de vidage (sinon --port)")
+    parser.add_argument("--port", help="port série ou pty de l'imprimante")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("-o", "--output", default="trace.json")
+    args = parser.parse_args()
+    if args.port:
+        lines = capture(args.port, args.baud, args.timeout)
+    elif args.dump:
+        lines = open(args.dump).read().splitlines()
+    else:
+        parser.error("fichier de vidage ou --port requis")
+    trace = convert(lines)
+    with open(args.output, "w") as out:
+        json.dump(trace, out)
+    header = trace["otherData"]
+    print("%d événements -> %s (perdus: %s, coût par événement: %s ns)"
+          % (len(trace["traceEvents"]), args.output, header.get("lost", "?"), header.get("overhead_ns", "?")))
+
+
+if __name__ == "__main__":
+    main()